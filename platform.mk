@@ -0,0 +1 @@
+ARCH_PLATFORM?=x86-i386
\ No newline at end of file
@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2018-2022, BookOS Development Team
+# SPDX-License-Identifier: Apache-2.0
+#
+# Contains: Decode trace dumped by NX_TraceDump to Chrome trace json
+#
+# Usage: trace2json.py console.log [trace.json]
+# Open the json in chrome://tracing or https://ui.perfetto.dev
+#
+
+import json
+import re
+import sys
+
+# same as enum NX_TraceEvent in src/include/utils/trace.h
+SCHED_SWITCH = 1
+SCHED_ENQUEUE = 2
+SCHED_DEQUEUE = 3
+IRQ_ENTER = 4
+IRQ_EXIT = 5
+TIMER_FIRE = 6
+HEAP_ALLOC = 7
+HEAP_FREE = 8
+
+# irq slices are put on a pseudo thread of each cpu
+IRQ_TID_BASE = 1000000
+
+TID_NONE = 0xffffffffffffffff
+
+
+def to_tid(value):
+    # tid -1 is sign extended on 32 bit and 64 bit arch
+    if value in (TID_NONE, 0xffffffff):
+        return -1
+    return value
+
+
+def parse(lines):
+    freq = 0
+    threads = {}
+    records = []
+    for line in lines:
+        # console may add color or time before, find the tag in line
+        m = re.search(r'NX_TRACE_BEGIN (\d+) ([0-9a-f]+)', line)
+        if m:
+            freq = int(m.group(2), 16)
+            threads = {}
+            records = []
+            continue
+        m = re.search(r'NX_TRACE_THREAD (\d+) (.*)$', line)
+        if m:
+            threads[int(m.group(1))] = m.group(2).strip()
+            continue
+        m = re.search(r'NX_TRACE (\d+) (\d+) ([0-9a-f]+) ([0-9a-f]+) ([0-9a-f]+) ([0-9a-f]+)', line)
+        if m:
+            records.append((int(m.group(3), 16), int(m.group(1)), int(m.group(2)),
+                            [int(m.group(i), 16) for i in range(4, 7)]))
+    if freq == 0:
+        raise SystemExit('no NX_TRACE_BEGIN found in dump')
+    records.sort(key=lambda r: r[0])
+    return freq, threads, records
+
+
+def convert(freq, threads, records):
+    events = []
+    if not records:
+        return events
+    start = records[0][0]
+    running = {}    # cpu -> (tid, begin us)
+    irqs = {}       # cpu -> [(irqno, begin us)]
+    cpus = set()
+
+    def us(time):
+        return (time - start) * 1000000.0 / freq
+
+    def thread_name(tid):
+        return threads.get(tid, 'tid %d' % tid)
+
+    for time, cpu, event, args in records:
+        ts = us(time)
+        cpus.add(cpu)
+        if event == SCHED_SWITCH:
+            prev = running.get(cpu)
+            if prev is not None:
+                events.append({'name': thread_name(prev[0]), 'ph': 'X', 'pid': cpu, 'tid': prev[0],
+                               'ts': prev[1], 'dur': ts - prev[1]})
+            running[cpu] = (to_tid(args[1]), ts)
+        elif event == IRQ_ENTER:
+            irqs.setdefault(cpu, []).append((args[0], ts))
+        elif event == IRQ_EXIT:
+            stack = irqs.get(cpu)
+            if stack:
+                irqno, begin = stack.pop()
+                events.append({'name': 'irq %d' % irqno, 'ph': 'X', 'pid': cpu,
+                               'tid': IRQ_TID_BASE + cpu, 'ts': begin, 'dur': ts - begin})
+        else:
+            tid = running[cpu][0] if cpu in running else 0
+            if event in (SCHED_ENQUEUE, SCHED_DEQUEUE):
+                name = 'enqueue' if event == SCHED_ENQUEUE else 'dequeue'
+                detail = {'thread': thread_name(to_tid(args[0])), 'core': args[1]}
+            elif event == TIMER_FIRE:
+                name = 'timer'
+                detail = {'timer': hex(args[0]), 'handler': hex(args[1])}
+            elif event == HEAP_ALLOC:
+                name = 'alloc'
+                detail = {'object': hex(args[0]), 'size': args[1]}
+            elif event == HEAP_FREE:
+                name = 'free'
+                detail = {'object': hex(args[0])}
+            else:
+                name = 'event %d' % event
+                detail = {'args': [hex(a) for a in args]}
+            events.append({'name': name, 'ph': 'i', 's': 't', 'pid': cpu, 'tid': tid,
+                           'ts': ts, 'args': detail})
+
+    # close slices still running at end of dump
+    end = us(records[-1][0])
+    for cpu, (tid, begin) in running.items():
+        events.append({'name': thread_name(tid), 'ph': 'X', 'pid': cpu, 'tid': tid,
+                       'ts': begin, 'dur': end - begin})
+
+    for cpu in sorted(cpus):
+        events.append({'name': 'process_name', 'ph': 'M', 'pid': cpu, 'args': {'name': 'CPU %d' % cpu}})
+        events.append({'name': 'thread_name', 'ph': 'M', 'pid': cpu, 'tid': IRQ_TID_BASE + cpu,
+                       'args': {'name': 'IRQ'}})
+        for tid, name in threads.items():
+            events.append({'name': 'thread_name', 'ph': 'M', 'pid': cpu, 'tid': tid,
+                           'args': {'name': '%s/%d' % (name, tid)}})
+    return events
+
+
+def main():
+    if len(sys.argv) < 2:
+        raise SystemExit('usage: %s console.log [trace.json]' % sys.argv[0])
+    with open(sys.argv[1], errors='replace') as f:
+        freq, threads, records = parse(f)
+    trace = {'traceEvents': convert(freq, threads, records), 'displayTimeUnit': 'ns'}
+    if len(sys.argv) > 2:
+        with open(sys.argv[2], 'w') as f:
+            json.dump(trace, f)
+    else:
+        json.dump(trace, sys.stdout)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,51 @@
+/**
+ * Copyright (c) 2018-2022, BookOS Development Team
+ * SPDX-License-Identifier: Apache-2.0
+ * 
+ * Contains: Flattened device tree(FDT)
+ */
+
+#ifndef __RISCV_FDT__
+#define __RISCV_FDT__
+
+#include <xbook.h>
+
+#define FDT_MAGIC           0xd00dfeed
+
+#define FDT_BEGIN_NODE      0x1
+#define FDT_END_NODE        0x2
+#define FDT_PROP            0x3
+#define FDT_NOP             0x4
+#define FDT_END             0x9
+
+#define FDT_MAX_MEM_REGIONS 8
+
+struct FDT_Header
+{
+    NX_U32 magic;
+    NX_U32 totalSize;
+    NX_U32 offDtStruct;
+    NX_U32 offDtStrings;
+    NX_U32 offMemRsvmap;
+    NX_U32 version;
+    NX_U32 lastCompVersion;
+    NX_U32 bootCpuidPhys;
+    NX_U32 sizeDtStrings;
+    NX_U32 sizeDtStruct;
+};
+typedef struct FDT_Header FDT_Header;
+
+struct FDT_MemRegion
+{
+    NX_U64 base;
+    NX_U64 size;
+};
+typedef struct FDT_MemRegion FDT_MemRegion;
+
+/* dtb address passed by SBI in a1, saved by boot entry */
+NX_IMPORT NX_Addr CPU_BootFdtAddr;
+
+NX_PUBLIC NX_Bool FDT_Check(void *fdt);
+NX_PUBLIC int FDT_GetMemRegions(void *fdt, FDT_MemRegion *regions, int maxRegions);
+
+#endif /* __RISCV_FDT__ */
@@ -0,0 +1,22 @@
+/**
+ * Copyright (c) 2018-2022, BookOS Development Team
+ * SPDX-License-Identifier: Apache-2.0
+ * 
+ * Contains: Word copy & set for memory utils
+ */
+
+#ifndef __PLATFORM_MEM_OPS__
+#define __PLATFORM_MEM_OPS__
+
+#include <xbook.h>
+
+/* misaligned load & store trap into sbi, very slow */
+#define HAL_MEM_UNALIGNED_ACCESS 0
+
+/**
+ * dst and src must be 8 bytes aligned, see mem_ops.S
+ */
+NX_PUBLIC void HAL_MemCopyWords(void *dst, const void *src, NX_USize words);
+NX_PUBLIC void HAL_MemSetWords(void *dst, NX_UArch value, NX_USize words);
+
+#endif  /* __PLATFORM_MEM_OPS__ */
@@ -14,6 +14,8 @@
 
 #include <xbook.h>
 #include <mm/page.h>
+#include <xbook/atomic.h>
+#include <sched/spin.h>
 
 // page table entry (PTE) fields
 #define PTE_V     0x001 // Valid
@@ -25,6 +27,9 @@
 #define PTE_A     0x040 // Accessed
 #define PTE_D     0x080 // Dirty
 #define PTE_SOFT  0x300 // Reserved for Software
+#define PTE_COW   0x100 // Copy on write, use software bit
+
+#define PTE_ATTR_MASK 0x3FF
 
 #define PTE_PPN_SHIFT 10
 
@@ -36,8 +41,9 @@
 #define PAGE_ATTR_USER (PTE_U)
 #define PAGE_ATTR_SYSTEM (0)
 
-#define PAGE_DEFAULT_ATTR_LEAF (PAGE_ATTR_RWX | PAGE_ATTR_USER | PTE_V | PTE_G)
-#define PAGE_DEFAULT_ATTR_NEXT (PAGE_ATTR_NEXT_LEVEL | PTE_V | PTE_G)
+/* user pages are tagged by asid, only kernel pages are global */
+#define PAGE_DEFAULT_ATTR_LEAF (PAGE_ATTR_RWX | PAGE_ATTR_USER | PTE_V)
+#define PAGE_DEFAULT_ATTR_NEXT (PAGE_ATTR_NEXT_LEVEL | PTE_V)
 #define PAGE_DEFAULT_ATTR_KERNEL (PAGE_ATTR_RWX | PAGE_ATTR_SYSTEM | PTE_V | PTE_G)
 
 #define PAGE_IS_LEAF(pte) ((pte) & PAGE_ATTR_RWX)
@@ -51,6 +57,13 @@
 #define VPN_SHIFT(level)  (NX_PAGE_SHIFT + (9 * (level)))
 #define GET_LEVEL_OFF(level, va) ((((NX_Addr)(va)) >> VPN_SHIFT(level)) & VPN_MASK)
 
+/* leaf pte on level 1 maps 2MB mega page, on level 2 maps 1GB giga page */
+#define PAGE_LEVEL_SIZE(level)  (1UL << VPN_SHIFT(level))
+#define PAGE_LEVEL_PAGES(level) (1UL << (9 * (level)))
+#define PAGE_MAX_LEAF_LEVEL     2
+
+#define PTE_PER_TABLE (NX_PAGE_SIZE / sizeof(MMU_PTE))
+
 /* bit 0-9 is attr, bit 10 ~ 37 is PPN */
 #define PTE2PADDR(pte) ((((pte) >> 10) & 0xFFFFFFF) << NX_PAGE_SHIFT)
 #define PADDR2PTE(pa) ((((NX_Addr)pa) >> 12) << 10)
@@ -58,17 +71,42 @@
 /* use sv39 mmu mode */
 #define MMU_MODE_SV39   0x08
 #define MMU_MODE_BIT_SHIFT   60
-#define MAKE_SATP(pageTable) (((NX_USize)MMU_MODE_SV39 << MMU_MODE_BIT_SHIFT) | (((NX_Addr)pageTable) >> NX_PAGE_SHIFT))
+#define SATP_ASID_SHIFT 44
+#define SATP_ASID_MASK  0xFFFFUL
+#define SATP_PPN_MASK   0xFFFFFFFFFFFUL
+#define MAKE_SATP(pageTable, asid) (((NX_USize)MMU_MODE_SV39 << MMU_MODE_BIT_SHIFT) | \
+    (((NX_USize)(asid) & SATP_ASID_MASK) << SATP_ASID_SHIFT) | (((NX_Addr)pageTable) >> NX_PAGE_SHIFT))
+
+#define GET_ADDR_FROM_SATP(satp) ((((NX_Addr)satp) & SATP_PPN_MASK) << NX_PAGE_SHIFT)
 
-#define GET_ADDR_FROM_SATP(satp) ((((NX_Addr)satp) << NX_PAGE_SHIFT))
+/* asid 0 is used by kernel page table, asid with old generation must realloc */
+#define MMU_ASID_KERNEL 0
 
 NX_INLINE void SFenceVMA()
 {
     NX_CASM("sfence.vma");
 }
 
+NX_INLINE void SFenceVMAAddr(NX_Addr addr)
+{
+    NX_CASM("sfence.vma %0" : : "r" (addr) : "memory");
+}
+
+NX_INLINE void SFenceVMAAsid(NX_U64 asid)
+{
+    NX_CASM("sfence.vma zero, %0" : : "r" (asid) : "memory");
+}
+
+NX_INLINE void SFenceVMAAddrAsid(NX_Addr addr, NX_U64 asid)
+{
+    NX_CASM("sfence.vma %0, %1" : : "r" (addr), "r" (asid) : "memory");
+}
+
 #define MMU_FlushTLB() SFenceVMA()
 
+/* flush whole tlb when range has more pages */
+#define MMU_FLUSH_TLB_RANGE_MAX 32
+
 typedef NX_U64 MMU_PDE; /* page dir entry */
 typedef NX_U64 MMU_PTE; /* page table entry */
 
@@ -78,16 +116,31 @@ struct MMU
     NX_Addr virStart;
     NX_Addr virEnd;
     NX_Addr earlyEnd;
+    NX_Atomic *cpuMask; /* cores have loaded this table, NX_NULL means kernel table */
+    NX_Spin *lock;      /* lock of table changes, NX_NULL means kernel table */
 };
 typedef struct MMU MMU;
 
 NX_PUBLIC void MMU_InitTable(MMU *mmu, void *pageTable, NX_Addr virStart, NX_USize size);
 NX_PUBLIC void MMU_SetPageTable(NX_Addr addr);
 NX_PUBLIC NX_Addr MMU_GetPageTable(void);
+NX_PUBLIC void MMU_InitAsid(void);
+NX_PUBLIC void MMU_SwitchPageTable(NX_Addr addr, NX_U64 *asid);
 
 NX_PUBLIC void *MMU_MapPage(MMU *mmu, NX_Addr virAddr, NX_USize size, NX_UArch attr);
 NX_PUBLIC void *MMU_MapPageWithPhy(MMU *mmu, NX_Addr virAddr, NX_Addr phyAddr, NX_USize size, NX_UArch attr);
+NX_PUBLIC NX_Error MMU_MapPageLocked(MMU *mmu, NX_Addr virAddr, NX_Addr phyAddr, NX_UArch attr);
 NX_PUBLIC NX_Error MMU_UnmapPage(MMU *mmu, NX_Addr virAddr, NX_USize size);
+NX_PUBLIC NX_Error MMU_UnmapSparse(MMU *mmu, NX_Addr virAddr, NX_USize size);
+NX_PUBLIC NX_Bool MMU_IsMapped(MMU *mmu, NX_Addr virAddr);
 NX_PUBLIC void *MMU_Vir2Phy(MMU *mmu, NX_Addr virAddr);
+NX_PUBLIC void MMU_FlushTLBRange(NX_Addr virAddr, NX_USize size);
+NX_PUBLIC NX_Error MMU_CopyOnWrite(MMU *dst, MMU *src);
+NX_PUBLIC NX_Error MMU_HandleCOWFault(MMU *mmu, NX_Addr virAddr);
+
+/* cores have loaded any page table */
+NX_IMPORT NX_Atomic MMU_LoadedCpuMask;
+
+NX_PUBLIC void MMU_ShootdownTLB(MMU *mmu, NX_Addr virAddr, NX_USize size);
 
 #endif  /* __PLATFORM_MMU__ */
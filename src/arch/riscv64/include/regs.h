@@ -30,6 +30,10 @@
 #define SCAUSE_S_TIMER_INTR     5
 #define SCAUSE_S_EXTERNAL_INTR  9
 
+#define SCAUSE_INST_PAGE_FAULT  12
+#define SCAUSE_LOAD_PAGE_FAULT  13
+#define SCAUSE_STORE_PAGE_FAULT 15
+
 #define IRQ_S_SOFT  1
 #define IRQ_H_SOFT  2
 #define IRQ_M_SOFT  3
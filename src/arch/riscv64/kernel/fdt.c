@@ -0,0 +1,156 @@
+/**
+ * Copyright (c) 2018-2022, BookOS Development Team
+ * SPDX-License-Identifier: Apache-2.0
+ * 
+ * Contains: Flattened device tree(FDT) memory node parser
+ */
+
+#include <fdt.h>
+#include <utils/string.h>
+
+#define NX_LOG_LEVEL NX_LOG_INFO
+#define NX_LOG_NAME "FDT"
+#include <utils/log.h>
+
+#define FDT_ALIGN4(x) (((x) + 3) & ~3)
+
+NX_PRIVATE NX_U32 FdtToCpu32(NX_U32 value)
+{
+    NX_U8 *p = (NX_U8 *)&value;
+    return ((NX_U32)p[0] << 24) | ((NX_U32)p[1] << 16) | ((NX_U32)p[2] << 8) | (NX_U32)p[3];
+}
+
+NX_PRIVATE NX_U64 FdtReadCells(NX_U32 *cells, int count)
+{
+    NX_U64 value = 0;
+    while (count-- > 0)
+    {
+        value = (value << 32) | FdtToCpu32(*cells++);
+    }
+    return value;
+}
+
+NX_PRIVATE NX_Bool FdtIsMemoryNode(const char *name)
+{
+    const char *memory = "memory";
+    while (*memory)
+    {
+        if (*name++ != *memory++)
+        {
+            return NX_False;
+        }
+    }
+    return (*name == '\0' || *name == '@') ? NX_True : NX_False;
+}
+
+NX_PUBLIC NX_Bool FDT_Check(void *fdt)
+{
+    if (fdt == NX_NULL || ((NX_Addr)fdt & 3))
+    {
+        return NX_False;
+    }
+    FDT_Header *header = (FDT_Header *)fdt;
+    if (FdtToCpu32(header->magic) != FDT_MAGIC)
+    {
+        return NX_False;
+    }
+    return NX_True;
+}
+
+/**
+ * Walk the structure block and collect reg of all /memory nodes.
+ * Only the root #address-cells and #size-cells are honored, which is enough for
+ * memory nodes because they must be children of root.
+ * 
+ * Return the number of regions found, 0 if dtb is invalid or no memory node.
+ */
+NX_PUBLIC int FDT_GetMemRegions(void *fdt, FDT_MemRegion *regions, int maxRegions)
+{
+    if (!FDT_Check(fdt) || regions == NX_NULL || maxRegions <= 0)
+    {
+        return 0;
+    }
+
+    FDT_Header *header = (FDT_Header *)fdt;
+    NX_U8 *structBlock = (NX_U8 *)fdt + FdtToCpu32(header->offDtStruct);
+    NX_U8 *structEnd = structBlock + FdtToCpu32(header->sizeDtStruct);
+    char *strings = (char *)fdt + FdtToCpu32(header->offDtStrings);
+
+    int addressCells = 2;
+    int sizeCells = 1;
+    int depth = 0;
+    NX_Bool inMemoryNode = NX_False;
+    int count = 0;
+
+    NX_U8 *p = structBlock;
+    while (p < structEnd)
+    {
+        NX_U32 token = FdtToCpu32(*(NX_U32 *)p);
+        p += 4;
+
+        switch (token)
+        {
+        case FDT_BEGIN_NODE:
+            {
+                char *name = (char *)p;
+                depth++;
+                /* memory nodes are children of root node */
+                inMemoryNode = (depth == 2 && FdtIsMemoryNode(name)) ? NX_True : NX_False;
+                p += FDT_ALIGN4(NX_StrLen(name) + 1);
+            }
+            break;
+        case FDT_END_NODE:
+            depth--;
+            inMemoryNode = NX_False;
+            break;
+        case FDT_PROP:
+            {
+                NX_U32 len = FdtToCpu32(*(NX_U32 *)p);
+                char *propName = strings + FdtToCpu32(*(NX_U32 *)(p + 4));
+                NX_U32 *value = (NX_U32 *)(p + 8);
+                p += 8 + FDT_ALIGN4(len);
+
+                if (depth == 1)
+                {
+                    if (!NX_StrCmp(propName, "#address-cells"))
+                    {
+                        addressCells = FdtToCpu32(*value);
+                    }
+                    else if (!NX_StrCmp(propName, "#size-cells"))
+                    {
+                        sizeCells = FdtToCpu32(*value);
+                    }
+                }
+                else if (inMemoryNode && !NX_StrCmp(propName, "reg"))
+                {
+                    NX_U32 entrySize = (addressCells + sizeCells) * 4;
+                    if (entrySize == 0 || addressCells > 2 || sizeCells > 2)
+                    {
+                        NX_LOG_W("unsupport cells: address %d size %d", addressCells, sizeCells);
+                        break;
+                    }
+                    NX_U32 off;
+                    for (off = 0; off + entrySize <= len && count < maxRegions; off += entrySize)
+                    {
+                        NX_U32 *cells = value + off / 4;
+                        regions[count].base = FdtReadCells(cells, addressCells);
+                        regions[count].size = FdtReadCells(cells + addressCells, sizeCells);
+                        if (regions[count].size > 0)
+                        {
+                            count++;
+                        }
+                    }
+                }
+            }
+            break;
+        case FDT_NOP:
+            break;
+        case FDT_END:
+            return count;
+        default:
+            NX_LOG_W("bad token %x at %p", token, p - 4);
+            return count;
+        }
+    }
+    return count;
+}
@@ -16,6 +16,7 @@
 #include <mm/page.h>
 #include <mmu.h>
 #include <riscv.h>
+#include <fdt.h>
 
 #define NX_LOG_LEVEL NX_LOG_INFO
 #define NX_LOG_NAME "Page"
@@ -51,6 +52,7 @@ NX_PUBLIC void MMU_EarlyMap(void)
     NX_LOG_I("OS map early on [%p~%p]", MEM_KERNEL_BASE, KernelMMU.earlyEnd);
 
     MMU_SetPageTable((NX_Addr)mmu->table);
+    MMU_InitAsid();
     
     NX_LOG_I("MMU enabled!");
 }
@@ -60,12 +62,40 @@ NX_PUBLIC void *HAL_GetKernelPageTable(void)
     return KernelMMU.table;
 }
 
+/**
+ * Get memory size from the start of DRAM, which holds SBI and kernel.
+ * The dtb is only used here, it may be overwritten after page zone init.
+ */
+NX_PRIVATE NX_USize GetMemorySize(void)
+{
+    FDT_MemRegion regions[FDT_MAX_MEM_REGIONS];
+    int count;
+    int i;
+
+    count = FDT_GetMemRegions((void *)CPU_BootFdtAddr, regions, FDT_MAX_MEM_REGIONS);
+    for (i = 0; i < count; i++)
+    {
+        NX_LOG_I("FDT memory region: %p~%p", regions[i].base, regions[i].base + regions[i].size);
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (regions[i].base <= MEM_SBI_BASE && MEM_SBI_BASE < regions[i].base + regions[i].size)
+        {
+            return NX_PAGE_ALIGNDOWN(regions[i].base + regions[i].size - MEM_SBI_BASE);
+        }
+    }
+
+    NX_LOG_W("No memory node in FDT %p, use default size", CPU_BootFdtAddr);
+    return DRAM_SIZE_DEFAULT;
+}
+
 /**
  * Init physic memory and map kernel on virtual memory.
  */
 NX_PUBLIC void HAL_PageZoneInit(void)
 {    
-    NX_USize memSize = DRAM_SIZE_DEFAULT;
+    NX_USize memSize = GetMemorySize();
     
     NX_LOG_I("Memory NX_USize: %x Bytes %d MB", memSize, memSize / NX_MB);
 
@@ -82,10 +112,10 @@ NX_PUBLIC void HAL_PageZoneInit(void)
     /* calc normal base & size */
     NX_USize avaliableSize = memSize - MEM_KERNEL_SZ - MEM_SBI_SZ;
     
-    NX_USize normalSize = avaliableSize / 2;
-    if (normalSize > MEM_KERNEL_SPACE_SZ)
+    NX_USize normalSize = NX_PAGE_ALIGNDOWN(avaliableSize / 100 * NX_PAGE_ZONE_NORMAL_PERCENT);
+    if (normalSize > MEM_KERNEL_TOP - MEM_NORMAL_BASE)
     {
-        normalSize = MEM_KERNEL_SPACE_SZ;
+        normalSize = MEM_KERNEL_TOP - MEM_NORMAL_BASE;
     }
     
     /* calc user base & size */
@@ -97,7 +127,10 @@ NX_PUBLIC void HAL_PageZoneInit(void)
 
     /* init page zone */
     NX_PageInitZone(NX_PAGE_ZONE_NORMAL, (void *)MEM_NORMAL_BASE, normalSize);
-    NX_PageInitZone(NX_PAGE_ZONE_USER, (void *)userBase, userSize);
+    if (userSize > 0)
+    {
+        NX_PageInitZone(NX_PAGE_ZONE_USER, (void *)userBase, userSize);
+    }
 
     KernelMMU.earlyEnd = MEM_NORMAL_BASE + normalSize;
 
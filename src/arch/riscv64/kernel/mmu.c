@@ -14,26 +14,158 @@
 
 #include <xbook/debug.h>
 #include <io/irq.h>
+#include <sched/spin.h>
+#include <sched/smp.h>
 #include <utils/memory.h>
+#include <utils/bitops.h>
 
 #define NX_LOG_LEVEL NX_LOG_INFO
 #define NX_LOG_NAME "MMU"
 #include <utils/log.h>
 
-NX_PRIVATE NX_Error UnmapOnePage(MMU *mmu, NX_Addr virAddr);
 NX_INLINE NX_Error __UnmapPage(MMU *mmu, NX_Addr virAddr, NX_USize pages);
 
-NX_PRIVATE MMU_PTE *PageWalk(MMU_PDE *pageTable, NX_Addr virAddr, NX_Bool allocPage)
+/**
+ * Page table reference is the count of used pte in it, the reference from
+ * alloc stands for the first pte. Top level table has no reference.
+ */
+
+/**
+ * Unmapped pages and empty page tables are gathered, then freed after tlb
+ * shootdown, so other cores never access them by stale tlb.
+ */
+#define MMU_GATHER_PAGES_MAX 32
+/* unmap a page gathers the page and at most 2 tables */
+#define MMU_GATHER_PAGES_RESERVE 3
+
+struct MMU_Gather
+{
+    MMU *mmu;
+    NX_Addr start;
+    NX_Addr end;
+    NX_USize count;
+    void *pages[MMU_GATHER_PAGES_MAX];
+};
+typedef struct MMU_Gather MMU_Gather;
+
+NX_PUBLIC NX_Atomic MMU_LoadedCpuMask;
+
+/**
+ * Page table of user space is changed with lock of process held, kernel
+ * table has no lock. Lock is never held across tlb shootdown, other cores
+ * spin on it with interrupt disabled and can't flush.
+ */
+NX_INLINE void TableLock(MMU *mmu)
+{
+    if (mmu->lock != NX_NULL)
+    {
+        NX_SpinLock(mmu->lock, NX_True);
+    }
+}
+
+NX_INLINE void TableUnlock(MMU *mmu)
+{
+    if (mmu->lock != NX_NULL)
+    {
+        NX_SpinUnlock(mmu->lock);
+    }
+}
+
+NX_PRIVATE void GatherInit(MMU_Gather *gather, MMU *mmu)
+{
+    gather->mmu = mmu;
+    gather->start = 0;
+    gather->end = 0;
+    gather->count = 0;
+}
+
+NX_PRIVATE void GatherFlush(MMU_Gather *gather)
+{
+    NX_USize i;
+
+    if (gather->end > gather->start)
+    {
+        MMU_ShootdownTLB(gather->mmu, gather->start, gather->end - gather->start);
+    }
+    for (i = 0; i < gather->count; i++)
+    {
+        NX_PageFree(gather->pages[i]);
+    }
+    gather->start = 0;
+    gather->end = 0;
+    gather->count = 0;
+}
+
+NX_PRIVATE void GatherRange(MMU_Gather *gather, NX_Addr virAddr, NX_USize size)
+{
+    if (gather->end == gather->start)
+    {
+        gather->start = virAddr;
+        gather->end = virAddr + size;
+        return;
+    }
+    if (virAddr < gather->start)
+    {
+        gather->start = virAddr;
+    }
+    if (virAddr + size > gather->end)
+    {
+        gather->end = virAddr + size;
+    }
+}
+
+/**
+ * range of page must be gathered before page
+ */
+NX_PRIVATE void GatherPage(MMU_Gather *gather, void *page)
+{
+    NX_ASSERT(gather->count < MMU_GATHER_PAGES_MAX);
+    gather->pages[gather->count++] = page;
+}
+
+NX_INLINE NX_Bool GatherFull(MMU_Gather *gather)
+{
+    return gather->count + MMU_GATHER_PAGES_RESERVE > MMU_GATHER_PAGES_MAX ? NX_True : NX_False;
+}
+
+/**
+ * make room for unmap a page, flush with table unlocked if full.
+ * page tables must be walked again after.
+ */
+NX_PRIVATE void GatherReserve(MMU_Gather *gather)
+{
+    if (GatherFull(gather))
+    {
+        TableUnlock(gather->mmu);
+        GatherFlush(gather);
+        TableLock(gather->mmu);
+    }
+}
+
+/**
+ * walk page table to pte on level, if a huge page leaf was found on higher level,
+ * return the leaf pte and set level to leaf level.
+ * if tableAlloced not null, return whether the table holds pte was alloced on this walk.
+ */
+NX_PRIVATE MMU_PTE *PageWalkLevel(MMU_PDE *pageTable, NX_Addr virAddr, int *level, NX_Bool allocPage,
+                                  NX_Bool *tableAlloced)
 {
     /* The page table in sv39 mode has 3 levels */
-    int level;
-    for (level = 2; level > 0; level--)
+    int walkLevel;
+    NX_Bool alloced = NX_False;
+    for (walkLevel = 2; walkLevel > *level; walkLevel--)
     {
-        MMU_PTE *pte = &pageTable[GET_LEVEL_OFF(level, virAddr)];
+        MMU_PTE *pte = &pageTable[GET_LEVEL_OFF(walkLevel, virAddr)];
         
         if (PTE_USED(*pte))
         {
+            if (PAGE_IS_LEAF(*pte))
+            {
+                *level = walkLevel;
+                return pte;
+            }
             pageTable = (MMU_PDE *)PTE2PADDR(*pte);
+            alloced = NX_False;
         }
         else
         {
@@ -41,28 +173,36 @@ NX_PRIVATE MMU_PTE *PageWalk(MMU_PDE *pageTable, NX_Addr virAddr, NX_Bool allocP
             {
                 return NX_NULL;
             }
-            pageTable = (MMU_PDE *)NX_PageAlloc(1);
+            pageTable = (MMU_PDE *)NX_PageAllocZeroed();
             if (pageTable == NX_NULL)
             {
                 return NX_NULL;
             }
-            NX_MemZero(NX_Phy2Virt(pageTable), NX_PAGE_SIZE);
 
             /* increase last level page table reference */
-            void *levelPageTable = (void *)(NX_Virt2Phy((NX_Addr)pte) & NX_PAGE_ADDR_MASK);
-            NX_PageIncrease(levelPageTable);
+            if (walkLevel < 2 && alloced == NX_False)
+            {
+                void *levelPageTable = (void *)(NX_Virt2Phy((NX_Addr)pte) & NX_PAGE_ADDR_MASK);
+                NX_PageIncrease(levelPageTable);
+            }
             
             *pte = PADDR2PTE(pageTable) | PTE_V;
+            alloced = NX_True;
         }
         pageTable = (MMU_PDE *)NX_Phy2Virt(pageTable);
     }
-    return &pageTable[GET_LEVEL_OFF(0, virAddr)];
+    if (tableAlloced != NX_NULL)
+    {
+        *tableAlloced = alloced;
+    }
+    return &pageTable[GET_LEVEL_OFF(*level, virAddr)];
 }
 
 /**
- * walk addr for get pte level 0, 1, 2
+ * walk addr for get pte level 0, 1, 2, stop at leaf pte.
+ * return the level of leaf pte.
  */
-NX_PRIVATE NX_Error PageWalkPTE(MMU_PDE *pageTable, NX_Addr virAddr, MMU_PTE *pteArray[3])
+NX_PRIVATE int PageWalkPTE(MMU_PDE *pageTable, NX_Addr virAddr, MMU_PTE *pteArray[3])
 {
     /* The page table in sv39 mode has 3 levels */
     int level;
@@ -73,113 +213,209 @@ NX_PRIVATE NX_Error PageWalkPTE(MMU_PDE *pageTable, NX_Addr virAddr, MMU_PTE *pt
 
         if (PTE_USED(*pte))
         {
+            if (PAGE_IS_LEAF(*pte))
+            {
+                return level;
+            }
             pageTable = (MMU_PDE *)PTE2PADDR(*pte);        
             pageTable = (MMU_PDE *)NX_Phy2Virt(pageTable);
         }
         else
         {
             NX_LOG_E("map walk pte: pte on vir:%p not used!", virAddr);
-            return NX_EFAULT;
+            return -1;
         }
     }
     pteArray[0] = &pageTable[GET_LEVEL_OFF(0, virAddr)];
-    return NX_EOK;
+    return 0;
 }
 
-NX_PRIVATE NX_Bool IsVirAddrMapped(MMU *mmu, NX_Addr virAddr)
+/**
+ * choose the max level which virAddr & phyAddr aligned and pages can fill
+ */
+NX_PRIVATE int PageFitLevel(NX_Addr virAddr, NX_Addr phyAddr, NX_USize pages)
 {
-    MMU_PTE *pte = PageWalk(mmu->table, virAddr, NX_False);
-    if (pte == NX_NULL)
-    {
-        return NX_False;
-    }
-    if (!PTE_USED(*pte))
+    int level;
+    for (level = PAGE_MAX_LEAF_LEVEL; level > 0; level--)
     {
-        return NX_False;
+        NX_USize mask = PAGE_LEVEL_SIZE(level) - 1;
+        if (!(virAddr & mask) && !(phyAddr & mask) && pages >= PAGE_LEVEL_PAGES(level))
+        {
+            return level;
+        }
     }
-    return NX_True;
+    return 0;
 }
 
-NX_PRIVATE NX_Error MapOnePage(MMU *mmu, NX_Addr virAddr, NX_Addr phyAddr, NX_UArch attr)
+/**
+ * map contiguous physic pages with leaf pte on level in one table,
+ * walk page table only once, count must not cross the table.
+ */
+NX_PRIVATE NX_Error MapTableRange(MMU *mmu, NX_Addr virAddr, NX_Addr phyAddr, int level, NX_USize count, NX_UArch attr)
 {
-    if (IsVirAddrMapped(mmu, virAddr) == NX_True)
-    {
-        NX_LOG_E("map page: vir:%p was mapped!", virAddr);
-        return NX_EINVAL;
-    }
-
     MMU_PDE *pageTable = (MMU_PDE *)mmu->table;
+    int walkLevel = level;
+    NX_Bool alloced = NX_False;
+    NX_USize i;
 
-    MMU_PTE *pte = PageWalk(pageTable, virAddr, NX_True);
+    MMU_PTE *pte = PageWalkLevel(pageTable, virAddr, &walkLevel, NX_True, &alloced);
     if (pte == NX_NULL)
     {
         NX_LOG_E("map page: walk page vir:%p failed!", virAddr);
         return NX_EFAULT;
     }
-    if (PTE_USED(*pte))
+    /* pte in new table must be unused, check old table */
+    if (walkLevel != level)
+    {
+        NX_LOG_E("map page: vir:%p was mapped!", virAddr);
+        return NX_EINVAL;
+    }
+    if (alloced == NX_False)
     {
-        NX_PANIC("Map one page but PTE had used!");
+        for (i = 0; i < count; i++)
+        {
+            if (PTE_USED(pte[i]))
+            {
+                NX_LOG_E("map page: vir:%p was mapped!", virAddr + i * PAGE_LEVEL_SIZE(level));
+                return NX_EINVAL;
+            }
+        }
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        pte[i] = PADDR2PTE(phyAddr + i * PAGE_LEVEL_SIZE(level)) | attr | PTE_V;
     }
+
     /* increase last level page table reference */
-    void *levelPageTable = (void *)(NX_Virt2Phy((NX_Addr)pte) & NX_PAGE_ADDR_MASK);
-    NX_PageIncrease(levelPageTable);
-    
-    *pte = PADDR2PTE(phyAddr) | attr | PTE_V;
+    if (level < 2)
+    {
+        void *levelPageTable = (void *)(NX_Virt2Phy((NX_Addr)pte) & NX_PAGE_ADDR_MASK);
+        for (i = (alloced == NX_True) ? 1 : 0; i < count; i++)
+        {
+            NX_PageIncrease(levelPageTable);
+        }
+    }
+    return NX_EOK;
+}
 
+/**
+ * map physic range into virtual range, use huge page when virAddr & phyAddr
+ * both aligned, fill 4KB pte in the same table with one walk.
+ * mapped return the count of pages mapped before failed.
+ */
+NX_PRIVATE NX_Error MapRange(MMU *mmu, NX_Addr virAddr, NX_Addr phyAddr, NX_USize pages, NX_UArch attr,
+                             NX_USize *mapped)
+{
+    *mapped = 0;
+    while (pages > 0)
+    {
+        int level = PageFitLevel(virAddr, phyAddr, pages);
+        NX_USize count = 1;
+        if (level == 0)
+        {
+            count = PTE_PER_TABLE - GET_LEVEL_OFF(0, virAddr);
+            if (count > pages)
+            {
+                count = pages;
+            }
+        }
+        NX_Error err = MapTableRange(mmu, virAddr, phyAddr, level, count, attr);
+        if (err != NX_EOK)
+        {
+            NX_LOG_E("map page: vir:%p phy:%p attr:%x failed!", virAddr, phyAddr, attr);
+            return err;
+        }
+        virAddr += count * PAGE_LEVEL_SIZE(level);
+        phyAddr += count * PAGE_LEVEL_SIZE(level);
+        pages -= count * PAGE_LEVEL_PAGES(level);
+        *mapped += count * PAGE_LEVEL_PAGES(level);
+    }
     return NX_EOK;
 }
 
 NX_PRIVATE void *__MapPageWithPhy(MMU *mmu, NX_Addr virAddr, NX_Addr phyAddr, NX_USize size, NX_UArch attr)
 {
-    NX_Addr addrStart = phyAddr;
-    NX_Addr addrEnd = phyAddr + size - 1;
+    NX_USize mappedPages;
+    NX_Error err;
 
-    NX_ISize pages = GET_PF_ID(addrEnd) - GET_PF_ID(addrStart) + 1;
-    NX_USize mappedPages = 0;
+    TableLock(mmu);
+    err = MapRange(mmu, virAddr, phyAddr, size >> NX_PAGE_SHIFT, attr, &mappedPages);
+    TableUnlock(mmu);
+    if (err != NX_EOK)
+    {
+        __UnmapPage(mmu, virAddr, mappedPages);
+        return NX_NULL;
+    }
+    return (void *)phyAddr;
+}
 
-    while (pages > 0)
+/**
+ * alloc physic pages as large as possible, split them into single pages so
+ * that unmap can free each page.
+ */
+NX_PRIVATE void *AllocPhyPages(NX_USize pages, NX_USize *allocated)
+{
+    NX_USize count = PTE_PER_TABLE;
+    void *phyAddr;
+
+    if (pages < PTE_PER_TABLE)
+    {
+        count = 1UL << (NX_FLS((int)pages) - 1);
+    }
+    for (; count > 0; count >>= 1)
     {
-        if (MapOnePage(mmu, virAddr, phyAddr, attr) != NX_EOK)
+        phyAddr = NX_PageAlloc(count);
+        if (phyAddr != NX_NULL)
         {
-            NX_LOG_E("map page: vir:%p phy:%p attr:%x failed!", virAddr, phyAddr, attr);
-            __UnmapPage(mmu, addrStart, mappedPages);
-            return NX_NULL;
+            if (count > 1)
+            {
+                NX_PageSplit(phyAddr);
+            }
+            *allocated = count;
+            return phyAddr;
         }
-        virAddr += NX_PAGE_SIZE;
-        phyAddr += NX_PAGE_SIZE;
-        pages--;
-        mappedPages++;
     }
-    return (void *)addrStart;
+    return NX_NULL;
 }
 
 NX_PRIVATE void *__MapPage(MMU *mmu, NX_Addr virAddr, NX_USize size, NX_UArch attr)
 {
     NX_Addr addrStart = virAddr;
-    NX_Addr addrEnd = virAddr + size - 1;
-
-    NX_ISize pages = GET_PF_ID(addrEnd) - GET_PF_ID(addrStart) + 1;
+    NX_USize pages = size >> NX_PAGE_SHIFT;
     NX_USize mappedPages = 0;
+    NX_USize count;
+    NX_USize mapped;
+    NX_USize i;
+    NX_Error err;
     void *phyAddr;
 
     while (pages > 0)
     {
-        phyAddr = NX_PageAlloc(1);
+        phyAddr = AllocPhyPages(pages, &count);
         if (phyAddr == NX_NULL)
         {
             NX_LOG_E("map page: alloc page failed!");
             goto err;
         }
 
-        if (MapOnePage(mmu, virAddr, (NX_Addr)phyAddr, attr) != NX_EOK)
+        TableLock(mmu);
+        err = MapRange(mmu, virAddr, (NX_Addr)phyAddr, count, attr, &mapped);
+        TableUnlock(mmu);
+        if (err != NX_EOK)
         {
             NX_LOG_E("map page: vir:%p phy:%p attr:%x failed!", virAddr, phyAddr, attr);
+            /* pages mapped will be freed by unmap */
+            for (i = mapped; i < count; i++)
+            {
+                NX_PageFree(phyAddr + i * NX_PAGE_SIZE);
+            }
+            mappedPages += mapped;
             goto err;
         }
-        virAddr += NX_PAGE_SIZE;
-        phyAddr += NX_PAGE_SIZE;
-        pages--;
-        mappedPages++;
+        virAddr += count * NX_PAGE_SIZE;
+        pages -= count;
+        mappedPages += count;
     }
     return (void *)addrStart;
 err:
@@ -210,57 +446,128 @@ NX_PUBLIC void *MMU_MapPageWithPhy(MMU *mmu, NX_Addr virAddr, NX_Addr phyAddr, N
     return addr;
 }
 
-NX_PRIVATE NX_Error UnmapOnePage(MMU *mmu, NX_Addr virAddr)
+/**
+ * Map a 4KB page on virAddr with lock of mmu held by caller, pte not used
+ * needs no tlb flush. Return NX_EAGAIN if virAddr was mapped.
+ */
+NX_PUBLIC NX_Error MMU_MapPageLocked(MMU *mmu, NX_Addr virAddr, NX_Addr phyAddr, NX_UArch attr)
 {
-    MMU_PDE *pageTable = (MMU_PDE *)mmu->table;
     MMU_PTE *pte;
-    NX_Addr phyPage;
+    NX_Error err;
+    int level = 0;
+
+    virAddr = virAddr & NX_PAGE_ADDR_MASK;
+    pte = PageWalkLevel(mmu->table, virAddr, &level, NX_False, NX_NULL);
+    if (pte != NX_NULL && PTE_USED(*pte))
+    {
+        return NX_EAGAIN;
+    }
+    err = MapTableRange(mmu, virAddr, phyAddr & NX_PAGE_ADDR_MASK, 0, 1, attr);
+    return err == NX_EFAULT ? NX_ENOMEM : err;
+}
+
+/**
+ * table on level lost one pte, gather it if no pte used, then clear pte in
+ * upper level. top level table never free here.
+ */
+NX_PRIVATE void PutPageTable(MMU_Gather *gather, MMU_PTE *pteArray[3], int level)
+{
     void *levelPageTable;
+    void *levelPageTablePhy;
+    MMU_PTE *pte;
 
-    MMU_PTE *pteArray[3] = {NX_NULL, NX_NULL, NX_NULL};
-    NX_ASSERT(PageWalkPTE(pageTable, virAddr, pteArray) == NX_EOK);
-
-    pte = pteArray[0];
-    NX_ASSERT(pte != NX_NULL);
-    NX_ASSERT(PTE_USED(*pte));
-    NX_ASSERT(PAGE_IS_LEAF(*pte));
-    phyPage = PTE2PADDR(*pte);
-    NX_ASSERT(phyPage);
-    NX_PageFree((void *)phyPage);   /* free leaf page*/
-    *pte = 0; /* clear pte in level 0 */
-    
-    /* free none-leaf page */
-    levelPageTable = (void *)(((NX_Addr)pte) & NX_PAGE_ADDR_MASK); /* get level page table by pte */
-    if (NX_PageFree(levelPageTable) == NX_EOK)
+    for (; level < 2; level++)
     {
-        pte = pteArray[1];
+        levelPageTable = (void *)(((NX_Addr)pteArray[level]) & NX_PAGE_ADDR_MASK); /* get level page table by pte */
+        levelPageTablePhy = (void *)NX_Virt2Phy((NX_Addr)levelPageTable);
+        if (NX_PageGetReference(levelPageTablePhy) > 1)
+        {
+            NX_PageFree(levelPageTablePhy); /* drop reference of pte */
+            break;
+        }
+        /* last pte cleared, free table after tlb flushed */
+        GatherPage(gather, levelPageTablePhy);
+        pte = pteArray[level + 1];
         NX_ASSERT(PTE_USED(*pte));
         NX_ASSERT(!PAGE_IS_LEAF(*pte));
-        NX_ASSERT((NX_Addr)levelPageTable == PTE2PADDR(*pte));
-        *pte = 0;   /* clear pte in level 1 */
+        NX_ASSERT(NX_Virt2Phy((NX_Addr)levelPageTable) == PTE2PADDR(*pte));
+        *pte = 0;   /* clear pte in upper level */
+    }
+}
 
-        levelPageTable = (void *)(((NX_Addr)pte) & NX_PAGE_ADDR_MASK);
-        if (NX_PageFree(levelPageTable) == NX_EOK)
+/**
+ * unmap leaf pte in one table with one walk, return pages unmapped.
+ * only 4KB leaf page will be freed, huge page must be mapped with physic address.
+ */
+NX_PRIVATE NX_USize UnmapTableRange(MMU_Gather *gather, NX_Addr virAddr, NX_USize pages)
+{
+    MMU_PTE *pteArray[3] = {NX_NULL, NX_NULL, NX_NULL};
+    MMU_PTE *pte;
+    NX_USize count;
+    NX_USize i;
+
+    int level = PageWalkPTE(gather->mmu->table, virAddr, pteArray);
+    NX_ASSERT(level >= 0);
+
+    if (level > 0)
+    {
+        /* huge page can not be split */
+        if ((virAddr & (PAGE_LEVEL_SIZE(level) - 1)) || pages < PAGE_LEVEL_PAGES(level))
         {
-            pte = pteArray[2]; 
-            NX_ASSERT(PTE_USED(*pte));
-            NX_ASSERT(!PAGE_IS_LEAF(*pte));
-            NX_ASSERT((NX_Addr)levelPageTable == PTE2PADDR(*pte));
-            *pte = 0;   /* clear pte in level 2 */
+            NX_LOG_E("unmap page: vir:%p is part of huge page!", virAddr);
+            return 0;
         }
+        *pteArray[level] = 0;
+        GatherRange(gather, virAddr, PAGE_LEVEL_SIZE(level));
+        PutPageTable(gather, pteArray, level);
+        return PAGE_LEVEL_PAGES(level);
     }
-    return NX_EOK;
+
+    count = PTE_PER_TABLE - GET_LEVEL_OFF(0, virAddr);
+    if (count > pages)
+    {
+        count = pages;
+    }
+
+    /* stop when gather is full, caller flushes and walks again */
+    for (i = 0; i < count && !GatherFull(gather); i++)
+    {
+        pte = pteArray[0] + i;
+        NX_ASSERT(PTE_USED(*pte));
+        NX_ASSERT(PAGE_IS_LEAF(*pte));
+        NX_ASSERT(PTE2PADDR(*pte));
+        GatherRange(gather, virAddr + i * NX_PAGE_SIZE, NX_PAGE_SIZE);
+        GatherPage(gather, (void *)PTE2PADDR(*pte));   /* free leaf page after flush */
+        *pte = 0; /* clear leaf pte */
+        /* table freed when last pte cleared */
+        PutPageTable(gather, pteArray, 0);
+    }
+    return i;
 }
 
 NX_INLINE NX_Error __UnmapPage(MMU *mmu, NX_Addr virAddr, NX_USize pages)
 {
+    MMU_Gather gather;
+    NX_USize count;
+    NX_Error err = NX_EOK;
+
+    GatherInit(&gather, mmu);
+    TableLock(mmu);
     while (pages > 0)
     {
-        UnmapOnePage(mmu, virAddr);
-        virAddr += NX_PAGE_SIZE;
-        pages--;
+        GatherReserve(&gather);
+        count = UnmapTableRange(&gather, virAddr, pages);
+        if (count == 0)
+        {
+            err = NX_EINVAL;
+            break;
+        }
+        virAddr += count * NX_PAGE_SIZE;
+        pages -= count;
     }
-    return NX_EOK;
+    TableUnlock(mmu);
+    GatherFlush(&gather);
+    return err;
 }
 
 NX_PUBLIC NX_Error MMU_UnmapPage(MMU *mmu, NX_Addr virAddr, NX_USize size)
@@ -278,6 +585,248 @@ NX_PUBLIC NX_Error MMU_UnmapPage(MMU *mmu, NX_Addr virAddr, NX_USize size)
     return err;
 }
 
+/**
+ * unmap pages mapped in range, holes are skipped. used for the range which
+ * pages are populated on demand.
+ */
+NX_PUBLIC NX_Error MMU_UnmapSparse(MMU *mmu, NX_Addr virAddr, NX_USize size)
+{
+    MMU_Gather gather;
+    MMU_PTE *pte;
+    NX_Addr addrEnd;
+    NX_USize pages;
+    NX_USize count;
+    NX_Error err = NX_EOK;
+    int level;
+
+    virAddr = virAddr & NX_PAGE_ADDR_MASK;
+    addrEnd = NX_PAGE_ALIGNUP(virAddr + size);
+
+    NX_UArch irqLevel = NX_IRQ_SaveLevel();
+    GatherInit(&gather, mmu);
+    TableLock(mmu);
+    while (virAddr < addrEnd)
+    {
+        GatherReserve(&gather);
+        level = 0;
+        pte = PageWalkLevel(mmu->table, virAddr, &level, NX_False, NX_NULL);
+        if (pte == NX_NULL)
+        {
+            /* no table holds pte, skip to next table */
+            virAddr = (virAddr + PAGE_LEVEL_SIZE(1)) & ~(PAGE_LEVEL_SIZE(1) - 1);
+            continue;
+        }
+        if (!PTE_USED(*pte))
+        {
+            virAddr += NX_PAGE_SIZE;
+            continue;
+        }
+
+        pages = (addrEnd - virAddr) >> NX_PAGE_SHIFT;
+        if (level == 0)
+        {
+            /* unmap used pte in this table with one walk */
+            count = 1;
+            while (count < pages && count < PTE_PER_TABLE - GET_LEVEL_OFF(0, virAddr) && PTE_USED(pte[count]))
+            {
+                count++;
+            }
+            pages = count;
+        }
+        count = UnmapTableRange(&gather, virAddr, pages);
+        if (count == 0)
+        {
+            err = NX_EINVAL;
+            break;
+        }
+        virAddr += count * NX_PAGE_SIZE;
+    }
+    TableUnlock(mmu);
+    GatherFlush(&gather);
+    NX_IRQ_RestoreLevel(irqLevel);
+    return err;
+}
+
+/**
+ * share pte in [idxStart, idxEnd) of src table to dst table on level, writable
+ * 4KB pages become read-only COW pages in both, huge pages are shared as they are.
+ * return used pte count of dst table by used.
+ */
+NX_PRIVATE NX_Error CopyTableCOW(MMU_PTE *dstTable, MMU_PTE *srcTable, int level,
+                                 NX_USize idxStart, NX_USize idxEnd, NX_USize *used)
+{
+    MMU_PTE pte;
+    MMU_PTE *subTable;
+    NX_USize subUsed;
+    NX_USize idx;
+    NX_Error err;
+
+    *used = 0;
+    for (idx = idxStart; idx < idxEnd; idx++)
+    {
+        pte = srcTable[idx];
+        if (!PTE_USED(pte))
+        {
+            continue;
+        }
+
+        if (PAGE_IS_LEAF(pte))
+        {
+            /* only pages from buddy has reference, others are physic mapping */
+            if (level == 0 && NX_PageGetReference((void *)PTE2PADDR(pte)) > 0)
+            {
+                if (pte & PTE_W)
+                {
+                    pte = (pte & ~PTE_W) | PTE_COW;
+                    srcTable[idx] = pte;
+                }
+                NX_PageIncrease((void *)PTE2PADDR(pte));
+            }
+            dstTable[idx] = pte;
+        }
+        else
+        {
+            subTable = (MMU_PTE *)NX_PageAllocZeroed();
+            if (subTable == NX_NULL)
+            {
+                return NX_ENOMEM;
+            }
+            dstTable[idx] = PADDR2PTE(subTable) | PTE_V;
+
+            err = CopyTableCOW((MMU_PTE *)NX_Phy2Virt(subTable), (MMU_PTE *)NX_Phy2Virt(PTE2PADDR(pte)),
+                               level - 1, 0, PTE_PER_TABLE, &subUsed);
+            if (err != NX_EOK)
+            {
+                return err;
+            }
+            if (subUsed == 0)
+            {
+                dstTable[idx] = 0;
+                NX_PageFree(subTable);
+                continue;
+            }
+            /* alloc reference stands for the first pte */
+            while (subUsed-- > 1)
+            {
+                NX_PageIncrease(subTable);
+            }
+        }
+        (*used)++;
+    }
+    return NX_EOK;
+}
+
+/**
+ * Duplicate the space of src to dst with copy on write, only page tables are copied.
+ * The space must be aligned with top level pte, so no top level pte is shared by others.
+ * If failed, tables copied are left in dst and freed with dst.
+ */
+NX_PUBLIC NX_Error MMU_CopyOnWrite(MMU *dst, MMU *src)
+{
+    NX_USize used;
+    NX_Error err;
+
+    NX_ASSERT(!(src->virStart & (PAGE_LEVEL_SIZE(2) - 1)) && !(src->virEnd & (PAGE_LEVEL_SIZE(2) - 1)));
+
+    NX_UArch level = NX_IRQ_SaveLevel();
+    /* dst is not used by anyone yet, only src needs lock */
+    TableLock(src);
+    err = CopyTableCOW(dst->table, src->table, 2, GET_LEVEL_OFF(2, src->virStart),
+                       GET_LEVEL_OFF(2, src->virEnd - 1) + 1, &used);
+    TableUnlock(src);
+    /* pages of src become read-only */
+    MMU_ShootdownTLB(src, src->virStart, src->virEnd - src->virStart);
+    NX_IRQ_RestoreLevel(level);
+    return err;
+}
+
+/**
+ * handle store fault on COW page, copy the page if it is still shared,
+ * otherwise make it writable. return NX_EOK if fault handled.
+ */
+NX_PUBLIC NX_Error MMU_HandleCOWFault(MMU *mmu, NX_Addr virAddr)
+{
+    MMU_PTE *pte;
+    void *page;
+    void *newPage = NX_NULL;
+    NX_Error err;
+    int level = 0;
+
+    virAddr = virAddr & NX_PAGE_ADDR_MASK;
+    if (virAddr < mmu->virStart || virAddr >= mmu->virEnd)
+    {
+        return NX_EFAULT;
+    }
+
+    NX_UArch irqLevel = NX_IRQ_SaveLevel();
+    TableLock(mmu);
+    pte = PageWalkLevel(mmu->table, virAddr, &level, NX_False, NX_NULL);
+    if (pte == NX_NULL || level != 0 || !PTE_USED(*pte))
+    {
+        TableUnlock(mmu);
+        NX_IRQ_RestoreLevel(irqLevel);
+        return NX_EFAULT;
+    }
+    if (!(*pte & PTE_COW))
+    {
+        /* pte changed, other thread has handled the fault */
+        err = (*pte & PTE_W) ? NX_EOK : NX_EFAULT;
+        TableUnlock(mmu);
+        NX_IRQ_RestoreLevel(irqLevel);
+        return err;
+    }
+
+    page = (void *)PTE2PADDR(*pte);
+    if (NX_PageGetReference(page) == 1 && page != NX_PageGetZeroPage())
+    {
+        /* last user of page, no need copy */
+        *pte = (*pte & ~PTE_COW) | PTE_W;
+        page = NX_NULL;
+    }
+    else
+    {
+        /* write on zero page needs no copy */
+        newPage = (page == NX_PageGetZeroPage()) ? NX_PageAllocZeroed() : NX_PageAlloc(1);
+        if (newPage == NX_NULL)
+        {
+            TableUnlock(mmu);
+            NX_IRQ_RestoreLevel(irqLevel);
+            return NX_ENOMEM;
+        }
+        if (page != NX_PageGetZeroPage())
+        {
+            NX_MemCopy(NX_Phy2Virt(newPage), NX_Phy2Virt(page), NX_PAGE_SIZE);
+        }
+        *pte = PADDR2PTE(newPage) | (*pte & PTE_ATTR_MASK & ~PTE_COW) | PTE_W;
+    }
+    TableUnlock(mmu);
+    MMU_ShootdownTLB(mmu, virAddr, NX_PAGE_SIZE);
+    if (page != NX_NULL)
+    {
+        NX_PageFree(page);  /* drop reference after no core can access it */
+    }
+    NX_IRQ_RestoreLevel(irqLevel);
+    return NX_EOK;
+}
+
+/**
+ * flush tlb of virtual range on this core, flush all if too many pages
+ */
+NX_PUBLIC void MMU_FlushTLBRange(NX_Addr virAddr, NX_USize size)
+{
+    NX_Addr addr;
+
+    if (size > MMU_FLUSH_TLB_RANGE_MAX * NX_PAGE_SIZE)
+    {
+        MMU_FlushTLB();
+        return;
+    }
+    for (addr = virAddr & NX_PAGE_ADDR_MASK; addr < virAddr + size; addr += NX_PAGE_SIZE)
+    {
+        SFenceVMAAddr(addr);
+    }
+}
+
 NX_PUBLIC void *MMU_Vir2Phy(MMU *mmu, NX_Addr virAddr)
 {
     NX_Addr pagePhy;
@@ -285,7 +834,9 @@ NX_PUBLIC void *MMU_Vir2Phy(MMU *mmu, NX_Addr virAddr)
     
     MMU_PDE *pageTable = (MMU_PDE *)mmu->table;
 
-    MMU_PTE *pte = PageWalk(pageTable, virAddr, NX_False);
+    int level = 0;
+
+    MMU_PTE *pte = PageWalkLevel(pageTable, virAddr, &level, NX_False, NX_NULL);
     if (pte == NX_NULL)
     {
         NX_PANIC("vir2phy walk fault!");
@@ -297,14 +848,114 @@ NX_PUBLIC void *MMU_Vir2Phy(MMU *mmu, NX_Addr virAddr)
     }
 
     pagePhy = PTE2PADDR(*pte);
-    pageOffset = virAddr % NX_PAGE_SIZE;
+    pageOffset = virAddr & (PAGE_LEVEL_SIZE(level) - 1);
     return (void *)(pagePhy + pageOffset);
 }
 
+NX_PUBLIC NX_Bool MMU_IsMapped(MMU *mmu, NX_Addr virAddr)
+{
+    int level = 0;
+    NX_Bool mapped;
+    MMU_PTE *pte;
+
+    NX_UArch irqLevel = NX_IRQ_SaveLevel();
+    TableLock(mmu);
+    pte = PageWalkLevel(mmu->table, virAddr, &level, NX_False, NX_NULL);
+    mapped = (pte != NX_NULL && PTE_USED(*pte)) ? NX_True : NX_False;
+    TableUnlock(mmu);
+    NX_IRQ_RestoreLevel(irqLevel);
+    return mapped;
+}
+
+/**
+ * Asid is allocated with a generation in the high bits. When all asid in a
+ * generation used, start a new generation and every core flush its tlb before
+ * it loads a asid of new generation, so stale entries never hit.
+ */
+NX_PRIVATE NX_U64 AsidBits = 0; /* 0 means asid not supported */
+NX_PRIVATE NX_U64 AsidGeneration = 1;
+NX_PRIVATE NX_U64 AsidNext = MMU_ASID_KERNEL + 1;
+NX_PRIVATE NX_Bool AsidFlushPending[NX_MULTI_CORES_NR];
+NX_PRIVATE STATIC_SPIN_UNLOCKED(AsidLock);
+
 NX_PUBLIC void MMU_SetPageTable(NX_Addr addr)
 {
-    WriteCSR(satp, MAKE_SATP(addr));
+    NX_AtomicSetMask(&MMU_LoadedCpuMask, 1UL << NX_SMP_GetIdx());
+    WriteCSR(satp, MAKE_SATP(addr, MMU_ASID_KERNEL));
+    MMU_FlushTLB();
+}
+
+/**
+ * Probe asid bits by writing all ones to satp.ASID, must be called after mmu enabled.
+ */
+NX_PUBLIC void MMU_InitAsid(void)
+{
+    NX_U64 satp = ReadCSR(satp);
+    NX_U64 asid;
+
+    WriteCSR(satp, satp | (SATP_ASID_MASK << SATP_ASID_SHIFT));
+    asid = (ReadCSR(satp) >> SATP_ASID_SHIFT) & SATP_ASID_MASK;
+    WriteCSR(satp, satp);
     MMU_FlushTLB();
+
+    AsidBits = 0;
+    while (asid & (1UL << AsidBits))
+    {
+        AsidBits++;
+    }
+    NX_LOG_I("asid bits: %d", AsidBits);
+}
+
+/**
+ * Switch to page table with asid of process, asid NX_NULL means kernel page table.
+ */
+NX_PUBLIC void MMU_SwitchPageTable(NX_Addr addr, NX_U64 *asid)
+{
+    NX_UArch level;
+    NX_Bool flush;
+    NX_UArch coreId;
+    NX_U64 curAsid;
+
+    if (AsidBits == 0)
+    {
+        MMU_SetPageTable(addr);
+        return;
+    }
+
+    NX_AtomicSetMask(&MMU_LoadedCpuMask, 1UL << NX_SMP_GetIdx());
+
+    if (asid == NX_NULL)
+    {
+        /* kernel pages are global, no need flush */
+        WriteCSR(satp, MAKE_SATP(addr, MMU_ASID_KERNEL));
+        return;
+    }
+
+    NX_SpinLockIRQ(&AsidLock, &level);
+    if ((*asid >> AsidBits) != AsidGeneration)
+    {
+        if (AsidNext >= (1UL << AsidBits))
+        {
+            AsidGeneration++;
+            AsidNext = MMU_ASID_KERNEL + 1;
+            for (coreId = 0; coreId < NX_MULTI_CORES_NR; coreId++)
+            {
+                AsidFlushPending[coreId] = NX_True;
+            }
+        }
+        *asid = (AsidGeneration << AsidBits) | AsidNext++;
+    }
+    curAsid = *asid;
+    coreId = NX_SMP_GetIdx();
+    flush = AsidFlushPending[coreId];
+    AsidFlushPending[coreId] = NX_False;
+    NX_SpinUnlockIRQ(&AsidLock, level);
+
+    WriteCSR(satp, MAKE_SATP(addr, curAsid & ((1UL << AsidBits) - 1)));
+    if (flush)
+    {
+        MMU_FlushTLB();
+    }
 }
 
 NX_PUBLIC NX_Addr MMU_GetPageTable(void)
@@ -316,6 +967,8 @@ NX_PUBLIC NX_Addr MMU_GetPageTable(void)
 NX_PUBLIC void MMU_InitTable(MMU *mmu, void *pageTable, NX_Addr virStart, NX_USize size)
 {
     mmu->table = pageTable;
+    mmu->cpuMask = NX_NULL;
+    mmu->lock = NX_NULL;
     mmu->virStart = virStart & NX_PAGE_ADDR_MASK;
     mmu->virEnd = virStart + NX_PAGE_ALIGNUP(size);
 }
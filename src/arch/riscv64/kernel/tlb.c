@@ -0,0 +1,92 @@
+/**
+ * Copyright (c) 2018-2022, BookOS Development Team
+ * SPDX-License-Identifier: Apache-2.0
+ * 
+ * Contains: TLB shootdown on multi cores
+ */
+
+#include <mmu.h>
+#include <regs.h>
+
+#include <sched/smp.h>
+
+#define NX_LOG_LEVEL NX_LOG_INFO
+#define NX_LOG_NAME "TLB"
+#include <utils/log.h>
+
+struct ShootdownRange
+{
+    NX_Addr table;      /* physic address of page table, 0 means kernel table */
+    NX_Addr virAddr;
+    NX_USize size;
+};
+typedef struct ShootdownRange ShootdownRange;
+
+/**
+ * flush range on this core. if the table is running, flush with its asid,
+ * otherwise entries may be tagged with any asid, flush address of all asid.
+ */
+NX_PRIVATE void ShootdownFlush(NX_Addr table, NX_Addr virAddr, NX_USize size)
+{
+    NX_U64 satp = ReadCSR(satp);
+    NX_U64 asid;
+    NX_Addr addr;
+
+    if (table != 0 && GET_ADDR_FROM_SATP(satp) == table)
+    {
+        asid = (satp >> SATP_ASID_SHIFT) & SATP_ASID_MASK;
+        if (size > MMU_FLUSH_TLB_RANGE_MAX * NX_PAGE_SIZE)
+        {
+            SFenceVMAAsid(asid);    /* global kernel pages kept */
+            return;
+        }
+        for (addr = virAddr & NX_PAGE_ADDR_MASK; addr < virAddr + size; addr += NX_PAGE_SIZE)
+        {
+            SFenceVMAAddrAsid(addr, asid);
+        }
+        return;
+    }
+    MMU_FlushTLBRange(virAddr, size);
+}
+
+/**
+ * flush range from other core, called in ipi handler
+ */
+NX_PRIVATE void ShootdownHandler(void *arg)
+{
+    ShootdownRange *range = (ShootdownRange *)arg;
+    ShootdownFlush(range->table, range->virAddr, range->size);
+}
+
+/**
+ * Flush tlb of range on all cores which have loaded the table of mmu,
+ * only those cores get ipi. Return after all of them flushed, so pages
+ * unmapped can be freed safely. Cores waiting with interrupt disabled
+ * serve remote calls, so two shootdowns never wait for each other.
+ */
+NX_PUBLIC void MMU_ShootdownTLB(MMU *mmu, NX_Addr virAddr, NX_USize size)
+{
+    ShootdownRange range;
+    NX_CpuMask cpuMask;
+
+    range.table = 0;
+    range.virAddr = virAddr;
+    range.size = size;
+    if (mmu->cpuMask != NX_NULL)
+    {
+        range.table = NX_Virt2Phy((NX_Addr)mmu->table);
+        cpuMask = NX_AtomicGet(mmu->cpuMask);
+    }
+    else
+    {
+        cpuMask = NX_AtomicGet(&MMU_LoadedCpuMask);
+    }
+
+    ShootdownFlush(range.table, virAddr, size);
+
+    cpuMask &= ~NX_CpuMaskOf(NX_SMP_GetIdx());
+    if (cpuMask != 0 && NX_SMP_CallFunction(cpuMask, ShootdownHandler, &range, NX_True) != NX_EOK)
+    {
+        NX_LOG_E("shootdown tlb on cores %lx failed!", cpuMask);
+    }
+}
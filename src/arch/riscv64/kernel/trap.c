@@ -14,6 +14,7 @@
 #include <interrupt.h>
 #include <clock.h>
 #include <plic.h>
+#include <mmu.h>
 #include <regs.h>
 
 #define NX_LOG_NAME "Trap"
@@ -22,6 +23,8 @@
 
 #include <sched/thread.h>
 #include <sched/smp.h>
+#include <sched/process.h>
+#include <mm/vma.h>
 #include <utils/memory.h>
 
 /* trap name for riscv */
@@ -170,6 +173,25 @@ NX_PUBLIC void CPU_InitTrap(NX_UArch coreId)
     SetCSR(sie, SIE_SSIE);
 }
 
+NX_PRIVATE NX_Error TrapHandlePageFault(NX_U64 cause, NX_Addr addr)
+{
+    NX_U32 access = NX_VMA_READ;
+    NX_Thread *thread = NX_ThreadSelf();
+    if (thread == NX_NULL || thread->resource.process == NX_NULL)
+    {
+        return NX_EFAULT;
+    }
+    if (cause == SCAUSE_STORE_PAGE_FAULT)
+    {
+        access = NX_VMA_WRITE;
+    }
+    else if (cause == SCAUSE_INST_PAGE_FAULT)
+    {
+        access = NX_VMA_EXEC;
+    }
+    return NX_VmaHandleFault(thread->resource.process, addr, access);
+}
+
 NX_PUBLIC void TrapDispatch(HAL_TrapFrame *frame)
 {
     NX_U64 cause = ReadCSR(scause);
@@ -192,7 +214,7 @@ NX_PUBLIC void TrapDispatch(HAL_TrapFrame *frame)
         SCAUSE_S_EXTERNAL_INTR == (cause & 0xff))
 #endif
     {    
-        NX_IRQ_Number irqno = PLIC_Claim(NX_SMP_GetBootCore());
+        NX_IRQ_Number irqno = PLIC_Claim(NX_SMP_GetIdx());
         if (irqno != 0)
         {
             NX_IRQ_Handle(irqno);
@@ -205,6 +227,18 @@ NX_PUBLIC void TrapDispatch(HAL_TrapFrame *frame)
         HAL_ClockHandler();
         return;
     }
+    else if ((SCAUSE_INTERRUPT | SCAUSE_S_SOFTWARE_INTR) == cause)
+    {
+        /* supervisor software interrupt is ipi from other core */
+        ClearCSR(sip, SIP_SSIE);
+        NX_SMP_IpiHandler();
+        return;
+    }
+    else if ((SCAUSE_INST_PAGE_FAULT == cause || SCAUSE_LOAD_PAGE_FAULT == cause ||
+              SCAUSE_STORE_PAGE_FAULT == cause) && TrapHandlePageFault(cause, stval) == NX_EOK)
+    {
+        return;
+    }
     else if (SCAUSE_INTERRUPT & cause)
     {
         if(id < sizeof(InterruptName) / sizeof(const char *))
@@ -31,6 +31,16 @@ NX_PRIVATE NX_U64 GetTimerCounter()
     return ret;
 }
 
+NX_INTERFACE NX_U64 HAL_ClockCounterGet(void)
+{
+    return GetTimerCounter();
+}
+
+NX_INTERFACE NX_U64 HAL_ClockCounterFreq(void)
+{
+    return NX_TIMER_CLK_FREQ;
+}
+
 NX_PUBLIC void HAL_ClockHandler(void)
 {
     NX_ClockTickGo();
@@ -14,27 +14,76 @@
 #include <io/irq.h>
 #include <plic.h>
 #include <sched/smp.h>
+#include <sched/spin.h>
+
+/* harts irq routed to, 0 means boot core */
+NX_PRIVATE NX_UArch IrqAffinity[NX_NR_IRQS];
+NX_PRIVATE NX_Bool IrqUnmasked[NX_NR_IRQS];
+/* enable bits of harts are shared by all irqs */
+NX_PRIVATE STATIC_SPIN_UNLOCKED(IrqLock);
+
+NX_PRIVATE NX_UArch IrqTargets(NX_IRQ_Number irqno)
+{
+    return IrqAffinity[irqno] != 0 ? IrqAffinity[irqno] : (1UL << NX_SMP_GetBootCore());
+}
+
+NX_PRIVATE NX_Error IrqProgram(NX_IRQ_Number irqno, NX_UArch targets, NX_Bool enable)
+{
+    NX_Error err = NX_EOK;
+    NX_U32 hart;
+
+    for (hart = 0; hart < NX_MULTI_CORES_NR; hart++)
+    {
+        if (!(targets & (1UL << hart)))
+        {
+            continue;
+        }
+        err = enable ? PLIC_EnableIRQ(hart, irqno) : PLIC_DisableIRQ(hart, irqno);
+        if (err != NX_EOK)
+        {
+            break;
+        }
+    }
+    return err;
+}
 
 NX_PRIVATE NX_Error HAL_IrqUnmask(NX_IRQ_Number irqno)
 {
+    NX_Error err;
+    NX_UArch level;
+
     if (irqno < 0 || irqno >= NX_NR_IRQS)
     {
         return NX_EINVAL;
     }
 
-    return PLIC_EnableIRQ(NX_SMP_GetBootCore(), irqno);
+    NX_SpinLockIRQ(&IrqLock, &level);
+    err = IrqProgram(irqno, IrqTargets(irqno), NX_True);
+    IrqUnmasked[irqno] = NX_True;
+    NX_SpinUnlockIRQ(&IrqLock, level);
+    return err;
 }
 
 NX_PRIVATE NX_Error HAL_IrqMask(NX_IRQ_Number irqno)
 {
+    NX_Error err;
+    NX_UArch level;
+
     if (irqno < 0 || irqno >= NX_NR_IRQS)
     {
         return NX_EINVAL;
     }
 
-    return PLIC_DisableIRQ(NX_SMP_GetBootCore(), irqno);
+    NX_SpinLockIRQ(&IrqLock, &level);
+    err = IrqProgram(irqno, IrqTargets(irqno), NX_False);
+    IrqUnmasked[irqno] = NX_False;
+    NX_SpinUnlockIRQ(&IrqLock, level);
+    return err;
 }
 
+/**
+ * irq is claimed on local hart, so complete it on local hart
+ */
 NX_PRIVATE NX_Error HAL_IrqAck(NX_IRQ_Number irqno)
 {
     if (irqno < 0 || irqno >= NX_NR_IRQS)
@@ -42,7 +91,60 @@ NX_PRIVATE NX_Error HAL_IrqAck(NX_IRQ_Number irqno)
         return NX_EINVAL;
     }
     
-    return PLIC_Complete(NX_SMP_GetBootCore(), irqno);
+    return PLIC_Complete(NX_SMP_GetIdx(), irqno);
+}
+
+/**
+ * called on old hart of irq, drop irq if not a target any more. irq is
+ * claimed and completed with interrupt disabled, so never between them.
+ */
+NX_PRIVATE void IrqAffinityDrop(void *arg)
+{
+    NX_IRQ_Number irqno = (NX_IRQ_Number)(NX_UArch)arg;
+    NX_U32 hart = NX_SMP_GetIdx();
+    NX_UArch level;
+
+    NX_SpinLockIRQ(&IrqLock, &level);
+    if (!(IrqTargets(irqno) & (1UL << hart)))
+    {
+        PLIC_DisableIRQ(hart, irqno);
+    }
+    NX_SpinUnlockIRQ(&IrqLock, level);
+}
+
+/**
+ * Program enable bits of each target hart, unmasked irq is moved at once.
+ * Complete is ignored if hart disabled after claim, so old harts disable
+ * themselves after new harts enabled.
+ */
+NX_PRIVATE NX_Error HAL_IrqSetAffinity(NX_IRQ_Number irqno, NX_UArch cpuMask)
+{
+    NX_Error err = NX_EOK;
+    NX_UArch level;
+    NX_UArch dropMask;
+
+    if (irqno <= 0 || irqno >= NX_NR_IRQS)
+    {
+        return NX_EINVAL;
+    }
+
+    NX_SpinLockIRQ(&IrqLock, &level);
+    dropMask = IrqTargets(irqno) & ~cpuMask;
+    IrqAffinity[irqno] = cpuMask;
+    if (IrqUnmasked[irqno])
+    {
+        err = IrqProgram(irqno, cpuMask, NX_True);
+    }
+    NX_SpinUnlockIRQ(&IrqLock, level);
+
+    if (dropMask != 0 && NX_SMP_CallFunction(dropMask, IrqAffinityDrop, (void *)(NX_UArch)irqno, NX_True) != NX_EOK)
+    {
+        /* no ipi, drop from here */
+        NX_SpinLockIRQ(&IrqLock, &level);
+        IrqProgram(irqno, dropMask & ~IrqTargets(irqno), NX_False);
+        NX_SpinUnlockIRQ(&IrqLock, level);
+    }
+    return err;
 }
 
 NX_PRIVATE void HAL_IrqEnable(void)
@@ -68,13 +170,20 @@ NX_PRIVATE void HAL_IrqRestoreLevel(NX_UArch level)
     WriteCSR(sstatus, ReadCSR(sstatus) | (level & SSTATUS_SIE));
 }
 
+NX_PRIVATE NX_Bool HAL_IrqIsEnabled(void)
+{
+    return (ReadCSR(sstatus) & SSTATUS_SIE) ? NX_True : NX_False;
+}
+
 NX_INTERFACE NX_IRQ_Controller NX_IRQ_ControllerInterface = 
 {
     .unmask = HAL_IrqUnmask,
     .mask = HAL_IrqMask,
     .ack = HAL_IrqAck,
+    .setAffinity = HAL_IrqSetAffinity,
     .enable = HAL_IrqEnable,
     .disable = HAL_IrqDisable,
     .saveLevel = HAL_IrqSaveLevel,
     .restoreLevel = HAL_IrqRestoreLevel,
+    .isEnabled = HAL_IrqIsEnabled,
 };
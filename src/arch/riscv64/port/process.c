@@ -13,10 +13,12 @@
 #include <mm/alloc.h>
 #include <utils/memory.h>
 #include <mm/page.h>
+#include <mm/vma.h>
 #include <utils/log.h>
 #include <xbook/debug.h>
 #include <platform.h>
 #include <mmu.h>
+#include <sched/smp.h>
 
 NX_PRIVATE NX_Error HAL_ProcessInitUserSpace(NX_Process *process)
 {
@@ -27,17 +29,118 @@ NX_PRIVATE NX_Error HAL_ProcessInitUserSpace(NX_Process *process)
     return NX_EOK;
 }
 
-NX_PRIVATE NX_Error HAL_ProcessSwitchPageTable(void *pageTableVir)
+NX_PRIVATE NX_Error HAL_ProcessSwitchPageTable(void *pageTableVir, NX_Process *process)
 {
     NX_Addr pageTablePhy = (NX_Addr)NX_Virt2Phy(pageTableVir);
     /* no need switch same page table */
     if (pageTablePhy != MMU_GetPageTable())
     {
-        MMU_SetPageTable(pageTablePhy);
+        if (process != NX_NULL)
+        {
+            /* mark core before load page table, shootdown will notify this core */
+            NX_AtomicSetMask(&process->cpuMask, 1UL << NX_SMP_GetIdx());
+            MMU_SwitchPageTable(pageTablePhy, &process->asid);
+        }
+        else
+        {
+            MMU_SwitchPageTable(pageTablePhy, NX_NULL);
+        }
     }
     return NX_EOK;
 }
 
+NX_PRIVATE void ProcessGetUserMMU(NX_Process *process, MMU *mmu)
+{
+    MMU_InitTable(mmu, process->pageTable, MEM_USER_SPACE_BASE, MEM_USER_SPACE_TOP - MEM_USER_SPACE_BASE);
+    mmu->cpuMask = &process->cpuMask;
+    mmu->lock = &process->pageTableLock;
+}
+
+NX_PRIVATE NX_Error HAL_ProcessCopyUserSpace(NX_Process *dst, NX_Process *src)
+{
+    MMU dstMMU;
+    MMU srcMMU;
+
+    ProcessGetUserMMU(dst, &dstMMU);
+    ProcessGetUserMMU(src, &srcMMU);
+    return MMU_CopyOnWrite(&dstMMU, &srcMMU);
+}
+
+NX_PRIVATE NX_Error HAL_ProcessHandleCOWFault(NX_Process *process, NX_Addr virAddr)
+{
+    MMU mmu;
+
+    ProcessGetUserMMU(process, &mmu);
+    return MMU_HandleCOWFault(&mmu, virAddr);
+}
+
+/**
+ * populate page on virAddr, read maps the shared zero page, others map a
+ * zeroed page. the page may be populated by other thread faulted on it, or
+ * the area unmapped by other thread, so check both with table locked.
+ */
+NX_PRIVATE NX_Error HAL_ProcessMapUserPage(NX_Process *process, NX_Addr virAddr, NX_U32 vmaFlags, NX_U32 access)
+{
+    MMU mmu;
+    void *page;
+    NX_UArch level;
+    NX_U32 flags = 0;
+    NX_Error err;
+    NX_UArch attr = PTE_U | PTE_R;
+    if (vmaFlags & NX_VMA_EXEC)
+    {
+        attr |= PTE_X;
+    }
+
+    ProcessGetUserMMU(process, &mmu);
+    if (MMU_IsMapped(&mmu, virAddr))
+    {
+        return NX_EOK;
+    }
+
+    if (access == NX_VMA_READ)
+    {
+        page = NX_PageGetZeroPage();
+        NX_PageIncrease(page);
+        /* write on zero page is copy on write */
+        attr |= (vmaFlags & NX_VMA_WRITE) ? PTE_COW : 0;
+    }
+    else
+    {
+        page = NX_PageAllocZeroed();
+        if (page == NX_NULL)
+        {
+            return NX_ENOMEM;
+        }
+        attr |= (vmaFlags & NX_VMA_WRITE) ? PTE_W : 0;
+    }
+
+    NX_SpinLockIRQ(&process->pageTableLock, &level);
+    if (NX_VmaGetFlags(process, virAddr, &flags) != NX_EOK || (flags & access) != access)
+    {
+        err = NX_EFAULT;
+    }
+    else
+    {
+        err = MMU_MapPageLocked(&mmu, virAddr, (NX_Addr)page, attr);
+    }
+    NX_SpinUnlockIRQ(&process->pageTableLock, level);
+
+    if (err != NX_EOK)
+    {
+        NX_PageFree(page);
+    }
+    return err == NX_EAGAIN ? NX_EOK : err;
+}
+
+NX_PRIVATE NX_Error HAL_ProcessUnmapUserSpace(NX_Process *process, NX_Addr virAddr, NX_USize size)
+{
+    MMU mmu;
+
+    ProcessGetUserMMU(process, &mmu);
+    return MMU_UnmapSparse(&mmu, virAddr, size);
+}
+
 NX_PRIVATE void *HAL_ProcessGetKernelPageTable(void)
 {
     return HAL_GetKernelPageTable();
@@ -48,4 +151,8 @@ NX_INTERFACE struct NX_ProcessOps NX_ProcessOpsInterface =
     .initUserSpace      = HAL_ProcessInitUserSpace,
     .switchPageTable    = HAL_ProcessSwitchPageTable,
     .getKernelPageTable = HAL_ProcessGetKernelPageTable,
+    .copyUserSpace      = HAL_ProcessCopyUserSpace,
+    .handleCOWFault     = HAL_ProcessHandleCOWFault,
+    .mapUserPage        = HAL_ProcessMapUserPage,
+    .unmapUserSpace     = HAL_ProcessUnmapUserSpace,
 };
@@ -88,9 +88,22 @@ NX_PRIVATE NX_Error HAL_CoreEnterApp(NX_UArch appCoreId)
     return NX_EOK;
 }
 
+NX_PRIVATE NX_Error HAL_CoreSendIpi(NX_UArch cpuMask)
+{
+#ifdef CONFIG_NX_PLATFROM_K210
+    return NX_ENORES;   /* software interrupt used as external interrupt on k210 */
+#else
+    NX_UArch hartMask = cpuMask;
+
+    sbi_send_ipi(&hartMask);
+    return NX_EOK;
+#endif
+}
+
 NX_INTERFACE struct NX_SMP_Ops NX_SMP_OpsInterface = 
 {
     .getIdx = HAL_CoreGetIndex,
     .bootApp = HAL_CoreBootApp,
     .enterApp = HAL_CoreEnterApp,
+    .sendIpi = HAL_CoreSendIpi,
 };
@@ -0,0 +1,83 @@
+/**
+ * Copyright (c) 2018-2022, BookOS Development Team
+ * SPDX-License-Identifier: Apache-2.0
+ * 
+ * Contains: Local APIC & IOAPIC
+ */
+
+#ifndef __I386_APIC__
+#define __I386_APIC__
+
+#include <xbook.h>
+
+/* local APIC & IOAPIC mmio, both in one 4MB page */
+#define APIC_MMIO_BASE      0xFEC00000
+#define IOAPIC_BASE         0xFEC00000
+#define LAPIC_BASE          0xFEE00000
+
+#define LAPIC_ID            0x020
+#define LAPIC_VERSION       0x030
+#define LAPIC_TPR           0x080   /* task priority */
+#define LAPIC_EOI           0x0B0
+#define LAPIC_LDR           0x0D0   /* logical destination */
+#define LAPIC_DFR           0x0E0   /* destination format */
+#define LAPIC_SVR           0x0F0   /* spurious interrupt vector */
+#define LAPIC_ESR           0x280   /* error status */
+#define LAPIC_ICR_LOW       0x300   /* interrupt command */
+#define LAPIC_ICR_HIGH      0x310
+#define LAPIC_LVT_TIMER     0x320
+#define LAPIC_LVT_LINT0     0x350
+#define LAPIC_LVT_LINT1     0x360
+#define LAPIC_LVT_ERROR     0x370
+#define LAPIC_TIMER_INIT    0x380
+#define LAPIC_TIMER_CUR     0x390
+#define LAPIC_TIMER_DIV     0x3E0
+
+#define LAPIC_SVR_ENABLE    (1 << 8)
+#define LAPIC_LVT_MASKED    (1 << 16)
+#define LAPIC_TIMER_PERIODIC (1 << 17)
+#define LAPIC_TIMER_DIV_16  0x03
+
+#define LAPIC_ICR_FIXED     (0 << 8)
+#define LAPIC_ICR_INIT      (5 << 8)
+#define LAPIC_ICR_STARTUP   (6 << 8)
+#define LAPIC_ICR_PENDING   (1 << 12)
+#define LAPIC_ICR_ASSERT    (1 << 14)
+#define LAPIC_ICR_LEVEL     (1 << 15)
+#define LAPIC_ICR_ALL_EXCLUDING_SELF (3 << 18)
+
+#define IOAPIC_REG_SELECT   0x00
+#define IOAPIC_REG_WINDOW   0x10
+#define IOAPIC_VERSION      0x01
+#define IOAPIC_REDIRECT(pin) (0x10 + (pin) * 2)
+
+#define IOAPIC_LOWEST_PRIORITY  (1 << 8)
+#define IOAPIC_DEST_LOGICAL     (1 << 11)
+#define IOAPIC_MASKED           (1 << 16)
+
+/* irq pins of IOAPIC, irq above are local */
+#define IOAPIC_IRQS 24
+
+NX_PUBLIC void APIC_Init(void);
+NX_PUBLIC void LAPIC_Init(NX_UArch coreId);
+NX_PUBLIC NX_U32 LAPIC_GetId(void);
+NX_PUBLIC NX_UArch LAPIC_GetCoreId(void);
+NX_PUBLIC void LAPIC_SendEOI(void);
+
+NX_PUBLIC NX_Error LAPIC_SendIPI(NX_UArch coreId, NX_U32 vector);
+NX_PUBLIC void LAPIC_BroadcastIPI(NX_U32 vector);
+NX_PUBLIC void LAPIC_SendInitIPI(NX_U32 apicId);
+NX_PUBLIC void LAPIC_SendStartupIPI(NX_U32 apicId, NX_Addr entry);
+
+NX_PUBLIC void APIC_DelayUs(NX_U32 microseconds);
+
+NX_PUBLIC void LAPIC_TimerCalibrate(void);
+NX_PUBLIC void LAPIC_TimerPeriodic(NX_U32 ticksPerSecond);
+NX_PUBLIC void LAPIC_TimerOneShot(NX_U32 microseconds);
+NX_PUBLIC void LAPIC_TimerMask(NX_Bool mask);
+
+NX_PUBLIC NX_Error IOAPIC_Unmask(NX_U32 irq);
+NX_PUBLIC NX_Error IOAPIC_Mask(NX_U32 irq);
+NX_PUBLIC NX_Error IOAPIC_SetAffinity(NX_U32 irq, NX_UArch cpuMask);
+
+#endif /* __I386_APIC__ */
@@ -36,6 +36,7 @@
 
 #ifndef __ASSEMBLY__
 NX_PUBLIC void CPU_InitGate(void);
+NX_PUBLIC void CPU_LoadGate(void);
 #endif
 
 #endif  /* __I386_GATE__ */
@@ -39,6 +39,11 @@
 #define IRQ_HARDDISK        (14)
 #define IRQ_RESERVE         (15)
 
+/* IOAPIC pins 16~23, local APIC irqs after pins */
+#define IRQ_LAPIC_TIMER     (24)
+#define IRQ_IPI             (25)
+#define IRQ_SPURIOUS        (31)  /* vector 0x3f, no eoi */
+
 struct HAL_TrapFrame
 {
     NX_U32 vectorNumber;
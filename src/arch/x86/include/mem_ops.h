@@ -0,0 +1,29 @@
+/**
+ * Copyright (c) 2018-2022, BookOS Development Team
+ * SPDX-License-Identifier: Apache-2.0
+ * 
+ * Contains: Word copy & set for memory utils
+ */
+
+#ifndef __PLATFORM_MEM_OPS__
+#define __PLATFORM_MEM_OPS__
+
+#include <xbook.h>
+
+/* i386 loads & stores word on any address */
+#define HAL_MEM_UNALIGNED_ACCESS 1
+
+/**
+ * copy words with rep movsd, direction flag is clear as abi required
+ */
+NX_INLINE void HAL_MemCopyWords(void *dst, const void *src, NX_USize words)
+{
+    NX_CASM("rep movsl" : "+D" (dst), "+S" (src), "+c" (words) : : "memory");
+}
+
+NX_INLINE void HAL_MemSetWords(void *dst, NX_UArch value, NX_USize words)
+{
+    NX_CASM("rep stosl" : "+D" (dst), "+c" (words) : "a" (value) : "memory");
+}
+
+#endif  /* __PLATFORM_MEM_OPS__ */
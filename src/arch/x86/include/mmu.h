@@ -15,6 +15,8 @@
 
 #include <xbook.h>
 #include <mm/page.h>
+#include <xbook/atomic.h>
+#include <sched/spin.h>
 
 #define __PTE_SHIFT NX_PAGE_SHIFT
 #define __PTE_BITS 10
@@ -45,9 +47,13 @@
 #define PTE_X     0x000 // Execute
 #define PTE_U     0x004 // User
 #define PTE_PWT   0x008 // Write-through
+#define PTE_PCD   0x010 // Cache disable
 #define PTE_S     0x000 // System
 #define PTE_A     0x020 // Accessed
 #define PTE_D     0x040 // Dirty
+#define PTE_PS    0x080 // Page size, 4MB page in pde
+#define PTE_G     0x100 // Global, kept in tlb when cr3 reload
+#define PTE_COW   0x200 // Copy on write, use available bit
 
 #define PAGE_ATTR_RWX (PTE_X | PTE_W | PTE_R)
 #define PAGE_ATTR_RDONLY (PTE_R)
@@ -56,9 +62,24 @@
 #define PAGE_ATTR_USER (PTE_U)
 #define PAGE_ATTR_SYSTEM (PTE_S)
 
-#define KERNEL_PAGE_ATTR  (PTE_P | PAGE_ATTR_RWX | PAGE_ATTR_SYSTEM)
+/* kernel space is same in all page tables, make it global */
+#define KERNEL_PAGE_ATTR  (PTE_P | PAGE_ATTR_RWX | PAGE_ATTR_SYSTEM | PTE_G)
 
 #define PTE_USED(pte) ((pte) & PTE_P)
+#define PDE_IS_HUGE(pde) ((pde) & PTE_PS)
+
+/* pde with PTE_PS maps 4MB huge page */
+#define PAGE_LEVEL_SIZE(level)  (1UL << (__PTE_SHIFT + __PTE_BITS * (level)))
+#define PAGE_LEVEL_PAGES(level) (1UL << (__PTE_BITS * (level)))
+#define PAGE_MAX_LEAF_LEVEL     1
+
+/* flush whole tlb when range has more pages */
+#define MMU_FLUSH_TLB_RANGE_MAX 32
+
+NX_INLINE void CPU_InvalidatePage(NX_Addr addr)
+{
+    NX_CASM("invlpg (%0)" : : "r" (addr) : "memory");
+}
 
 typedef NX_U32 MMU_PDE; /* page dir entry */
 typedef NX_U32 MMU_PTE; /* page table entry */
@@ -69,6 +90,8 @@ struct MMU
     NX_Addr virStart;
     NX_Addr earlyEnd;
     NX_Addr virEnd;
+    NX_Atomic *cpuMask; /* cores have loaded this table, NX_NULL means kernel table */
+    NX_Spin *lock;      /* lock of table changes, NX_NULL means kernel table */
 };
 typedef struct MMU MMU;
 
@@ -80,7 +103,15 @@ NX_PUBLIC void MMU_Enable(void);
 NX_PUBLIC void MMU_InitTable(MMU *mmu, void *pageTable, NX_Addr virStart, NX_USize size);
 NX_PUBLIC void *MMU_MapPage(MMU *mmu, NX_Addr virAddr, NX_USize size, NX_UArch attr);
 NX_PUBLIC void *MMU_MapPageWithPhy(MMU *mmu, NX_Addr virAddr, NX_Addr phyAddr, NX_USize size, NX_UArch attr);
+NX_PUBLIC NX_Error MMU_MapPageLocked(MMU *mmu, NX_Addr virAddr, NX_Addr phyAddr, NX_UArch attr);
 NX_PUBLIC NX_Error MMU_UnmapPage(MMU *mmu, NX_Addr virAddr, NX_USize size);
+NX_PUBLIC NX_Error MMU_UnmapSparse(MMU *mmu, NX_Addr virAddr, NX_USize size);
+NX_PUBLIC NX_Bool MMU_IsMapped(MMU *mmu, NX_Addr virAddr);
 NX_PUBLIC void *MMU_Vir2Phy(MMU *mmu, NX_Addr virAddr);
+NX_PUBLIC void MMU_FlushTLB(void);
+NX_PUBLIC void MMU_FlushTLBRange(NX_Addr virAddr, NX_USize size);
+NX_PUBLIC void MMU_ShootdownTLB(MMU *mmu, NX_Addr virAddr, NX_USize size);
+NX_PUBLIC NX_Error MMU_CopyOnWrite(MMU *dst, MMU *src);
+NX_PUBLIC NX_Error MMU_HandleCOWFault(MMU *mmu, NX_Addr virAddr);
 
 #endif  /* __PLATFORM_MMU__ */
@@ -21,6 +21,8 @@
 
 #define PIC_EIO             0x20    /* end of IO port */
 
+#define PIC_IRQS            16
+
 NX_PUBLIC void PIC_Init(void);
 NX_PUBLIC void PIC_Enable(NX_U32 irq);
 NX_PUBLIC void PIC_Disable(NX_U32 irq);
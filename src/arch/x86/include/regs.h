@@ -27,8 +27,14 @@
 /* cr0 bit 31 is page enable bit, 1: enable MMU, 0: disable MMU */
 #define CR0_PG  (1 << 31)
 
-/* cr0 bit 31 is page enable bit, 1: enable MMU, 0: disable MMU */
-#define CR0_PG  (1 << 31)
+/* cr0 bit 16 is write protect bit, 1: kernel can not write read-only page */
+#define CR0_WP  (1 << 16)
+
+/* cr4 bit 4 is page size extension bit, 1: enable 4MB page */
+#define CR4_PSE (1 << 4)
+
+/* cr4 bit 7 is page global enable bit, 1: global pages kept in tlb when cr3 reload */
+#define CR4_PGE (1 << 7)
 
 NX_INLINE void CPU_LoadTR(NX_U32 selector)
 {
@@ -66,6 +72,18 @@ NX_INLINE void CPU_WriteCR0(NX_U32 val)
     NX_CASM("movl %0, %%cr0\n\t": :"a" (val));
 }
 
+NX_INLINE NX_U32 CPU_ReadCR4(void)
+{
+    NX_U32 val;
+    NX_CASM("movl %%cr4, %0\n\t": "=a" (val));
+    return val;
+}
+
+NX_INLINE void CPU_WriteCR4(NX_U32 val)
+{
+    NX_CASM("movl %0, %%cr4\n\t": :"a" (val));
+}
+
 NX_INLINE NX_U32 CPU_ReadESP(void)
 {
     NX_U32 sp;
@@ -73,4 +91,23 @@ NX_INLINE NX_U32 CPU_ReadESP(void)
     return sp;
 }
 
+NX_INLINE NX_U64 CPU_ReadMSR(NX_U32 msr)
+{
+    NX_U32 low, high;
+    NX_CASM("rdmsr" : "=a" (low), "=d" (high) : "c" (msr));
+    return ((NX_U64)high << 32) | low;
+}
+
+NX_INLINE void CPU_WriteMSR(NX_U32 msr, NX_U64 val)
+{
+    NX_CASM("wrmsr" : : "c" (msr), "a" ((NX_U32)val), "d" ((NX_U32)(val >> 32)));
+}
+
+NX_INLINE NX_U64 CPU_ReadTSC(void)
+{
+    NX_U32 low, high;
+    NX_CASM("rdtsc" : "=a" (low), "=d" (high));
+    return ((NX_U64)high << 32) | low;
+}
+
 #endif  /* __PLATFROM_REGS__ */
@@ -49,6 +49,8 @@
 #define INDEX_USER_DATA 5
 #define INDEX_USER_TLS 6
 
+#define GDT_ENTRY_NR 8
+
 #define KERNEL_CODE_SEL ((INDEX_KERNEL_CODE << 3) + (SA_TIG << 2) + SA_RPL0)
 #define KERNEL_DATA_SEL ((INDEX_KERNEL_DATA << 3) + (SA_TIG << 2) + SA_RPL0)
 #define KERNEL_STACK_SEL KERNEL_DATA_SEL
@@ -61,10 +63,8 @@
 
 #define USER_TLS_SEL ((INDEX_USER_TLS << 3) + (SA_TIG << 2) + SA_RPL3)
 
-#define GDT_LIMIT           0x000007ff
-#define GDT_PADDR           0x003F0000
-
-#define GDT_VADDR           (NX_KVADDR_OFFSET + GDT_PADDR)
+/* each cpu has a gdt, so tss and tls are per cpu */
+#define GDT_LIMIT           (GDT_ENTRY_NR * 8 - 1)
 
 #define GDT_OFF2PTR(gdt, off)    (gdt + off)
 
@@ -79,7 +79,7 @@
 #define GDT_USER_TLS_ATTR           (DA_DR | DA_DPL3 | DA_32 | DA_G)  /* read only data seg */
 
 #ifndef __ASSEMBLY__
-NX_PUBLIC void CPU_InitSegment(void);
+NX_PUBLIC void CPU_InitSegment(NX_UArch coreId);
 #endif
 
 #endif  /*__I386_SEGMENT__*/
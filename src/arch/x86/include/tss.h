@@ -48,8 +48,8 @@ struct CPU_TSS
     NX_U32 iobase;
 };
 
-void CPU_InitTSS(void);
-struct CPU_TSS *CPU_GetTSS(void);
+void CPU_InitTSS(NX_UArch coreId, NX_UArch stackTop);
+struct CPU_TSS *CPU_GetTSS(NX_UArch coreId);
 void CPU_SetTssStack(NX_UArch top);
 
 #endif  /* __I386_TSS__ */
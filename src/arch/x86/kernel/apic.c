@@ -0,0 +1,349 @@
+/**
+ * Copyright (c) 2018-2022, BookOS Development Team
+ * SPDX-License-Identifier: Apache-2.0
+ * 
+ * Contains: Local APIC & IOAPIC
+ */
+
+#include <xbook.h>
+
+#ifdef CONFIG_NX_X86_APIC
+
+#include <apic.h>
+#include <io.h>
+#include <regs.h>
+#include <interrupt.h>
+#include <io/irq.h>
+#include <sched/smp.h>
+#include <xbook/init_call.h>
+
+#define NX_LOG_NAME "APIC"
+#include <utils/log.h>
+
+#define MSR_APIC_BASE           0x1B
+#define MSR_APIC_BASE_ENABLE    (1 << 11)
+
+/* PIT counter 2 used to calibrate local APIC timer */
+#define PIT_COUNTER2        0x42
+#define PIT_CTRL            0x43
+#define PIT_GATE_PORT       0x61
+#define PIT_GATE_ENABLE     0x01
+#define PIT_GATE_SPEAKER    0x02
+#define PIT_GATE_OUT        0x20
+#define PIT_FREQ            1193180
+#define PIT_CALIBRATE_COUNT 11931   /* 10ms on 1193180 Hz */
+
+#define APIC_ID_NR          256
+
+/* core bit in 8 bits logical destination */
+#if NX_MULTI_CORES_NR > 8
+#error "local APIC flat mode supports 8 cores at most"
+#endif
+
+/* apic id of each core, used to send ipi */
+NX_PRIVATE NX_U32 ApicIdTable[NX_MULTI_CORES_NR];
+
+/* core id of each apic id, core 0 before local APIC init */
+NX_PRIVATE NX_U8 CoreIdTable[APIC_ID_NR];
+
+/* local timer ticks in 10ms with divide 16, all cores share one bus clock */
+NX_PRIVATE NX_U32 LapicTicksPer10ms;
+
+NX_PRIVATE NX_Spin IoApicLock;
+
+NX_INLINE NX_U32 LAPIC_Read(NX_U32 reg)
+{
+    return *(NX_VOLATILE NX_U32 *)(LAPIC_BASE + reg);
+}
+
+NX_INLINE void LAPIC_Write(NX_U32 reg, NX_U32 value)
+{
+    *(NX_VOLATILE NX_U32 *)(LAPIC_BASE + reg) = value;
+    (void)LAPIC_Read(LAPIC_ID);    /* wait write finish */
+}
+
+NX_INLINE NX_U32 IOAPIC_Read(NX_U32 reg)
+{
+    *(NX_VOLATILE NX_U32 *)(IOAPIC_BASE + IOAPIC_REG_SELECT) = reg;
+    return *(NX_VOLATILE NX_U32 *)(IOAPIC_BASE + IOAPIC_REG_WINDOW);
+}
+
+NX_INLINE void IOAPIC_Write(NX_U32 reg, NX_U32 value)
+{
+    *(NX_VOLATILE NX_U32 *)(IOAPIC_BASE + IOAPIC_REG_SELECT) = reg;
+    *(NX_VOLATILE NX_U32 *)(IOAPIC_BASE + IOAPIC_REG_WINDOW) = value;
+}
+
+NX_PUBLIC NX_U32 LAPIC_GetId(void)
+{
+    return LAPIC_Read(LAPIC_ID) >> 24;
+}
+
+NX_PUBLIC NX_UArch LAPIC_GetCoreId(void)
+{
+    return CoreIdTable[LAPIC_GetId() & (APIC_ID_NR - 1)];
+}
+
+NX_PUBLIC void LAPIC_SendEOI(void)
+{
+    *(NX_VOLATILE NX_U32 *)(LAPIC_BASE + LAPIC_EOI) = 0;
+}
+
+/**
+ * Init local APIC of current core, use flat logical destination,
+ * so core n is bit n of the destination of IOAPIC entry.
+ */
+NX_PUBLIC void LAPIC_Init(NX_UArch coreId)
+{
+    CPU_WriteMSR(MSR_APIC_BASE, CPU_ReadMSR(MSR_APIC_BASE) | MSR_APIC_BASE_ENABLE);
+
+    ApicIdTable[coreId] = LAPIC_GetId();
+    CoreIdTable[ApicIdTable[coreId] & (APIC_ID_NR - 1)] = coreId;
+
+    LAPIC_Write(LAPIC_DFR, 0xFFFFFFFF);
+    LAPIC_Write(LAPIC_LDR, (1 << coreId) << 24);
+
+    /* external interrupts all come from IOAPIC */
+    LAPIC_Write(LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);
+    LAPIC_Write(LAPIC_LVT_LINT1, LAPIC_LVT_MASKED);
+    LAPIC_Write(LAPIC_LVT_ERROR, LAPIC_LVT_MASKED);
+    LAPIC_Write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+
+    LAPIC_Write(LAPIC_SVR, LAPIC_SVR_ENABLE | (EXTERNAL_BASE + IRQ_SPURIOUS));
+
+    /* clear error status and pending interrupt */
+    LAPIC_Write(LAPIC_ESR, 0);
+    LAPIC_Write(LAPIC_ESR, 0);
+    LAPIC_SendEOI();
+
+    LAPIC_Write(LAPIC_TPR, 0);
+
+    NX_LOG_I("core %d local apic id %d version %x", coreId, ApicIdTable[coreId], LAPIC_Read(LAPIC_VERSION) & 0xff);
+}
+
+NX_PRIVATE void LAPIC_SendICR(NX_U32 apicId, NX_U32 command)
+{
+    LAPIC_Write(LAPIC_ICR_HIGH, apicId << 24);
+    LAPIC_Write(LAPIC_ICR_LOW, command);
+    while (LAPIC_Read(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING)
+    {
+        NX_CASM("pause");
+    }
+}
+
+NX_PUBLIC NX_Error LAPIC_SendIPI(NX_UArch coreId, NX_U32 vector)
+{
+    NX_UArch level;
+
+    if (coreId >= NX_MULTI_CORES_NR)
+    {
+        return NX_EINVAL;
+    }
+    level = NX_IRQ_SaveLevel();
+    LAPIC_SendICR(ApicIdTable[coreId], LAPIC_ICR_FIXED | LAPIC_ICR_ASSERT | vector);
+    NX_IRQ_RestoreLevel(level);
+    return NX_EOK;
+}
+
+NX_PUBLIC void LAPIC_BroadcastIPI(NX_U32 vector)
+{
+    NX_UArch level;
+
+    level = NX_IRQ_SaveLevel();
+    LAPIC_SendICR(0, LAPIC_ICR_ALL_EXCLUDING_SELF | LAPIC_ICR_FIXED | LAPIC_ICR_ASSERT | vector);
+    NX_IRQ_RestoreLevel(level);
+}
+
+NX_PUBLIC void LAPIC_SendInitIPI(NX_U32 apicId)
+{
+    LAPIC_SendICR(apicId, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL | LAPIC_ICR_ASSERT);
+    LAPIC_SendICR(apicId, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL);
+}
+
+/**
+ * Startup ipi jumps to entry in real mode, entry must be 4KB aligned under 1MB
+ */
+NX_PUBLIC void LAPIC_SendStartupIPI(NX_U32 apicId, NX_Addr entry)
+{
+    LAPIC_SendICR(apicId, LAPIC_ICR_STARTUP | ((entry >> 12) & 0xff));
+}
+
+/**
+ * Start PIT counter 2 with count, which has no irq and not used by system clock.
+ */
+NX_PRIVATE void PIT_StartCounter2(NX_U16 count)
+{
+    NX_U8 gate;
+
+    gate = IO_In8(PIT_GATE_PORT);
+    IO_Out8(PIT_GATE_PORT, (gate & ~PIT_GATE_SPEAKER) | PIT_GATE_ENABLE);
+
+    /* counter 2, lsb then msb, mode 0 */
+    IO_Out8(PIT_CTRL, 0xB0);
+    IO_Out8(PIT_COUNTER2, count & 0xff);
+    IO_Out8(PIT_COUNTER2, (count >> 8) & 0xff);
+
+    /* restart counter 2 by gate */
+    gate = IO_In8(PIT_GATE_PORT) & ~PIT_GATE_ENABLE;
+    IO_Out8(PIT_GATE_PORT, gate);
+    IO_Out8(PIT_GATE_PORT, gate | PIT_GATE_ENABLE);
+}
+
+NX_PRIVATE void PIT_WaitCounter2(void)
+{
+    while (!(IO_In8(PIT_GATE_PORT) & PIT_GATE_OUT))
+    {
+    }
+}
+
+/**
+ * Busy wait without clock irq, 50ms at most
+ */
+NX_PUBLIC void APIC_DelayUs(NX_U32 microseconds)
+{
+    NX_U32 count = microseconds * (PIT_FREQ / 1000) / 1000;
+
+    PIT_StartCounter2(count > 0xFFFF ? 0xFFFF : (count == 0 ? 1 : count));
+    PIT_WaitCounter2();
+}
+
+/**
+ * Count local timer ticks in 10ms of PIT counter 2
+ */
+NX_PUBLIC void LAPIC_TimerCalibrate(void)
+{
+    PIT_StartCounter2(PIT_CALIBRATE_COUNT);
+
+    LAPIC_Write(LAPIC_TIMER_DIV, LAPIC_TIMER_DIV_16);
+    LAPIC_Write(LAPIC_TIMER_INIT, 0xFFFFFFFF);
+
+    PIT_WaitCounter2();
+
+    LapicTicksPer10ms = 0xFFFFFFFF - LAPIC_Read(LAPIC_TIMER_CUR);
+    LAPIC_Write(LAPIC_TIMER_INIT, 0);
+
+    NX_LOG_I("timer %d ticks per 10ms", LapicTicksPer10ms);
+}
+
+NX_PUBLIC void LAPIC_TimerPeriodic(NX_U32 ticksPerSecond)
+{
+    LAPIC_Write(LAPIC_TIMER_DIV, LAPIC_TIMER_DIV_16);
+    LAPIC_Write(LAPIC_LVT_TIMER, LAPIC_TIMER_PERIODIC | (EXTERNAL_BASE + IRQ_LAPIC_TIMER));
+    LAPIC_Write(LAPIC_TIMER_INIT, LapicTicksPer10ms * 100 / ticksPerSecond);
+}
+
+/**
+ * Fire timer irq once after microseconds, count in 32 bits.
+ */
+NX_PUBLIC void LAPIC_TimerOneShot(NX_U32 microseconds)
+{
+    NX_U32 ticksPerMs = LapicTicksPer10ms / 10;
+    NX_U32 count;
+
+    count = (microseconds / 1000) * ticksPerMs + (microseconds % 1000) * ticksPerMs / 1000;
+    if (count == 0)
+    {
+        count = 1;
+    }
+    LAPIC_Write(LAPIC_TIMER_DIV, LAPIC_TIMER_DIV_16);
+    LAPIC_Write(LAPIC_LVT_TIMER, EXTERNAL_BASE + IRQ_LAPIC_TIMER);
+    LAPIC_Write(LAPIC_TIMER_INIT, count);
+}
+
+NX_PUBLIC void LAPIC_TimerMask(NX_Bool mask)
+{
+    NX_U32 lvt = LAPIC_Read(LAPIC_LVT_TIMER);
+
+    LAPIC_Write(LAPIC_LVT_TIMER, mask ? (lvt | LAPIC_LVT_MASKED) : (lvt & ~LAPIC_LVT_MASKED));
+}
+
+NX_PRIVATE NX_Error IOAPIC_Update(NX_U32 irq, NX_U32 clear, NX_U32 set)
+{
+    NX_UArch level;
+    NX_U32 low;
+
+    if (irq >= IOAPIC_IRQS)
+    {
+        return NX_EINVAL;
+    }
+    NX_SpinLockIRQ(&IoApicLock, &level);
+    low = IOAPIC_Read(IOAPIC_REDIRECT(irq));
+    IOAPIC_Write(IOAPIC_REDIRECT(irq), (low & ~clear) | set);
+    NX_SpinUnlockIRQ(&IoApicLock, level);
+    return NX_EOK;
+}
+
+NX_PUBLIC NX_Error IOAPIC_Unmask(NX_U32 irq)
+{
+    return IOAPIC_Update(irq, IOAPIC_MASKED, 0);
+}
+
+NX_PUBLIC NX_Error IOAPIC_Mask(NX_U32 irq)
+{
+    return IOAPIC_Update(irq, 0, IOAPIC_MASKED);
+}
+
+/**
+ * Deliver irq to lowest priority core in mask, flat logical mode has 8 cores at most.
+ */
+NX_PUBLIC NX_Error IOAPIC_SetAffinity(NX_U32 irq, NX_UArch cpuMask)
+{
+    NX_UArch level;
+
+    cpuMask &= (1UL << NX_MULTI_CORES_NR) - 1;
+    if (irq >= IOAPIC_IRQS || (cpuMask & 0xff) == 0)
+    {
+        return NX_EINVAL;
+    }
+    NX_SpinLockIRQ(&IoApicLock, &level);
+    IOAPIC_Write(IOAPIC_REDIRECT(irq) + 1, (cpuMask & 0xff) << 24);
+    NX_SpinUnlockIRQ(&IoApicLock, level);
+    return NX_EOK;
+}
+
+/**
+ * Init IOAPIC with isa irq on same pin, all masked and delivered to boot core,
+ * then init local APIC of boot core. 8259 PIC must be masked before.
+ */
+NX_PUBLIC void APIC_Init(void)
+{
+    NX_U32 pins;
+    NX_U32 irq;
+
+    NX_SpinInit(&IoApicLock);
+
+    pins = ((IOAPIC_Read(IOAPIC_VERSION) >> 16) & 0xff) + 1;
+    if (pins > IOAPIC_IRQS)
+    {
+        pins = IOAPIC_IRQS;
+    }
+    for (irq = 0; irq < pins; irq++)
+    {
+        IOAPIC_Write(IOAPIC_REDIRECT(irq) + 1, (1 << NX_SMP_GetBootCore()) << 24);
+        IOAPIC_Write(IOAPIC_REDIRECT(irq), IOAPIC_MASKED | IOAPIC_DEST_LOGICAL |
+                     IOAPIC_LOWEST_PRIORITY | (EXTERNAL_BASE + irq));
+    }
+    NX_LOG_I("ioapic %d pins", pins);
+
+    LAPIC_Init(NX_SMP_GetBootCore());
+}
+
+NX_PRIVATE NX_Error IpiHandler(NX_U32 irq, void *arg)
+{
+    NX_SMP_IpiHandler();
+    return NX_EOK;
+}
+
+NX_PRIVATE void APIC_IpiInit(void)
+{
+    if (NX_IRQ_Bind(IRQ_IPI, IpiHandler, NX_NULL, "IPI", NX_IRQ_FLAG_NOBALANCE) != NX_EOK)
+    {
+        NX_LOG_E("bind ipi irq failed!");
+        return;
+    }
+    NX_IRQ_Unmask(IRQ_IPI);
+}
+
+NX_INITCALL(APIC_IpiInit);
+
+#endif /* CONFIG_NX_X86_APIC */
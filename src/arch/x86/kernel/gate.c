@@ -72,6 +72,22 @@ NX_PUBLIC void CPU_TrapEntry0x2c(void);
 NX_PUBLIC void CPU_TrapEntry0x2d(void);
 NX_PUBLIC void CPU_TrapEntry0x2e(void);
 NX_PUBLIC void CPU_TrapEntry0x2f(void);
+NX_PUBLIC void CPU_TrapEntry0x30(void);
+NX_PUBLIC void CPU_TrapEntry0x31(void);
+NX_PUBLIC void CPU_TrapEntry0x32(void);
+NX_PUBLIC void CPU_TrapEntry0x33(void);
+NX_PUBLIC void CPU_TrapEntry0x34(void);
+NX_PUBLIC void CPU_TrapEntry0x35(void);
+NX_PUBLIC void CPU_TrapEntry0x36(void);
+NX_PUBLIC void CPU_TrapEntry0x37(void);
+NX_PUBLIC void CPU_TrapEntry0x38(void);
+NX_PUBLIC void CPU_TrapEntry0x39(void);
+NX_PUBLIC void CPU_TrapEntry0x3a(void);
+NX_PUBLIC void CPU_TrapEntry0x3b(void);
+NX_PUBLIC void CPU_TrapEntry0x3c(void);
+NX_PUBLIC void CPU_TrapEntry0x3d(void);
+NX_PUBLIC void CPU_TrapEntry0x3e(void);
+NX_PUBLIC void CPU_TrapEntry0x3f(void);
 
 NX_PUBLIC void CPU_SyscallEntry(void);
 NX_PUBLIC void CPU_LoadIDT(NX_UArch NX_USize, NX_UArch idtr);    
@@ -144,8 +160,32 @@ NX_PUBLIC void CPU_InitGate(void)
     SetGate(OFF(idt, EXTERNAL_BASE+13), CPU_TrapEntry0x2d, KERNEL_CODE_SEL, DA_386_INTR_GATE, DA_GATE_DPL0);
     SetGate(OFF(idt, EXTERNAL_BASE+14), CPU_TrapEntry0x2e, KERNEL_CODE_SEL, DA_386_INTR_GATE, DA_GATE_DPL0);
     SetGate(OFF(idt, EXTERNAL_BASE+15), CPU_TrapEntry0x2f, KERNEL_CODE_SEL, DA_386_INTR_GATE, DA_GATE_DPL0);
+    SetGate(OFF(idt, EXTERNAL_BASE+16), CPU_TrapEntry0x30, KERNEL_CODE_SEL, DA_386_INTR_GATE, DA_GATE_DPL0);
+    SetGate(OFF(idt, EXTERNAL_BASE+17), CPU_TrapEntry0x31, KERNEL_CODE_SEL, DA_386_INTR_GATE, DA_GATE_DPL0);
+    SetGate(OFF(idt, EXTERNAL_BASE+18), CPU_TrapEntry0x32, KERNEL_CODE_SEL, DA_386_INTR_GATE, DA_GATE_DPL0);
+    SetGate(OFF(idt, EXTERNAL_BASE+19), CPU_TrapEntry0x33, KERNEL_CODE_SEL, DA_386_INTR_GATE, DA_GATE_DPL0);
+    SetGate(OFF(idt, EXTERNAL_BASE+20), CPU_TrapEntry0x34, KERNEL_CODE_SEL, DA_386_INTR_GATE, DA_GATE_DPL0);
+    SetGate(OFF(idt, EXTERNAL_BASE+21), CPU_TrapEntry0x35, KERNEL_CODE_SEL, DA_386_INTR_GATE, DA_GATE_DPL0);
+    SetGate(OFF(idt, EXTERNAL_BASE+22), CPU_TrapEntry0x36, KERNEL_CODE_SEL, DA_386_INTR_GATE, DA_GATE_DPL0);
+    SetGate(OFF(idt, EXTERNAL_BASE+23), CPU_TrapEntry0x37, KERNEL_CODE_SEL, DA_386_INTR_GATE, DA_GATE_DPL0);
+    SetGate(OFF(idt, EXTERNAL_BASE+24), CPU_TrapEntry0x38, KERNEL_CODE_SEL, DA_386_INTR_GATE, DA_GATE_DPL0);
+    SetGate(OFF(idt, EXTERNAL_BASE+25), CPU_TrapEntry0x39, KERNEL_CODE_SEL, DA_386_INTR_GATE, DA_GATE_DPL0);
+    SetGate(OFF(idt, EXTERNAL_BASE+26), CPU_TrapEntry0x3a, KERNEL_CODE_SEL, DA_386_INTR_GATE, DA_GATE_DPL0);
+    SetGate(OFF(idt, EXTERNAL_BASE+27), CPU_TrapEntry0x3b, KERNEL_CODE_SEL, DA_386_INTR_GATE, DA_GATE_DPL0);
+    SetGate(OFF(idt, EXTERNAL_BASE+28), CPU_TrapEntry0x3c, KERNEL_CODE_SEL, DA_386_INTR_GATE, DA_GATE_DPL0);
+    SetGate(OFF(idt, EXTERNAL_BASE+29), CPU_TrapEntry0x3d, KERNEL_CODE_SEL, DA_386_INTR_GATE, DA_GATE_DPL0);
+    SetGate(OFF(idt, EXTERNAL_BASE+30), CPU_TrapEntry0x3e, KERNEL_CODE_SEL, DA_386_INTR_GATE, DA_GATE_DPL0);
+    SetGate(OFF(idt, EXTERNAL_BASE+31), CPU_TrapEntry0x3f, KERNEL_CODE_SEL, DA_386_INTR_GATE, DA_GATE_DPL0);
 
     SetGate(OFF(idt, SYSCALL_BASE), CPU_SyscallEntry, KERNEL_CODE_SEL, DA_386_INTR_GATE, DA_GATE_DPL3);
     
+    CPU_LoadGate();
+}
+
+/**
+ * All cores share one idt, app core only loads it
+ */
+NX_PUBLIC void CPU_LoadGate(void)
+{
     CPU_LoadIDT(IDT_LIMIT, IDT_VADDR);
 }
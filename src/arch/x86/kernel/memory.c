@@ -12,6 +12,10 @@
 #include <mmu.h>
 #include <page_zone.h>
 #include <platform.h>
+#include <boot.h>
+#ifdef CONFIG_NX_X86_APIC
+#include <apic.h>
+#endif
 
 #include <utils/memory.h>
 
@@ -21,18 +25,47 @@
 
 #include <xbook/debug.h>
 
-#define GRUB2_READ_MEMORY_BYTES_ADDR (0x000001000)
+/* 32 bits physical address, highest page can be used */
+#define MEM_PHY_TOP (0x100000000ULL - NX_PAGE_SIZE)
 
 NX_PUBLIC MMU KernelMMU;
 
 NX_PRIVATE MMU_PDE KernelTable[NX_PAGE_SIZE / sizeof(MMU_PDE)] NX_CALIGN(NX_PAGE_SIZE);
 
+/**
+ * Get memory top of the available region which holds normal zone base.
+ * Use basic meminfo from GRUB2 if no memory map.
+ */
+NX_PRIVATE NX_USize GetMemorySize(void)
+{
+    struct BootMemInfo *memInfo = (struct BootMemInfo *)BOOT_MEM_INFO_ADDR;
+    int i;
+
+    for (i = 0; i < memInfo->regionNum; i++)
+    {
+        unsigned long long base = memInfo->regions[i].base;
+        unsigned long long end = base + memInfo->regions[i].size;
+
+        NX_LOG_I("Memory region: %x~%x", (NX_U32)base, (NX_U32)(end > MEM_PHY_TOP ? MEM_PHY_TOP : end));
+
+        if (base <= MEM_NORMAL_BASE && MEM_NORMAL_BASE < end)
+        {
+            if (end > MEM_PHY_TOP)
+            {
+                end = MEM_PHY_TOP;
+            }
+            return NX_PAGE_ALIGNDOWN((NX_USize)end);
+        }
+    }
+    return memInfo->memSize;
+}
+
 /**
  * Init physic memory and map kernel on virtual memory.
  */
 NX_PUBLIC void HAL_PageZoneInit(void)
 {    
-    NX_USize memSize = *(NX_USize *)GRUB2_READ_MEMORY_BYTES_ADDR;
+    NX_USize memSize = GetMemorySize();
     
     NX_LOG_I("Memory NX_USize: %x Bytes %d MB", memSize, memSize / NX_MB);
 
@@ -47,16 +80,16 @@ NX_PUBLIC void HAL_PageZoneInit(void)
     }
     
     /* calc normal base & size */
-    NX_USize normalSize = memSize - MEM_DMA_SIZE - MEM_KERNEL_SZ;
-    normalSize /= 2;
-    if (normalSize > MEM_KERNEL_SPACE_SZ)
+    NX_USize avaliableSize = memSize - MEM_DMA_SIZE - MEM_KERNEL_SZ;
+    NX_USize normalSize = NX_PAGE_ALIGNDOWN(avaliableSize / 100 * NX_PAGE_ZONE_NORMAL_PERCENT);
+    if (normalSize > MEM_KERNEL_TOP - MEM_NORMAL_BASE)
     {
-        normalSize = MEM_KERNEL_SPACE_SZ;
+        normalSize = MEM_KERNEL_TOP - MEM_NORMAL_BASE;
     }
     
     /* calc user base & size */
     NX_Addr userBase = MEM_NORMAL_BASE + normalSize;
-    NX_USize userSize = memSize - normalSize;
+    NX_USize userSize = avaliableSize - normalSize;
 
     NX_LOG_I("DMA memory base: %x NX_USize:%d MB", MEM_DMA_BASE, MEM_DMA_SIZE / NX_MB);
     NX_LOG_I("Normal memory base: %x NX_USize:%d MB", MEM_NORMAL_BASE, normalSize / NX_MB);
@@ -65,7 +98,10 @@ NX_PUBLIC void HAL_PageZoneInit(void)
     /* init page zone */
     NX_PageInitZone(NX_PAGE_ZONE_DMA, (void *)MEM_DMA_BASE, MEM_DMA_SIZE);
     NX_PageInitZone(NX_PAGE_ZONE_NORMAL, (void *)MEM_NORMAL_BASE, normalSize);
-    NX_PageInitZone(NX_PAGE_ZONE_USER, (void *)userBase, userSize);
+    if (userSize > 0)
+    {
+        NX_PageInitZone(NX_PAGE_ZONE_USER, (void *)userBase, userSize);
+    }
 
     KernelMMU.earlyEnd = userBase;
     
@@ -73,6 +109,11 @@ NX_PUBLIC void HAL_PageZoneInit(void)
 
     MMU_EarlyMap(&KernelMMU, KernelMMU.virStart, KernelMMU.earlyEnd);
 
+#ifdef CONFIG_NX_X86_APIC
+    /* apic mmio in one uncached 4MB page, process table copies it from kernel */
+    KernelTable[GET_PDE_OFF(APIC_MMIO_BASE)] = MAKE_PTE(APIC_MMIO_BASE, KERNEL_PAGE_ATTR | PTE_PS | PTE_PCD | PTE_PWT);
+#endif
+
     MMU_SetPageTable((NX_UArch)KernelMMU.table);
     MMU_Enable();
 
@@ -14,18 +14,148 @@
 #include <regs.h>
 #include <xbook/debug.h>
 #include <io/irq.h>
+#include <mm/page.h>
+#include <sched/smp.h>
 #include <utils/memory.h>
+#include <utils/bitops.h>
 
 #define NX_LOG_LEVEL NX_LOG_INFO
 #define NX_LOG_NAME "MMU"
 #include <utils/log.h>
 
-NX_PRIVATE NX_Error UnmapOnePage(MMU *mmu, NX_Addr virAddr);
 NX_INLINE NX_Error __UnmapPage(MMU *mmu, NX_Addr virAddr, NX_USize pages);
 
-NX_PRIVATE MMU_PTE *PageWalk(MMU_PDE *pageTable, NX_Addr virAddr, NX_Bool allocPage)
+/**
+ * Page table reference is the count of used pte in it, the reference from
+ * alloc stands for the first pte. Page dir has no reference.
+ */
+
+/**
+ * Unmapped pages and empty page tables are gathered, then freed after tlb
+ * shootdown, so other cores never access them by stale tlb.
+ */
+#define MMU_GATHER_PAGES_MAX 32
+/* unmap a page gathers the page and at most 1 table */
+#define MMU_GATHER_PAGES_RESERVE 2
+
+struct MMU_Gather
+{
+    MMU *mmu;
+    NX_Addr start;
+    NX_Addr end;
+    NX_USize count;
+    void *pages[MMU_GATHER_PAGES_MAX];
+};
+typedef struct MMU_Gather MMU_Gather;
+
+/**
+ * Page table of user space is changed with lock of process held, kernel
+ * table has no lock. Lock is never held across tlb shootdown, other cores
+ * spin on it with interrupt disabled and can't flush.
+ */
+NX_INLINE void TableLock(MMU *mmu)
+{
+    if (mmu->lock != NX_NULL)
+    {
+        NX_SpinLock(mmu->lock, NX_True);
+    }
+}
+
+NX_INLINE void TableUnlock(MMU *mmu)
+{
+    if (mmu->lock != NX_NULL)
+    {
+        NX_SpinUnlock(mmu->lock);
+    }
+}
+
+NX_PRIVATE void GatherInit(MMU_Gather *gather, MMU *mmu)
+{
+    gather->mmu = mmu;
+    gather->start = 0;
+    gather->end = 0;
+    gather->count = 0;
+}
+
+NX_PRIVATE void GatherFlush(MMU_Gather *gather)
+{
+    NX_USize i;
+
+    if (gather->end > gather->start)
+    {
+        MMU_ShootdownTLB(gather->mmu, gather->start, gather->end - gather->start);
+    }
+    for (i = 0; i < gather->count; i++)
+    {
+        NX_PageFree(gather->pages[i]);
+    }
+    gather->start = 0;
+    gather->end = 0;
+    gather->count = 0;
+}
+
+NX_PRIVATE void GatherRange(MMU_Gather *gather, NX_Addr virAddr, NX_USize size)
+{
+    if (gather->end == gather->start)
+    {
+        gather->start = virAddr;
+        gather->end = virAddr + size;
+        return;
+    }
+    if (virAddr < gather->start)
+    {
+        gather->start = virAddr;
+    }
+    if (virAddr + size > gather->end)
+    {
+        gather->end = virAddr + size;
+    }
+}
+
+/**
+ * range of page must be gathered before page
+ */
+NX_PRIVATE void GatherPage(MMU_Gather *gather, void *page)
+{
+    NX_ASSERT(gather->count < MMU_GATHER_PAGES_MAX);
+    gather->pages[gather->count++] = page;
+}
+
+NX_INLINE NX_Bool GatherFull(MMU_Gather *gather)
+{
+    return gather->count + MMU_GATHER_PAGES_RESERVE > MMU_GATHER_PAGES_MAX ? NX_True : NX_False;
+}
+
+/**
+ * make room for unmap a page, flush with table unlocked if full.
+ * page tables must be walked again after.
+ */
+NX_PRIVATE void GatherReserve(MMU_Gather *gather)
+{
+    if (GatherFull(gather))
+    {
+        TableUnlock(gather->mmu);
+        GatherFlush(gather);
+        TableLock(gather->mmu);
+    }
+}
+
+/**
+ * walk page table to pte on level, if a 4MB page pde was found,
+ * return the pde and set level to 1.
+ * if tableAlloced not null, return whether the table holds pte was alloced on this walk.
+ */
+NX_PRIVATE MMU_PTE *PageWalkLevel(MMU_PDE *pageTable, NX_Addr virAddr, int *level, NX_Bool allocPage,
+                                  NX_Bool *tableAlloced)
 {
     MMU_PTE *pte = &pageTable[GET_PDE_OFF(virAddr)];
+    NX_Bool alloced = NX_False;
+
+    if (*level == 1 || (PTE_USED(*pte) && PDE_IS_HUGE(*pte)))
+    {
+        *level = 1;
+        return pte;
+    }
     
     if (PTE_USED(*pte))
     {
@@ -37,140 +167,234 @@ NX_PRIVATE MMU_PTE *PageWalk(MMU_PDE *pageTable, NX_Addr virAddr, NX_Bool allocP
         {
             return NX_NULL;
         }
-        pageTable = (MMU_PDE *)NX_PageAlloc(1);
+        pageTable = (MMU_PDE *)NX_PageAllocZeroed();
         if (pageTable == NX_NULL)
         {
             return NX_NULL;
         }
-        NX_MemZero(NX_Phy2Virt(pageTable), NX_PAGE_SIZE);
-
-        /* increase page table reference */
-        void *levelPageTable = (void *)(NX_Virt2Phy((NX_Addr)pte) & NX_PAGE_ADDR_MASK);
-        NX_PageIncrease(levelPageTable);
         
-        *pte = PADDR2PTE(pageTable) | PTE_P;
+        /* access controlled by leaf pte */
+        *pte = PADDR2PTE(pageTable) | PTE_P | PTE_W | PTE_U;
+        alloced = NX_True;
     }
     pageTable = (MMU_PDE *)NX_Phy2Virt(pageTable);
 
+    if (tableAlloced != NX_NULL)
+    {
+        *tableAlloced = alloced;
+    }
     return &pageTable[GET_PTE_OFF(virAddr)];
 }
 
 /**
- * walk addr for get pte level 0, 1
+ * walk addr for get pte level 0, 1, stop at 4MB page pde.
+ * return the level of leaf pte.
  */
-NX_PRIVATE NX_Error PageWalkPTE(MMU_PDE *pageTable, NX_Addr virAddr, MMU_PTE *pteArray[2])
+NX_PRIVATE int PageWalkPTE(MMU_PDE *pageTable, NX_Addr virAddr, MMU_PTE *pteArray[2])
 {
     MMU_PTE *pte = (MMU_PTE *)&pageTable[GET_PDE_OFF(virAddr)];
     pteArray[1] = pte;
 
     if (PTE_USED(*pte))
     {
+        if (PDE_IS_HUGE(*pte))
+        {
+            return 1;
+        }
         pageTable = (MMU_PTE *)PTE2PADDR(*pte);        
         pageTable = (MMU_PTE *)NX_Phy2Virt(pageTable);
     }
     else
     {
         NX_LOG_E("map walk pte: pte on vir:%p not used!", virAddr);
-        return NX_EFAULT;
+        return -1;
     }
     pteArray[0] = &pageTable[GET_PTE_OFF(virAddr)];
-    return NX_EOK;
+    return 0;
 }
 
-NX_PRIVATE NX_Bool IsVirAddrMapped(MMU *mmu, NX_Addr virAddr)
+/**
+ * choose 4MB page if virAddr & phyAddr aligned and pages can fill
+ */
+NX_PRIVATE int PageFitLevel(NX_Addr virAddr, NX_Addr phyAddr, NX_USize pages)
 {
-    MMU_PTE *pte = PageWalk(mmu->table, virAddr, NX_False);
-    if (pte == NX_NULL)
+    NX_USize mask = PAGE_LEVEL_SIZE(1) - 1;
+    if (!(virAddr & mask) && !(phyAddr & mask) && pages >= PAGE_LEVEL_PAGES(1))
     {
-        return NX_False;
+        return 1;
     }
-    if (!PTE_USED(*pte))
-    {
-        return NX_False;
-    }
-    return NX_True;
+    return 0;
 }
 
-NX_PRIVATE NX_Error MapOnePage(MMU *mmu, NX_Addr virAddr, NX_Addr phyAddr, NX_UArch attr)
+/**
+ * map contiguous physic pages with leaf pte on level in one table,
+ * walk page table only once, count must not cross the table.
+ */
+NX_PRIVATE NX_Error MapTableRange(MMU *mmu, NX_Addr virAddr, NX_Addr phyAddr, int level, NX_USize count, NX_UArch attr)
 {
-    if (IsVirAddrMapped(mmu, virAddr) == NX_True)
-    {
-        NX_LOG_E("map page: vir:%p was mapped!", virAddr);
-        return NX_EINVAL;
-    }
-
     MMU_PDE *pageTable = (MMU_PDE *)mmu->table;
+    int walkLevel = level;
+    NX_Bool alloced = NX_False;
+    NX_USize i;
 
-    MMU_PTE *pte = PageWalk(pageTable, virAddr, NX_True);
+    MMU_PTE *pte = PageWalkLevel(pageTable, virAddr, &walkLevel, NX_True, &alloced);
     if (pte == NX_NULL)
     {
         NX_LOG_E("map page: walk page vir:%p failed!", virAddr);
         return NX_EFAULT;
     }
-    if (PTE_USED(*pte))
+    /* pte in new table must be unused, check old table */
+    if (walkLevel != level)
     {
-        NX_PANIC("Map one page but PTE had used!");
+        NX_LOG_E("map page: vir:%p was mapped!", virAddr);
+        return NX_EINVAL;
     }
-    /* increase last level page table reference */
-    void *levelPageTable = (void *)(NX_Virt2Phy((NX_Addr)pte) & NX_PAGE_ADDR_MASK);
-    NX_PageIncrease(levelPageTable);
-    
-    *pte = PADDR2PTE(phyAddr) | attr | PTE_P;
+    if (alloced == NX_False)
+    {
+        for (i = 0; i < count; i++)
+        {
+            if (PTE_USED(pte[i]))
+            {
+                NX_LOG_E("map page: vir:%p was mapped!", virAddr + i * PAGE_LEVEL_SIZE(level));
+                return NX_EINVAL;
+            }
+        }
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        pte[i] = PADDR2PTE(phyAddr + i * PAGE_LEVEL_SIZE(level)) | attr | PTE_P | (level ? PTE_PS : 0);
+    }
+
+    /* increase page table reference, page dir has no reference */
+    if (level == 0)
+    {
+        void *levelPageTable = (void *)(NX_Virt2Phy((NX_Addr)pte) & NX_PAGE_ADDR_MASK);
+        for (i = (alloced == NX_True) ? 1 : 0; i < count; i++)
+        {
+            NX_PageIncrease(levelPageTable);
+        }
+    }
+    return NX_EOK;
+}
 
+/**
+ * map physic range into virtual range, use 4MB page when virAddr & phyAddr
+ * both aligned, fill 4KB pte in the same table with one walk.
+ * mapped return the count of pages mapped before failed.
+ */
+NX_PRIVATE NX_Error MapRange(MMU *mmu, NX_Addr virAddr, NX_Addr phyAddr, NX_USize pages, NX_UArch attr,
+                             NX_USize *mapped)
+{
+    *mapped = 0;
+    while (pages > 0)
+    {
+        int level = PageFitLevel(virAddr, phyAddr, pages);
+        NX_USize count = 1;
+        if (level == 0)
+        {
+            count = PTE_CNT_PER_PAGE - GET_PTE_OFF(virAddr);
+            if (count > pages)
+            {
+                count = pages;
+            }
+        }
+        NX_Error err = MapTableRange(mmu, virAddr, phyAddr, level, count, attr);
+        if (err != NX_EOK)
+        {
+            NX_LOG_E("map page: vir:%p phy:%p attr:%x failed!", virAddr, phyAddr, attr);
+            return err;
+        }
+        virAddr += count * PAGE_LEVEL_SIZE(level);
+        phyAddr += count * PAGE_LEVEL_SIZE(level);
+        pages -= count * PAGE_LEVEL_PAGES(level);
+        *mapped += count * PAGE_LEVEL_PAGES(level);
+    }
     return NX_EOK;
 }
 
 NX_PRIVATE void *__MapPageWithPhy(MMU *mmu, NX_Addr virAddr, NX_Addr phyAddr, NX_USize size, NX_UArch attr)
 {
-    NX_Addr addrStart = phyAddr;
-    NX_Addr addrEnd = phyAddr + size - 1;
+    NX_USize mappedPages;
+    NX_Error err;
 
-    NX_ISize pages = GET_PF_ID(addrEnd) - GET_PF_ID(addrStart) + 1;
-    NX_USize mappedPages = 0;
+    TableLock(mmu);
+    err = MapRange(mmu, virAddr, phyAddr, size >> NX_PAGE_SHIFT, attr, &mappedPages);
+    TableUnlock(mmu);
+    if (err != NX_EOK)
+    {
+        __UnmapPage(mmu, virAddr, mappedPages);
+        return NX_NULL;
+    }
+    return (void *)phyAddr;
+}
 
-    while (pages > 0)
+/**
+ * alloc physic pages as large as possible, split them into single pages so
+ * that unmap can free each page.
+ */
+NX_PRIVATE void *AllocPhyPages(NX_USize pages, NX_USize *allocated)
+{
+    NX_USize count = PTE_CNT_PER_PAGE;
+    void *phyAddr;
+
+    if (pages < PTE_CNT_PER_PAGE)
     {
-        if (MapOnePage(mmu, virAddr, phyAddr, attr) != NX_EOK)
+        count = 1UL << (NX_FLS((int)pages) - 1);
+    }
+    for (; count > 0; count >>= 1)
+    {
+        phyAddr = NX_PageAlloc(count);
+        if (phyAddr != NX_NULL)
         {
-            NX_LOG_E("map page: vir:%p phy:%p attr:%x failed!", virAddr, phyAddr, attr);
-            __UnmapPage(mmu, addrStart, mappedPages);
-            return NX_NULL;
+            if (count > 1)
+            {
+                NX_PageSplit(phyAddr);
+            }
+            *allocated = count;
+            return phyAddr;
         }
-        virAddr += NX_PAGE_SIZE;
-        phyAddr += NX_PAGE_SIZE;
-        pages--;
-        mappedPages++;
     }
-    return (void *)addrStart;
+    return NX_NULL;
 }
 
 NX_PRIVATE void *__MapPage(MMU *mmu, NX_Addr virAddr, NX_USize size, NX_UArch attr)
 {
     NX_Addr addrStart = virAddr;
-    NX_Addr addrEnd = virAddr + size - 1;
-
-    NX_ISize pages = GET_PF_ID(addrEnd) - GET_PF_ID(addrStart) + 1;
+    NX_USize pages = size >> NX_PAGE_SHIFT;
     NX_USize mappedPages = 0;
+    NX_USize count;
+    NX_USize mapped;
+    NX_USize i;
+    NX_Error err;
     void *phyAddr;
 
     while (pages > 0)
     {
-        phyAddr = NX_PageAlloc(1);
+        phyAddr = AllocPhyPages(pages, &count);
         if (phyAddr == NX_NULL)
         {
             NX_LOG_E("map page: alloc page failed!");
             goto err;
         }
 
-        if (MapOnePage(mmu, virAddr, (NX_Addr)phyAddr, attr) != NX_EOK)
+        TableLock(mmu);
+        err = MapRange(mmu, virAddr, (NX_Addr)phyAddr, count, attr, &mapped);
+        TableUnlock(mmu);
+        if (err != NX_EOK)
         {
             NX_LOG_E("map page: vir:%p phy:%p attr:%x failed!", virAddr, phyAddr, attr);
+            /* pages mapped will be freed by unmap */
+            for (i = mapped; i < count; i++)
+            {
+                NX_PageFree(phyAddr + i * NX_PAGE_SIZE);
+            }
+            mappedPages += mapped;
             goto err;
         }
-        virAddr += NX_PAGE_SIZE;
-        phyAddr += NX_PAGE_SIZE;
-        pages--;
-        mappedPages++;
+        virAddr += count * NX_PAGE_SIZE;
+        pages -= count;
+        mappedPages += count;
     }
     return (void *)addrStart;
 err:
@@ -201,45 +425,118 @@ NX_PUBLIC void *MMU_MapPageWithPhy(MMU *mmu, NX_Addr virAddr, NX_Addr phyAddr, N
     return addr;
 }
 
-NX_PRIVATE NX_Error UnmapOnePage(MMU *mmu, NX_Addr virAddr)
+/**
+ * Map a 4KB page on virAddr with lock of mmu held by caller, pte not used
+ * needs no tlb flush. Return NX_EAGAIN if virAddr was mapped.
+ */
+NX_PUBLIC NX_Error MMU_MapPageLocked(MMU *mmu, NX_Addr virAddr, NX_Addr phyAddr, NX_UArch attr)
 {
-    MMU_PDE *pde, *pageTable = (MMU_PDE *)mmu->table;
     MMU_PTE *pte;
-    NX_Addr phyPage;
-    void *levelPageTable;
+    NX_Error err;
+    int level = 0;
+
+    virAddr = virAddr & NX_PAGE_ADDR_MASK;
+    pte = PageWalkLevel(mmu->table, virAddr, &level, NX_False, NX_NULL);
+    if (pte != NX_NULL && PTE_USED(*pte))
+    {
+        return NX_EAGAIN;
+    }
+    err = MapTableRange(mmu, virAddr, phyAddr & NX_PAGE_ADDR_MASK, 0, 1, attr);
+    return err == NX_EFAULT ? NX_ENOMEM : err;
+}
+
+/**
+ * table lost one pte, gather it if no pte used, then clear pde.
+ * page dir never free here.
+ */
+NX_PRIVATE void PutPageTable(MMU_Gather *gather, MMU_PTE *pteArray[2])
+{
+    void *levelPageTable = (void *)NX_Virt2Phy(((NX_Addr)pteArray[0]) & NX_PAGE_ADDR_MASK); /* get level page table by pte */
+    MMU_PDE *pde = pteArray[1];
 
+    if (NX_PageGetReference(levelPageTable) > 1)
+    {
+        NX_PageFree(levelPageTable); /* drop reference of pte */
+        return;
+    }
+    /* last pte cleared, free table after tlb flushed */
+    GatherPage(gather, levelPageTable);
+    NX_ASSERT(PTE_USED(*pde));
+    NX_ASSERT((NX_Addr)levelPageTable == PTE2PADDR(*pde));
+    *pde = 0;   /* clear pde */
+}
+
+/**
+ * unmap leaf pte in one table with one walk, return pages unmapped.
+ * only 4KB leaf page will be freed, 4MB page must be mapped with physic address.
+ */
+NX_PRIVATE NX_USize UnmapTableRange(MMU_Gather *gather, NX_Addr virAddr, NX_USize pages)
+{
     MMU_PTE *pteArray[2] = {NX_NULL, NX_NULL};
-    NX_ASSERT(PageWalkPTE(pageTable, virAddr, pteArray) == NX_EOK);
-
-    pte = pteArray[0];
-    NX_ASSERT(pte != NX_NULL);
-    NX_ASSERT(PTE_USED(*pte));
-    phyPage = PTE2PADDR(*pte);
-    NX_ASSERT(phyPage);
-    NX_PageFree((void *)phyPage);   /* free leaf page*/
-    *pte = 0; /* clear pte */
-    
-    /* free none-leaf page */
-    levelPageTable = (void *)(((NX_Addr)pte) & NX_PAGE_ADDR_MASK); /* get level page table by pte */
-    if (NX_PageFree(levelPageTable) == NX_EOK)
+    MMU_PTE *pte;
+    NX_USize count;
+    NX_USize i;
+
+    int level = PageWalkPTE(gather->mmu->table, virAddr, pteArray);
+    NX_ASSERT(level >= 0);
+
+    if (level > 0)
+    {
+        /* 4MB page can not be split */
+        if ((virAddr & (PAGE_LEVEL_SIZE(level) - 1)) || pages < PAGE_LEVEL_PAGES(level))
+        {
+            NX_LOG_E("unmap page: vir:%p is part of huge page!", virAddr);
+            return 0;
+        }
+        *pteArray[1] = 0;   /* clear pde, page dir never free here */
+        GatherRange(gather, virAddr, PAGE_LEVEL_SIZE(level));
+        return PAGE_LEVEL_PAGES(level);
+    }
+
+    count = PTE_CNT_PER_PAGE - GET_PTE_OFF(virAddr);
+    if (count > pages)
     {
-        pde = pteArray[1];
-        NX_ASSERT(PTE_USED(*pde));
-        NX_ASSERT((NX_Addr)levelPageTable == PTE2PADDR(*pde));
-        *pde = 0;   /* clear pde */
+        count = pages;
     }
-    return NX_EOK;
+
+    /* stop when gather is full, caller flushes and walks again */
+    for (i = 0; i < count && !GatherFull(gather); i++)
+    {
+        pte = pteArray[0] + i;
+        NX_ASSERT(PTE_USED(*pte));
+        NX_ASSERT(PTE2PADDR(*pte));
+        GatherRange(gather, virAddr + i * NX_PAGE_SIZE, NX_PAGE_SIZE);
+        GatherPage(gather, (void *)PTE2PADDR(*pte));   /* free leaf page after flush */
+        *pte = 0; /* clear pte */
+        /* table freed when last pte cleared */
+        PutPageTable(gather, pteArray);
+    }
+    return i;
 }
 
 NX_INLINE NX_Error __UnmapPage(MMU *mmu, NX_Addr virAddr, NX_USize pages)
 {
+    MMU_Gather gather;
+    NX_USize count;
+    NX_Error err = NX_EOK;
+
+    GatherInit(&gather, mmu);
+    TableLock(mmu);
     while (pages > 0)
     {
-        UnmapOnePage(mmu, virAddr);
-        virAddr += NX_PAGE_SIZE;
-        pages--;
+        GatherReserve(&gather);
+        count = UnmapTableRange(&gather, virAddr, pages);
+        if (count == 0)
+        {
+            err = NX_EINVAL;
+            break;
+        }
+        virAddr += count * NX_PAGE_SIZE;
+        pages -= count;
     }
-    return NX_EOK;
+    TableUnlock(mmu);
+    GatherFlush(&gather);
+    return err;
 }
 
 NX_PUBLIC NX_Error MMU_UnmapPage(MMU *mmu, NX_Addr virAddr, NX_USize size)
@@ -257,6 +554,294 @@ NX_PUBLIC NX_Error MMU_UnmapPage(MMU *mmu, NX_Addr virAddr, NX_USize size)
     return err;
 }
 
+/**
+ * unmap pages mapped in range, holes are skipped. used for the range which
+ * pages are populated on demand.
+ */
+NX_PUBLIC NX_Error MMU_UnmapSparse(MMU *mmu, NX_Addr virAddr, NX_USize size)
+{
+    MMU_Gather gather;
+    MMU_PTE *pte;
+    NX_Addr addrEnd;
+    NX_USize pages;
+    NX_USize count;
+    NX_Error err = NX_EOK;
+    int level;
+
+    virAddr = virAddr & NX_PAGE_ADDR_MASK;
+    addrEnd = NX_PAGE_ALIGNUP(virAddr + size);
+
+    NX_UArch irqLevel = NX_IRQ_SaveLevel();
+    GatherInit(&gather, mmu);
+    TableLock(mmu);
+    while (virAddr < addrEnd)
+    {
+        GatherReserve(&gather);
+        level = 0;
+        pte = PageWalkLevel(mmu->table, virAddr, &level, NX_False, NX_NULL);
+        if (pte == NX_NULL)
+        {
+            /* no table holds pte, skip to next table */
+            virAddr = (virAddr + PAGE_LEVEL_SIZE(1)) & ~(PAGE_LEVEL_SIZE(1) - 1);
+            continue;
+        }
+        if (!PTE_USED(*pte))
+        {
+            virAddr += NX_PAGE_SIZE;
+            continue;
+        }
+
+        pages = (addrEnd - virAddr) >> NX_PAGE_SHIFT;
+        if (level == 0)
+        {
+            /* unmap used pte in this table with one walk */
+            count = 1;
+            while (count < pages && count < PTE_CNT_PER_PAGE - GET_PTE_OFF(virAddr) && PTE_USED(pte[count]))
+            {
+                count++;
+            }
+            pages = count;
+        }
+        count = UnmapTableRange(&gather, virAddr, pages);
+        if (count == 0)
+        {
+            err = NX_EINVAL;
+            break;
+        }
+        virAddr += count * NX_PAGE_SIZE;
+    }
+    TableUnlock(mmu);
+    GatherFlush(&gather);
+    NX_IRQ_RestoreLevel(irqLevel);
+    return err;
+}
+
+/**
+ * share pte of src page table to dst page table, writable 4KB pages become
+ * read-only COW pages in both. return used pte count of dst table by used.
+ */
+NX_PRIVATE void CopyTableCOW(MMU_PTE *dstTable, MMU_PTE *srcTable, NX_USize *used)
+{
+    MMU_PTE pte;
+    NX_USize idx;
+
+    *used = 0;
+    for (idx = 0; idx < PTE_CNT_PER_PAGE; idx++)
+    {
+        pte = srcTable[idx];
+        if (!PTE_USED(pte))
+        {
+            continue;
+        }
+        /* only pages from buddy has reference, others are physic mapping */
+        if (NX_PageGetReference((void *)PTE2PADDR(pte)) > 0)
+        {
+            if (pte & PTE_W)
+            {
+                pte = (pte & ~PTE_W) | PTE_COW;
+                srcTable[idx] = pte;
+            }
+            NX_PageIncrease((void *)PTE2PADDR(pte));
+        }
+        dstTable[idx] = pte;
+        (*used)++;
+    }
+}
+
+/**
+ * Duplicate the space of src to dst with copy on write, only page tables are copied.
+ * The space must be aligned with 4MB, so no pde is shared by others.
+ * If failed, tables copied are left in dst and freed with dst.
+ */
+NX_PUBLIC NX_Error MMU_CopyOnWrite(MMU *dst, MMU *src)
+{
+    MMU_PDE pde;
+    MMU_PTE *table;
+    NX_USize used;
+    NX_USize idx;
+    NX_Error err = NX_EOK;
+
+    NX_ASSERT(!(src->virStart & (PAGE_LEVEL_SIZE(1) - 1)) && !(src->virEnd & (PAGE_LEVEL_SIZE(1) - 1)));
+
+    NX_UArch level = NX_IRQ_SaveLevel();
+    /* dst is not used by anyone yet, only src needs lock */
+    TableLock(src);
+    for (idx = GET_PDE_OFF(src->virStart); idx <= GET_PDE_OFF(src->virEnd - 1); idx++)
+    {
+        pde = src->table[idx];
+        if (!PTE_USED(pde))
+        {
+            continue;
+        }
+        if (PDE_IS_HUGE(pde))
+        {
+            /* 4MB page is physic mapping, share it */
+            dst->table[idx] = pde;
+            continue;
+        }
+
+        table = (MMU_PTE *)NX_PageAllocZeroed();
+        if (table == NX_NULL)
+        {
+            err = NX_ENOMEM;
+            break;
+        }
+        CopyTableCOW((MMU_PTE *)NX_Phy2Virt(table), (MMU_PTE *)NX_Phy2Virt(PTE2PADDR(pde)), &used);
+        if (used == 0)
+        {
+            NX_PageFree(table);
+            continue;
+        }
+        /* alloc reference stands for the first pte */
+        while (used-- > 1)
+        {
+            NX_PageIncrease(table);
+        }
+        dst->table[idx] = PADDR2PTE(table) | PTE2ATTR(pde);
+    }
+    TableUnlock(src);
+    /* pages of src become read-only */
+    MMU_ShootdownTLB(src, src->virStart, src->virEnd - src->virStart);
+    NX_IRQ_RestoreLevel(level);
+    return err;
+}
+
+/**
+ * handle write fault on COW page, copy the page if it is still shared,
+ * otherwise make it writable. return NX_EOK if fault handled.
+ */
+NX_PUBLIC NX_Error MMU_HandleCOWFault(MMU *mmu, NX_Addr virAddr)
+{
+    MMU_PTE *pte;
+    void *page;
+    void *newPage = NX_NULL;
+    NX_Error err;
+    int level = 0;
+
+    virAddr = virAddr & NX_PAGE_ADDR_MASK;
+    if (virAddr < mmu->virStart || virAddr >= mmu->virEnd)
+    {
+        return NX_EFAULT;
+    }
+
+    NX_UArch irqLevel = NX_IRQ_SaveLevel();
+    TableLock(mmu);
+    pte = PageWalkLevel(mmu->table, virAddr, &level, NX_False, NX_NULL);
+    if (pte == NX_NULL || level != 0 || !PTE_USED(*pte))
+    {
+        TableUnlock(mmu);
+        NX_IRQ_RestoreLevel(irqLevel);
+        return NX_EFAULT;
+    }
+    if (!(*pte & PTE_COW))
+    {
+        /* pte changed, other thread has handled the fault */
+        err = (*pte & PTE_W) ? NX_EOK : NX_EFAULT;
+        TableUnlock(mmu);
+        NX_IRQ_RestoreLevel(irqLevel);
+        return err;
+    }
+
+    page = (void *)PTE2PADDR(*pte);
+    if (NX_PageGetReference(page) == 1 && page != NX_PageGetZeroPage())
+    {
+        /* last user of page, no need copy */
+        *pte = (*pte & ~PTE_COW) | PTE_W;
+        page = NX_NULL;
+    }
+    else
+    {
+        /* write on zero page needs no copy */
+        newPage = (page == NX_PageGetZeroPage()) ? NX_PageAllocZeroed() : NX_PageAlloc(1);
+        if (newPage == NX_NULL)
+        {
+            TableUnlock(mmu);
+            NX_IRQ_RestoreLevel(irqLevel);
+            return NX_ENOMEM;
+        }
+        if (page != NX_PageGetZeroPage())
+        {
+            NX_MemCopy(NX_Phy2Virt(newPage), NX_Phy2Virt(page), NX_PAGE_SIZE);
+        }
+        *pte = MAKE_PTE(newPage, (PTE2ATTR(*pte) & ~PTE_COW) | PTE_W);
+    }
+    TableUnlock(mmu);
+    MMU_ShootdownTLB(mmu, virAddr, NX_PAGE_SIZE);
+    if (page != NX_NULL)
+    {
+        NX_PageFree(page);  /* drop reference after no core can access it */
+    }
+    NX_IRQ_RestoreLevel(irqLevel);
+    return NX_EOK;
+}
+
+/**
+ * flush tlb of virtual range on this cpu, flush all if too many pages
+ */
+NX_PUBLIC void MMU_FlushTLBRange(NX_Addr virAddr, NX_USize size)
+{
+    NX_Addr addr;
+
+    if (size > MMU_FLUSH_TLB_RANGE_MAX * NX_PAGE_SIZE)
+    {
+        MMU_FlushTLB();
+        return;
+    }
+    for (addr = virAddr & NX_PAGE_ADDR_MASK; addr < virAddr + size; addr += NX_PAGE_SIZE)
+    {
+        CPU_InvalidatePage(addr);
+    }
+}
+
+struct MMU_ShootdownRange
+{
+    NX_Addr table;      /* physic address of page table, 0 means kernel table */
+    NX_Addr virAddr;
+    NX_USize size;
+};
+typedef struct MMU_ShootdownRange MMU_ShootdownRange;
+
+/**
+ * no pcid, user pages of other table were flushed when page table switched
+ */
+NX_PRIVATE void MMU_ShootdownHandler(void *arg)
+{
+    MMU_ShootdownRange *range = (MMU_ShootdownRange *)arg;
+
+    if (range->table == 0 || range->table == MMU_GetPageTable())
+    {
+        MMU_FlushTLBRange(range->virAddr, range->size);
+    }
+}
+
+/**
+ * Flush tlb of range on all cores which have loaded the table of mmu,
+ * kernel table is loaded on all cores. Return after all of them flushed,
+ * so pages unmapped can be freed safely.
+ */
+NX_PUBLIC void MMU_ShootdownTLB(MMU *mmu, NX_Addr virAddr, NX_USize size)
+{
+    MMU_ShootdownRange range;
+    NX_CpuMask cpuMask = NX_CPU_MASK_ALL;
+
+    range.table = 0;
+    range.virAddr = virAddr;
+    range.size = size;
+    if (mmu->cpuMask != NX_NULL)
+    {
+        range.table = NX_Virt2Phy((NX_Addr)mmu->table);
+        cpuMask = NX_AtomicGet(mmu->cpuMask);
+    }
+
+    MMU_FlushTLBRange(virAddr, size);
+
+    cpuMask &= ~NX_CpuMaskOf(NX_SMP_GetIdx());
+    if (cpuMask != 0 && NX_SMP_CallFunction(cpuMask, MMU_ShootdownHandler, &range, NX_True) != NX_EOK)
+    {
+        NX_LOG_E("shootdown tlb on cores %lx failed!", (unsigned long)cpuMask);
+    }
+}
+
 NX_PUBLIC void *MMU_Vir2Phy(MMU *mmu, NX_Addr virAddr)
 {
     NX_Addr pagePhy;
@@ -264,7 +849,9 @@ NX_PUBLIC void *MMU_Vir2Phy(MMU *mmu, NX_Addr virAddr)
     
     MMU_PDE *pageTable = (MMU_PDE *)mmu->table;
 
-    MMU_PTE *pte = PageWalk(pageTable, virAddr, NX_False);
+    int level = 0;
+
+    MMU_PTE *pte = PageWalkLevel(pageTable, virAddr, &level, NX_False, NX_NULL);
     if (pte == NX_NULL)
     {
         NX_PANIC("vir2phy walk fault!");
@@ -276,13 +863,30 @@ NX_PUBLIC void *MMU_Vir2Phy(MMU *mmu, NX_Addr virAddr)
     }
 
     pagePhy = PTE2PADDR(*pte);
-    pageOffset = virAddr % NX_PAGE_SIZE;
+    pageOffset = virAddr & (PAGE_LEVEL_SIZE(level) - 1);
     return (void *)(pagePhy + pageOffset);
 }
 
+NX_PUBLIC NX_Bool MMU_IsMapped(MMU *mmu, NX_Addr virAddr)
+{
+    int level = 0;
+    NX_Bool mapped;
+    MMU_PTE *pte;
+
+    NX_UArch irqLevel = NX_IRQ_SaveLevel();
+    TableLock(mmu);
+    pte = PageWalkLevel(mmu->table, virAddr, &level, NX_False, NX_NULL);
+    mapped = (pte != NX_NULL && PTE_USED(*pte)) ? NX_True : NX_False;
+    TableUnlock(mmu);
+    NX_IRQ_RestoreLevel(irqLevel);
+    return mapped;
+}
+
 NX_PUBLIC void MMU_InitTable(MMU *mmu, void *pageTable, NX_Addr virStart, NX_USize size)
 {
     mmu->table = pageTable;
+    mmu->cpuMask = NX_NULL;
+    mmu->lock = NX_NULL;
     mmu->virStart = virStart & NX_PAGE_ADDR_MASK;
     mmu->virEnd = virStart + NX_PAGE_ALIGNUP(size);
 }
@@ -304,15 +908,9 @@ NX_PUBLIC void MMU_EarlyMap(MMU *mmu, NX_Addr virStart, NX_USize size)
     int i, j;
     for (i = 0; i < pdeCnt; i++)
     {
-        /* fill pde */
-        pdt[pdeIdx + i] = MAKE_PTE(pte, KERNEL_PAGE_ATTR);
-        for (j = 0; j < PTE_CNT_PER_PAGE; j++)
-        {
-            /* fill each pte */
-            pte[j] = MAKE_PTE(phyStart, KERNEL_PAGE_ATTR);
-            phyStart += NX_PAGE_SIZE;
-        }
-        pte += PTE_CNT_PER_PAGE;
+        /* fill pde with 4MB page, no page table needed */
+        pdt[pdeIdx + i] = MAKE_PTE(phyStart, KERNEL_PAGE_ATTR | PTE_PS);
+        phyStart += PAGE_LEVEL_SIZE(1);
     }
     if (pteCnt > 0)
     {
@@ -328,10 +926,28 @@ NX_PUBLIC void MMU_EarlyMap(MMU *mmu, NX_Addr virStart, NX_USize size)
 
 NX_PUBLIC void MMU_SetPageTable(NX_Addr addr)
 {
-    /* set new pgdir will flush tlb */
+    /* set new pgdir will flush tlb except global pages */
     CPU_WriteCR3(addr);
 }
 
+/**
+ * flush all tlb on this core, include global pages
+ */
+NX_PUBLIC void MMU_FlushTLB(void)
+{
+    NX_U32 cr4 = CPU_ReadCR4();
+    if (cr4 & CR4_PGE)
+    {
+        /* toggle PGE will flush global pages too */
+        CPU_WriteCR4(cr4 & ~CR4_PGE);
+        CPU_WriteCR4(cr4);
+    }
+    else
+    {
+        CPU_WriteCR3(CPU_ReadCR3());
+    }
+}
+
 NX_PUBLIC NX_Addr MMU_GetPageTable(void)
 {
     return CPU_ReadCR3();
@@ -339,5 +955,8 @@ NX_PUBLIC NX_Addr MMU_GetPageTable(void)
 
 NX_PUBLIC void MMU_Enable(void)
 {
-    CPU_WriteCR0(CPU_ReadCR0() | CR0_PG);
+    /* enable 4MB page and global page before paging */
+    CPU_WriteCR4(CPU_ReadCR4() | CR4_PSE | CR4_PGE);
+    /* kernel write read-only COW page will fault too */
+    CPU_WriteCR0(CPU_ReadCR0() | CR0_PG | CR0_WP);
 }
@@ -21,6 +21,8 @@ struct CPU_Segment
     NX_U8 limitHigh, baseHigh;
 };
 
+NX_PRIVATE struct CPU_Segment GdtTable[NX_MULTI_CORES_NR][GDT_ENTRY_NR] NX_CALIGN(8);
+
 NX_PRIVATE void SetSegment(struct CPU_Segment *seg, NX_UArch limit,
                         NX_UArch base, NX_UArch attributes)
 {
@@ -32,13 +34,13 @@ NX_PRIVATE void SetSegment(struct CPU_Segment *seg, NX_UArch limit,
     seg->baseHigh    = (base >> 24) & 0xff;
 }
 
-NX_PUBLIC void CPU_InitSegment(void)
+NX_PUBLIC void CPU_InitSegment(NX_UArch coreId)
 {
     /* Global segment table */
-    struct CPU_Segment *gdt = (struct CPU_Segment *) GDT_VADDR;
+    struct CPU_Segment *gdt = GdtTable[coreId];
 
     int i;
-    for (i = 0; i <= GDT_LIMIT / 8; i++)
+    for (i = 0; i < GDT_ENTRY_NR; i++)
     {
         SetSegment(GDT_OFF2PTR(gdt, i), 0, 0, 0);
     }
@@ -46,7 +48,7 @@ NX_PUBLIC void CPU_InitSegment(void)
     SetSegment(GDT_OFF2PTR(gdt, INDEX_KERNEL_CODE), GDT_BOUND_TOP, GDT_BOUND_BOTTOM, GDT_KERNEL_CODE_ATTR);
     SetSegment(GDT_OFF2PTR(gdt, INDEX_KERNEL_DATA), GDT_BOUND_TOP, GDT_BOUND_BOTTOM, GDT_KERNEL_DATA_ATTR);
 
-    struct CPU_TSS *tss = CPU_GetTSS();
+    struct CPU_TSS *tss = CPU_GetTSS(coreId);
     SetSegment(GDT_OFF2PTR(gdt, INDEX_TSS), sizeof(struct CPU_TSS) - 1, (NX_UArch)tss, GDT_TSS_ATTR);
 
     SetSegment(GDT_OFF2PTR(gdt, INDEX_USER_CODE), GDT_BOUND_TOP, GDT_BOUND_BOTTOM, GDT_USER_CODE_ATTR);
@@ -54,5 +56,5 @@ NX_PUBLIC void CPU_InitSegment(void)
 
     SetSegment(GDT_OFF2PTR(gdt, INDEX_USER_TLS), GDT_BOUND_TOP, GDT_BOUND_BOTTOM, GDT_USER_TLS_ATTR);
 
-    CPU_LoadGDT(GDT_LIMIT, GDT_VADDR);
+    CPU_LoadGDT(GDT_LIMIT, (NX_UArch)gdt);
 }
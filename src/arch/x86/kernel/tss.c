@@ -13,25 +13,28 @@
 #include <segment.h>
 #include <regs.h>
 #include <utils/memory.h>
+#include <sched/smp.h>
 
-NX_PRIVATE struct CPU_TSS tss;
+NX_PRIVATE struct CPU_TSS TssTable[NX_MULTI_CORES_NR];
 
-NX_PUBLIC struct CPU_TSS *CPU_GetTSS(void)
+NX_PUBLIC struct CPU_TSS *CPU_GetTSS(NX_UArch coreId)
 {
-    return &tss;
+    return &TssTable[coreId];
 }
 
 NX_PUBLIC void CPU_SetTssStack(NX_UArch top)
 {
-    tss.esp0 = top; /* esp0 is kernel mode */
+    TssTable[NX_SMP_GetIdx()].esp0 = top; /* esp0 is kernel mode */
 }
 
-void CPU_InitTSS(void)
+void CPU_InitTSS(NX_UArch coreId, NX_UArch stackTop)
 {
-    NX_MemZero(&tss, sizeof(struct CPU_TSS));
-    tss.esp0 = KERNEL_STACK_TOP;
-    tss.ss0 = KERNEL_DATA_SEL;
-    tss.iobase = sizeof(struct CPU_TSS);
+    struct CPU_TSS *tss = &TssTable[coreId];
+
+    NX_MemZero(tss, sizeof(struct CPU_TSS));
+    tss->esp0 = stackTop;
+    tss->ss0 = KERNEL_DATA_SEL;
+    tss->iobase = sizeof(struct CPU_TSS);
 
     CPU_LoadTR(KERNEL_TSS_SEL);
 }
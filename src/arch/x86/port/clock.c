@@ -14,6 +14,9 @@
 #include <mods/time/clock.h>
 #include <io/irq.h>
 #include <io/delay_irq.h>
+#include <sched/smp.h>
+#include <apic.h>
+#include <regs.h>
 
 #define NX_LOG_NAME "Clock"
 #include <utils/log.h>
@@ -134,14 +137,91 @@ enum ctrl_mode_bits
 #define TIMER_FREQ     1193180  /* clock frequency */
 #define COUNTER0_VALUE  (TIMER_FREQ / NX_TICKS_PER_SECOND)
 
+/* Port 61h, gate and output of counter 2, counter 2 is used to calibrate tsc */
+#define PIT_GATE_PORT       0x61
+#define PIT_GATE_ENABLE     0x01
+#define PIT_GATE_SPEAKER    0x02
+#define PIT_GATE_OUT        0x20
+
+#define TSC_CALIBRATE_MS    10
+#define COUNTER2_CALIBRATE_VALUE (TIMER_FREQ * TSC_CALIBRATE_MS / 1000)
+
+/* tsc cycles per second, all cores share one tsc rate */
+NX_PRIVATE NX_U64 TscFreq;
+
+/**
+ * Count tsc cycles in 10ms of PIT counter 2, counter 0 keeps ticking.
+ */
+NX_PRIVATE void TscCalibrate(void)
+{
+    NX_U64 begin;
+    NX_U32 cycles;
+    NX_U8 gate;
+
+    gate = IO_In8(PIT_GATE_PORT);
+    IO_Out8(PIT_GATE_PORT, (gate & ~PIT_GATE_SPEAKER) & ~PIT_GATE_ENABLE);
+
+    IO_Out8(PIT_CTRL, PIT_MODE_0 | PIT_MODE_MSB_LSB |
+            PIT_MODE_COUNTER_2 | PIT_MODE_BINARY);
+    IO_Out8(PIT_COUNTER2, (NX_U8) (COUNTER2_CALIBRATE_VALUE & 0xff));
+    IO_Out8(PIT_COUNTER2, (NX_U8) (COUNTER2_CALIBRATE_VALUE >> 8) & 0xff);
+
+    /* counter 2 starts when gate rises, output goes high when count reaches 0 */
+    IO_Out8(PIT_GATE_PORT, (gate & ~PIT_GATE_SPEAKER) | PIT_GATE_ENABLE);
+    begin = CPU_ReadTSC();
+    while (!(IO_In8(PIT_GATE_PORT) & PIT_GATE_OUT))
+    {
+    }
+    cycles = (NX_U32)(CPU_ReadTSC() - begin);
+    TscFreq = (NX_U64)cycles * (1000 / TSC_CALIBRATE_MS);
+
+    NX_LOG_I("tsc %d cycles per 10ms", cycles);
+}
+
+NX_INTERFACE NX_U64 HAL_ClockCounterGet(void)
+{
+    return CPU_ReadTSC();
+}
+
+NX_INTERFACE NX_U64 HAL_ClockCounterFreq(void)
+{
+    return TscFreq;
+}
+
 NX_PRIVATE NX_Error ClockHandler(NX_U32 irq, void *arg)
 {
     NX_ClockTickGo();
     return NX_EOK;
 }
 
+#ifdef CONFIG_NX_X86_APIC
+/**
+ * Each core ticks by its local timer, boot core calibrates timer and binds irq.
+ */
 NX_INTERFACE NX_Error HAL_InitClock(void)
 {
+    NX_Error err;
+
+    if (NX_SMP_GetIdx() == NX_SMP_GetBootCore())
+    {
+        TscCalibrate();
+        LAPIC_TimerCalibrate();
+
+        err = NX_IRQ_Bind(IRQ_LAPIC_TIMER, ClockHandler, NX_NULL, "Clock", NX_IRQ_FLAG_NOBALANCE);
+        if (err != NX_EOK)
+        {
+            NX_LOG_E("IRQ bind failed! %d", err);
+            return NX_ERROR;
+        }
+    }
+    LAPIC_TimerPeriodic(NX_TICKS_PER_SECOND);
+    return NX_EOK;
+}
+#else
+NX_INTERFACE NX_Error HAL_InitClock(void)
+{
+    TscCalibrate();
+
     IO_Out8(PIT_CTRL, PIT_MODE_2 | PIT_MODE_MSB_LSB |
             PIT_MODE_COUNTER_0 | PIT_MODE_BINARY);
     IO_Out8(PIT_COUNTER0, (NX_U8) (COUNTER0_VALUE & 0xff));
@@ -161,3 +241,4 @@ NX_INTERFACE NX_Error HAL_InitClock(void)
     }
     return NX_EOK;
 }
+#endif /* CONFIG_NX_X86_APIC */
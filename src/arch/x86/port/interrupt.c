@@ -14,8 +14,12 @@
 #include <utils/string.h>
 #include <utils/memory.h>
 #include <pic.h>
+#include <apic.h>
 #include <io/irq.h>
 #include <regs.h>
+#include <sched/thread.h>
+#include <sched/process.h>
+#include <mm/vma.h>
 
 #define NX_LOG_LEVEL NX_LOG_DBG
 #define NX_LOG_NAME "Interrupt"
@@ -59,6 +63,9 @@ NX_PRIVATE char *ExceptionName[] = {
 NX_PUBLIC void CPU_InitInterrupt(void)
 {
     PIC_Init();
+#ifdef CONFIG_NX_X86_APIC
+    APIC_Init();
+#endif
 }
 
 NX_PUBLIC void CPU_TrapFrameDump(HAL_TrapFrame *frame)
@@ -109,6 +116,21 @@ NX_PRIVATE void CPU_ExceptionDump(HAL_TrapFrame *frame)
     }
 }
 
+/* page fault error code bit 0: protection violation, bit 1: write access */
+#define PF_ERROR_PROTECT 0x01
+#define PF_ERROR_WRITE   0x02
+
+NX_PRIVATE NX_Error HandlePageFault(HAL_TrapFrame *frame)
+{
+    NX_Thread *thread = NX_ThreadSelf();
+    if (thread == NX_NULL || thread->resource.process == NX_NULL)
+    {
+        return NX_EFAULT;
+    }
+    return NX_VmaHandleFault(thread->resource.process, CPU_ReadCR2(),
+                             (frame->errorCode & PF_ERROR_WRITE) ? NX_VMA_WRITE : NX_VMA_READ);
+}
+
 NX_PUBLIC void HAL_InterruptDispatch(void *stackFrame)
 {
     HAL_TrapFrame *frame = (HAL_TrapFrame *) stackFrame;
@@ -118,10 +140,21 @@ NX_PUBLIC void HAL_InterruptDispatch(void *stackFrame)
     if (vector >= EXCEPTION_BASE && vector < EXCEPTION_BASE + MAX_EXCEPTION_NR)
     {
         /* exception */
+        if (vector == 14 && HandlePageFault(frame) == NX_EOK)
+        {
+            return;
+        }
         NX_LOG_E("unhandled exception vector %x/%s", vector, ExceptionName[vector]);
         CPU_ExceptionDump(frame);
         while (1);
     }
+#ifdef CONFIG_NX_X86_APIC
+    else if (vector == EXTERNAL_BASE + IRQ_SPURIOUS)
+    {
+        /* spurious interrupt has no eoi */
+        return;
+    }
+#endif
     else if (vector >= EXTERNAL_BASE && vector < EXTERNAL_BASE + NX_NR_IRQS)
     {
         NX_IRQ_Handle(vector - EXTERNAL_BASE);
@@ -138,12 +171,68 @@ NX_PUBLIC void HAL_InterruptDispatch(void *stackFrame)
     }
 }
 
+#ifdef CONFIG_NX_X86_APIC
 NX_PRIVATE NX_Error HAL_IrqUnmask(NX_IRQ_Number irqno)
 {
     if (irqno < 0 || irqno >= NX_NR_IRQS)
     {
         return NX_EINVAL;
     }
+    if (irqno == IRQ_LAPIC_TIMER)
+    {
+        LAPIC_TimerMask(NX_False);
+        return NX_EOK;
+    }
+    if (irqno >= IOAPIC_IRQS)
+    {
+        return NX_EOK;  /* ipi can not be masked */
+    }
+    return IOAPIC_Unmask(irqno);
+}
+
+NX_PRIVATE NX_Error HAL_IrqMask(NX_IRQ_Number irqno)
+{
+    if (irqno < 0 || irqno >= NX_NR_IRQS)
+    {
+        return NX_EINVAL;
+    }
+    if (irqno == IRQ_LAPIC_TIMER)
+    {
+        LAPIC_TimerMask(NX_True);
+        return NX_EOK;
+    }
+    if (irqno >= IOAPIC_IRQS)
+    {
+        return NX_EOK;
+    }
+    return IOAPIC_Mask(irqno);
+}
+
+NX_PRIVATE NX_Error HAL_IrqAck(NX_IRQ_Number irqno)
+{
+    if (irqno < 0 || irqno >= NX_NR_IRQS)
+    {
+        return NX_EINVAL;
+    }
+    LAPIC_SendEOI();
+    return NX_EOK;
+}
+
+NX_PRIVATE NX_Error HAL_IrqSetAffinity(NX_IRQ_Number irqno, NX_UArch cpuMask)
+{
+    if (irqno < 0 || irqno >= IOAPIC_IRQS)
+    {
+        return NX_EINVAL;   /* local irqs always on current core */
+    }
+    return IOAPIC_SetAffinity(irqno, cpuMask);
+}
+#else
+NX_PRIVATE NX_Error HAL_IrqUnmask(NX_IRQ_Number irqno)
+{
+    if (irqno < 0 || irqno >= PIC_IRQS)
+    {
+        return NX_EINVAL;
+    }
 
     PIC_Enable(irqno);
     return NX_EOK;
@@ -151,7 +240,7 @@ NX_PRIVATE NX_Error HAL_IrqUnmask(NX_IRQ_Number irqno)
 
 NX_PRIVATE NX_Error HAL_IrqMask(NX_IRQ_Number irqno)
 {
-    if (irqno < 0 || irqno >= NX_NR_IRQS)
+    if (irqno < 0 || irqno >= PIC_IRQS)
     {
         return NX_EINVAL;
     }
@@ -161,13 +250,14 @@ NX_PRIVATE NX_Error HAL_IrqMask(NX_IRQ_Number irqno)
 
 NX_PRIVATE NX_Error HAL_IrqAck(NX_IRQ_Number irqno)
 {
-    if (irqno < 0 || irqno >= NX_NR_IRQS)
+    if (irqno < 0 || irqno >= PIC_IRQS)
     {
         return NX_EINVAL;
     }
     PIC_Ack(irqno);
     return NX_EOK;
 }
+#endif /* CONFIG_NX_X86_APIC */
 
 NX_PRIVATE void HAL_IrqEnable(void)
 {
@@ -191,13 +281,24 @@ NX_PRIVATE void HAL_IrqRestoreLevel(NX_UArch level)
     NX_CASM("pushl %0; popfl": :"g" (level):"memory", "cc");
 }
 
+NX_PRIVATE NX_Bool HAL_IrqIsEnabled(void)
+{
+    NX_UArch level = 0;
+    NX_CASM("pushfl; popl %0":"=g" (level): :"memory");
+    return (level & EFLAGS_IF_1) ? NX_True : NX_False;
+}
+
 NX_INTERFACE NX_IRQ_Controller NX_IRQ_ControllerInterface = 
 {
     .unmask = HAL_IrqUnmask,
     .mask = HAL_IrqMask,
     .ack = HAL_IrqAck,
+#ifdef CONFIG_NX_X86_APIC
+    .setAffinity = HAL_IrqSetAffinity,
+#endif
     .enable = HAL_IrqEnable,
     .disable = HAL_IrqDisable,
     .saveLevel = HAL_IrqSaveLevel,
     .restoreLevel = HAL_IrqRestoreLevel,
+    .isEnabled = HAL_IrqIsEnabled,
 };
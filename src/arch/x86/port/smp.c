@@ -10,28 +10,171 @@
  */
 
 #include <sched/smp.h>
+#include <mm/barrier.h>
+#include <mm/page.h>
+#include <utils/memory.h>
+#include <segment.h>
+#include <gate.h>
+#include <tss.h>
+#include <apic.h>
+#include <platform.h>
+#include <interrupt.h>
 #define NX_LOG_NAME "Multi Core"
 #include <utils/log.h>
 
-NX_PUBLIC NX_UArch HAL_CoreGetIndex(void)
+#if NX_MULTI_CORES_NR > 1 && !defined(CONFIG_NX_X86_APIC)
+#error "multi core on i386 needs local APIC, enable CONFIG_NX_X86_APIC"
+#endif
+
+#ifdef CONFIG_NX_X86_APIC
+
+/* trampoline must be 4KB aligned under 1MB, in real mode */
+#define AP_TRAMPOLINE_ADDR  0x7000
+
+#define AP_STACK_SIZE       8192
+
+/* wait app core setup, in 10ms */
+#define AP_BOOT_TIMEOUT     100
+
+NX_IMPORT char CPU_ApTrampoline[];
+NX_IMPORT char CPU_ApTrampolineEnd[];
+NX_IMPORT char CPU_ApGdtr[];
+
+/* read by trampoline, set before app core boot */
+NX_PUBLIC NX_VOLATILE NX_Addr CPU_ApBootPageTable;
+NX_PUBLIC NX_VOLATILE NX_Addr CPU_ApBootStack;
+NX_PUBLIC NX_VOLATILE NX_UArch CPU_ApBootCoreId;
+
+/* app core set it after cpu init done */
+NX_PRIVATE NX_VOLATILE NX_Bool ApStarted;
+
+/* stack used before first thread */
+NX_PRIVATE NX_U8 ApStack[NX_MULTI_CORES_NR][AP_STACK_SIZE] NX_CALIGN(16);
+
+NX_PRIVATE NX_UArch HAL_CoreGetIndex(void)
+{
+    return LAPIC_GetCoreId();
+}
+
+NX_PRIVATE NX_Error BootApp(NX_UArch coreId, NX_U32 apicId)
+{
+    int i;
+
+    CPU_ApBootCoreId = coreId;
+    CPU_ApBootStack = (NX_Addr)&ApStack[coreId][AP_STACK_SIZE];
+    ApStarted = NX_False;
+    NX_MemoryBarrier();
+
+    /* INIT, STARTUP, STARTUP sequence */
+    LAPIC_SendInitIPI(apicId);
+    APIC_DelayUs(10000);
+    LAPIC_SendStartupIPI(apicId, AP_TRAMPOLINE_ADDR);
+    APIC_DelayUs(200);
+    if (!ApStarted)
+    {
+        LAPIC_SendStartupIPI(apicId, AP_TRAMPOLINE_ADDR);
+    }
+
+    for (i = 0; i < AP_BOOT_TIMEOUT && !ApStarted; i++)
+    {
+        APIC_DelayUs(10000);
+    }
+    return ApStarted ? NX_EOK : NX_ETIMEOUT;
+}
+
+/**
+ * No MADT parsed, apic id of core is assumed same as core id, which is
+ * the default on qemu. Cores are booted one by one, share one trampoline.
+ */
+NX_PRIVATE NX_Error HAL_CoreBootApp(NX_UArch bootCoreId)
+{
+    NX_UArch coreId;
+    NX_U16 *gdtr;
+
+    NX_LOG_I("boot core is:%d", bootCoreId);
+
+    NX_MemCopy((void *)AP_TRAMPOLINE_ADDR, CPU_ApTrampoline, CPU_ApTrampolineEnd - CPU_ApTrampoline);
+
+    /* app core loads gdt of boot core in real mode */
+    gdtr = (NX_U16 *)(AP_TRAMPOLINE_ADDR + (CPU_ApGdtr - CPU_ApTrampoline));
+    NX_CASM("sgdtl %0" : "=m" (*gdtr));
+
+    CPU_ApBootPageTable = NX_Virt2Phy((NX_Addr)HAL_GetKernelPageTable());
+
+    for (coreId = 0; coreId < NX_MULTI_CORES_NR; coreId++)
+    {
+        if (bootCoreId == coreId) /* skip boot core */
+        {
+            continue;
+        }
+        NX_LOG_I("wakeup app core:%d", coreId);
+        if (BootApp(coreId, coreId) != NX_EOK)
+        {
+            NX_LOG_E("app core:%d not respond", coreId);
+            return NX_ETIMEOUT;
+        }
+    }
+    return NX_EOK;
+}
+
+NX_PRIVATE NX_Error HAL_CoreEnterApp(NX_UArch appCoreId)
+{
+    /* NOTE: init segment & local APIC first, core id is got from local APIC */
+    CPU_InitSegment(appCoreId);
+    CPU_LoadGate();
+    CPU_InitTSS(appCoreId, (NX_UArch)&ApStack[appCoreId][AP_STACK_SIZE]);
+    LAPIC_Init(appCoreId);
+
+    NX_MemoryBarrier();
+    ApStarted = NX_True;
+
+    NX_LOG_I("core#%d enter application!", appCoreId);
+    return NX_EOK;
+}
+
+NX_PRIVATE NX_Error HAL_CoreSendIpi(NX_UArch cpuMask)
+{
+    NX_UArch coreId;
+
+    for (coreId = 0; coreId < NX_MULTI_CORES_NR; coreId++)
+    {
+        if (cpuMask & (1UL << coreId))
+        {
+            LAPIC_SendIPI(coreId, EXTERNAL_BASE + IRQ_IPI);
+        }
+    }
+    return NX_EOK;
+}
+
+#else
+
+NX_PRIVATE NX_UArch HAL_CoreGetIndex(void)
 {
     return 0;
 }
 
-NX_PUBLIC NX_Error HAL_CoreBootApp(NX_UArch bootCoreId)
+NX_PRIVATE NX_Error HAL_CoreBootApp(NX_UArch bootCoreId)
 {
     NX_LOG_I("boot core is:%d", bootCoreId);
     return NX_ENORES;
 }
 
-NX_PUBLIC NX_Error HAL_CoreEnterApp(NX_UArch appCoreId)
+NX_PRIVATE NX_Error HAL_CoreEnterApp(NX_UArch appCoreId)
 {
     return NX_ENORES;
 }
 
+NX_PRIVATE NX_Error HAL_CoreSendIpi(NX_UArch cpuMask)
+{
+    return NX_ENORES;
+}
+
+#endif /* CONFIG_NX_X86_APIC */
+
 NX_INTERFACE struct NX_SMP_Ops NX_SMP_OpsInterface = 
 {
     .getIdx = HAL_CoreGetIndex,
     .bootApp = HAL_CoreBootApp,
     .enterApp = HAL_CoreEnterApp,
+    .sendIpi = HAL_CoreSendIpi,
 };
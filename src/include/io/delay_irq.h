@@ -33,6 +33,19 @@ typedef enum NX_IRQ_DelayQueue NX_IRQ_DelayQueue;
 
 typedef void (*NX_IRQ_WorkHandler)(void *arg);
 
+struct NX_IRQ_DelayWork;
+
+/* node of work on pending list of a cpu */
+struct NX_IRQ_DelayWorkNode
+{
+    NX_List list;
+    struct NX_IRQ_DelayWork *work;
+#ifdef CONFIG_NX_IRQ_STATS
+    NX_U64 handleTime;  /* clock counter when handled */
+#endif
+};
+typedef struct NX_IRQ_DelayWorkNode NX_IRQ_DelayWorkNode;
+
 struct NX_IRQ_DelayWork
 {
     NX_List list;
@@ -40,9 +53,19 @@ struct NX_IRQ_DelayWork
     NX_IRQ_WorkHandler handler;
     void *arg;
     NX_IRQ_DelayQueue queue;
+    NX_IRQ_DelayWorkNode pending[NX_MULTI_CORES_NR];
 };
 typedef struct NX_IRQ_DelayWork NX_IRQ_DelayWork;
 
+/* time is in clock counter cycles, see NX_ClockCounterFreq */
+struct NX_IRQ_DelayQueueStat
+{
+    NX_U64 runs;            /* works run */
+    NX_U64 totalLatency;    /* time from handle to run */
+    NX_U64 maxLatency;
+};
+typedef struct NX_IRQ_DelayQueueStat NX_IRQ_DelayQueueStat;
+
 NX_PUBLIC void NX_IRQ_DelayQueueInit(void);
 
 NX_PUBLIC NX_Error NX_IRQ_DelayQueueEnter(NX_IRQ_DelayQueue queue, NX_IRQ_DelayWork *work);
@@ -56,4 +79,7 @@ NX_PUBLIC NX_Error NX_IRQ_DelayWorkHandle(NX_IRQ_DelayWork *work);
 
 NX_INTERFACE void NX_IRQ_DelayQueueCheck(void);
 
+NX_PUBLIC NX_Error NX_IRQ_DelayQueueStatGet(NX_IRQ_DelayQueue queue, NX_UArch coreId, NX_IRQ_DelayQueueStat *stat);
+NX_PUBLIC void NX_IRQ_DelayQueueStatDump(void);
+
 #endif  /* __IO_DELAY_IRQ__ */
@@ -15,6 +15,7 @@
 #include <xbook.h>
 #include <utils/list.h>
 #include <xbook/atomic.h>
+#include <sched/spin.h>
 
 #ifdef CONFIG_NX_IRQ_NAME_LEN
 #define NX_IRQ_NAME_LEN CONFIG_NX_IRQ_NAME_LEN
@@ -30,6 +31,10 @@
 
 #define NX_IRQ_FLAG_REENTER    0x01    /* handle irq allow reenter */
 #define NX_IRQ_FLAG_SHARED     0x02    /* irq was shared by more device */
+#define NX_IRQ_FLAG_NOBALANCE  0x04    /* irq balance never move the irq */
+
+/* cpu mask with all cores */
+#define NX_IRQ_AFFINITY_ALL ((NX_UArch)((1UL << NX_MULTI_CORES_NR) - 1))
 
 typedef NX_U32 NX_IRQ_Number;
 typedef NX_Error (*NX_IRQ_Handler)(NX_IRQ_Number, void *);
@@ -39,14 +44,18 @@ struct NX_IRQ_Controller
     NX_Error (*unmask)(NX_IRQ_Number irqno);
     NX_Error (*mask)(NX_IRQ_Number irqno);
     NX_Error (*ack)(NX_IRQ_Number irqno);
+    NX_Error (*setAffinity)(NX_IRQ_Number irqno, NX_UArch cpuMask);
     
     void (*enable)(void);
     void (*disable)(void);
     NX_UArch (*saveLevel)(void);
     void (*restoreLevel)(NX_UArch level);
+    NX_Bool (*isEnabled)(void);
 };
 typedef struct NX_IRQ_Controller NX_IRQ_Controller;
 
+struct NX_Thread;
+
 struct NX_IRQ_Action
 {
     NX_List list;
@@ -54,6 +63,14 @@ struct NX_IRQ_Action
     void *data;
     NX_U32 flags;
     char name[NX_IRQ_NAME_LEN];
+
+    /* threaded irq */
+    NX_IRQ_Number irqno;
+    NX_IRQ_Handler threadHandler;
+    struct NX_Thread *thread;
+    NX_Spin threadLock;
+    NX_Bool threadPending;  /* irq masked until thread handled it */
+    NX_Bool threadExit;
 };
 typedef struct NX_IRQ_Action NX_IRQ_Action;
 
@@ -63,9 +80,19 @@ struct NX_IRQ_Node
     NX_List actionList;
     NX_U32 flags;
     NX_Atomic reference;   /* irq reference */
+    NX_UArch affinity;     /* cpu mask irq routed to */
 };
 typedef struct NX_IRQ_Node NX_IRQ_Node;
 
+/* time is in clock counter cycles, see NX_ClockCounterFreq */
+struct NX_IRQ_Stat
+{
+    NX_U64 count;
+    NX_U64 totalTime;   /* time in handlers */
+    NX_U64 maxTime;
+};
+typedef struct NX_IRQ_Stat NX_IRQ_Stat;
+
 NX_INTERFACE NX_IMPORT NX_IRQ_Controller NX_IRQ_ControllerInterface;
 
 NX_PUBLIC NX_Error NX_IRQ_Bind(NX_IRQ_Number irqno,
@@ -74,17 +101,31 @@ NX_PUBLIC NX_Error NX_IRQ_Bind(NX_IRQ_Number irqno,
                          char *name,
                          NX_U32 flags);
                          
+NX_PUBLIC NX_Error NX_IRQ_BindThreaded(NX_IRQ_Number irqno,
+                         NX_IRQ_Handler quickHandler,
+                         NX_IRQ_Handler threadHandler,
+                         void *data,
+                         char *name,
+                         NX_U32 flags);
+
 NX_PUBLIC NX_Error NX_IRQ_Unbind(NX_IRQ_Number irqno, void *data);
 
 NX_PUBLIC NX_Error NX_IRQ_Unmask(NX_IRQ_Number irqno);
 NX_PUBLIC NX_Error NX_IRQ_Mask(NX_IRQ_Number irqno);
 
+NX_PUBLIC NX_Error NX_IRQ_SetAffinity(NX_IRQ_Number irqno, NX_UArch cpuMask);
+NX_PUBLIC NX_UArch NX_IRQ_GetAffinity(NX_IRQ_Number irqno);
+
 NX_PUBLIC NX_Error NX_IRQ_Handle(NX_IRQ_Number irqno);
 
+NX_PUBLIC NX_Error NX_IRQ_StatGet(NX_IRQ_Number irqno, NX_UArch coreId, NX_IRQ_Stat *stat);
+NX_PUBLIC void NX_IRQ_StatDump(void);
+
 #define NX_IRQ_Enable()            NX_IRQ_ControllerInterface.enable()
 #define NX_IRQ_Disable()           NX_IRQ_ControllerInterface.disable()
 #define NX_IRQ_SaveLevel()         NX_IRQ_ControllerInterface.saveLevel()
 #define NX_IRQ_RestoreLevel(level) NX_IRQ_ControllerInterface.restoreLevel(level)
+#define NX_IRQ_IsEnabled()         NX_IRQ_ControllerInterface.isEnabled()
 
 NX_PUBLIC void NX_IRQ_Init(void);
 
@@ -52,6 +52,8 @@ NX_PUBLIC NX_BuddySystem* NX_BuddyCreate(void *mem, NX_USize size);
 NX_PUBLIC void *NX_BuddyAllocPage(NX_BuddySystem* system, NX_USize count);
 NX_PUBLIC NX_Error NX_BuddyFreePage(NX_BuddySystem* system, void *ptr);
 NX_PUBLIC NX_Error NX_BuddyIncreasePage(NX_BuddySystem* system, void *ptr);
+NX_PUBLIC NX_Error NX_BuddySplitPage(NX_BuddySystem* system, void *ptr);
+NX_PUBLIC NX_IArch NX_BuddyGetPageReference(NX_BuddySystem* system, void *ptr);
 
 NX_PUBLIC NX_Page* NX_PageFromPtr(NX_BuddySystem* system, void *ptr);
 
@@ -21,6 +21,20 @@
 #define NX_PAGE_SHIFT 12
 #endif
 
+/* normal zone is also capped by kernel space size of each platform */
+#ifdef CONFIG_NX_PAGE_ZONE_NORMAL_PERCENT
+#define NX_PAGE_ZONE_NORMAL_PERCENT CONFIG_NX_PAGE_ZONE_NORMAL_PERCENT
+#else
+#define NX_PAGE_ZONE_NORMAL_PERCENT 50
+#endif
+
+/* free pages zeroed in background, consumed by zeroed page alloc */
+#ifdef CONFIG_NX_PAGE_ZERO_POOL_PAGES
+#define NX_PAGE_ZERO_POOL_PAGES CONFIG_NX_PAGE_ZERO_POOL_PAGES
+#else
+#define NX_PAGE_ZERO_POOL_PAGES 64
+#endif
+
 #define NX_PAGE_SIZE   (1U << NX_PAGE_SHIFT)
 #define NX_PAGE_MASK   (NX_PAGE_SIZE - 1UL)
 
@@ -34,14 +48,22 @@ NX_PUBLIC void NX_PageInitZone(NX_PageZone zone, void *mem, NX_USize size);
 NX_PUBLIC void *NX_PageAllocInZone(NX_PageZone zone, NX_USize count);
 NX_PUBLIC NX_Error NX_PageFreeInZone(NX_PageZone zone, void *ptr);
 NX_PUBLIC NX_Error NX_PageIncreaseInZone(NX_PageZone zone, void *ptr);
+NX_PUBLIC NX_Error NX_PageSplitInZone(NX_PageZone zone, void *ptr);
+NX_PUBLIC NX_IArch NX_PageGetReferenceInZone(NX_PageZone zone, void *ptr);
 NX_PUBLIC void *NX_PageZoneGetBase(NX_PageZone zone);
 NX_PUBLIC NX_USize NX_PageZoneGetPages(NX_PageZone zone);
 
 NX_PUBLIC void *NX_PageZoneGetBuddySystem(NX_PageZone zone);
 
+NX_PUBLIC void *NX_PageAllocZeroed(void);
+NX_PUBLIC NX_USize NX_PageZeroPoolFill(NX_USize count);
+NX_PUBLIC void *NX_PageGetZeroPage(void);
+
 #define NX_PageAlloc(count) NX_PageAllocInZone(NX_PAGE_ZONE_NORMAL, count)
 #define NX_PageFree(ptr) NX_PageFreeInZone(NX_PAGE_ZONE_NORMAL, ptr)
 #define NX_PageIncrease(ptr) NX_PageIncreaseInZone(NX_PAGE_ZONE_NORMAL, ptr)
+#define NX_PageSplit(ptr) NX_PageSplitInZone(NX_PAGE_ZONE_NORMAL, ptr)
+#define NX_PageGetReference(ptr) NX_PageGetReferenceInZone(NX_PAGE_ZONE_NORMAL, ptr)
 
 #define NX_Phy2Virt(addr) ((addr) + NX_KVADDR_OFFSET)
 #define NX_Virt2Phy(addr) ((addr) - NX_KVADDR_OFFSET)
@@ -0,0 +1,40 @@
+/**
+ * Copyright (c) 2018-2022, BookOS Development Team
+ * SPDX-License-Identifier: Apache-2.0
+ * 
+ * Contains: Virtual memory area of user space
+ */
+
+#ifndef __MM_VMA__
+#define __MM_VMA__
+
+#include <xbook.h>
+#include <utils/list.h>
+
+#define NX_VMA_READ     0x01
+#define NX_VMA_WRITE    0x02
+#define NX_VMA_EXEC     0x04
+
+/**
+ * Area [start, end) of user space reserved by process, pages are populated
+ * on first touch in page fault.
+ */
+struct NX_Vma
+{
+    NX_List list;
+    NX_Addr start;
+    NX_Addr end;
+    NX_U32 flags;
+};
+typedef struct NX_Vma NX_Vma;
+
+struct NX_Process;
+
+NX_PUBLIC NX_Error NX_VmaMap(struct NX_Process *process, NX_Addr addr, NX_USize size, NX_U32 flags);
+NX_PUBLIC NX_Error NX_VmaUnmap(struct NX_Process *process, NX_Addr addr, NX_USize size);
+NX_PUBLIC NX_Error NX_VmaCopy(struct NX_Process *dst, struct NX_Process *src);
+NX_PUBLIC void NX_VmaUnmapAll(struct NX_Process *process);
+NX_PUBLIC NX_Error NX_VmaGetFlags(struct NX_Process *process, NX_Addr addr, NX_U32 *flags);
+NX_PUBLIC NX_Error NX_VmaHandleFault(struct NX_Process *process, NX_Addr addr, NX_U32 access);
+
+#endif /* __MM_VMA__ */
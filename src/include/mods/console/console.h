@@ -20,6 +20,8 @@
 
 NX_PUBLIC void NX_ConsoleOutChar(char ch);
 NX_PUBLIC void NX_ConsoleOutStr(const char *str);
+NX_PUBLIC void NX_ConsoleOutBuf(const char *buf, NX_USize len);
+NX_PUBLIC void NX_ConsoleFlush(void);
 
 NX_PUBLIC void NX_Printf(const char *fmt, ...);
 
@@ -37,6 +37,9 @@ NX_PUBLIC void NX_ClockTickGo(void);
 
 NX_PUBLIC NX_Error NX_ClockTickDelay(NX_ClockTick ticks);
 
+NX_PUBLIC NX_U64 NX_ClockCounterGet(void);
+NX_PUBLIC NX_U64 NX_ClockCounterFreq(void);
+
 NX_INLINE NX_TimeVal NX_ClockTickToMillisecond(NX_ClockTick tick)
 {
     return NX_TICKS_TO_MILLISECOND(tick);
@@ -0,0 +1,25 @@
+#ifndef __NX_CONFIG__
+#define __NX_CONFIG__
+#define CONFIG_NX_DEBUG 1
+#define CONFIG_NX_LOG_LEVEL 3
+#define CONFIG_NX_DEBUG_COLOR 1
+#define CONFIG_NX_DEBUG_TIMELINE 1
+#define CONFIG_NX_LOG_RING 1
+#define CONFIG_NX_LOG_RING_SIZE 8192
+#define CONFIG_NX_LOG_DRAIN_PERIOD 20
+#define CONFIG_NX_PLATFROM_NAME "x86-i386"
+#define CONFIG_NX_MULTI_CORES_NR 1
+#define CONFIG_NX_IRQ_NAME_LEN 48
+#define CONFIG_NX_NR_IRQS 32
+#define CONFIG_NX_IRQ_STATS 1
+#define CONFIG_NX_KVADDR_OFFSET 0x00000000
+#define CONFIG_NX_PAGE_SHIFT 12
+#define CONFIG_NX_PAGE_ZONE_NORMAL_PERCENT 50
+#define CONFIG_NX_PAGE_ZERO_POOL_PAGES 64
+#define CONFIG_NX_MAX_THREAD_NR 256
+#define CONFIG_NX_THREAD_NAME_LEN 32
+#define CONFIG_NX_THREAD_STACK_SIZE 8192
+#define CONFIG_NX_ENABLE_SCHED 1
+#define CONFIG_NX_PLATFROM_I386_PC32 1
+#define CONFIG_NX_TICKS_PER_SECOND 100
+#endif
@@ -0,0 +1,47 @@
+/**
+ * Copyright (c) 2018-2022, BookOS Development Team
+ * SPDX-License-Identifier: Apache-2.0
+ * 
+ * Contains: Cpu mask
+ */
+
+#ifndef __SCHED_CPUMASK__
+#define __SCHED_CPUMASK__
+
+#include <xbook.h>
+
+/* bit n set means core n */
+typedef NX_UArch NX_CpuMask;
+
+/* all cores of system */
+#define NX_CPU_MASK_ALL ((NX_CpuMask)((1UL << NX_MULTI_CORES_NR) - 1))
+
+#define NX_CpuMaskOf(coreId) ((NX_CpuMask)1UL << (coreId))
+
+NX_INLINE NX_Bool NX_CpuMaskTest(NX_CpuMask mask, NX_UArch coreId)
+{
+    return coreId < NX_MULTI_CORES_NR && (mask & NX_CpuMaskOf(coreId)) ? NX_True : NX_False;
+}
+
+/**
+ * first core in mask, NX_MULTI_CORES_NR if empty
+ */
+NX_INLINE NX_UArch NX_CpuMaskFirst(NX_CpuMask mask)
+{
+    NX_UArch coreId;
+    for (coreId = 0; coreId < NX_MULTI_CORES_NR; coreId++)
+    {
+        if (mask & NX_CpuMaskOf(coreId))
+        {
+            break;
+        }
+    }
+    return coreId;
+}
+
+NX_INLINE NX_Bool NX_CpuMaskIsSingle(NX_CpuMask mask)
+{
+    return mask != 0 && !(mask & (mask - 1)) ? NX_True : NX_False;
+}
+
+#endif /* __SCHED_CPUMASK__ */
@@ -0,0 +1,72 @@
+/**
+ * Copyright (c) 2018-2022, BookOS Development Team
+ * SPDX-License-Identifier: Apache-2.0
+ * 
+ * Contains: Deadline(EDF) real-time sched class
+ */
+
+#ifndef __SCHED_DEADLINE__
+#define __SCHED_DEADLINE__
+
+#include <xbook.h>
+#include <utils/list.h>
+#include <mods/time/timer.h>
+
+#ifdef CONFIG_NX_SCHED_DEADLINE_UTIL
+#define NX_SCHED_DEADLINE_UTIL CONFIG_NX_SCHED_DEADLINE_UTIL
+#else
+#define NX_SCHED_DEADLINE_UTIL 90
+#endif
+
+/* utilization is runtime / period in per thousand */
+#define NX_DEADLINE_UTIL_SCALE 1000
+
+/**
+ * Time is in clock ticks. A job is released each period with runtime budget,
+ * thread completes a job by NX_ThreadDeadlineWait.
+ */
+struct NX_ThreadDeadline
+{
+    NX_ClockTick runtime;       /* budget of each job, 0 if not deadline thread */
+    NX_ClockTick period;
+    NX_ClockTick deadline;      /* relative deadline from job released */
+    NX_ClockTick absDeadline;   /* deadline of current job */
+    NX_ClockTick budget;        /* runtime left of current job */
+    NX_Bool throttled;          /* budget used up, sleep until next period */
+    NX_Bool waiting;            /* sleep until next period */
+    NX_U32 util;                /* utilization reserved on core */
+    NX_U32 released;            /* jobs released */
+    NX_U32 completed;           /* jobs completed */
+    NX_U32 missCount;           /* jobs not completed before next released */
+    NX_Timer *timer;            /* replenish timer */
+};
+typedef struct NX_ThreadDeadline NX_ThreadDeadline;
+
+struct NX_ThreadDeadlineStat
+{
+    NX_ClockTick runtime;
+    NX_ClockTick period;
+    NX_ClockTick deadline;
+    NX_U32 released;
+    NX_U32 completed;
+    NX_U32 missCount;
+};
+typedef struct NX_ThreadDeadlineStat NX_ThreadDeadlineStat;
+
+struct NX_Thread;
+
+#define NX_ThreadIsDeadline(thread) ((thread)->deadline.runtime != 0)
+
+NX_PUBLIC NX_Error NX_ThreadSetDeadline(struct NX_Thread *thread, NX_UArch runtime, NX_UArch period, NX_UArch deadline);
+NX_PUBLIC NX_Error NX_ThreadDeadlineWait(void);
+NX_PUBLIC NX_Error NX_ThreadDeadlineStatGet(struct NX_Thread *thread, NX_ThreadDeadlineStat *stat);
+NX_PUBLIC NX_U32 NX_DeadlineUtilGet(NX_UArch coreId);
+
+/* called by scheduler */
+NX_PUBLIC void NX_DeadlineListAdd(NX_List *list, struct NX_Thread *thread);
+NX_PUBLIC NX_Bool NX_DeadlinePreempt(struct NX_Thread *running, struct NX_Thread *thread);
+NX_PUBLIC void NX_DeadlineTick(struct NX_Thread *thread);
+NX_PUBLIC NX_Bool NX_DeadlineThrottle(struct NX_Thread *thread, NX_UArch irqLevel);
+NX_PUBLIC void NX_DeadlineRelease(struct NX_Thread *thread);
+
+#endif /* __SCHED_DEADLINE__ */
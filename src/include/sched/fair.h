@@ -0,0 +1,72 @@
+/**
+ * Copyright (c) 2018-2022, BookOS Development Team
+ * SPDX-License-Identifier: Apache-2.0
+ * 
+ * Contains: Fair share sched class
+ */
+
+#ifndef __SCHED_FAIR__
+#define __SCHED_FAIR__
+
+#include <xbook.h>
+#include <utils/rbtree.h>
+
+#ifdef CONFIG_NX_SCHED_FAIR_LATENCY
+#define NX_SCHED_FAIR_LATENCY CONFIG_NX_SCHED_FAIR_LATENCY
+#else
+#define NX_SCHED_FAIR_LATENCY 20
+#endif
+
+#ifdef CONFIG_NX_SCHED_FAIR_GRANULARITY
+#define NX_SCHED_FAIR_GRANULARITY CONFIG_NX_SCHED_FAIR_GRANULARITY
+#else
+#define NX_SCHED_FAIR_GRANULARITY 4
+#endif
+
+#define NX_NICE_MIN (-20)
+#define NX_NICE_MAX 19
+
+#define NX_NICE_0_WEIGHT_SHIFT 10
+#define NX_NICE_0_WEIGHT (1 << NX_NICE_0_WEIGHT_SHIFT)
+
+struct NX_ThreadFair
+{
+    NX_RbNode node;     /* node in fair queue of core */
+    NX_U64 vruntime;    /* runtime in nanoseconds, weighted by nice 0 weight / weight */
+    NX_U32 weight;
+    NX_U32 invWeight;   /* 2^32 / weight */
+    int nice;
+    NX_Bool queued;     /* on fair queue */
+    NX_Bool relative;   /* vruntime is relative to min vruntime, when not on core */
+};
+typedef struct NX_ThreadFair NX_ThreadFair;
+
+/**
+ * Ready threads of core ordered by vruntime, running thread is not in queue.
+ */
+struct NX_FairQueue
+{
+    NX_RbRoot tree;
+    NX_RbNode *leftmost;    /* thread with min vruntime */
+    NX_U64 minVruntime;     /* only increases */
+    NX_U32 load;            /* weight of threads in queue */
+    NX_U32 count;
+};
+typedef struct NX_FairQueue NX_FairQueue;
+
+struct NX_Thread;
+
+NX_PUBLIC NX_Error NX_ThreadSetNice(struct NX_Thread *thread, int nice);
+NX_PUBLIC int NX_ThreadGetNice(struct NX_Thread *thread);
+
+/* called by scheduler with lock of core held */
+NX_PUBLIC void NX_FairThreadInit(struct NX_Thread *thread);
+NX_PUBLIC void NX_FairQueueInit(NX_FairQueue *queue);
+NX_PUBLIC void NX_FairEnqueue(NX_FairQueue *queue, struct NX_Thread *thread);
+NX_PUBLIC struct NX_Thread *NX_FairDequeue(NX_FairQueue *queue, NX_UArch coreId);
+NX_PUBLIC void NX_FairRemove(NX_FairQueue *queue, struct NX_Thread *thread);
+NX_PUBLIC void NX_FairTick(struct NX_Thread *thread);
+NX_PUBLIC void NX_FairMigrate(NX_UArch coreId, struct NX_Thread *thread);
+NX_PUBLIC NX_Bool NX_FairPreempt(struct NX_Thread *running, struct NX_Thread *thread);
+
+#endif /* __SCHED_FAIR__ */
@@ -21,15 +21,19 @@ struct NX_Process
     NX_U32 flags;
     /* MMU */
     void *pageTable;
+    NX_U64 asid;    /* address space id with generation, managed by arch */
+    NX_Atomic cpuMask;  /* cores have run on this page table, for tlb shootdown */
 
     NX_Atomic threadCount;  /* thread count in this process */
     NX_List threadPoolListHead;    /* all thread on this process */
 
     NX_Spin lock;   /* lock for process */
+    NX_Spin pageTableLock;  /* lock for page table changes, taken before lock */
 
     int exitCode;   /* exit code for process */
 
     /* User space memory manager */
+    NX_List vmaListHead;   /* vma sorted by address, pages populated on fault */
 
     /* Hub Handle */
 
@@ -40,8 +44,12 @@ typedef struct NX_Process NX_Process;
 struct NX_ProcessOps
 {
     NX_Error (*initUserSpace)(NX_Process *process);
-    NX_Error (*switchPageTable)(void *pageTable);
+    NX_Error (*switchPageTable)(void *pageTable, NX_Process *process);
     void *(*getKernelPageTable)(void);
+    NX_Error (*copyUserSpace)(NX_Process *dst, NX_Process *src);
+    NX_Error (*handleCOWFault)(NX_Process *process, NX_Addr virAddr);
+    NX_Error (*mapUserPage)(NX_Process *process, NX_Addr virAddr, NX_U32 vmaFlags, NX_U32 access);
+    NX_Error (*unmapUserSpace)(NX_Process *process, NX_Addr virAddr, NX_USize size);
 };
 
 NX_INTERFACE NX_IMPORT struct NX_ProcessOps NX_ProcessOpsInterface; 
@@ -49,9 +57,14 @@ NX_INTERFACE NX_IMPORT struct NX_ProcessOps NX_ProcessOpsInterface;
 #define NX_ProcessInitUserSpace         NX_ProcessOpsInterface.initUserSpace
 #define NX_ProcessSwitchPageTable       NX_ProcessOpsInterface.switchPageTable
 #define NX_ProcessGetKernelPageTable    NX_ProcessOpsInterface.getKernelPageTable
+#define NX_ProcessCopyUserSpace         NX_ProcessOpsInterface.copyUserSpace
+#define NX_ProcessHandleCOWFault        NX_ProcessOpsInterface.handleCOWFault
+#define NX_ProcessMapUserPage           NX_ProcessOpsInterface.mapUserPage
+#define NX_ProcessUnmapUserSpace        NX_ProcessOpsInterface.unmapUserSpace
 
 NX_PUBLIC NX_Process *NX_ProcessCreate(NX_U32 flags);
 NX_PUBLIC NX_Error NX_ProcessDestroy(NX_Process *process);
+NX_PUBLIC NX_Process *NX_ProcessDuplicate(NX_Process *process);
 NX_PUBLIC NX_Error NX_ProcessExecute(char *name, char *path, NX_U32 flags);
 NX_PUBLIC void NX_ProcessExit(int exitCode);
 
@@ -23,4 +23,7 @@ NX_PUBLIC void NX_SchedYield(void);
 NX_PUBLIC void NX_ReSchedCheck(void);
 NX_PUBLIC void NX_SchedExit(void);
 
+NX_PUBLIC void NX_PreemptDisable(void);
+NX_PUBLIC void NX_PreemptEnable(void);
+
 #endif /* __XBOOK_SCHED___ */
@@ -16,11 +16,15 @@
 #include <utils/list.h>
 #include <sched/thread.h>
 #include <sched/spin.h>
+#include <sched/fair.h>
+#include <sched/cpumask.h>
 #include <xbook/atomic.h>
 
 struct NX_Cpu
 {
     NX_List threadReadyList;   /* list for thread ready to run */
+    NX_List deadlineReadyList; /* list for deadline thread ready to run, run before ready list */
+    NX_FairQueue fairQueue;    /* queue for thread ready to run when fair sched, instead of ready list */
     NX_Thread *threadRunning;  /* the thread running on core */
 
     NX_Spin lock;     /* lock for CPU */
@@ -33,6 +37,7 @@ struct NX_SMP_Ops
     NX_UArch (*getIdx)(void);
     NX_Error (*bootApp)(NX_UArch bootCoreId);
     NX_Error (*enterApp)(NX_UArch appCoreId);
+    NX_Error (*sendIpi)(NX_UArch cpuMask);  /* ipi cores in mask, must call NX_SMP_IpiHandler */
 };
 
 NX_INTERFACE NX_IMPORT struct NX_SMP_Ops NX_SMP_OpsInterface; 
@@ -40,6 +45,9 @@ NX_INTERFACE NX_IMPORT struct NX_SMP_Ops NX_SMP_OpsInterface;
 #define NX_SMP_BootApp    NX_SMP_OpsInterface.bootApp
 #define NX_SMP_EnterApp   NX_SMP_OpsInterface.enterApp
 #define NX_SMP_GetIdx     NX_SMP_OpsInterface.getIdx
+#define NX_SMP_SendIpi    NX_SMP_OpsInterface.sendIpi
+
+typedef void (*NX_SMP_CallHandler)(void *arg);
 
 NX_PUBLIC void NX_SMP_Preload(NX_UArch coreId);
 NX_PUBLIC void NX_SMP_Init(NX_UArch coreId);
@@ -55,6 +63,13 @@ NX_PUBLIC NX_Error NX_SMP_SetRunning(NX_UArch coreId, NX_Thread *thread);
 NX_PUBLIC NX_Cpu *NX_CpuGetIndex(NX_UArch coreId);
 
 NX_PUBLIC NX_Thread *NX_SMP_DeququeNoAffinityThread(NX_UArch coreId);
+NX_PUBLIC NX_Thread *NX_SMP_DeququeDisallowedThread(NX_UArch coreId);
+NX_PUBLIC NX_UArch NX_SMP_SelectCore(NX_CpuMask mask);
+
+NX_PUBLIC NX_Error NX_SMP_CallFunction(NX_CpuMask cpuMask, NX_SMP_CallHandler handler, void *arg, NX_Bool wait);
+NX_PUBLIC void NX_SMP_Reschedule(NX_UArch coreId);
+NX_PUBLIC void NX_SMP_WakeupPreempt(NX_UArch coreId, NX_Thread *thread);
+NX_PUBLIC void NX_SMP_IpiHandler(void);
 
 /**
  * get CPU by core id
@@ -65,5 +80,6 @@ NX_INLINE NX_Cpu *NX_CpuGetPtr(void)
 }
 
 NX_PUBLIC NX_Thread *NX_SMP_GetRunning(void);
+NX_PUBLIC NX_Thread *NX_SMP_GetRunningIrqDisabled(void);
 
 #endif /* __SCHED_SMP__ */
@@ -16,6 +16,9 @@
 #include <mods/time/timer.h>
 #include <sched/spin.h>
 #include <sched/process.h>
+#include <sched/deadline.h>
+#include <sched/fair.h>
+#include <sched/cpumask.h>
 
 #ifdef CONFIG_NX_THREAD_NAME_LEN
 #define NX_THREAD_NAME_LEN CONFIG_NX_THREAD_NAME_LEN
@@ -74,9 +77,12 @@ struct NX_Thread
     NX_U32 timeslice;
     NX_U32 ticks;
     NX_U32 needSched;
+    NX_U32 preemptCount;    /* preempt disabled if not zero, hold by spin lock */
     NX_U32 isTerminated;
     NX_UArch onCore;        /* thread on which core */
-    NX_UArch coreAffinity;  /* thread would like to run on the core */
+    NX_CpuMask coreAffinity; /* cores thread is allowed to run on */
+    NX_ThreadDeadline deadline; /* deadline sched params */
+    NX_ThreadFair fair;         /* fair sched params */
 
     /* thread resource */
     NX_ThreadResource resource;
@@ -109,10 +115,11 @@ NX_PUBLIC NX_Thread *NX_ThreadFindById(NX_U32 tid);
 
 NX_PUBLIC NX_Error NX_ThreadRun(NX_Thread *thread);
 NX_PUBLIC void NX_ThreadYield(void);
-NX_PUBLIC NX_Error NX_ThreadSetAffinity(NX_Thread *thread, NX_UArch coreId);
+NX_PUBLIC NX_Error NX_ThreadSetAffinity(NX_Thread *thread, NX_CpuMask mask);
 
 NX_PUBLIC NX_Error NX_ThreadSleep(NX_UArch microseconds);
 NX_PUBLIC NX_Error NX_ThreadWakeup(NX_Thread *thread);
+NX_PUBLIC void NX_ThreadBlockLockedIRQ(NX_Spin *lock, NX_UArch irqLevel);
 
 NX_PUBLIC void NX_ThreadsInit(void);
 
@@ -121,7 +128,7 @@ NX_PUBLIC void NX_SchedToFirstThread(void);
 
 NX_PUBLIC void NX_ThreadEnququeExitList(NX_Thread *thread);
 NX_PUBLIC void NX_ThreadEnqueuePendingList(NX_Thread *thread);
-NX_PUBLIC NX_Thread *NX_ThreadDequeuePendingList(void);
+NX_PUBLIC NX_Thread *NX_ThreadDequeuePendingList(NX_UArch coreId);
 
 NX_PUBLIC void NX_ThreadReadyRunLocked(NX_Thread *thread, int flags);
 NX_PUBLIC void NX_ThreadReadyRunUnlocked(NX_Thread *thread, int flags);
@@ -65,53 +65,25 @@
  * CYAN     36
  * WHITE    37
  */
-#ifdef NX_LOG_COLOR
-#define __NX_LOG_COLOR(n) NX_Printf("\033[%sm", #n)
-#define __NX_LOG_BEGIN(logName, color) NX_Printf("\033[%sm[%s-%s] ", #color, logName, NX_LOG_MOD_NAME)
-#define __NX_LOG_END NX_Printf("\033[0m" NX_CON_NEWLINE)
-#else
-#define __NX_LOG_COLOR(n)
-#define __NX_LOG_BEGIN(logName, color) NX_Printf("[%s-%s] ", logName, NX_LOG_MOD_NAME)
-#define __NX_LOG_END NX_Printf(NX_CON_NEWLINE)
-#endif /* NX_LOG_COLOR */
-
-
-#ifdef CONFIG_NX_DEBUG_TIMELINE
-#define NX_LOG_TIMELINE NX_Printf("[%10d.%03d] ", NX_ClockTickGetMillisecond() / 1000, NX_ClockTickGetMillisecond() % 1000);
-#else
-#define NX_LOG_TIMELINE
-#endif
-
-NX_PUBLIC NX_Error LogLineLock(NX_UArch *level);
-NX_PUBLIC NX_Error LogLineUnlock(NX_UArch level);
-
-#define NX_LOG_LINE(logName, color, ...) \
-    do \
-    { \
-        NX_UArch _level; \
-        LogLineLock(&_level); \
-        NX_LOG_TIMELINE \
-        __NX_LOG_BEGIN(logName, color); \
-        NX_Printf(__VA_ARGS__); \
-        __NX_LOG_END; \
-        LogLineUnlock(_level); \
-    } \
-    while (0)
-#define __NX_LOG_RAW(...) NX_LOG_TIMELINE \
-    do \
-    { \
-        NX_UArch _level; \
-        LogLineLock(&_level); \
-        NX_Printf(__VA_ARGS__); \
-        LogLineUnlock(_level); \
-    } \
-    while (0)
+#define NX_LOG_LINE(logName, color, ...) NX_LogLine(logName, NX_LOG_MOD_NAME, #color, __VA_ARGS__)
+#define __NX_LOG_RAW(...) NX_LogRaw(__VA_ARGS__)
 
 #else
 #define NX_LOG_LINE(logName, color, fmt, ...)
 #define __NX_LOG_RAW(fmt, ...)
 #endif /* NX_LOG_ENABLE */
 
+/**
+ * Log lines are formatted with time and put to ring of current cpu, the
+ * drain thread outputs them to console later. Before the drain thread
+ * runs, and after panic, lines are output directly.
+ */
+NX_PUBLIC void NX_LogLine(const char *logName, const char *modName, const char *color, const char *fmt, ...);
+NX_PUBLIC void NX_LogRaw(const char *fmt, ...);
+NX_PUBLIC void NX_LogDrain(void);
+NX_PUBLIC void NX_LogPanicDump(void);
+NX_PUBLIC void NX_LogInit(void);
+
 /**
  * Log api
  */
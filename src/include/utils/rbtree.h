@@ -0,0 +1,70 @@
+/**
+ * Copyright (c) 2018-2022, BookOS Development Team
+ * SPDX-License-Identifier: Apache-2.0
+ * 
+ * Contains: Red-black tree utils
+ */
+
+#ifndef __UTILS_RBTREE__
+#define __UTILS_RBTREE__
+
+#include <xbook.h>
+
+#define NX_RB_RED   0
+#define NX_RB_BLACK 1
+
+/**
+ * Node is embedded in owner struct. Caller searches tree by its own key,
+ * links node by NX_RbLinkNode then rebalances by NX_RbInsertColor.
+ */
+struct NX_RbNode
+{
+    struct NX_RbNode *parent;
+    struct NX_RbNode *left;
+    struct NX_RbNode *right;
+    int color;
+};
+typedef struct NX_RbNode NX_RbNode;
+
+struct NX_RbRoot
+{
+    NX_RbNode *node;
+};
+typedef struct NX_RbRoot NX_RbRoot;
+
+#define NX_RB_ROOT_INIT { NX_NULL }
+
+#define NX_RbEntry(ptr, type, member) NX_PTR_OF_STRUCT(ptr, type, member)
+
+#define NX_RbEntryOrNULL(ptr, type, member) ({ \
+        NX_RbNode *__node = (ptr); \
+        __node ? NX_RbEntry(__node, type, member) : NX_NULL; \
+})
+
+NX_INLINE void NX_RbRootInit(NX_RbRoot *root)
+{
+    root->node = NX_NULL;
+}
+
+NX_INLINE NX_Bool NX_RbEmpty(NX_RbRoot *root)
+{
+    return root->node == NX_NULL;
+}
+
+NX_INLINE void NX_RbLinkNode(NX_RbNode *node, NX_RbNode *parent, NX_RbNode **link)
+{
+    node->parent = parent;
+    node->left = node->right = NX_NULL;
+    node->color = NX_RB_RED;
+    *link = node;
+}
+
+NX_PUBLIC void NX_RbInsertColor(NX_RbNode *node, NX_RbRoot *root);
+NX_PUBLIC void NX_RbErase(NX_RbNode *node, NX_RbRoot *root);
+
+NX_PUBLIC NX_RbNode *NX_RbFirst(NX_RbRoot *root);
+NX_PUBLIC NX_RbNode *NX_RbLast(NX_RbRoot *root);
+NX_PUBLIC NX_RbNode *NX_RbNext(NX_RbNode *node);
+NX_PUBLIC NX_RbNode *NX_RbPrev(NX_RbNode *node);
+
+#endif  /* __UTILS_RBTREE__ */
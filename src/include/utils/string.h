@@ -19,6 +19,16 @@ NX_PUBLIC char *NX_StrCopy(const char *dst, const char *src);
 NX_PUBLIC int NX_StrCmp(const char *a, const char *b);
 NX_PUBLIC int NX_StrLen(const char *str);
 NX_PUBLIC char *NX_StrCopyN(const char *dst, const char *src, NX_USize len);
+NX_PUBLIC NX_USize NX_StrNLen(const char *str, NX_USize maxLen);
+NX_PUBLIC NX_USize NX_StrLCopy(char *dst, const char *src, NX_USize size);
+
+/**
+ * Output of formatter, called with chunks of text, which are not terminated.
+ */
+typedef void (*NX_PrintSink)(void *sinkArg, const char *str, NX_USize len);
+
+NX_PUBLIC int NX_VSinkPrintf(NX_PrintSink sink, void *sinkArg, const char *fmt, NX_VarList args);
+NX_PUBLIC int NX_SinkPrintf(NX_PrintSink sink, void *sinkArg, const char *fmt, ...);
 
 NX_PUBLIC int NX_VSNPrintf(char *buf, int bufLen, const char *fmt, NX_VarList args);
 NX_PUBLIC int NX_SNPrintf(char *buf, int buflen, const char *fmt, ...);
@@ -0,0 +1,58 @@
+/**
+ * Copyright (c) 2018-2022, BookOS Development Team
+ * SPDX-License-Identifier: Apache-2.0
+ * 
+ * Contains: Binary event trace
+ */
+
+#ifndef __UTILS_TRACE__
+#define __UTILS_TRACE__
+
+#include <xbook.h>
+
+#ifdef CONFIG_NX_TRACE_EVENTS
+#define NX_TRACE_EVENTS CONFIG_NX_TRACE_EVENTS
+#else
+#define NX_TRACE_EVENTS 4096
+#endif
+
+#define NX_TRACE_ARGS 3
+
+/* event id, args are noted after */
+enum NX_TraceEvent
+{
+    NX_TRACE_SCHED_SWITCH = 1,  /* prev tid(-1 if exited), next tid */
+    NX_TRACE_SCHED_ENQUEUE,     /* tid, core, flags */
+    NX_TRACE_SCHED_DEQUEUE,     /* tid, core */
+    NX_TRACE_IRQ_ENTER,         /* irqno */
+    NX_TRACE_IRQ_EXIT,          /* irqno */
+    NX_TRACE_TIMER_FIRE,        /* timer, handler */
+    NX_TRACE_HEAP_ALLOC,        /* object, size */
+    NX_TRACE_HEAP_FREE,         /* object */
+};
+
+/**
+ * Same layout on all arch, so dump can be decoded by scripts/trace2json.py
+ */
+struct NX_TraceRecord
+{
+    NX_U64 time;    /* clock counter */
+    NX_U16 cpu;
+    NX_U16 event;
+    NX_U32 reserved;
+    NX_U64 args[NX_TRACE_ARGS];
+};
+typedef struct NX_TraceRecord NX_TraceRecord;
+
+#ifdef CONFIG_NX_TRACE
+#define NX_TRACE(event, arg0, arg1, arg2) \
+    NX_TraceEmit(event, (NX_U64)(NX_UArch)(arg0), (NX_U64)(NX_UArch)(arg1), (NX_U64)(NX_UArch)(arg2))
+#else
+#define NX_TRACE(event, arg0, arg1, arg2)
+#endif
+
+NX_PUBLIC void NX_TraceEmit(NX_U16 event, NX_U64 arg0, NX_U64 arg1, NX_U64 arg2);
+NX_PUBLIC void NX_TraceEnable(NX_Bool enable);
+NX_PUBLIC void NX_TraceDump(void);
+
+#endif  /* __UTILS_TRACE__ */
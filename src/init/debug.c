@@ -16,8 +16,10 @@
 #ifdef CONFIG_NX_DEBUG
 NX_PUBLIC void NX_DebugAssertionFailure(char *exp, char *file, char *baseFile, int line)
 {
+    NX_LogPanicDump();
     NX_LOG_E("\nAssert(%s) failed:\nfile: %s\nbase_file: %s\nln: %d", 
         exp, file, baseFile, line);
+    NX_ConsoleFlush();
     while (1);
 }
 #endif
@@ -25,6 +27,7 @@ NX_PUBLIC void NX_DebugAssertionFailure(char *exp, char *file, char *baseFile, i
 NX_PUBLIC void NX_DebugSpin(const char *str)
 {
     NX_LOG_I(str, NX_Endln "FILE:%s\nFUNCTION:%s\nLINE:%d", __FILE__, __FUNCTION__, __LINE__);
+    NX_ConsoleFlush();
     while (1);
 }
 
@@ -34,6 +37,7 @@ NX_PUBLIC void NX_DebugSpin(const char *str)
 NX_PUBLIC void NX_DebugPanic(const char *str)
 {
     NX_IRQ_Disable();
+    NX_LogPanicDump();
     NX_LOG_E("!NX_PANIC!");
     NX_SPIN(str);
 }
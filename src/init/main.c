@@ -71,6 +71,9 @@ NX_PUBLIC int NX_Main(NX_UArch coreId)
 
         /* init thread */
         NX_ThreadsInit();
+
+        /* init log drain */
+        NX_LogInit();
         
         if (NX_ClockInit() != NX_EOK)
         {
@@ -11,82 +11,133 @@
 
 #include <io/delay_irq.h>
 #include <mm/alloc.h>
+#include <mods/console/console.h>
+#include <mods/time/clock.h>
+#include <sched/smp.h>
+#include <sched/spin.h>
+#include <sched/sched.h>
 
 /* protect flags */
-#define NX_IRQ_WORK_PENDING        0x80000000    /* work is pending */
 #define NX_IRQ_WORK_ON_QUEUED      0x40000000    /* work is on queue */
 
+/**
+ * Works handled on a cpu wait on its pending lists. Lists are used by the
+ * cpu with interrupt disabled and by leave from other cpus, so locked.
+ * Events are set and cleared atomically.
+ */
+struct IRQ_DelayCpu
+{
+    NX_Spin lock;
+    NX_List pendingList[NX_IRQ_QUEUE_NR];
+    NX_IRQ_DelayWork *running;  /* work handler running on cpu */
+    NX_Atomic event;    /* bit of queue has pending work */
+};
+typedef struct IRQ_DelayCpu IRQ_DelayCpu;
+
 NX_PRIVATE NX_List DelayIrqListTable[NX_IRQ_QUEUE_NR];
-NX_PRIVATE NX_VOLATILE NX_U32 DelayIrqEvent;
+NX_PRIVATE NX_Spin DelayIrqListLock;
+NX_PRIVATE IRQ_DelayCpu DelayIrqCpuTable[NX_MULTI_CORES_NR];
+
+#ifdef CONFIG_NX_IRQ_STATS
+NX_PRIVATE NX_IRQ_DelayQueueStat DelayQueueStatTable[NX_MULTI_CORES_NR][NX_IRQ_QUEUE_NR];
+
+NX_PRIVATE const char *DelayQueueName[NX_IRQ_QUEUE_NR] = {"fast", "normal", "period", "sched", "slow"};
+#endif
 
 NX_PUBLIC void NX_IRQ_DelayQueueInit(void)
 {
+    IRQ_DelayCpu *cpu;
     int i;
+    int coreId;
+
     for (i = 0; i < NX_IRQ_QUEUE_NR; i++)
     {
         NX_ListInit(&DelayIrqListTable[i]);
     }
-    DelayIrqEvent = 0;
-}
+    NX_SpinInit(&DelayIrqListLock);
 
-NX_PRIVATE NX_U32 IRQ_DelayEventGet(void)
-{
-    return DelayIrqEvent;
-}
-
-NX_PRIVATE void IRQ_DelayEventSet(NX_U32 event)
-{
-    DelayIrqEvent |= event;
-}
-
-NX_PRIVATE void IRQ_DelayEventClear(void)
-{
-    DelayIrqEvent = 0;
+    for (coreId = 0; coreId < NX_MULTI_CORES_NR; coreId++)
+    {
+        cpu = &DelayIrqCpuTable[coreId];
+        NX_SpinInit(&cpu->lock);
+        cpu->running = NX_NULL;
+        for (i = 0; i < NX_IRQ_QUEUE_NR; i++)
+        {
+            NX_ListInit(&cpu->pendingList[i]);
+        }
+        NX_AtomicSet(&cpu->event, 0);
+    }
 }
 
 NX_PUBLIC NX_Error NX_IRQ_DelayQueueEnter(NX_IRQ_DelayQueue queue, NX_IRQ_DelayWork *work)
 {
+    NX_UArch level;
+
     if (queue < 0 || queue >= NX_IRQ_QUEUE_NR || work == NX_NULL)
     {
         return NX_EINVAL;
     }
     
-    if (NX_ListFind(&work->list, &DelayIrqListTable[queue]))
+    NX_SpinLockIRQ(&DelayIrqListLock, &level);
+    if (work->flags & NX_IRQ_WORK_ON_QUEUED)
     {
+        NX_SpinUnlockIRQ(&DelayIrqListLock, level);
         return NX_EAGAIN;
     }
-
-    NX_UArch level = NX_IRQ_SaveLevel();
     work->queue = queue;
     work->flags |= NX_IRQ_WORK_ON_QUEUED;
     NX_ListAddTail(&work->list, &DelayIrqListTable[queue]);
-    NX_IRQ_RestoreLevel(level);
+    NX_SpinUnlockIRQ(&DelayIrqListLock, level);
     return NX_EOK;
 }
 
+/**
+ * Work is taken off pending lists of all cpus, and handler running on other
+ * cpu is waited, so work can be destroyed after left.
+ */
 NX_PUBLIC NX_Error NX_IRQ_DelayQueueLeave(NX_IRQ_DelayQueue queue, NX_IRQ_DelayWork *work)
 {
+    IRQ_DelayCpu *cpu;
+    NX_UArch level;
+    NX_UArch coreId;
+    NX_Bool running;
+
     if (queue < 0 || queue >= NX_IRQ_QUEUE_NR || work == NX_NULL)
     {
         return NX_EINVAL;
     }
     
-    if (!NX_ListFind(&work->list, &DelayIrqListTable[queue]))
+    NX_SpinLockIRQ(&DelayIrqListLock, &level);
+    if (!(work->flags & NX_IRQ_WORK_ON_QUEUED) || work->queue != queue)
     {
+        NX_SpinUnlockIRQ(&DelayIrqListLock, level);
         return NX_ENOSRCH;
     }
-
-    NX_UArch level = NX_IRQ_SaveLevel();
     work->queue = 0;
     work->flags &= ~NX_IRQ_WORK_ON_QUEUED;
 
     NX_ListDel(&work->list);
-    NX_IRQ_RestoreLevel(level);
+    NX_SpinUnlockIRQ(&DelayIrqListLock, level);
+
+    for (coreId = 0; coreId < NX_MULTI_CORES_NR; coreId++)
+    {
+        cpu = &DelayIrqCpuTable[coreId];
+        do
+        {
+            NX_SpinLockIRQ(&cpu->lock, &level);
+            NX_ListDelInit(&work->pending[coreId].list);
+            /* leave in own handler not waited */
+            running = (cpu->running == work && coreId != NX_SMP_GetIdx()) ? NX_True : NX_False;
+            NX_SpinUnlockIRQ(&cpu->lock, level);
+        } while (running);
+    }
     return NX_EOK;
 }
 
 NX_PUBLIC NX_Error NX_IRQ_DelayWorkInit(NX_IRQ_DelayWork *work, NX_IRQ_WorkHandler handler, void *arg, NX_U32 flags)
 {
+    int coreId;
+
     if (work == NX_NULL || handler == NX_NULL)
     {
         return NX_EINVAL;
@@ -96,6 +147,11 @@ NX_PUBLIC NX_Error NX_IRQ_DelayWorkInit(NX_IRQ_DelayWork *work, NX_IRQ_WorkHandl
     work->flags = flags;
     work->flags &= ~NX_IRQ_WORK_NOREENTER; /*  */
     NX_ListInit(&work->list);
+    for (coreId = 0; coreId < NX_MULTI_CORES_NR; coreId++)
+    {
+        NX_ListInit(&work->pending[coreId].list);
+        work->pending[coreId].work = work;
+    }
     return NX_EOK;
 }
 
@@ -114,21 +170,34 @@ NX_PUBLIC NX_IRQ_DelayWork *NX_IRQ_DelayWorkCreate(NX_IRQ_WorkHandler handler, v
     return work;
 }
 
+/**
+ * Work must left queue before destroyed
+ */
 NX_PUBLIC NX_Error NX_IRQ_DelayWorkDestroy(NX_IRQ_DelayWork *work)
 {
     if (work == NX_NULL)
     {
         return NX_EINVAL;
     }
+    if (work->flags & NX_IRQ_WORK_ON_QUEUED)
+    {
+        return NX_EAGAIN;
+    }
     NX_MemFree(work);
     return NX_EOK;
 }
 
 /**
- * Must called with interrupt disabled
+ * Must called with interrupt disabled, work runs on this cpu.
+ * Same work can be pending on each cpu once.
  */
 NX_PUBLIC NX_Error NX_IRQ_DelayWorkHandle(NX_IRQ_DelayWork *work)
 {
+    NX_IRQ_DelayWorkNode *node;
+    IRQ_DelayCpu *cpu;
+    NX_UArch coreId;
+    NX_IRQ_DelayQueue queue;
+
     if (work == NX_NULL)
     {
         return NX_EINVAL;
@@ -137,21 +206,74 @@ NX_PUBLIC NX_Error NX_IRQ_DelayWorkHandle(NX_IRQ_DelayWork *work)
     {
         return NX_EFAULT;
     }
-    if (work->queue < 0 || work->queue >= NX_IRQ_QUEUE_NR)
+    queue = work->queue;
+    if (queue < 0 || queue >= NX_IRQ_QUEUE_NR)
     {
         return NX_EFAULT;
     }
-    IRQ_DelayEventSet((1 << work->queue));
-    work->flags |= NX_IRQ_WORK_PENDING;
+
+    coreId = NX_SMP_GetIdx();
+    node = &work->pending[coreId];
+    cpu = &DelayIrqCpuTable[coreId];
+    NX_SpinLock(&cpu->lock, NX_True);
+    if (!NX_ListEmpty(&node->list))
+    {
+        NX_SpinUnlock(&cpu->lock);
+        return NX_EOK;  /* already pending */
+    }
+#ifdef CONFIG_NX_IRQ_STATS
+    /* latency is from the first handle before work runs */
+    node->handleTime = NX_ClockCounterGet();
+#endif
+    NX_ListAddTail(&node->list, &cpu->pendingList[queue]);
+    NX_SpinUnlock(&cpu->lock);
+    NX_AtomicSetMask(&cpu->event, 1 << queue);
 
     return NX_EOK;
 }
 
-NX_INLINE void IRQ_DelayWorkCheck(NX_IRQ_DelayWork *work)
+#ifdef CONFIG_NX_IRQ_STATS
+NX_PRIVATE void IRQ_DelayQueueStatUpdate(NX_IRQ_DelayWorkNode *node, NX_UArch coreId, NX_IRQ_DelayQueue queue)
 {
-    if (work->flags & NX_IRQ_WORK_PENDING)
+    NX_IRQ_DelayQueueStat *stat;
+    NX_U64 latency;
+
+    latency = NX_ClockCounterGet() - node->handleTime;
+    stat = &DelayQueueStatTable[coreId][queue];
+    stat->runs++;
+    stat->totalLatency += latency;
+    if (latency > stat->maxLatency)
     {
-        work->flags &= ~NX_IRQ_WORK_PENDING; /* clear pending */
+        stat->maxLatency = latency;
+    }
+}
+#endif
+
+/**
+ * Run works pending on queue, only pending works are visited.
+ * Must called interrupt disabled, work is taken off list before handler.
+ */
+NX_INLINE void IRQ_DelayQueueRun(IRQ_DelayCpu *cpu, NX_UArch coreId, NX_IRQ_DelayQueue queue)
+{
+    NX_List *pendingList = &cpu->pendingList[queue];
+    NX_IRQ_DelayWorkNode *node;
+    NX_IRQ_DelayWork *work;
+
+    NX_SpinLock(&cpu->lock, NX_True);
+    while (!NX_ListEmpty(pendingList))
+    {
+        node = NX_ListFirstEntry(pendingList, NX_IRQ_DelayWorkNode, list);
+        NX_ListDelInit(&node->list);
+        work = node->work;
+        if (!(work->flags & NX_IRQ_WORK_ON_QUEUED))
+        {
+            continue;   /* left queue */
+        }
+        cpu->running = work;
+        NX_SpinUnlock(&cpu->lock);
+#ifdef CONFIG_NX_IRQ_STATS
+        IRQ_DelayQueueStatUpdate(node, coreId, queue);
+#endif
 
         if (!(work->flags & NX_IRQ_WORK_NOREENTER))
         {
@@ -164,41 +286,99 @@ NX_INLINE void IRQ_DelayWorkCheck(NX_IRQ_DelayWork *work)
         {
             NX_IRQ_Disable();                      
         }
+
+        NX_SpinLock(&cpu->lock, NX_True);
+        cpu->running = NX_NULL;
     }
+    NX_SpinUnlock(&cpu->lock);
 }
 
 /**
- * Must called interrupt disabled
+ * Must called interrupt disabled.
+ * Works may run with interrupt enabled, preempt is disabled so spin unlock
+ * in works never sched here, NX_ReSchedCheck does it after.
  */
 NX_INTERFACE void NX_IRQ_DelayQueueCheck(void)
 {
     int checkTimes = NX_IRQ_DELAY_WORK_CHECK_TIMES;
+    NX_UArch coreId = NX_SMP_GetIdx();
+    IRQ_DelayCpu *cpu = &DelayIrqCpuTable[coreId];
+    NX_U32 irqEvent;
+    int i;
     
+    NX_PreemptDisable();
     while (checkTimes-- > 0)
     {
-        NX_U32 irqEvent = IRQ_DelayEventGet();
-        IRQ_DelayEventClear();
+        irqEvent = NX_AtomicSwap(&cpu->event, 0);
         if (irqEvent == 0)
         {
-            return;
+            break;
         }
-        NX_IRQ_Enable();
 
-        int i;
         for (i = 0; i < NX_IRQ_QUEUE_NR; i++)
         {
-            if (!(irqEvent & (1 << i)))
+            if (irqEvent & (1 << i))
             {
-                continue;
+                IRQ_DelayQueueRun(cpu, coreId, i);
             }
+        }
+    }
+    NX_PreemptEnable();
+}
+
+NX_PUBLIC NX_Error NX_IRQ_DelayQueueStatGet(NX_IRQ_DelayQueue queue, NX_UArch coreId, NX_IRQ_DelayQueueStat *stat)
+{
+#ifdef CONFIG_NX_IRQ_STATS
+    if (queue < 0 || queue >= NX_IRQ_QUEUE_NR || coreId >= NX_MULTI_CORES_NR || stat == NX_NULL)
+    {
+        return NX_EINVAL;
+    }
+    *stat = DelayQueueStatTable[coreId][queue];
+    return NX_EOK;
+#else
+    return NX_ENOFUNC;
+#endif
+}
+
+/**
+ * Print works run of each cpu and latency from handle to run of queues.
+ * Time is in clock counter cycles.
+ */
+NX_PUBLIC void NX_IRQ_DelayQueueStatDump(void)
+{
+#ifdef CONFIG_NX_IRQ_STATS
+    NX_IRQ_DelayQueueStat *stat;
+    NX_U64 runs;
+    NX_U64 totalLatency;
+    NX_U64 maxLatency;
+    int queue;
+    int coreId;
 
-            NX_IRQ_DelayWork *work;
-            NX_ListForEachEntry(work, &DelayIrqListTable[i], list)
+    NX_Printf("QUEUE ");
+    for (coreId = 0; coreId < NX_MULTI_CORES_NR; coreId++)
+    {
+        NX_Printf("      CPU%d", coreId);
+    }
+    NX_Printf("  total latency  max latency" NX_CON_NEWLINE);
+
+    for (queue = 0; queue < NX_IRQ_QUEUE_NR; queue++)
+    {
+        runs = 0;
+        totalLatency = 0;
+        maxLatency = 0;
+        NX_Printf("%-6s", DelayQueueName[queue]);
+        for (coreId = 0; coreId < NX_MULTI_CORES_NR; coreId++)
+        {
+            stat = &DelayQueueStatTable[coreId][queue];
+            runs += stat->runs;
+            totalLatency += stat->totalLatency;
+            if (stat->maxLatency > maxLatency)
             {
-                IRQ_DelayWorkCheck(work);
+                maxLatency = stat->maxLatency;
             }
+            NX_Printf(" %9lu", (unsigned long)stat->runs);
         }
-
-        NX_IRQ_Disable();
+        NX_Printf(" %14lu %12lu" NX_CON_NEWLINE, (unsigned long)totalLatency, (unsigned long)maxLatency);
     }
+#endif
 }
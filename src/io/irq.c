@@ -13,10 +13,22 @@
 #include <io/delay_irq.h>
 #include <utils/memory.h>
 #include <utils/string.h>
+#include <utils/trace.h>
 #include <mm/alloc.h>
+#include <mods/console/console.h>
+#include <mods/time/clock.h>
+#include <sched/smp.h>
+#include <sched/thread.h>
+#include <xbook/debug.h>
+#include <xbook/init_call.h>
 
 NX_PRIVATE NX_IRQ_Node IRQ_NodeTable[NX_NR_IRQS];
 
+#ifdef CONFIG_NX_IRQ_STATS
+/* each cpu only updates its own stats in irq */
+NX_PRIVATE NX_IRQ_Stat IRQ_StatTable[NX_MULTI_CORES_NR][NX_NR_IRQS];
+#endif
+
 NX_PUBLIC void NX_IRQ_Init(void)
 {
     int i;
@@ -28,6 +40,7 @@ NX_PUBLIC void NX_IRQ_Init(void)
         irq->controller = NX_NULL;
         NX_AtomicSet(&irq->reference, 0);
         NX_ListInit(&irq->actionList);
+        irq->affinity = 1UL << NX_SMP_GetBootCore();
     }
     NX_IRQ_DelayQueueInit();
 }
@@ -40,6 +53,42 @@ NX_PRIVATE NX_IRQ_Node *IRQ_NodeGet(NX_IRQ_Number irq)
     return NX_NULL;
 }
 
+NX_PRIVATE NX_IRQ_Action *IRQ_ActionCreate(NX_IRQ_Number irqno,
+                                          NX_IRQ_Handler handler,
+                                          void *data,
+                                          char *name,
+                                          NX_U32 flags)
+{
+    NX_IRQ_Action *action = NX_MemAlloc(sizeof(NX_IRQ_Action));
+    if (action == NX_NULL)
+    {
+        return NX_NULL;
+    }
+    action->data = data;
+    action->flags = flags;
+    action->handler = handler;
+    NX_StrLCopy(action->name, name, NX_IRQ_NAME_LEN);
+
+    action->irqno = irqno;
+    action->threadHandler = NX_NULL;
+    action->thread = NX_NULL;
+    NX_SpinInit(&action->threadLock);
+    action->threadPending = NX_False;
+    action->threadExit = NX_False;
+    return action;
+}
+
+NX_PRIVATE void IRQ_ActionAdd(NX_IRQ_Node *irqNode, NX_IRQ_Action *action)
+{
+    irqNode->controller = &NX_IRQ_ControllerInterface;
+    irqNode->flags = action->flags;
+
+    /* add to action list */
+    NX_ListAddTail(&action->list, &irqNode->actionList);
+    
+    NX_AtomicInc(&irqNode->reference);
+}
+
 NX_PUBLIC NX_Error NX_IRQ_Bind(NX_IRQ_Number irqno,
                          NX_IRQ_Handler handler,
                          void *data,
@@ -47,28 +96,133 @@ NX_PUBLIC NX_Error NX_IRQ_Bind(NX_IRQ_Number irqno,
                          NX_U32 flags)
 {
     NX_IRQ_Node *irqNode = IRQ_NodeGet(irqno);
-    if (irqNode == NX_NULL)
+    if (irqNode == NX_NULL || handler == NX_NULL)
     {
         return NX_EINVAL;
     }
-    irqNode->controller = &NX_IRQ_ControllerInterface;
-    irqNode->flags = flags;
 
-    NX_IRQ_Action *action = NX_MemAlloc(sizeof(NX_IRQ_Action));
+    NX_IRQ_Action *action = IRQ_ActionCreate(irqno, handler, data, name, flags);
     if (action == NX_NULL)
     {
         return NX_ENOMEM;
     }
-    action->data = data;
-    action->flags = flags;
-    action->handler = handler;
-    NX_MemZero(action->name, NX_IRQ_NAME_LEN);
-    NX_StrCopyN(action->name, name, NX_IRQ_NAME_LEN);
-    
-    /* add to action list */
-    NX_ListAddTail(&action->list, &irqNode->actionList);
-    
-    NX_AtomicInc(&irqNode->reference);
+    IRQ_ActionAdd(irqNode, action);
+    return NX_EOK;
+}
+
+/**
+ * Thread of a threaded irq, the irq stays masked from the quick handler
+ * until thread handler returned, so the handler may block on mutex.
+ * Unmask with pending cleared under lock, or a late mask after ack
+ * could keep the irq masked forever.
+ */
+NX_PRIVATE void IRQ_ThreadEntry(void *arg)
+{
+    NX_IRQ_Action *action = (NX_IRQ_Action *)arg;
+    NX_UArch level;
+
+    while (1)
+    {
+        NX_SpinLockIRQ(&action->threadLock, &level);
+        if (action->threadExit)
+        {
+            break;
+        }
+        if (!action->threadPending)
+        {
+            NX_ThreadBlockLockedIRQ(&action->threadLock, level);
+            continue;
+        }
+        NX_SpinUnlockIRQ(&action->threadLock, level);
+
+        action->threadHandler(action->irqno, action->data);
+
+        NX_SpinLockIRQ(&action->threadLock, &level);
+        action->threadPending = NX_False;
+        NX_IRQ_Unmask(action->irqno);
+        NX_SpinUnlockIRQ(&action->threadLock, level);
+    }
+
+    /* unbound, action is owned by thread now */
+    if (action->threadPending)
+    {
+        NX_IRQ_Unmask(action->irqno);
+    }
+    NX_SpinUnlockIRQ(&action->threadLock, level);
+    NX_MemFree(action);
+    NX_ThreadExit();
+}
+
+/**
+ * called in irq, wake thread of action. the thread was queued on head of
+ * ready list, preempt running thread if on same core, so thread handler
+ * runs right after irq returned.
+ */
+NX_PRIVATE void IRQ_ThreadWake(NX_IRQ_Action *action)
+{
+    NX_SpinLock(&action->threadLock, NX_True);
+    if (!action->threadPending)
+    {
+        action->threadPending = NX_True;
+        NX_ThreadWakeup(action->thread);
+    }
+    NX_SpinUnlock(&action->threadLock);
+}
+
+/**
+ * called in irq after ack, mask irq until thread handler returned.
+ * plic ignores complete of a disabled source, so never mask before ack.
+ */
+NX_PRIVATE void IRQ_ThreadMask(NX_IRQ_Action *action)
+{
+    NX_SpinLock(&action->threadLock, NX_True);
+    if (action->threadPending)
+    {
+        NX_IRQ_Mask(action->irqno);
+    }
+    NX_SpinUnlock(&action->threadLock);
+}
+
+/**
+ * Bind irq with a handler thread, named irq/irqno-name.
+ * quickHandler runs in irq: return NX_EAGAIN to mask irq and wake thread,
+ * NX_EOK if handled, other if irq is not from the device.
+ * quickHandler may be null, then the thread is always woken.
+ * Thread is bound on current core.
+ */
+NX_PUBLIC NX_Error NX_IRQ_BindThreaded(NX_IRQ_Number irqno,
+                         NX_IRQ_Handler quickHandler,
+                         NX_IRQ_Handler threadHandler,
+                         void *data,
+                         char *name,
+                         NX_U32 flags)
+{
+    char threadName[NX_THREAD_NAME_LEN];
+    NX_IRQ_Node *irqNode = IRQ_NodeGet(irqno);
+    if (irqNode == NX_NULL || threadHandler == NX_NULL)
+    {
+        return NX_EINVAL;
+    }
+
+    NX_IRQ_Action *action = IRQ_ActionCreate(irqno, quickHandler, data, name, flags);
+    if (action == NX_NULL)
+    {
+        return NX_ENOMEM;
+    }
+    action->threadHandler = threadHandler;
+
+    NX_SNPrintf(threadName, NX_THREAD_NAME_LEN, "irq/%d-%s", irqno, name);
+    action->thread = NX_ThreadCreate(threadName, IRQ_ThreadEntry, action);
+    if (action->thread == NX_NULL)
+    {
+        NX_MemFree(action);
+        return NX_ENOMEM;
+    }
+    /* woken in irq, so never moved to other core */
+    NX_ASSERT(NX_ThreadSetAffinity(action->thread, NX_CpuMaskOf(NX_SMP_GetIdx())) == NX_EOK);
+
+    IRQ_ActionAdd(irqNode, action);
+    NX_ASSERT(NX_ThreadRun(action->thread) == NX_EOK);
     return NX_EOK;
 }
 
@@ -111,7 +265,18 @@ NX_PUBLIC NX_Error NX_IRQ_Unbind(NX_IRQ_Number irqno, void *data)
     }
     /* remove action */
     NX_ListDel(&actionFind->list);
-    NX_MemFree(actionFind);
+    if (actionFind->thread != NX_NULL)
+    {
+        /* thread frees action when exit */
+        NX_SpinLock(&actionFind->threadLock, NX_True);
+        actionFind->threadExit = NX_True;
+        NX_ThreadWakeup(actionFind->thread);
+        NX_SpinUnlock(&actionFind->threadLock);
+    }
+    else
+    {
+        NX_MemFree(actionFind);
+    }
 
     NX_AtomicDec(&irqNode->reference);
     /* no device on this irq */
@@ -152,6 +317,40 @@ NX_PUBLIC NX_Error NX_IRQ_Mask(NX_IRQ_Number irqno)
     return NX_ENOFUNC;
 }
 
+/**
+ * Route irq to cores in cpuMask, irq is taken by one of them.
+ * Default is boot core.
+ */
+NX_PUBLIC NX_Error NX_IRQ_SetAffinity(NX_IRQ_Number irqno, NX_UArch cpuMask)
+{
+    NX_Error err;
+    NX_IRQ_Node *irqNode = IRQ_NodeGet(irqno);
+    if (irqNode == NX_NULL || cpuMask == 0 || (cpuMask & ~NX_IRQ_AFFINITY_ALL))
+    {
+        return NX_EINVAL;
+    }
+    if (NX_IRQ_ControllerInterface.setAffinity == NX_NULL)
+    {
+        return NX_ENOFUNC;
+    }
+    err = NX_IRQ_ControllerInterface.setAffinity(irqno, cpuMask);
+    if (err == NX_EOK)
+    {
+        irqNode->affinity = cpuMask;
+    }
+    return err;
+}
+
+NX_PUBLIC NX_UArch NX_IRQ_GetAffinity(NX_IRQ_Number irqno)
+{
+    NX_IRQ_Node *irqNode = IRQ_NodeGet(irqno);
+    if (irqNode == NX_NULL)
+    {
+        return 0;
+    }
+    return irqNode->affinity;
+}
+
 NX_PUBLIC NX_Error NX_IRQ_Handle(NX_IRQ_Number irqno)
 {
     NX_IRQ_Node *irqNode = IRQ_NodeGet(irqno);
@@ -160,11 +359,27 @@ NX_PUBLIC NX_Error NX_IRQ_Handle(NX_IRQ_Number irqno)
         return NX_EINVAL;
     }
     NX_IRQ_Action *action;
+    NX_IRQ_Action *threaded = NX_NULL;
+    NX_Error err;
+#ifdef CONFIG_NX_IRQ_STATS
+    NX_IRQ_Stat *stat;
+    NX_U64 begin = NX_ClockCounterGet();
+    NX_U64 time;
+#endif
+
+    NX_TRACE(NX_TRACE_IRQ_ENTER, irqno, 0, 0);
 
     /* invoke each action on irq node */
     NX_ListForEachEntry(action, &irqNode->actionList, list)
     {
-        if (action->handler(irqno, action->data) == NX_EOK)
+        err = action->handler != NX_NULL ? action->handler(irqno, action->data) : NX_EAGAIN;
+        if (err == NX_EAGAIN && action->thread != NX_NULL)
+        {
+            IRQ_ThreadWake(action);
+            threaded = action;
+            break;
+        }
+        if (err == NX_EOK)
         {
             break;
         }
@@ -174,5 +389,250 @@ NX_PUBLIC NX_Error NX_IRQ_Handle(NX_IRQ_Number irqno)
     {
         irqNode->controller->ack(irqno);
     }
+    if (threaded != NX_NULL)
+    {
+        IRQ_ThreadMask(threaded);
+    }
+
+#ifdef CONFIG_NX_IRQ_STATS
+    time = NX_ClockCounterGet() - begin;
+    stat = &IRQ_StatTable[NX_SMP_GetIdx()][irqno];
+    stat->count++;
+    stat->totalTime += time;
+    if (time > stat->maxTime)
+    {
+        stat->maxTime = time;
+    }
+#endif
+
+    NX_TRACE(NX_TRACE_IRQ_EXIT, irqno, 0, 0);
     return NX_EOK;
 }
+
+NX_PUBLIC NX_Error NX_IRQ_StatGet(NX_IRQ_Number irqno, NX_UArch coreId, NX_IRQ_Stat *stat)
+{
+#ifdef CONFIG_NX_IRQ_STATS
+    if (IRQ_NodeGet(irqno) == NX_NULL || coreId >= NX_MULTI_CORES_NR || stat == NX_NULL)
+    {
+        return NX_EINVAL;
+    }
+    *stat = IRQ_StatTable[coreId][irqno];
+    return NX_EOK;
+#else
+    return NX_ENOFUNC;
+#endif
+}
+
+/**
+ * Print irq count of each cpu, handler time and names like /proc/interrupts,
+ * then stats of delay queues. Time is in clock counter cycles.
+ */
+NX_PUBLIC void NX_IRQ_StatDump(void)
+{
+#ifdef CONFIG_NX_IRQ_STATS
+    NX_IRQ_Node *irqNode;
+    NX_IRQ_Action *action;
+    NX_IRQ_Stat *stat;
+    NX_U64 count;
+    NX_U64 totalTime;
+    NX_U64 maxTime;
+    NX_UArch level;
+    int irqno;
+    int coreId;
+
+    NX_Printf("counter freq: %lu" NX_CON_NEWLINE "IRQ ", (unsigned long)NX_ClockCounterFreq());
+    for (coreId = 0; coreId < NX_MULTI_CORES_NR; coreId++)
+    {
+        NX_Printf("      CPU%d", coreId);
+    }
+    NX_Printf("   total time     max time  name" NX_CON_NEWLINE);
+
+    for (irqno = 0; irqno < NX_NR_IRQS; irqno++)
+    {
+        irqNode = &IRQ_NodeTable[irqno];
+        count = 0;
+        totalTime = 0;
+        maxTime = 0;
+        for (coreId = 0; coreId < NX_MULTI_CORES_NR; coreId++)
+        {
+            stat = &IRQ_StatTable[coreId][irqno];
+            count += stat->count;
+            totalTime += stat->totalTime;
+            if (stat->maxTime > maxTime)
+            {
+                maxTime = stat->maxTime;
+            }
+        }
+        if (count == 0 && NX_ListEmpty(&irqNode->actionList))
+        {
+            continue;
+        }
+
+        NX_Printf("%3d:", irqno);
+        for (coreId = 0; coreId < NX_MULTI_CORES_NR; coreId++)
+        {
+            NX_Printf(" %9lu", (unsigned long)IRQ_StatTable[coreId][irqno].count);
+        }
+        NX_Printf(" %12lu %12lu ", (unsigned long)totalTime, (unsigned long)maxTime);
+
+        level = NX_IRQ_SaveLevel();
+        NX_ListForEachEntry(action, &irqNode->actionList, list)
+        {
+            NX_Printf(" %s", action->name);
+        }
+        NX_IRQ_RestoreLevel(level);
+        NX_Printf(NX_CON_NEWLINE);
+    }
+#endif
+    NX_IRQ_DelayQueueStatDump();
+}
+
+#ifdef CONFIG_NX_IRQ_BALANCE
+
+#ifdef CONFIG_NX_IRQ_BALANCE_PERIOD
+#define IRQ_BALANCE_PERIOD CONFIG_NX_IRQ_BALANCE_PERIOD
+#else
+#define IRQ_BALANCE_PERIOD 1000
+#endif
+
+/* cores differ less than this irqs in a period are balanced */
+#define IRQ_BALANCE_THRESHOLD 64
+
+NX_PRIVATE NX_U64 BalanceLastCount[NX_NR_IRQS];
+
+/**
+ * irq counts of last period, 0 if irq is not balanced
+ */
+NX_PRIVATE NX_U64 BalanceIrqLoad(NX_IRQ_Number irqno)
+{
+    NX_IRQ_Node *irqNode = &IRQ_NodeTable[irqno];
+    NX_IRQ_Action *action;
+    NX_U64 count = 0;
+    NX_U64 delta;
+    NX_UArch affinity = irqNode->affinity;
+    NX_UArch coreId;
+    NX_UArch level;
+
+    for (coreId = 0; coreId < NX_MULTI_CORES_NR; coreId++)
+    {
+        count += IRQ_StatTable[coreId][irqno].count;
+    }
+    delta = count - BalanceLastCount[irqno];
+    BalanceLastCount[irqno] = count;
+
+    /* only irq routed to one core is moved */
+    if (affinity == 0 || (affinity & (affinity - 1)) != 0)
+    {
+        return 0;
+    }
+    level = NX_IRQ_SaveLevel();
+    NX_ListForEachEntry(action, &irqNode->actionList, list)
+    {
+        if (action->flags & NX_IRQ_FLAG_NOBALANCE)
+        {
+            delta = 0;
+        }
+    }
+    NX_IRQ_RestoreLevel(level);
+    return delta;
+}
+
+NX_PRIVATE NX_UArch BalanceIrqCore(NX_IRQ_Number irqno)
+{
+    NX_UArch affinity = IRQ_NodeTable[irqno].affinity;
+    NX_UArch coreId = 0;
+
+    while (!(affinity & (1UL << coreId)))
+    {
+        coreId++;
+    }
+    return coreId;
+}
+
+/**
+ * Move one irq from the busiest core to the idlest core each period,
+ * the irq with most counts that still makes two cores closer is chosen.
+ */
+NX_PRIVATE void IRQ_Balance(void)
+{
+    NX_U64 irqLoad[NX_NR_IRQS];
+    NX_U64 coreLoad[NX_MULTI_CORES_NR];
+    NX_UArch coreId;
+    NX_UArch busiest = NX_MULTI_CORES_NR;
+    NX_UArch idlest = NX_MULTI_CORES_NR;
+    NX_U64 diff;
+    int irqno;
+    int best = -1;
+
+    for (coreId = 0; coreId < NX_MULTI_CORES_NR; coreId++)
+    {
+        coreLoad[coreId] = 0;
+    }
+    for (irqno = 0; irqno < NX_NR_IRQS; irqno++)
+    {
+        irqLoad[irqno] = BalanceIrqLoad(irqno);
+        coreLoad[BalanceIrqCore(irqno)] += irqLoad[irqno];
+    }
+
+    for (coreId = 0; coreId < NX_MULTI_CORES_NR; coreId++)
+    {
+        /* core not online */
+        if (NX_CpuGetIndex(coreId)->threadRunning == NX_NULL)
+        {
+            continue;
+        }
+        if (busiest == NX_MULTI_CORES_NR || coreLoad[coreId] > coreLoad[busiest])
+        {
+            busiest = coreId;
+        }
+        if (idlest == NX_MULTI_CORES_NR || coreLoad[coreId] < coreLoad[idlest])
+        {
+            idlest = coreId;
+        }
+    }
+    if (busiest == idlest || busiest == NX_MULTI_CORES_NR)
+    {
+        return;
+    }
+    diff = coreLoad[busiest] - coreLoad[idlest];
+    if (diff < IRQ_BALANCE_THRESHOLD)
+    {
+        return;
+    }
+
+    for (irqno = 0; irqno < NX_NR_IRQS; irqno++)
+    {
+        if (irqLoad[irqno] == 0 || irqLoad[irqno] >= diff || BalanceIrqCore(irqno) != busiest)
+        {
+            continue;
+        }
+        if (best < 0 || irqLoad[irqno] > irqLoad[best])
+        {
+            best = irqno;
+        }
+    }
+    if (best >= 0)
+    {
+        NX_IRQ_SetAffinity(best, 1UL << idlest);
+    }
+}
+
+NX_PRIVATE void IRQ_BalanceThreadEntry(void *arg)
+{
+    while (1)
+    {
+        NX_ThreadSleep(IRQ_BALANCE_PERIOD);
+        IRQ_Balance();
+    }
+}
+
+NX_PRIVATE void IRQ_BalanceInit(void)
+{
+    NX_Thread *thread = NX_ThreadCreate("IrqBalance", IRQ_BalanceThreadEntry, NX_NULL);
+    NX_ASSERT(thread != NX_NULL);
+    NX_ASSERT(NX_ThreadRun(thread) == NX_EOK);
+}
+
+NX_INITCALL(IRQ_BalanceInit);
+
+#endif /* CONFIG_NX_IRQ_BALANCE */
@@ -269,6 +269,11 @@ NX_PUBLIC NX_Error NX_BuddyIncreasePage(NX_BuddySystem* system, void *ptr)
 
     if (ptr)
     {
+        if (NX_PAGE_INVALID_ADDR(system, ptr))
+        {
+            return NX_EINVAL;
+        }
+
         NX_Page* page = NX_PageFromPtr(system, ptr);
         NX_AtomicInc(&page->reference);
         return NX_EOK;
@@ -276,6 +281,61 @@ NX_PUBLIC NX_Error NX_BuddyIncreasePage(NX_BuddySystem* system, void *ptr)
     return NX_EINVAL;
 }
 
+/**
+ * get reference of page, return 0 if page not allocated
+ */
+NX_PUBLIC NX_IArch NX_BuddyGetPageReference(NX_BuddySystem* system, void *ptr)
+{
+    NX_ASSERT(system && ptr);
+
+    if (NX_PAGE_INVALID_ADDR(system, ptr))
+    {
+        return 0;
+    }
+
+    NX_Page* page = NX_PageFromPtr(system, ptr);
+    if (DoPageFree(page))
+    {
+        return 0;
+    }
+    return NX_AtomicGet(&page->reference);
+}
+
+/**
+ * split pages allocated together into single pages, each page can be
+ * freed alone after split.
+ */
+NX_PUBLIC NX_Error NX_BuddySplitPage(NX_BuddySystem* system, void *ptr)
+{
+    NX_ASSERT(system && ptr);
+
+    if (ptr)
+    {
+        if (NX_PAGE_INVALID_ADDR(system, ptr))
+        {
+            return NX_EINVAL;
+        }
+
+        NX_Page* page = NX_PageFromPtr(system, ptr);
+        if (DoPageFree(page) || page->order == NX_PAGE_INVALID_ORDER)
+        {
+            return NX_EFAULT;
+        }
+
+        NX_USize count = 1UL << page->order;
+        NX_USize i;
+        for (i = 0; i < count; i++)
+        {
+            NX_ListInit(&page[i].list);
+            page[i].flags = 0;
+            page[i].order = 0;
+            NX_AtomicSet(&page[i].reference, 1);
+        }
+        return NX_EOK;
+    }
+    return NX_EINVAL;
+}
+
 /**
  * free page, if reference > 1, dec reference and return NX_EAGAIN.
  * if reference = 0, free the page and return NX_EOK.
@@ -15,6 +15,7 @@
 #include <mm/buddy.h>
 #include <mm/page.h>
 #include <sched/mutex.h>
+#include <utils/trace.h>
 
 #define NX_LOG_LEVEL NX_LOG_INFO
 #define NX_LOG_NAME "HeapCache"
@@ -238,6 +239,7 @@ NX_PUBLIC void *NX_HeapAlloc(NX_USize size)
     NX_MutexLock(&HeapCacheLock, NX_True);
     void *ptr = DoHeapAlloc(size);
     NX_MutexUnlock(&HeapCacheLock);
+    NX_TRACE(NX_TRACE_HEAP_ALLOC, ptr, size, 0);
     return ptr;
 }
 
@@ -323,6 +325,7 @@ NX_PUBLIC NX_Error NX_HeapFree(void *object)
     {
         return NX_EINVAL;
     }
+    NX_TRACE(NX_TRACE_HEAP_FREE, object, 0, 0);
     NX_MutexLock(&HeapCacheLock, NX_True);
     NX_Error err = DoHeapFree(object);
     NX_MutexUnlock(&HeapCacheLock);
@@ -11,11 +11,41 @@
 
 #include <mm/buddy.h>
 #include <mm/page.h>
+#include <sched/spin.h>
+#include <utils/memory.h>
 #include <utils/log.h>
 #include <xbook/debug.h>
 
 NX_PRIVATE NX_BuddySystem *BuddySystemArray[NX_PAGE_ZONE_NR]; 
 
+/* buddy system has no lock, all cores alloc and free pages under zone lock */
+NX_PRIVATE NX_Spin BuddyLockArray[NX_PAGE_ZONE_NR];
+
+/**
+ * Free pages of normal zone zeroed in idle time, so zeroed alloc on fault
+ * path needs no memset.
+ */
+NX_PRIVATE void *ZeroPoolPages[NX_PAGE_ZERO_POOL_PAGES];
+NX_PRIVATE NX_USize ZeroPoolCount = 0;
+NX_PRIVATE STATIC_SPIN_UNLOCKED(ZeroPoolLock);
+
+/* shared read-only page backs reads on anonymous memory not written yet */
+NX_PRIVATE void *ZeroPage = NX_NULL;
+
+NX_PRIVATE void *ZeroPoolGet(void)
+{
+    void *page = NX_NULL;
+    NX_UArch level;
+
+    NX_SpinLockIRQ(&ZeroPoolLock, &level);
+    if (ZeroPoolCount > 0)
+    {
+        page = ZeroPoolPages[--ZeroPoolCount];
+    }
+    NX_SpinUnlockIRQ(&ZeroPoolLock, level);
+    return page;
+}
+
 /**
  * Init buddy memory allocator
  */
@@ -24,24 +54,73 @@ NX_PUBLIC void NX_PageInitZone(NX_PageZone zone, void *mem, NX_USize size)
     NX_ASSERT(zone >= NX_PAGE_ZONE_NORMAL && zone < NX_PAGE_ZONE_NR && size > 0);
     BuddySystemArray[zone] = NX_BuddyCreate(mem, size);
     NX_ASSERT(BuddySystemArray[zone] != NX_NULL);
+    NX_SpinInit(&BuddyLockArray[zone]);
+
+    if (zone == NX_PAGE_ZONE_NORMAL)
+    {
+        /* zero page holds the alloc reference, never freed by unmap */
+        ZeroPage = NX_BuddyAllocPage(BuddySystemArray[zone], 1);
+        NX_ASSERT(ZeroPage != NX_NULL);
+        NX_MemZero(NX_Phy2Virt(ZeroPage), NX_PAGE_SIZE);
+    }
 }
 
 NX_PUBLIC void *NX_PageAllocInZone(NX_PageZone zone, NX_USize count)
 {
     NX_ASSERT(zone >= NX_PAGE_ZONE_NORMAL && zone < NX_PAGE_ZONE_NR && count > 0);
-    return NX_BuddyAllocPage(BuddySystemArray[zone], count);
+    NX_UArch level;
+    NX_SpinLockIRQ(&BuddyLockArray[zone], &level);
+    void *page = NX_BuddyAllocPage(BuddySystemArray[zone], count);
+    NX_SpinUnlockIRQ(&BuddyLockArray[zone], level);
+    if (page == NX_NULL && zone == NX_PAGE_ZONE_NORMAL && count == 1)
+    {
+        page = ZeroPoolGet();   /* take back zeroed pages when memory is low */
+    }
+    return page;
 }
 
 NX_PUBLIC NX_Error NX_PageFreeInZone(NX_PageZone zone, void *ptr)
 {
     NX_ASSERT(zone >= NX_PAGE_ZONE_NORMAL && zone < NX_PAGE_ZONE_NR && ptr != NX_NULL);
-    return NX_BuddyFreePage(BuddySystemArray[zone], ptr);
+    NX_UArch level;
+    NX_Error err;
+    NX_SpinLockIRQ(&BuddyLockArray[zone], &level);
+    err = NX_BuddyFreePage(BuddySystemArray[zone], ptr);
+    NX_SpinUnlockIRQ(&BuddyLockArray[zone], level);
+    return err;
 }
 
 NX_PUBLIC NX_Error NX_PageIncreaseInZone(NX_PageZone zone, void *ptr)
 {
     NX_ASSERT(zone >= NX_PAGE_ZONE_NORMAL && zone < NX_PAGE_ZONE_NR && ptr != NX_NULL);
-    return NX_BuddyIncreasePage(BuddySystemArray[zone], ptr);
+    NX_UArch level;
+    NX_Error err;
+    NX_SpinLockIRQ(&BuddyLockArray[zone], &level);
+    err = NX_BuddyIncreasePage(BuddySystemArray[zone], ptr);
+    NX_SpinUnlockIRQ(&BuddyLockArray[zone], level);
+    return err;
+}
+
+NX_PUBLIC NX_Error NX_PageSplitInZone(NX_PageZone zone, void *ptr)
+{
+    NX_ASSERT(zone >= NX_PAGE_ZONE_NORMAL && zone < NX_PAGE_ZONE_NR && ptr != NX_NULL);
+    NX_UArch level;
+    NX_Error err;
+    NX_SpinLockIRQ(&BuddyLockArray[zone], &level);
+    err = NX_BuddySplitPage(BuddySystemArray[zone], ptr);
+    NX_SpinUnlockIRQ(&BuddyLockArray[zone], level);
+    return err;
+}
+
+NX_PUBLIC NX_IArch NX_PageGetReferenceInZone(NX_PageZone zone, void *ptr)
+{
+    NX_ASSERT(zone >= NX_PAGE_ZONE_NORMAL && zone < NX_PAGE_ZONE_NR && ptr != NX_NULL);
+    NX_UArch level;
+    NX_IArch ref;
+    NX_SpinLockIRQ(&BuddyLockArray[zone], &level);
+    ref = NX_BuddyGetPageReference(BuddySystemArray[zone], ptr);
+    NX_SpinUnlockIRQ(&BuddyLockArray[zone], level);
+    return ref;
 }
 
 NX_PUBLIC void *NX_PageZoneGetBase(NX_PageZone zone)
@@ -61,3 +140,70 @@ NX_PUBLIC void *NX_PageZoneGetBuddySystem(NX_PageZone zone)
     NX_ASSERT(zone >= NX_PAGE_ZONE_NORMAL && zone < NX_PAGE_ZONE_NR);
     return BuddySystemArray[zone];
 }
+
+/**
+ * Alloc one page filled with zero from normal zone, take from zeroed pool
+ * first, zero page here if pool is empty.
+ */
+NX_PUBLIC void *NX_PageAllocZeroed(void)
+{
+    void *page = ZeroPoolGet();
+    if (page != NX_NULL)
+    {
+        return page;
+    }
+
+    page = NX_PageAlloc(1);
+    if (page != NX_NULL)
+    {
+        NX_MemZero(NX_Phy2Virt(page), NX_PAGE_SIZE);
+    }
+    return page;
+}
+
+/**
+ * Zero at most count free pages into pool, return pages zeroed. Called in
+ * idle thread of each core, page is zeroed without lock held.
+ */
+NX_PUBLIC NX_USize NX_PageZeroPoolFill(NX_USize count)
+{
+    NX_USize filled = 0;
+    NX_UArch level;
+    void *page;
+
+    while (filled < count && ZeroPoolCount < NX_PAGE_ZERO_POOL_PAGES)
+    {
+        page = NX_PageAlloc(1);
+        if (page == NX_NULL)
+        {
+            break;
+        }
+        NX_MemZero(NX_Phy2Virt(page), NX_PAGE_SIZE);
+
+        NX_SpinLockIRQ(&ZeroPoolLock, &level);
+        if (ZeroPoolCount < NX_PAGE_ZERO_POOL_PAGES)
+        {
+            ZeroPoolPages[ZeroPoolCount++] = page;
+            page = NX_NULL;
+        }
+        NX_SpinUnlockIRQ(&ZeroPoolLock, level);
+
+        if (page != NX_NULL)
+        {
+            /* pool filled by other core */
+            NX_PageFree(page);
+            break;
+        }
+        filled++;
+    }
+    return filled;
+}
+
+/**
+ * Get physic address of the shared zero page, mapping it must increase
+ * its reference, which is dropped by unmap.
+ */
+NX_PUBLIC void *NX_PageGetZeroPage(void)
+{
+    return ZeroPage;
+}
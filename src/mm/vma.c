@@ -0,0 +1,274 @@
+/**
+ * Copyright (c) 2018-2022, BookOS Development Team
+ * SPDX-License-Identifier: Apache-2.0
+ * 
+ * Contains: Virtual memory area of user space
+ */
+
+#include <mm/vma.h>
+#include <mm/alloc.h>
+#include <mm/page.h>
+#include <sched/process.h>
+#include <platform.h>
+
+#define NX_LOG_NAME "VMA"
+#include <utils/log.h>
+
+/**
+ * Vma list is sorted by address and protected by process lock. Page tables
+ * are changed under page table lock of process, which is released before tlb
+ * shootdown, because shootdown waits for other cores which may spin on the
+ * lock with interrupt disabled. Fault maps a page with page table lock held
+ * and checks the vma again, so no page is mapped after the area is unmapped.
+ */
+
+NX_PRIVATE NX_Bool VmaCheckRange(NX_Addr addr, NX_USize size)
+{
+    if (size == 0 || (addr & NX_PAGE_MASK))
+    {
+        return NX_False;
+    }
+    size = NX_PAGE_ALIGNUP(size);
+    if (addr < MEM_USER_SPACE_BASE || addr + size < addr || addr + size > MEM_USER_SPACE_TOP)
+    {
+        return NX_False;
+    }
+    return NX_True;
+}
+
+/**
+ * Reserve [addr, addr + size) in user space, no page is allocated until
+ * the area is touched.
+ */
+NX_PUBLIC NX_Error NX_VmaMap(NX_Process *process, NX_Addr addr, NX_USize size, NX_U32 flags)
+{
+    NX_Vma *vma;
+    NX_Vma *pos;
+    NX_UArch level;
+
+    if (process == NX_NULL || !VmaCheckRange(addr, size))
+    {
+        return NX_EINVAL;
+    }
+
+    vma = NX_MemAlloc(sizeof(NX_Vma));
+    if (vma == NX_NULL)
+    {
+        return NX_ENOMEM;
+    }
+    vma->start = addr;
+    vma->end = addr + NX_PAGE_ALIGNUP(size);
+    vma->flags = flags;
+
+    NX_SpinLockIRQ(&process->lock, &level);
+    NX_ListForEachEntry(pos, &process->vmaListHead, list)
+    {
+        if (pos->start >= vma->end)
+        {
+            break;
+        }
+        if (pos->end > vma->start)
+        {
+            NX_SpinUnlockIRQ(&process->lock, level);
+            NX_MemFree(vma);
+            return NX_EINVAL;   /* overlap with others */
+        }
+    }
+    /* insert before the first area after it, or tail of list */
+    NX_ListAddBefore(&vma->list, &pos->list);
+    NX_SpinUnlockIRQ(&process->lock, level);
+    return NX_EOK;
+}
+
+/**
+ * Release [addr, addr + size) of user space, areas cross the range are cut,
+ * pages populated in the range are unmapped.
+ */
+NX_PUBLIC NX_Error NX_VmaUnmap(NX_Process *process, NX_Addr addr, NX_USize size)
+{
+    NX_Vma *vma;
+    NX_Vma *next;
+    NX_Vma *split;
+    NX_Addr end;
+    NX_UArch level;
+    NX_LIST_HEAD(freeList);
+
+    if (process == NX_NULL || !VmaCheckRange(addr, size))
+    {
+        return NX_EINVAL;
+    }
+    size = NX_PAGE_ALIGNUP(size);
+    end = addr + size;
+
+    /* area may be split into two */
+    split = NX_MemAlloc(sizeof(NX_Vma));
+    if (split == NX_NULL)
+    {
+        return NX_ENOMEM;
+    }
+
+    NX_SpinLockIRQ(&process->lock, &level);
+    NX_ListForEachEntrySafe(vma, next, &process->vmaListHead, list)
+    {
+        if (vma->end <= addr)
+        {
+            continue;
+        }
+        if (vma->start >= end)
+        {
+            break;
+        }
+        if (vma->start < addr && vma->end > end)
+        {
+            split->start = end;
+            split->end = vma->end;
+            split->flags = vma->flags;
+            vma->end = addr;
+            NX_ListAddAfter(&split->list, &vma->list);
+            split = NX_NULL;
+            break;
+        }
+        if (vma->start < addr)
+        {
+            vma->end = addr;
+        }
+        else if (vma->end > end)
+        {
+            vma->start = end;
+        }
+        else
+        {
+            NX_ListDel(&vma->list);
+            NX_ListAdd(&vma->list, &freeList);
+        }
+    }
+    NX_SpinUnlockIRQ(&process->lock, level);
+
+    NX_ListForEachEntrySafe(vma, next, &freeList, list)
+    {
+        NX_MemFree(vma);
+    }
+    if (split != NX_NULL)
+    {
+        NX_MemFree(split);
+    }
+    return NX_ProcessUnmapUserSpace(process, addr, size);
+}
+
+/**
+ * Copy areas of src to dst, used when duplicate process.
+ */
+NX_PUBLIC NX_Error NX_VmaCopy(NX_Process *dst, NX_Process *src)
+{
+    NX_Vma *vma;
+    NX_Vma *newVma;
+    NX_UArch level;
+    NX_Error err = NX_EOK;
+    NX_LIST_HEAD(copyList);
+
+    NX_SpinLockIRQ(&src->lock, &level);
+    NX_ListForEachEntry(vma, &src->vmaListHead, list)
+    {
+        newVma = NX_MemAlloc(sizeof(NX_Vma));
+        if (newVma == NX_NULL)
+        {
+            err = NX_ENOMEM;
+            break;
+        }
+        newVma->start = vma->start;
+        newVma->end = vma->end;
+        newVma->flags = vma->flags;
+        NX_ListAddTail(&newVma->list, &copyList);
+    }
+    NX_SpinUnlockIRQ(&src->lock, level);
+
+    /* areas copied are freed with dst if failed */
+    NX_SpinLockIRQ(&dst->lock, &level);
+    NX_ListForEachEntrySafe(vma, newVma, &copyList, list)
+    {
+        NX_ListDel(&vma->list);
+        NX_ListAddTail(&vma->list, &dst->vmaListHead);
+    }
+    NX_SpinUnlockIRQ(&dst->lock, level);
+    return err;
+}
+
+/**
+ * Release all areas and pages of user space, called when process destroy.
+ */
+NX_PUBLIC void NX_VmaUnmapAll(NX_Process *process)
+{
+    NX_Vma *vma;
+    NX_Vma *next;
+    NX_UArch level;
+    NX_LIST_HEAD(freeList);
+
+    NX_SpinLockIRQ(&process->lock, &level);
+    NX_ListForEachEntrySafe(vma, next, &process->vmaListHead, list)
+    {
+        NX_ListDel(&vma->list);
+        NX_ListAdd(&vma->list, &freeList);
+    }
+    NX_SpinUnlockIRQ(&process->lock, level);
+
+    NX_ListForEachEntrySafe(vma, next, &freeList, list)
+    {
+        NX_MemFree(vma);
+    }
+    /* pages may be populated by fault raced with unmap, release whole space */
+    NX_ProcessUnmapUserSpace(process, MEM_USER_SPACE_BASE, MEM_USER_SPACE_TOP - MEM_USER_SPACE_BASE);
+}
+
+/**
+ * Handle page fault on addr of user space, access is NX_VMA_READ, NX_VMA_WRITE
+ * or NX_VMA_EXEC. Store on COW page copies it, read on area not populated maps
+ * the shared zero page, other access maps a zeroed page. Return NX_EOK if fault
+ * handled, otherwise the access is invalid.
+ */
+/**
+ * Get flags of area holds addr, return NX_EFAULT if addr not in any area.
+ */
+NX_PUBLIC NX_Error NX_VmaGetFlags(NX_Process *process, NX_Addr addr, NX_U32 *flags)
+{
+    NX_Vma *vma;
+    NX_UArch level;
+    NX_Error err = NX_EFAULT;
+
+    NX_SpinLockIRQ(&process->lock, &level);
+    NX_ListForEachEntry(vma, &process->vmaListHead, list)
+    {
+        if (vma->start > addr)
+        {
+            break;
+        }
+        if (vma->end > addr)
+        {
+            *flags = vma->flags;
+            err = NX_EOK;
+            break;
+        }
+    }
+    NX_SpinUnlockIRQ(&process->lock, level);
+    return err;
+}
+
+NX_PUBLIC NX_Error NX_VmaHandleFault(NX_Process *process, NX_Addr addr, NX_U32 access)
+{
+    NX_U32 flags = 0;
+
+    if (NX_VmaGetFlags(process, addr, &flags) != NX_EOK)
+    {
+        return NX_EFAULT;
+    }
+    if ((flags & access) != access)
+    {
+        NX_LOG_E("access %x on %p not permitted by area %x", access, addr, flags);
+        return NX_EPERM;
+    }
+
+    if ((access & NX_VMA_WRITE) && NX_ProcessHandleCOWFault(process, addr) == NX_EOK)
+    {
+        return NX_EOK;
+    }
+    return NX_ProcessMapUserPage(process, addr & NX_PAGE_ADDR_MASK, flags, access);
+}
@@ -9,20 +9,23 @@
  * 2021-10-1      JasonHu           Init
  */
 
-#include <utils/memory.h>
-#include <utils/log.h>
+#include <mods/console/console.h>
 #include <utils/string.h>
 #include <utils/var_args.h>
 
-#ifdef CONFIG_PRINT_BUF_LEN
-#define NX_PRINT_BUF_LEN CONFIG_PRINT_BUF_LEN
-#else
-#define NX_PRINT_BUF_LEN 256
-#endif
-
 /* Conosle HAL */
 NX_INTERFACE NX_WEAK_SYM void HAL_ConsoleOutChar(char ch) {}
 
+NX_INTERFACE NX_WEAK_SYM void HAL_ConsoleOutBuf(const char *buf, NX_USize len)
+{
+    while (len-- > 0)
+    {
+        HAL_ConsoleOutChar(*buf++);
+    }
+}
+
+NX_INTERFACE NX_WEAK_SYM void HAL_ConsoleFlush(void) {}
+
 NX_PUBLIC void NX_ConsoleOutChar(char ch)
 {
     HAL_ConsoleOutChar(ch);
@@ -30,19 +33,32 @@ NX_PUBLIC void NX_ConsoleOutChar(char ch)
 
 NX_PUBLIC void NX_ConsoleOutStr(const char *str)
 {
-    char *p = (char *)str;
-    while (*p)
-    {
-        HAL_ConsoleOutChar(*p++);
-    }
+    HAL_ConsoleOutBuf(str, NX_StrLen(str));
+}
+
+NX_PUBLIC void NX_ConsoleOutBuf(const char *buf, NX_USize len)
+{
+    HAL_ConsoleOutBuf(buf, len);
+}
+
+/**
+ * Output chars buffered by console driver now, used when interrupt may
+ * be off forever, such as panic.
+ */
+NX_PUBLIC void NX_ConsoleFlush(void)
+{
+    HAL_ConsoleFlush();
+}
+
+NX_PRIVATE void ConsolePrintSink(void *sinkArg, const char *str, NX_USize len)
+{
+    NX_ConsoleOutBuf(str, len);
 }
 
 NX_PUBLIC void NX_Printf(const char *fmt, ...)
 {
-	char buf[NX_PRINT_BUF_LEN] = {0};
-	NX_VarList arg;
+    NX_VarList arg;
     NX_VarStart(arg, fmt);
-    NX_VSNPrintf(buf, NX_PRINT_BUF_LEN, fmt, arg);
-	NX_VarEnd(arg);
-    NX_ConsoleOutStr(buf);
+    NX_VSinkPrintf(ConsolePrintSink, NX_NULL, fmt, arg);
+    NX_VarEnd(arg);
 }
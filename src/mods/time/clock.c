@@ -37,6 +37,30 @@ NX_PUBLIC NX_ClockTick NX_ClockTickGet(void)
     return SystemClockTicks;
 }
 
+/* Counter HAL, ticks is used if platform has no counter */
+NX_INTERFACE NX_WEAK_SYM NX_U64 HAL_ClockCounterGet(void)
+{
+    return SystemClockTicks;
+}
+
+NX_INTERFACE NX_WEAK_SYM NX_U64 HAL_ClockCounterFreq(void)
+{
+    return NX_TICKS_PER_SECOND;
+}
+
+/**
+ * Counter runs faster than ticks, used to measure short time
+ */
+NX_PUBLIC NX_U64 NX_ClockCounterGet(void)
+{
+    return HAL_ClockCounterGet();
+}
+
+NX_PUBLIC NX_U64 NX_ClockCounterFreq(void)
+{
+    return HAL_ClockCounterFreq();
+}
+
 NX_PUBLIC void NX_ClockTickSet(NX_ClockTick tick)
 {
     SystemClockTicks = tick;
@@ -83,13 +107,20 @@ NX_PRIVATE void NX_TimerIrqHandler(void *arg)
 NX_PRIVATE void NX_SchedIrqHandler(void *arg)
 {
     NX_Thread *thread = NX_ThreadSelf();
-    thread->ticks--;
+    /* ticks stay 0 while preempt disabled holds thread after slice used up */
+    if (thread->ticks > 0)
+    {
+        thread->ticks--;
+    }
     if (thread->ticks == 0)
     {
         // NX_LOG_I("thread:%s need sched", thread->name);
         thread->needSched = 1; /* mark sched */
     }
-    NX_ASSERT(thread->ticks >= 0);
+    NX_DeadlineTick(thread);
+#ifdef CONFIG_NX_SCHED_FAIR
+    NX_FairTick(thread);
+#endif
 }
 
 NX_PUBLIC NX_Error NX_ClockInit(void)
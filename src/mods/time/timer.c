@@ -15,6 +15,7 @@
 #include <utils/log.h>
 #include <xbook/debug.h>
 #include <sched/spin.h>
+#include <utils/trace.h>
 
 #define NX_IDLE_TIMER_TIMEOUT  NX_MAX_TIMER_TIMEOUT
 #define NX_IDLE_TIMER_TIMEOUT_TICKS  (NX_IDLE_TIMER_TIMEOUT / (1000 / NX_TICKS_PER_SECOND))
@@ -247,6 +248,8 @@ NX_PUBLIC NX_Error NX_TimerStop(NX_Timer *timer)
 NX_PRIVATE void NX_TimerInvoke(NX_Timer *timer)
 {
     timer->state = NX_TIMER_PROCESSING;
+
+    NX_TRACE(NX_TRACE_TIMER_FIRE, timer, timer->handler, 0);
     
     /* stop timer here */
     if (timer->handler(timer, timer->arg) == NX_False)
@@ -39,6 +39,12 @@ QEMU_ARGS 	:=  -m 512m \
 				-boot d \
 				-cdrom $(NXOS_NAME).iso \
 
+ifndef CORES
+CORES := 1
+endif # CORES
+
+QEMU_ARGS	+= 	-smp $(CORES)
+
 ifeq ($(QEMU_WINDOW),y)
 	QEMU_ARGS += -serial stdio
 else
@@ -10,7 +10,7 @@
  */
 
 #include <xbook.h>
-#include <io/delay_irq.h>
+#include <io/irq.h>
 #include <drivers/direct_uart.h>
 #include <utils/log.h>
 #include <xbook/debug.h>
@@ -133,7 +133,6 @@ struct DirectUart
 };
 
 NX_PRIVATE struct DirectUart DirectUart;
-NX_PRIVATE NX_IRQ_DelayWork UartWork;
 
 NX_PRIVATE void UartSent(struct DirectUart *uart, char data)
 {
@@ -231,21 +230,21 @@ NX_PUBLIC int HAL_DirectUartGetc(void)
     return data;
 }
 
-NX_PRIVATE void UartWorkHandler(void *arg)
+/**
+ * input handler may output and wait uart, so run in irq thread
+ */
+NX_PRIVATE NX_Error UartIrqThreadHandler(NX_IRQ_Number irqno, void *arg)
 {
-    int data = HAL_DirectUartGetc();
-    if (data != -1)
+    struct DirectUart *uart = &DirectUart;
+
+    while (IO_In8(uart->lineStatus) & LINE_STATUS_DATA_READY)
     {
+        char data = IO_In8(uart->data);
         if (HAL_DirectUartGetcHandler != NX_NULL)
         {
             HAL_DirectUartGetcHandler(data);
         }
     }
-}
-
-NX_PRIVATE NX_Error UartIrqHandler(NX_IRQ_Number irqno, void *arg)
-{
-    NX_IRQ_DelayWorkHandle(&UartWork);
     return NX_EOK;
 }
 
@@ -253,9 +252,6 @@ NX_PUBLIC void HAL_DirectUartStage2(void)
 {
     struct DirectUart *uart = &DirectUart;
     
-    NX_ASSERT(NX_IRQ_DelayWorkInit(&UartWork, UartWorkHandler, NX_NULL, NX_IRQ_WORK_NOREENTER) == NX_EOK);
-    NX_ASSERT(NX_IRQ_DelayQueueEnter(NX_IRQ_NORMAL_QUEUE, &UartWork) == NX_EOK);
-
-    NX_ASSERT(NX_IRQ_Bind(uart->irqno, UartIrqHandler, NX_NULL, "Uart", 0) == NX_EOK);
+    NX_ASSERT(NX_IRQ_BindThreaded(uart->irqno, NX_NULL, UartIrqThreadHandler, NX_NULL, "Uart", 0) == NX_EOK);
     NX_ASSERT(NX_IRQ_Unmask(uart->irqno) == NX_EOK);
 }
@@ -15,6 +15,7 @@
 
 NX_INLINE void BootModInit(struct multiboot_tag *tag);
 NX_INLINE void BootMemModInit(struct multiboot_tag *tag);
+NX_INLINE void BootMemMapInit(struct multiboot_tag *tag);
 
 NX_PUBLIC int HAL_BootSetting(unsigned long magic, unsigned long addr)
 {
@@ -26,6 +27,7 @@ NX_PUBLIC int HAL_BootSetting(unsigned long magic, unsigned long addr)
     struct multiboot_tag *tag;
     
     BootModInfoInit();
+    BootMemInfoInit();
 
     for (tag = (struct multiboot_tag*)(addr + 8);
         tag->type != MULTIBOOT_TAG_TYPE_END;
@@ -38,6 +40,9 @@ NX_PUBLIC int HAL_BootSetting(unsigned long magic, unsigned long addr)
         case MULTIBOOT_TAG_TYPE_BASIC_MEMINFO:
             BootMemModInit(tag);
             break;
+        case MULTIBOOT_TAG_TYPE_MMAP:
+            BootMemMapInit(tag);
+            break;
         }
     }
     return 0;
@@ -78,5 +83,26 @@ NX_INLINE void BootMemModInit(struct multiboot_tag *tag)
 {
     unsigned long memUpper = ((struct multiboot_tag_basic_meminfo *)tag)->mem_upper;
     unsigned long memLower = ((struct multiboot_tag_basic_meminfo *)tag)->mem_lower;
-    *((unsigned int *)0x000001000) = ((memUpper - memLower) << 10) + 0x100000;
+    struct BootMemInfo *memInfo = (struct BootMemInfo *)BOOT_MEM_INFO_ADDR;
+    memInfo->memSize = ((memUpper - memLower) << 10) + 0x100000;
+}
+
+NX_INLINE void BootMemMapInit(struct multiboot_tag *tag)
+{
+    struct BootMemInfo *memInfo = (struct BootMemInfo *)BOOT_MEM_INFO_ADDR;
+    struct multiboot_tag_mmap *mmapTag = (struct multiboot_tag_mmap *)tag;
+    multiboot_memory_map_t *mmap;
+
+    for (mmap = mmapTag->entries;
+        (multiboot_uint8_t *)mmap < (multiboot_uint8_t *)tag + tag->size;
+        mmap = (multiboot_memory_map_t *)((multiboot_uint8_t *)mmap + mmapTag->entry_Size))
+    {
+        if (mmap->type != MULTIBOOT_MEMORY_AVAILABLE || memInfo->regionNum >= MAX_BOOT_MEM_REGIONS)
+        {
+            continue;
+        }
+        memInfo->regions[memInfo->regionNum].base = mmap->addr;
+        memInfo->regions[memInfo->regionNum].size = mmap->len;
+        ++memInfo->regionNum;
+    }
 }
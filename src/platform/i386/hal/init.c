@@ -34,8 +34,8 @@ NX_INTERFACE NX_Error HAL_PlatformInit(NX_UArch coreId)
     NX_LOG_I("Hello, PC32!");
 
     CPU_InitGate();
-    CPU_InitSegment();
-    CPU_InitTSS();
+    CPU_InitSegment(coreId);
+    CPU_InitTSS(coreId, KERNEL_STACK_TOP);
     CPU_InitInterrupt();
     
     HAL_PageZoneInit();
@@ -11,10 +11,13 @@
 
 #include <xbook.h>
 #include <drivers/direct_uart.h>
+#include <io/irq.h>
 
 #define NX_LOG_NAME "HAL_PlatformMain"
 #include <utils/log.h>
 
+#define KEY_CTRL_T 0x14   /* status key */
+
 NX_INTERFACE void HAL_PlatformMain(void)
 {
     NX_LOG_I("PC32 platform main running...\n");
@@ -34,6 +37,9 @@ NX_PUBLIC void HAL_DirectUartGetcHandler(char data)
         HAL_DirectUartPutc(' ');
         HAL_DirectUartPutc('\b');
         break;
+    case KEY_CTRL_T:
+        NX_IRQ_StatDump();
+        break;
     default:
         HAL_DirectUartPutc(data);
         break;
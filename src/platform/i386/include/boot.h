@@ -16,6 +16,10 @@
 
 #define BOOT_INFO_ADDR 0x3F1000
 
+#define BOOT_MEM_INFO_ADDR 0x1000
+
+#define MAX_BOOT_MEM_REGIONS 16
+
 #define MAX_BOOT_MODS_NUM 1
 #define MAX_BOOT_MODS_SIZE (1 * NX_MB)
 
@@ -40,6 +44,25 @@ struct BootModInfo
 	} modules[MAX_BOOT_MODS_NUM];
 } __attribute__ ((packed));
 
+/* memSize is from basic meminfo, only used when no memory map */
+struct BootMemInfo
+{
+	unsigned int memSize;
+	unsigned int regionNum;
+	struct
+	{
+		unsigned long long base;
+		unsigned long long size;
+	} regions[MAX_BOOT_MEM_REGIONS];
+} __attribute__ ((packed));
+
+NX_INLINE void BootMemInfoInit()
+{
+	struct BootMemInfo *memInfo = (struct BootMemInfo *)BOOT_MEM_INFO_ADDR;
+	memInfo->memSize = 0;
+	memInfo->regionNum = 0;
+}
+
 NX_INLINE void BootModInfoInit()
 {
 	struct BootModInfo *modInfo = (struct BootModInfo *)BOOT_INFO_ADDR;
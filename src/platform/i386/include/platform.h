@@ -28,6 +28,14 @@
 
 #define MEM_KERNEL_TOP (MEM_KERNEL_BASE + MEM_KERNEL_SPACE_SZ)
 
+/* last 4MB not used, so top of user space not overflow */
+#define MEM_USER_SPACE_BASE MEM_KERNEL_TOP
+#ifdef CONFIG_NX_X86_APIC
+#define MEM_USER_SPACE_TOP 0xFEC00000   /* apic mmio mapped on top */
+#else
+#define MEM_USER_SPACE_TOP 0xFFC00000
+#endif
+
 /**
  * Physical memory layout:
  *
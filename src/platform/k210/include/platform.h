@@ -30,6 +30,10 @@
 
 #define MEM_KERNEL_TOP  (MEM_SBI_BASE + MEM_KERNEL_SPACE_SZ)
 
+/* user space aligned with 1GB, top level pte of user space not shared with kernel */
+#define MEM_USER_SPACE_BASE  0xC0000000UL
+#define MEM_USER_SPACE_TOP   0x100000000UL
+
 /* max cpus for qemu */
 #define PLATFORM_MAX_NR_MULTI_CORES 2
 
@@ -56,6 +60,8 @@
  * 
  * +------------------------+ <- 0xFFFFFFFF (4GB)
  * | @USER                  |
+ * +------------------------+ <- 0xC0000000 (3GB)
+ * | UNMAPPED               |
  * +------------------------+ <- 0x88000000 (2GB + 128MB)
  * | @KMAP                  |
  * +------------------------+ <- 0x84000000 (2GB + 64MB)
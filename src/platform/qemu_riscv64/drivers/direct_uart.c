@@ -13,6 +13,8 @@
 #include <xbook.h>
 #include <io/delay_irq.h>
 #include <drivers/direct_uart.h>
+#include <io/irq.h>
+#include <sched/spin.h>
 #include <utils/log.h>
 #include <xbook/debug.h>
 
@@ -42,17 +44,145 @@
 #define LSR_RX_READY (1 << 0)   // input is waiting to be read from RHR
 #define LSR_TX_IDLE (1 << 5)    // THR can accept another character to send
 
+#define UART_FIFO_SIZE 16       // tx fifo is empty when LSR_TX_IDLE set
+
+#ifndef CONFIG_NX_UART0_FROM_SBI
+
+#ifdef CONFIG_NX_UART0_TX_BUF_SIZE
+#define UART_TX_BUF_SIZE CONFIG_NX_UART0_TX_BUF_SIZE
+#else
+#define UART_TX_BUF_SIZE 4096
+#endif
+
+#if (UART_TX_BUF_SIZE & (UART_TX_BUF_SIZE - 1))
+#error "uart tx buf size must be power of 2"
+#endif
+
+/**
+ * Chars to send, head and tail increase forever, masked with size to get
+ * offset. Fifo is filled from ring by tx interrupt after stage2.
+ */
+NX_PRIVATE char UartTxBuf[UART_TX_BUF_SIZE];
+NX_PRIVATE NX_USize UartTxHead;
+NX_PRIVATE NX_USize UartTxTail;
+NX_PRIVATE NX_U8 UartIer;
+NX_PRIVATE STATIC_SPIN_UNLOCKED(UartTxLock);
+
+/* chars are sent by polling until interrupt bound */
+NX_PRIVATE NX_Bool UartTxBuffered = NX_False;
+
+NX_PRIVATE void UartPutcPoll(char ch)
+{
+    while ((Read8(UART0_PHY_ADDR + LSR) & LSR_TX_IDLE) == 0)
+    {
+    }
+    Write8(UART0_PHY_ADDR + THR, ch);
+}
+
+/**
+ * Move chars from ring to fifo if fifo empty, call with tx lock held.
+ */
+NX_PRIVATE void UartTxFill(void)
+{
+    int count;
+
+    if ((Read8(UART0_PHY_ADDR + LSR) & LSR_TX_IDLE) == 0)
+    {
+        return;
+    }
+    for (count = 0; count < UART_FIFO_SIZE && UartTxTail != UartTxHead; count++)
+    {
+        Write8(UART0_PHY_ADDR + THR, UartTxBuf[UartTxTail++ & (UART_TX_BUF_SIZE - 1)]);
+    }
+}
+
+/**
+ * Enable tx interrupt while chars left in ring, call with tx lock held.
+ */
+NX_PRIVATE void UartTxUpdateIrq(void)
+{
+    NX_U8 ier = UartIer & ~IER_TX_ENABLE;
+
+    if (UartTxTail != UartTxHead)
+    {
+        ier |= IER_TX_ENABLE;
+    }
+    if (ier != UartIer)
+    {
+        UartIer = ier;
+        Write8(UART0_PHY_ADDR + IER, ier);
+    }
+}
+
+NX_PRIVATE void UartTxPut(const char *buf, NX_USize len)
+{
+    NX_UArch level;
+
+    NX_SpinLockIRQ(&UartTxLock, &level);
+    while (len > 0)
+    {
+        if (UartTxHead - UartTxTail == UART_TX_BUF_SIZE)
+        {
+            /* tx interrupt can not come with lock held, wait fifo here, never drop chars */
+            while ((Read8(UART0_PHY_ADDR + LSR) & LSR_TX_IDLE) == 0)
+            {
+            }
+            UartTxFill();
+        }
+        UartTxBuf[UartTxHead++ & (UART_TX_BUF_SIZE - 1)] = *buf++;
+        len--;
+    }
+    UartTxFill();
+    UartTxUpdateIrq();
+    NX_SpinUnlockIRQ(&UartTxLock, level);
+}
+#endif /* !CONFIG_NX_UART0_FROM_SBI */
+
 NX_PUBLIC void HAL_DirectUartPutc(char ch)
+{
+    HAL_DirectUartWrite(&ch, 1);
+}
+
+NX_PUBLIC void HAL_DirectUartWrite(const char *buf, NX_USize len)
 {
 #ifdef CONFIG_NX_UART0_FROM_SBI
-    sbi_console_putchar(ch);
+    while (len-- > 0)
+    {
+        sbi_console_putchar(*buf++);
+    }
 #else
-    if ((Read8(UART0_PHY_ADDR + LSR) & LSR_TX_IDLE) == 0)
+    if (UartTxBuffered)
     {
-        // the UART transmit holding register is full,
+        UartTxPut(buf, len);
         return;
     }
-    Write8(UART0_PHY_ADDR + THR, ch);
+    while (len-- > 0)
+    {
+        UartPutcPoll(*buf++);
+    }
+#endif
+}
+
+/**
+ * Send all chars in ring by polling, interrupt may be off forever.
+ * Tx lock is ignored if other holds it, the core may never run again.
+ * Interrupt is off while flushing, tx irq on this core would spin on the lock.
+ */
+NX_PUBLIC void HAL_DirectUartFlush(void)
+{
+#ifndef CONFIG_NX_UART0_FROM_SBI
+    NX_UArch level = NX_IRQ_SaveLevel();
+    NX_Bool locked = NX_SpinLock(&UartTxLock, NX_False) == NX_EOK;
+
+    while (UartTxTail != UartTxHead)
+    {
+        UartTxFill();
+    }
+    if (locked)
+    {
+        NX_SpinUnlock(&UartTxLock);
+    }
+    NX_IRQ_RestoreLevel(level);
 #endif
 }
 
@@ -78,6 +208,16 @@ NX_INTERFACE void HAL_ConsoleOutChar(char ch)
     HAL_DirectUartPutc(ch);
 }
 
+NX_INTERFACE void HAL_ConsoleOutBuf(const char *buf, NX_USize len)
+{
+    HAL_DirectUartWrite(buf, len);
+}
+
+NX_INTERFACE void HAL_ConsoleFlush(void)
+{
+    HAL_DirectUartFlush();
+}
+
 NX_PUBLIC void HAL_DirectUartInit(void)
 {
     // disable interrupts.
@@ -103,24 +243,60 @@ NX_WEAK_SYM NX_PUBLIC void HAL_DirectUartGetcHandler(char data)
     NX_LOG_I("Deafult uart handler:%x/%c\n", data, data);
 }
 
+/**
+ * fill tx fifo in irq, wake irq thread if input ready
+ */
 NX_PRIVATE NX_Error UartIrqHandler(NX_IRQ_Number irqno, void *arg)
 {
-    int data = HAL_DirectUartGetc();
-    if (data != -1)
+#ifndef CONFIG_NX_UART0_FROM_SBI
+    NX_UArch level;
+
+    NX_SpinLockIRQ(&UartTxLock, &level);
+    UartTxFill();
+    UartTxUpdateIrq();
+    NX_SpinUnlockIRQ(&UartTxLock, level);
+
+    if ((Read8(UART0_PHY_ADDR + LSR) & LSR_RX_READY) == 0)
+    {
+        return NX_EOK;
+    }
+#endif
+    return NX_EAGAIN;
+}
+
+/**
+ * input handler may output and wait tx fifo, so run in irq thread
+ */
+NX_PRIVATE NX_Error UartIrqThreadHandler(NX_IRQ_Number irqno, void *arg)
+{
+    int data;
+
+    while ((data = HAL_DirectUartGetc()) != -1)
     {
         if (HAL_DirectUartGetcHandler != NX_NULL)
         {
             HAL_DirectUartGetcHandler(data);
         }
     }
-    return data != -1 ? NX_EOK : NX_EIO;
+    return NX_EOK;
 }
 
 NX_PUBLIC void HAL_DirectUartStage2(void)
 {
+#ifndef CONFIG_NX_UART0_FROM_SBI
+    NX_UArch level;
+
+    /* enable receive interrupts, tx interrupt is enabled when chars buffered. */
+    NX_SpinLockIRQ(&UartTxLock, &level);
+    UartIer = IER_RX_ENABLE;
+    Write8(UART0_PHY_ADDR + IER, UartIer);
+    UartTxBuffered = NX_True;
+    NX_SpinUnlockIRQ(&UartTxLock, level);
+#else
     /* enable receive interrupts. */
     Write8(UART0_PHY_ADDR + IER, IER_RX_ENABLE);
+#endif
 
-    NX_ASSERT(NX_IRQ_Bind(UART0_IRQ, UartIrqHandler, NX_NULL, "Uart", 0) == NX_EOK);
+    NX_ASSERT(NX_IRQ_BindThreaded(UART0_IRQ, UartIrqHandler, UartIrqThreadHandler, NX_NULL, "Uart", 0) == NX_EOK);
     NX_ASSERT(NX_IRQ_Unmask(UART0_IRQ) == NX_EOK);
 }
@@ -23,6 +23,8 @@ NX_PUBLIC void HAL_DirectUartInit(void);
 NX_PUBLIC void HAL_DirectUartStage2(void);
 
 NX_PUBLIC void HAL_DirectUartPutc(char ch);
+NX_PUBLIC void HAL_DirectUartWrite(const char *buf, NX_USize len);
+NX_PUBLIC void HAL_DirectUartFlush(void);
 NX_PUBLIC int HAL_DirectUartGetc(void);
 
 #endif /* __DIRECT_UART_HEADER__ */
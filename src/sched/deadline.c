@@ -0,0 +1,345 @@
+/**
+ * Copyright (c) 2018-2022, BookOS Development Team
+ * SPDX-License-Identifier: Apache-2.0
+ * 
+ * Contains: Deadline(EDF) real-time sched class
+ */
+
+#include <sched/deadline.h>
+#include <sched/thread.h>
+#include <sched/smp.h>
+#include <sched/spin.h>
+#include <io/irq.h>
+#include <mods/time/clock.h>
+#define NX_LOG_NAME "Deadline"
+#include <utils/log.h>
+#include <xbook/debug.h>
+
+/* utilization reserved by deadline threads on each core */
+NX_PRIVATE NX_U32 DeadlineUtilTable[NX_MULTI_CORES_NR];
+NX_PRIVATE STATIC_SPIN_UNLOCKED(DeadlineUtilLock);
+
+/**
+ * compare with tick wrap
+ */
+NX_INLINE NX_Bool DeadlineBefore(NX_ClockTick a, NX_ClockTick b)
+{
+    return (NX_IArch)(a - b) < 0 ? NX_True : NX_False;
+}
+
+/**
+ * no 64 bit division on 32 bit arch, util rounds up for large period
+ */
+NX_PRIVATE NX_U32 DeadlineUtil(NX_ClockTick runtime, NX_ClockTick period)
+{
+    if (period >= NX_DEADLINE_UTIL_SCALE)
+    {
+        return runtime / (period / NX_DEADLINE_UTIL_SCALE);
+    }
+    return runtime * NX_DEADLINE_UTIL_SCALE / period;
+}
+
+/**
+ * Release next job of thread each period, called in timer irq.
+ * A job not completed is a miss, only the late job and the new one are kept.
+ */
+NX_PRIVATE NX_Bool DeadlineReplenish(NX_Timer *timer, void *arg)
+{
+    NX_Thread *thread = (NX_Thread *)arg;
+    NX_ThreadDeadline *dl = &thread->deadline;
+
+    NX_SpinLock(&thread->lock, NX_True);
+    if (dl->completed != dl->released)
+    {
+        dl->missCount++;
+        dl->completed = dl->released - 1;
+    }
+    dl->released++;
+    dl->budget = dl->runtime;
+    dl->absDeadline = NX_ClockTickGet() + dl->deadline;
+    dl->throttled = NX_False;
+    if (dl->waiting)
+    {
+        dl->waiting = NX_False;
+        NX_ThreadWakeup(thread);
+    }
+    NX_SpinUnlock(&thread->lock);
+    return NX_True;
+}
+
+/**
+ * Set deadline params of thread in milliseconds, thread must not run yet.
+ * deadline is period if 0. Thread is bound on its affinity core or current core,
+ * fails with NX_ENORES if utilization of core over NX_SCHED_DEADLINE_UTIL percent.
+ * The first job is released at once.
+ */
+NX_PUBLIC NX_Error NX_ThreadSetDeadline(NX_Thread *thread, NX_UArch runtime, NX_UArch period, NX_UArch deadline)
+{
+    NX_ThreadDeadline *dl;
+    NX_ClockTick runtimeTicks;
+    NX_ClockTick periodTicks;
+    NX_ClockTick deadlineTicks;
+    NX_Timer *timer;
+    NX_UArch coreId;
+    NX_UArch level;
+    NX_U32 util;
+
+    if (thread == NX_NULL || !runtime || !period)
+    {
+        return NX_EINVAL;
+    }
+    if (!deadline)
+    {
+        deadline = period;
+    }
+    if (runtime > deadline || deadline > period)
+    {
+        return NX_EINVAL;
+    }
+    if (thread->state != NX_THREAD_INIT || NX_ThreadIsDeadline(thread))
+    {
+        return NX_EPERM;
+    }
+
+    periodTicks = NX_MILLISECOND_TO_TICKS(period);
+    if (!periodTicks)
+    {
+        return NX_EINVAL;
+    }
+    runtimeTicks = NX_MILLISECOND_TO_TICKS(runtime);
+    if (!runtimeTicks)
+    {
+        runtimeTicks = 1;
+    }
+    deadlineTicks = NX_MILLISECOND_TO_TICKS(deadline);
+    if (deadlineTicks < runtimeTicks)
+    {
+        deadlineTicks = runtimeTicks;
+    }
+    util = DeadlineUtil(runtimeTicks, periodTicks);
+    coreId = NX_SMP_GetIdx();
+    if (!NX_CpuMaskTest(thread->coreAffinity, coreId))
+    {
+        coreId = NX_CpuMaskFirst(thread->coreAffinity);
+    }
+
+    timer = NX_TimerCreate(period, DeadlineReplenish, thread, NX_TIMER_PERIOD);
+    if (timer == NX_NULL)
+    {
+        return NX_ENOMEM;
+    }
+
+    /* admission control */
+    NX_SpinLockIRQ(&DeadlineUtilLock, &level);
+    if (DeadlineUtilTable[coreId] + util > NX_SCHED_DEADLINE_UTIL * NX_DEADLINE_UTIL_SCALE / 100)
+    {
+        NX_SpinUnlockIRQ(&DeadlineUtilLock, level);
+        NX_TimerDestroy(timer);
+        return NX_ENORES;
+    }
+    DeadlineUtilTable[coreId] += util;
+    NX_SpinUnlockIRQ(&DeadlineUtilLock, level);
+
+    /* deadline thread never moves to other core */
+    NX_ThreadSetAffinity(thread, NX_CpuMaskOf(coreId));
+
+    dl = &thread->deadline;
+    dl->period = periodTicks;
+    dl->deadline = deadlineTicks;
+    dl->absDeadline = NX_ClockTickGet() + deadlineTicks;
+    dl->budget = runtimeTicks;
+    dl->throttled = NX_False;
+    dl->waiting = NX_False;
+    dl->util = util;
+    dl->released = 1;
+    dl->completed = 0;
+    dl->missCount = 0;
+    dl->timer = timer;
+    dl->runtime = runtimeTicks;
+
+    if (NX_TimerStart(timer) != NX_EOK)
+    {
+        NX_DeadlineRelease(thread);
+        return NX_EINVAL;
+    }
+
+    NX_LOG_D("thread %s/%d runtime:%d period:%d deadline:%d ticks on core#%d",
+        thread->name, thread->tid, runtimeTicks, periodTicks, deadlineTicks, coreId);
+    return NX_EOK;
+}
+
+/**
+ * Complete current job and sleep until next job released.
+ * Return at once if next job was released already.
+ */
+NX_PUBLIC NX_Error NX_ThreadDeadlineWait(void)
+{
+    NX_Thread *thread = NX_ThreadSelf();
+    NX_ThreadDeadline *dl = &thread->deadline;
+    NX_UArch level;
+
+    if (!NX_ThreadIsDeadline(thread))
+    {
+        return NX_EPERM;
+    }
+
+    NX_SpinLockIRQ(&thread->lock, &level);
+    dl->completed++;
+    if (dl->completed != dl->released)
+    {
+        NX_SpinUnlockIRQ(&thread->lock, level);
+        return NX_EOK;
+    }
+    dl->waiting = NX_True;
+    NX_ThreadBlockLockedIRQ(&thread->lock, level);
+    return NX_EOK;
+}
+
+NX_PUBLIC NX_Error NX_ThreadDeadlineStatGet(NX_Thread *thread, NX_ThreadDeadlineStat *stat)
+{
+    NX_ThreadDeadline *dl;
+    NX_UArch level;
+
+    if (thread == NX_NULL || stat == NX_NULL)
+    {
+        return NX_EINVAL;
+    }
+    if (!NX_ThreadIsDeadline(thread))
+    {
+        return NX_EPERM;
+    }
+
+    dl = &thread->deadline;
+    NX_SpinLockIRQ(&thread->lock, &level);
+    stat->runtime = dl->runtime;
+    stat->period = dl->period;
+    stat->deadline = dl->deadline;
+    stat->released = dl->released;
+    stat->completed = dl->completed;
+    stat->missCount = dl->missCount;
+    NX_SpinUnlockIRQ(&thread->lock, level);
+    return NX_EOK;
+}
+
+/**
+ * get utilization reserved on core, in NX_DEADLINE_UTIL_SCALE
+ */
+NX_PUBLIC NX_U32 NX_DeadlineUtilGet(NX_UArch coreId)
+{
+    if (coreId >= NX_MULTI_CORES_NR)
+    {
+        return 0;
+    }
+    return DeadlineUtilTable[coreId];
+}
+
+/**
+ * add thread to ready list in deadline order, must hold lock of list
+ */
+NX_PUBLIC void NX_DeadlineListAdd(NX_List *list, NX_Thread *thread)
+{
+    NX_Thread *next;
+
+    NX_ListForEachEntry(next, list, list)
+    {
+        if (DeadlineBefore(thread->deadline.absDeadline, next->deadline.absDeadline))
+        {
+            NX_ListAddBefore(&thread->list, &next->list);
+            return;
+        }
+    }
+    NX_ListAddTail(&thread->list, list);
+}
+
+/**
+ * whether thread should preempt running thread, deadline thread preempts
+ * non deadline thread, or deadline thread with later deadline.
+ */
+NX_PUBLIC NX_Bool NX_DeadlinePreempt(NX_Thread *running, NX_Thread *thread)
+{
+    if (!NX_ThreadIsDeadline(thread))
+    {
+        return NX_False;
+    }
+    if (!NX_ThreadIsDeadline(running))
+    {
+        return NX_True;
+    }
+    return DeadlineBefore(thread->deadline.absDeadline, running->deadline.absDeadline);
+}
+
+/**
+ * charge running thread a tick, mark sched if budget used up
+ */
+NX_PUBLIC void NX_DeadlineTick(NX_Thread *thread)
+{
+    NX_ThreadDeadline *dl = &thread->deadline;
+
+    if (!NX_ThreadIsDeadline(thread))
+    {
+        return;
+    }
+
+    NX_SpinLock(&thread->lock, NX_True);
+    if (!dl->throttled)
+    {
+        if (dl->budget > 0)
+        {
+            dl->budget--;
+        }
+        if (dl->budget == 0)
+        {
+            dl->throttled = NX_True;
+            thread->needSched = 1;
+        }
+    }
+    NX_SpinUnlock(&thread->lock);
+}
+
+/**
+ * Sleep until next period if budget used up, called when running thread
+ * is preempted with interrupt disabled. Return true if thread had slept.
+ */
+NX_PUBLIC NX_Bool NX_DeadlineThrottle(NX_Thread *thread, NX_UArch irqLevel)
+{
+    if (!NX_ThreadIsDeadline(thread))
+    {
+        return NX_False;
+    }
+
+    NX_SpinLock(&thread->lock, NX_True);
+    if (!thread->deadline.throttled)
+    {
+        NX_SpinUnlock(&thread->lock);
+        return NX_False;
+    }
+    thread->deadline.waiting = NX_True;
+    NX_ThreadBlockLockedIRQ(&thread->lock, irqLevel);
+    return NX_True;
+}
+
+/**
+ * stop replenish and release utilization, thread is normal thread after
+ */
+NX_PUBLIC void NX_DeadlineRelease(NX_Thread *thread)
+{
+    NX_ThreadDeadline *dl = &thread->deadline;
+    NX_UArch level;
+
+    if (!NX_ThreadIsDeadline(thread))
+    {
+        return;
+    }
+
+    NX_TimerStop(dl->timer);
+    NX_TimerDestroy(dl->timer);
+    dl->timer = NX_NULL;
+
+    NX_SpinLockIRQ(&DeadlineUtilLock, &level);
+    DeadlineUtilTable[NX_CpuMaskFirst(thread->coreAffinity)] -= dl->util;
+    NX_SpinUnlockIRQ(&DeadlineUtilLock, level);
+
+    NX_SpinLockIRQ(&thread->lock, &level);
+    dl->runtime = 0;
+    NX_SpinUnlockIRQ(&thread->lock, level);
+}
@@ -0,0 +1,311 @@
+/**
+ * Copyright (c) 2018-2022, BookOS Development Team
+ * SPDX-License-Identifier: Apache-2.0
+ * 
+ * Contains: Fair share sched class
+ */
+
+#include <sched/fair.h>
+#include <sched/thread.h>
+#include <sched/smp.h>
+#include <mods/time/clock.h>
+#include <io/irq.h>
+
+/* runtime of a tick, vruntime is charged each tick */
+#define FAIR_TICK_NS (1000000000 / NX_TICKS_PER_SECOND)
+
+#define FAIR_LATENCY_NS ((NX_U64)NX_SCHED_FAIR_LATENCY * 1000000)
+#define FAIR_GRANULARITY_NS ((NX_U64)NX_SCHED_FAIR_GRANULARITY * 1000000)
+
+/**
+ * weight of nice -20 ~ 19, each nice step is about 10% cpu
+ */
+NX_PRIVATE const NX_U32 FairNiceToWeight[40] =
+{
+    /* -20 */ 88761, 71755, 56483, 46273, 36291,
+    /* -15 */ 29154, 23254, 18705, 14949, 11916,
+    /* -10 */ 9548, 7620, 6100, 4904, 3906,
+    /*  -5 */ 3121, 2501, 1991, 1586, 1277,
+    /*   0 */ 1024, 820, 655, 526, 423,
+    /*   5 */ 335, 272, 215, 172, 137,
+    /*  10 */ 110, 87, 70, 56, 45,
+    /*  15 */ 36, 29, 23, 18, 15,
+};
+
+/**
+ * 2^32 / weight, so vruntime is charged without division
+ */
+NX_PRIVATE const NX_U32 FairNiceToInvWeight[40] =
+{
+    /* -20 */ 48388, 59856, 76040, 92818, 118348,
+    /* -15 */ 147320, 184698, 229616, 287308, 360437,
+    /* -10 */ 449829, 563644, 704093, 875809, 1099582,
+    /*  -5 */ 1376151, 1717300, 2157191, 2708050, 3363326,
+    /*   0 */ 4194304, 5237765, 6557202, 8165337, 10153587,
+    /*   5 */ 12820798, 15790321, 19976592, 24970740, 31350126,
+    /*  10 */ 39045157, 49367440, 61356676, 76695844, 95443717,
+    /*  15 */ 119304647, 148102320, 186737708, 238609294, 286331153,
+};
+
+/**
+ * compare with vruntime wrap
+ */
+NX_INLINE NX_Bool FairBefore(NX_U64 a, NX_U64 b)
+{
+    return (NX_I64)(a - b) < 0 ? NX_True : NX_False;
+}
+
+NX_INLINE NX_UArch FairTicks(NX_UArch milliseconds)
+{
+    NX_UArch ticks = NX_MILLISECOND_TO_TICKS(milliseconds);
+    return ticks ? ticks : 1;
+}
+
+NX_PRIVATE void FairUpdateMin(NX_FairQueue *queue, NX_U64 vruntime)
+{
+    NX_Thread *first = NX_RbEntryOrNULL(queue->leftmost, NX_Thread, fair.node);
+
+    if (first != NX_NULL && FairBefore(first->fair.vruntime, vruntime))
+    {
+        vruntime = first->fair.vruntime;
+    }
+    if (FairBefore(queue->minVruntime, vruntime))
+    {
+        queue->minVruntime = vruntime;
+    }
+}
+
+NX_PRIVATE void FairErase(NX_FairQueue *queue, NX_Thread *thread)
+{
+    if (queue->leftmost == &thread->fair.node)
+    {
+        queue->leftmost = NX_RbNext(queue->leftmost);
+    }
+    NX_RbErase(&thread->fair.node, &queue->tree);
+    queue->load -= thread->fair.weight;
+    queue->count--;
+    thread->fair.queued = NX_False;
+}
+
+NX_PUBLIC void NX_FairThreadInit(NX_Thread *thread)
+{
+    thread->fair.vruntime = 0;
+    thread->fair.nice = 0;
+    thread->fair.weight = FairNiceToWeight[0 - NX_NICE_MIN];
+    thread->fair.invWeight = FairNiceToInvWeight[0 - NX_NICE_MIN];
+    thread->fair.queued = NX_False;
+    thread->fair.relative = NX_True;    /* start from min vruntime of core */
+}
+
+NX_PUBLIC void NX_FairQueueInit(NX_FairQueue *queue)
+{
+    NX_RbRootInit(&queue->tree);
+    queue->leftmost = NX_NULL;
+    queue->minVruntime = 0;
+    queue->load = 0;
+    queue->count = 0;
+}
+
+/**
+ * Thread from other core starts from min vruntime. Sleeper keeps its
+ * vruntime as credit, but at most half latency before min vruntime,
+ * so it runs soon after woken but can't starve others.
+ */
+NX_PUBLIC void NX_FairEnqueue(NX_FairQueue *queue, NX_Thread *thread)
+{
+    NX_ThreadFair *fair = &thread->fair;
+    NX_RbNode **link = &queue->tree.node;
+    NX_RbNode *parent = NX_NULL;
+    NX_Bool leftmost = NX_True;
+    NX_Thread *entry;
+    NX_U64 floor;
+
+    if (fair->relative)
+    {
+        fair->vruntime += queue->minVruntime;
+        fair->relative = NX_False;
+    }
+    else
+    {
+        floor = queue->minVruntime - FAIR_LATENCY_NS / 2;
+        if (FairBefore(fair->vruntime, floor))
+        {
+            fair->vruntime = floor;
+        }
+    }
+
+    /* same vruntime goes right, keep fifo order */
+    while (*link != NX_NULL)
+    {
+        parent = *link;
+        entry = NX_RbEntry(parent, NX_Thread, fair.node);
+        if (FairBefore(fair->vruntime, entry->fair.vruntime))
+        {
+            link = &parent->left;
+        }
+        else
+        {
+            link = &parent->right;
+            leftmost = NX_False;
+        }
+    }
+    NX_RbLinkNode(&fair->node, parent, link);
+    NX_RbInsertColor(&fair->node, &queue->tree);
+    if (leftmost)
+    {
+        queue->leftmost = &fair->node;
+    }
+
+    queue->load += fair->weight;
+    queue->count++;
+    fair->queued = NX_True;
+}
+
+/**
+ * Take thread with min vruntime allowed on core to run, its slice is share of
+ * latency by weight, latency stretches when threads are too many for granularity.
+ */
+NX_PUBLIC NX_Thread *NX_FairDequeue(NX_FairQueue *queue, NX_UArch coreId)
+{
+    NX_Thread *thread = NX_NULL;
+    NX_RbNode *node;
+    NX_UArch granularity = FairTicks(NX_SCHED_FAIR_GRANULARITY);
+    NX_UArch period = FairTicks(NX_SCHED_FAIR_LATENCY);
+    NX_UArch slice;
+
+    for (node = queue->leftmost; node != NX_NULL; node = NX_RbNext(node))
+    {
+        thread = NX_RbEntry(node, NX_Thread, fair.node);
+        if (NX_CpuMaskTest(thread->coreAffinity, coreId))
+        {
+            break;
+        }
+    }
+    if (node == NX_NULL)
+    {
+        return NX_NULL;
+    }
+
+    if (queue->count * granularity > period)
+    {
+        period = queue->count * granularity;
+    }
+    slice = period * thread->fair.weight / queue->load;
+    thread->ticks = slice > granularity ? slice : granularity;
+
+    FairErase(queue, thread);
+    FairUpdateMin(queue, thread->fair.vruntime);
+    return thread;
+}
+
+/**
+ * remove thread to move to other core, vruntime is relative after
+ */
+NX_PUBLIC void NX_FairRemove(NX_FairQueue *queue, NX_Thread *thread)
+{
+    FairErase(queue, thread);
+    thread->fair.vruntime -= queue->minVruntime;
+    thread->fair.relative = NX_True;
+}
+
+/**
+ * Thread not queued leaves core, like woken onto other core, vruntime is
+ * made relative to min vruntime of the core it left.
+ */
+NX_PUBLIC void NX_FairMigrate(NX_UArch coreId, NX_Thread *thread)
+{
+    NX_Cpu *cpu = NX_CpuGetIndex(coreId);
+
+    NX_SpinLock(&cpu->lock, NX_True);
+    if (!thread->fair.relative)
+    {
+        thread->fair.vruntime -= cpu->fairQueue.minVruntime;
+        thread->fair.relative = NX_True;
+    }
+    NX_SpinUnlock(&cpu->lock);
+}
+
+/**
+ * Charge running thread a tick, preempt it if it runs ahead of the
+ * leftmost thread over granularity.
+ */
+NX_PUBLIC void NX_FairTick(NX_Thread *thread)
+{
+    NX_Cpu *cpu = NX_CpuGetPtr();
+    NX_FairQueue *queue = &cpu->fairQueue;
+    NX_ThreadFair *fair = &thread->fair;
+    NX_Thread *first;
+
+    if (NX_ThreadIsDeadline(thread))
+    {
+        return;
+    }
+
+    NX_SpinLock(&cpu->lock, NX_True);
+    fair->vruntime += ((NX_U64)FAIR_TICK_NS * fair->invWeight) >> (32 - NX_NICE_0_WEIGHT_SHIFT);
+    FairUpdateMin(queue, fair->vruntime);
+
+    first = NX_RbEntryOrNULL(queue->leftmost, NX_Thread, fair.node);
+    if (first != NX_NULL && FairBefore(first->fair.vruntime + FAIR_GRANULARITY_NS, fair->vruntime))
+    {
+        thread->needSched = 1;
+    }
+    NX_SpinUnlock(&cpu->lock);
+}
+
+/**
+ * Whether thread woken onto queue should preempt running thread, it must be
+ * behind over granularity as tick does, so wakeups don't switch too often.
+ * Lock of core must be held, vruntime of thread is not relative after enqueue.
+ */
+NX_PUBLIC NX_Bool NX_FairPreempt(NX_Thread *running, NX_Thread *thread)
+{
+    return FairBefore(thread->fair.vruntime + FAIR_GRANULARITY_NS, running->fair.vruntime);
+}
+
+/**
+ * Set nice of thread in [NX_NICE_MIN, NX_NICE_MAX], lower nice gets more cpu.
+ * Only used by fair sched.
+ */
+NX_PUBLIC NX_Error NX_ThreadSetNice(NX_Thread *thread, int nice)
+{
+    NX_Cpu *cpu = NX_NULL;
+    NX_U32 weight;
+    NX_UArch level;
+
+    if (thread == NX_NULL || nice < NX_NICE_MIN || nice > NX_NICE_MAX)
+    {
+        return NX_EINVAL;
+    }
+
+    weight = FairNiceToWeight[nice - NX_NICE_MIN];
+
+    level = NX_IRQ_SaveLevel();
+    if (thread->onCore < NX_MULTI_CORES_NR)
+    {
+        cpu = NX_CpuGetIndex(thread->onCore);
+        NX_SpinLock(&cpu->lock, NX_True);
+    }
+    if (thread->fair.queued && cpu != NX_NULL)
+    {
+        cpu->fairQueue.load = cpu->fairQueue.load - thread->fair.weight + weight;
+    }
+    thread->fair.nice = nice;
+    thread->fair.weight = weight;
+    thread->fair.invWeight = FairNiceToInvWeight[nice - NX_NICE_MIN];
+    if (cpu != NX_NULL)
+    {
+        NX_SpinUnlock(&cpu->lock);
+    }
+    NX_IRQ_RestoreLevel(level);
+    return NX_EOK;
+}
+
+NX_PUBLIC int NX_ThreadGetNice(NX_Thread *thread)
+{
+    if (thread == NX_NULL)
+    {
+        return 0;
+    }
+    return thread->fair.nice;
+}
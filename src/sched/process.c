@@ -12,6 +12,7 @@
 #include <sched/process.h>
 #include <sched/thread.h>
 #include <mm/alloc.h>
+#include <mm/vma.h>
 #include <xbook/debug.h>
 #include <utils/memory.h>
 #include <utils/log.h>
@@ -51,11 +52,15 @@ NX_PUBLIC NX_Process *NX_ProcessCreate(NX_U32 flags)
     }
     
     process->flags = flags;
+    process->asid = 0;
+    NX_AtomicSet(&process->cpuMask, 0);
 
     NX_AtomicSet(&process->threadCount, 0);
     NX_ListInit(&process->threadPoolListHead);
+    NX_ListInit(&process->vmaListHead);
 
     NX_SpinInit(&process->lock);
+    NX_SpinInit(&process->pageTableLock);
 
     return process;
 }
@@ -68,12 +73,39 @@ NX_PUBLIC NX_Error NX_ProcessDestroy(NX_Process *process)
     }
     
     NX_ASSERT(process->pageTable != NX_NULL);
+    NX_VmaUnmapAll(process);
     NX_MemFree(process->pageTable);
 
     NX_MemFree(process);
     return NX_EOK;
 }
 
+/**
+ * Create a process with user space of process, pages are shared with copy on write,
+ * so only page tables are copied.
+ */
+NX_PUBLIC NX_Process *NX_ProcessDuplicate(NX_Process *process)
+{
+    if (process == NX_NULL)
+    {
+        return NX_NULL;
+    }
+
+    NX_Process *newProcess = NX_ProcessCreate(process->flags);
+    if (newProcess == NX_NULL)
+    {
+        return NX_NULL;
+    }
+
+    if (NX_VmaCopy(newProcess, process) != NX_EOK ||
+        NX_ProcessCopyUserSpace(newProcess, process) != NX_EOK)
+    {
+        NX_ProcessDestroy(newProcess);
+        return NX_NULL;
+    }
+    return newProcess;
+}
+
 NX_PRIVATE void ProcessThreadEntry(void *arg)
 {
     NX_Thread *thread = NX_ThreadSelf();
@@ -19,6 +19,7 @@
 #include <sched/smp.h>
 #include <sched/context.h>
 #include <sched/process.h>
+#include <utils/trace.h>
 
 NX_IMPORT NX_ThreadManager NX_ThreadManagerObject;
 NX_IMPORT NX_Atomic NX_ActivedCoreCount;
@@ -38,7 +39,7 @@ NX_INLINE void SchedSwithProcess(NX_Thread *thread)
     }
 
     NX_ASSERT(pageTable != NX_NULL);
-    NX_ASSERT(NX_ProcessSwitchPageTable(pageTable) == NX_EOK);
+    NX_ASSERT(NX_ProcessSwitchPageTable(pageTable, process) == NX_EOK);
 }
 
 NX_INLINE void SchedToNext(NX_Thread *next)
@@ -82,10 +83,21 @@ NX_PRIVATE void PullOrPushThread(NX_UArch coreId)
     NX_LOG_D("core#%d: pending threads:%d", coreId, NX_AtomicGet(&NX_ThreadManagerObject.pendingThreadCount));
     NX_LOG_D("core#%d: threads per core:%d", coreId, threadsPerCore);
 
+    /* move out thread not allowed here after its affinity changed */
+    thread = NX_SMP_DeququeDisallowedThread(coreId);
+    if (thread != NX_NULL)
+    {
+        thread->onCore = NX_SMP_SelectCore(thread->coreAffinity);
+        NX_LOG_D("---> core#%d: move thread:%s/%d to core#%d", coreId, thread->name, thread->tid, thread->onCore);
+        NX_ThreadReadyRunLocked(thread, NX_SCHED_TAIL);
+        NX_SMP_Reschedule(thread->onCore);
+        coreThreadCount--;
+    }
+
     if (coreThreadCount < threadsPerCore)
     {
         /* pull from pending */
-        thread = NX_ThreadDequeuePendingList();
+        thread = NX_ThreadDequeuePendingList(coreId);
         if (thread != NX_NULL)
         {
             NX_LOG_D("---> core#%d: pull thread:%s/%d", coreId, thread->name, thread->tid);
@@ -130,6 +142,8 @@ NX_PUBLIC void NX_SchedWithInterruptDisabled(NX_UArch irqLevel)
     next = NX_SMP_DeququeThreadIrqDisabled(coreId);
     NX_SMP_SetRunning(coreId, next);
 
+    NX_TRACE(NX_TRACE_SCHED_SWITCH, prev != NX_NULL ? prev->tid : -1, next->tid, 0);
+
     if (prev != NX_NULL)
     {
         NX_ASSERT(prev && next);
@@ -167,11 +181,40 @@ NX_PUBLIC void NX_SchedExit(void)
     NX_SchedWithInterruptDisabled(level);
 }
 
+/**
+ * put running thread to ready list and sched, interrupt must be disabled
+ */
+NX_PRIVATE void SchedPreempt(NX_Thread *thread, NX_UArch level)
+{
+    thread->needSched = 0;
+
+    /* reset ticks from timeslice */
+    thread->ticks = thread->timeslice;
+
+    /* deadline thread used up budget sleeps until next period */
+    if (NX_DeadlineThrottle(thread, level))
+    {
+        return;
+    }
+
+    NX_ThreadReadyRunUnlocked(thread, NX_SCHED_TAIL);
+
+    NX_SchedWithInterruptDisabled(level);
+}
+
 NX_PUBLIC void NX_ReSchedCheck(void)
 {
     NX_IRQ_Enable();
 
     NX_Thread *thread = NX_CurrentThread;
+
+    /* thread holds spin lock, sched at outermost unlock */
+    if (thread->preemptCount > 0)
+    {
+        NX_IRQ_Disable();
+        return;
+    }
+
     if (thread->isTerminated)
     {
         NX_LOG_D("call terminate: %d", thread->tid);
@@ -180,15 +223,45 @@ NX_PUBLIC void NX_ReSchedCheck(void)
     }
     if (thread->needSched)
     {
-        NX_UArch level = NX_IRQ_SaveLevel();
-        thread->needSched = 0;
+        SchedPreempt(thread, NX_IRQ_SaveLevel());
+    }
+    NX_IRQ_Disable();
+}
 
-        /* reset ticks from timeslice */
-        thread->ticks = thread->timeslice;
+/**
+ * Preempt count is on running thread, so it moves with thread when sched.
+ * Running thread is read with interrupt disabled, so thread won't move to other core.
+ * Count not works before the first thread run on core.
+ */
+NX_PUBLIC void NX_PreemptDisable(void)
+{
+    NX_UArch level = NX_IRQ_SaveLevel();
+    NX_Thread *thread = NX_SMP_GetRunningIrqDisabled();
+    if (thread != NX_NULL)
+    {
+        thread->preemptCount++;
+    }
+    NX_IRQ_RestoreLevel(level);
+}
 
-        NX_ThreadReadyRunUnlocked(thread, NX_SCHED_TAIL);
+/**
+ * Sched if count down to zero and thread was marked need sched,
+ * but not in irq or interrupt disabled, NX_ReSchedCheck will do it then.
+ */
+NX_PUBLIC void NX_PreemptEnable(void)
+{
+    NX_Bool enabled = NX_IRQ_IsEnabled();
+    NX_UArch level = NX_IRQ_SaveLevel();
+    NX_Thread *thread = NX_SMP_GetRunningIrqDisabled();
 
-        NX_SchedWithInterruptDisabled(level);
+    if (thread != NX_NULL && thread->preemptCount > 0)
+    {
+        thread->preemptCount--;
+        if (thread->preemptCount == 0 && thread->needSched && enabled)
+        {
+            SchedPreempt(thread, level);
+            return;
+        }
     }
-    NX_IRQ_Disable();
+    NX_IRQ_RestoreLevel(level);
 }
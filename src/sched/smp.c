@@ -12,6 +12,9 @@
 #include <sched/smp.h>
 #include <sched/thread.h>
 #include <sched/sched.h>
+#include <utils/trace.h>
+#include <utils/memory.h>
+#include <io/irq.h>
 #define NX_LOG_NAME "Core"
 #include <utils/log.h>
 
@@ -26,6 +29,35 @@ NX_PRIVATE NX_VOLATILE NX_UArch BootCoreId = 0;
 
 NX_PRIVATE NX_Cpu CpuArray[NX_MULTI_CORES_NR];
 
+/* cores can handle ipi */
+NX_PRIVATE NX_STATIC_ATOMIC_INIT(CoreOnlineMask, 0);
+
+/* reasons of ipi pending on core */
+#define SMP_IPI_RESCHED 0x01
+#define SMP_IPI_CALL    0x02
+
+/* caller handles its own queue when queue of target is full */
+#define SMP_CALL_QUEUE_MAX 8
+
+struct SMP_CallRequest
+{
+    NX_SMP_CallHandler handler;
+    void *arg;
+    NX_Atomic *done;    /* decreased after handled, null if caller not wait */
+};
+typedef struct SMP_CallRequest SMP_CallRequest;
+
+struct SMP_IpiQueue
+{
+    NX_Spin lock;
+    NX_U32 count;
+    SMP_CallRequest requests[SMP_CALL_QUEUE_MAX];
+    NX_Atomic pending;  /* SMP_IPI_* */
+};
+typedef struct SMP_IpiQueue SMP_IpiQueue;
+
+NX_PRIVATE SMP_IpiQueue IpiQueueArray[NX_MULTI_CORES_NR];
+
 NX_PUBLIC void NX_SMP_Preload(NX_UArch coreId)
 {
     /* recored boot core */
@@ -48,9 +80,16 @@ NX_PUBLIC void NX_SMP_Init(NX_UArch coreId)
     {
         CpuArray[i].threadRunning = NX_NULL;
         NX_ListInit(&CpuArray[i].threadReadyList);
+        NX_ListInit(&CpuArray[i].deadlineReadyList);
+        NX_FairQueueInit(&CpuArray[i].fairQueue);
         NX_SpinInit(&CpuArray[i].lock);
         NX_AtomicSet(&CpuArray[i].threadCount, 0);
+
+        NX_SpinInit(&IpiQueueArray[i].lock);
+        IpiQueueArray[i].count = 0;
+        NX_AtomicSet(&IpiQueueArray[i].pending, 0);
     }
+    NX_AtomicSetMask(&CoreOnlineMask, 1UL << coreId);
 }
 
 /**
@@ -85,6 +124,7 @@ NX_PUBLIC void NX_SMP_Stage2(NX_UArch appCoreId)
     }
     else
     {
+        NX_AtomicSetMask(&CoreOnlineMask, 1UL << appCoreId);
         if (HAL_InitClock() != NX_EOK)
         {
             NX_LOG_E("app core: %d init clock failed!", appCoreId);
@@ -102,7 +142,19 @@ NX_PUBLIC void NX_SMP_EnqueueThreadIrqDisabled(NX_UArch coreId, NX_Thread *threa
 
     NX_SpinLock(&cpu->lock, NX_True);
 
-    if (flags & NX_SCHED_HEAD)
+    if (NX_ThreadIsDeadline(thread))
+    {
+        /* earliest deadline first, flags not used */
+        NX_DeadlineListAdd(&cpu->deadlineReadyList, thread);
+    }
+#ifdef CONFIG_NX_SCHED_FAIR
+    else
+    {
+        /* ordered by vruntime, flags not used */
+        NX_FairEnqueue(&cpu->fairQueue, thread);
+    }
+#else
+    else if (flags & NX_SCHED_HEAD)
     {
         NX_ListAdd(&thread->list, &cpu->threadReadyList);
     }
@@ -110,10 +162,13 @@ NX_PUBLIC void NX_SMP_EnqueueThreadIrqDisabled(NX_UArch coreId, NX_Thread *threa
     {
         NX_ListAddTail(&thread->list, &cpu->threadReadyList);
     }
+#endif
 
     NX_AtomicInc(&cpu->threadCount);
 
     NX_SpinUnlock(&cpu->lock);
+
+    NX_TRACE(NX_TRACE_SCHED_ENQUEUE, thread->tid, coreId, flags);
 }
 
 NX_PUBLIC NX_Thread *NX_SMP_DeququeThreadIrqDisabled(NX_UArch coreId)
@@ -123,29 +178,77 @@ NX_PUBLIC NX_Thread *NX_SMP_DeququeThreadIrqDisabled(NX_UArch coreId)
     
     NX_SpinLock(&cpu->lock, NX_True);
     
-    thread = NX_ListFirstEntry(&cpu->threadReadyList, NX_Thread, list);
-    NX_ListDel(&thread->list);
+    thread = NX_ListFirstEntryOrNULL(&cpu->deadlineReadyList, NX_Thread, list);
+    if (thread != NX_NULL)
+    {
+        NX_ListDel(&thread->list);
+    }
+    else
+    {
+#ifdef CONFIG_NX_SCHED_FAIR
+        thread = NX_FairDequeue(&cpu->fairQueue, coreId);
+#else
+        /* skip thread not allowed here, which is moved out later */
+        NX_ListForEachEntry(thread, &cpu->threadReadyList, list)
+        {
+            if (NX_CpuMaskTest(thread->coreAffinity, coreId))
+            {
+                break;
+            }
+        }
+        NX_ASSERT(&thread->list != &cpu->threadReadyList);
+        NX_ListDel(&thread->list);
+#endif
+    }
 
     NX_AtomicDec(&cpu->threadCount);
 
     NX_SpinUnlock(&cpu->lock);
 
+    NX_TRACE(NX_TRACE_SCHED_DEQUEUE, thread->tid, coreId, 0);
     return thread;
 }
 
 /**
- * NOTE: this must called irq disabled
+ * Thread can move if allowed on other cores. Running thread of core was put
+ * back to queue before switched away, so never moved.
  */
-NX_PUBLIC NX_Thread *NX_SMP_DeququeNoAffinityThread(NX_UArch coreId)
+NX_INLINE NX_Bool SMP_ThreadMovable(NX_Cpu *cpu, NX_Thread *thread, NX_UArch coreId, NX_Bool disallowedOnly)
+{
+    if (thread == cpu->threadRunning || !(thread->coreAffinity & ~NX_CpuMaskOf(coreId)))
+    {
+        return NX_False;
+    }
+    return !disallowedOnly || !NX_CpuMaskTest(thread->coreAffinity, coreId);
+}
+
+NX_PRIVATE NX_Thread *SMP_DequeueMovableThread(NX_UArch coreId, NX_Bool disallowedOnly)
 {
     NX_Thread *thread, *findThread = NX_NULL;
     NX_Cpu *cpu = NX_CpuGetIndex(coreId);
+#ifdef CONFIG_NX_SCHED_FAIR
+    NX_RbNode *node;
+#endif
     
     NX_SpinLock(&cpu->lock, NX_True);
     
+#ifdef CONFIG_NX_SCHED_FAIR
+    /* take the one with max vruntime, it has least to lose by moving */
+    for (node = NX_RbLast(&cpu->fairQueue.tree); node != NX_NULL; node = NX_RbPrev(node))
+    {
+        thread = NX_RbEntry(node, NX_Thread, fair.node);
+        if (SMP_ThreadMovable(cpu, thread, coreId, disallowedOnly))
+        {
+            findThread = thread;
+            NX_FairRemove(&cpu->fairQueue, thread);
+            NX_AtomicDec(&cpu->threadCount);
+            break;
+        }
+    }
+#else
     NX_ListForEachEntry(thread, &cpu->threadReadyList, list)
     {
-        if (thread->coreAffinity >= NX_MULTI_CORES_NR) /* no affinity on any core */
+        if (SMP_ThreadMovable(cpu, thread, coreId, disallowedOnly))
         {
             findThread = thread;
             NX_ListDel(&thread->list);
@@ -153,12 +256,61 @@ NX_PUBLIC NX_Thread *NX_SMP_DeququeNoAffinityThread(NX_UArch coreId)
             break;
         }
     }
+#endif
     
     NX_SpinUnlock(&cpu->lock);
 
     return findThread;
 }
 
+/**
+ * dequeue thread allowed on other cores to balance, must called irq disabled
+ */
+NX_PUBLIC NX_Thread *NX_SMP_DeququeNoAffinityThread(NX_UArch coreId)
+{
+    return SMP_DequeueMovableThread(coreId, NX_False);
+}
+
+/**
+ * dequeue thread not allowed on core after affinity changed, must called irq disabled
+ */
+NX_PUBLIC NX_Thread *NX_SMP_DeququeDisallowedThread(NX_UArch coreId)
+{
+    return SMP_DequeueMovableThread(coreId, NX_True);
+}
+
+/**
+ * select online core in mask with least ready threads
+ */
+NX_PUBLIC NX_UArch NX_SMP_SelectCore(NX_CpuMask mask)
+{
+    NX_UArch coreId;
+    NX_UArch selected = NX_MULTI_CORES_NR;
+    NX_IArch count, minCount = 0;
+    NX_CpuMask online = mask & NX_AtomicGet(&CoreOnlineMask);
+
+    if (online == 0)
+    {
+        /* not online yet, queue on it until core up */
+        return NX_CpuMaskFirst(mask);
+    }
+
+    for (coreId = 0; coreId < NX_MULTI_CORES_NR; coreId++)
+    {
+        if (!NX_CpuMaskTest(online, coreId))
+        {
+            continue;
+        }
+        count = NX_AtomicGet(&CpuArray[coreId].threadCount);
+        if (selected == NX_MULTI_CORES_NR || count < minCount)
+        {
+            selected = coreId;
+            minCount = count;
+        }
+    }
+    return selected;
+}
+
 NX_PUBLIC NX_Error NX_SMP_SetRunning(NX_UArch coreId, NX_Thread *thread)
 {
     if (coreId >= NX_MULTI_CORES_NR || thread == NX_NULL)
@@ -166,12 +318,13 @@ NX_PUBLIC NX_Error NX_SMP_SetRunning(NX_UArch coreId, NX_Thread *thread)
         return NX_EINVAL;
     }
 
+    /**
+     * only set by the core itself with interrupt disabled, not use spin lock,
+     * or lock and unlock would count preempt on different threads.
+     */
     NX_Cpu *cpu = NX_CpuGetIndex(coreId);
-    NX_UArch level;
-    NX_SpinLockIRQ(&cpu->lock, &level);
     thread->state = NX_THREAD_RUNNING;
     cpu->threadRunning = thread;
-    NX_SpinUnlockIRQ(&cpu->lock, level);
     return NX_EOK;
 }
 
@@ -188,3 +341,250 @@ NX_PUBLIC NX_Thread *NX_SMP_GetRunning(void)
     NX_SpinUnlockIRQ(&cpu->lock, level);
     return thread;
 }
+
+/**
+ * get running thread without lock, interrupt must be disabled.
+ * return null before core index works (trap of riscv not set).
+ */
+NX_PUBLIC NX_Thread *NX_SMP_GetRunningIrqDisabled(void)
+{
+    if (NX_AtomicGet(&CoreOnlineMask) == 0)
+    {
+        return NX_NULL;
+    }
+    return CpuArray[NX_SMP_GetIdx()].threadRunning;
+}
+
+/**
+ * Run call requests queued on this core, interrupt must be disabled
+ */
+NX_PRIVATE void SMP_CallRun(SMP_IpiQueue *queue)
+{
+    SMP_CallRequest requests[SMP_CALL_QUEUE_MAX];
+    NX_U32 count;
+    NX_U32 i;
+
+    NX_SpinLock(&queue->lock, NX_True);
+    count = queue->count;
+    NX_MemCopy(requests, queue->requests, sizeof(SMP_CallRequest) * count);
+    queue->count = 0;
+    NX_SpinUnlock(&queue->lock);
+
+    for (i = 0; i < count; i++)
+    {
+        requests[i].handler(requests[i].arg);
+        if (requests[i].done != NX_NULL)
+        {
+            NX_AtomicDec(requests[i].done);
+        }
+    }
+}
+
+NX_PRIVATE void SMP_CallEnqueue(NX_UArch coreId, NX_SMP_CallHandler handler, void *arg, NX_Atomic *done)
+{
+    SMP_IpiQueue *queue = &IpiQueueArray[coreId];
+
+    while (1)
+    {
+        NX_SpinLock(&queue->lock, NX_True);
+        if (queue->count < SMP_CALL_QUEUE_MAX)
+        {
+            queue->requests[queue->count].handler = handler;
+            queue->requests[queue->count].arg = arg;
+            queue->requests[queue->count].done = done;
+            queue->count++;
+            NX_AtomicSetMask(&queue->pending, SMP_IPI_CALL);
+            NX_SpinUnlock(&queue->lock);
+            return;
+        }
+        NX_SpinUnlock(&queue->lock);
+
+        /* target may wait for us with interrupt disabled */
+        SMP_CallRun(&IpiQueueArray[NX_SMP_GetIdx()]);
+    }
+}
+
+/**
+ * Take back request not run yet after ipi failed, return whether found
+ */
+NX_PRIVATE NX_Bool SMP_CallCancel(NX_UArch coreId, NX_SMP_CallHandler handler, void *arg, NX_Atomic *done)
+{
+    SMP_IpiQueue *queue = &IpiQueueArray[coreId];
+    NX_Bool found = NX_False;
+    NX_U32 i;
+
+    NX_SpinLock(&queue->lock, NX_True);
+    for (i = queue->count; i > 0; i--)
+    {
+        if (queue->requests[i - 1].handler == handler && queue->requests[i - 1].arg == arg &&
+            queue->requests[i - 1].done == done)
+        {
+            NX_MemMove(&queue->requests[i - 1], &queue->requests[i],
+                       sizeof(SMP_CallRequest) * (queue->count - i));
+            queue->count--;
+            found = NX_True;
+            break;
+        }
+    }
+    NX_SpinUnlock(&queue->lock);
+    return found;
+}
+
+/**
+ * Call handler on each online core in mask, in interrupt context of
+ * remote cores. If wait, return after all of them done.
+ * Return NX_ENOFUNC without ipi, handler not called on any core then.
+ */
+NX_PUBLIC NX_Error NX_SMP_CallFunction(NX_CpuMask cpuMask, NX_SMP_CallHandler handler, void *arg, NX_Bool wait)
+{
+    NX_Atomic done;
+    NX_UArch ipiMask = 0;
+    NX_UArch coreId;
+    NX_UArch self;
+    NX_UArch level;
+    NX_Error err = NX_EOK;
+
+    if (handler == NX_NULL)
+    {
+        return NX_EINVAL;
+    }
+
+    level = NX_IRQ_SaveLevel();
+    self = NX_SMP_GetIdx();
+    cpuMask &= NX_AtomicGet(&CoreOnlineMask);
+    if ((cpuMask & ~NX_CpuMaskOf(self)) != 0 && NX_SMP_SendIpi == NX_NULL)
+    {
+        NX_IRQ_RestoreLevel(level);
+        return NX_ENOFUNC;
+    }
+    NX_AtomicSet(&done, 0);
+
+    for (coreId = 0; coreId < NX_MULTI_CORES_NR; coreId++)
+    {
+        if (coreId != self && (cpuMask & (1UL << coreId)))
+        {
+            if (wait)
+            {
+                NX_AtomicInc(&done);
+            }
+            SMP_CallEnqueue(coreId, handler, arg, wait ? &done : NX_NULL);
+            ipiMask |= 1UL << coreId;
+        }
+    }
+
+    if (ipiMask != 0)
+    {
+        err = NX_SMP_SendIpi(ipiMask);
+    }
+    if (err != NX_EOK)
+    {
+        /* requests left point to done on stack, those taken are waited */
+        for (coreId = 0; coreId < NX_MULTI_CORES_NR; coreId++)
+        {
+            if ((ipiMask & (1UL << coreId)) && SMP_CallCancel(coreId, handler, arg, wait ? &done : NX_NULL) && wait)
+            {
+                NX_AtomicDec(&done);
+            }
+        }
+    }
+
+    if (cpuMask & (1UL << self))
+    {
+        handler(arg);
+    }
+
+    while (wait && NX_AtomicGet(&done) > 0)
+    {
+        SMP_CallRun(&IpiQueueArray[self]);
+    }
+
+    NX_IRQ_RestoreLevel(level);
+    return err;
+}
+
+/**
+ * Let running thread on core be scheduled on interrupt exit,
+ * other core is scheduled at once by ipi instead of next tick.
+ */
+NX_PUBLIC void NX_SMP_Reschedule(NX_UArch coreId)
+{
+    NX_Thread *running;
+
+    if (coreId >= NX_MULTI_CORES_NR || !(NX_AtomicGet(&CoreOnlineMask) & (1UL << coreId)))
+    {
+        return;
+    }
+
+    if (coreId == NX_SMP_GetIdx())
+    {
+        running = CpuArray[coreId].threadRunning;
+        if (running != NX_NULL)
+        {
+            running->needSched = 1;
+        }
+        return;
+    }
+
+    NX_AtomicSetMask(&IpiQueueArray[coreId].pending, SMP_IPI_RESCHED);
+    NX_SMP_SendIpi(1UL << coreId);
+}
+
+/**
+ * Reschedule core if thread just woken onto it should run before the running
+ * thread. Deadline thread is compared by deadline, fair thread by vruntime.
+ * Fifo thread was queued on head, it preempts non deadline thread at once.
+ */
+NX_PUBLIC void NX_SMP_WakeupPreempt(NX_UArch coreId, NX_Thread *thread)
+{
+    NX_Cpu *cpu = NX_CpuGetIndex(coreId);
+    NX_Thread *running;
+    NX_Bool preempt = NX_True;
+
+    NX_SpinLock(&cpu->lock, NX_True);
+    running = cpu->threadRunning;
+    if (running != NX_NULL)
+    {
+        if (NX_ThreadIsDeadline(thread) || NX_ThreadIsDeadline(running))
+        {
+            preempt = NX_DeadlinePreempt(running, thread);
+        }
+#ifdef CONFIG_NX_SCHED_FAIR
+        else
+        {
+            preempt = NX_FairPreempt(running, thread);
+        }
+#endif
+    }
+    NX_SpinUnlock(&cpu->lock);
+
+    if (preempt)
+    {
+        NX_SMP_Reschedule(coreId);
+    }
+}
+
+/**
+ * Called by arch in ipi interrupt
+ */
+NX_PUBLIC void NX_SMP_IpiHandler(void)
+{
+    SMP_IpiQueue *queue = &IpiQueueArray[NX_SMP_GetIdx()];
+    NX_Thread *running;
+    NX_UArch pending;
+
+    pending = NX_AtomicSwap(&queue->pending, 0);
+
+    if (pending & SMP_IPI_CALL)
+    {
+        SMP_CallRun(queue);
+    }
+
+    if (pending & SMP_IPI_RESCHED)
+    {
+        running = NX_CpuGetPtr()->threadRunning;
+        if (running != NX_NULL)
+        {
+            running->needSched = 1;
+        }
+    }
+}
@@ -10,6 +10,7 @@
  */
 
 #include <sched/spin.h>
+#include <sched/sched.h>
 #include <io/irq.h>
 
 NX_PUBLIC NX_Error NX_SpinInit(NX_Spin *lock)
@@ -35,6 +36,7 @@ NX_PUBLIC NX_Error NX_SpinLock(NX_Spin *lock, NX_Bool forever)
         return NX_EFAULT;
     }
 
+    NX_PreemptDisable();
     do
     {
         if (NX_AtomicCAS(&lock->value, 0, NX_SPIN_LOCK_VALUE) == 0)
@@ -43,6 +45,7 @@ NX_PUBLIC NX_Error NX_SpinLock(NX_Spin *lock, NX_Bool forever)
         }
         if (forever == NX_False)
         {
+            NX_PreemptEnable();
             return NX_ETIMEOUT;
         }
     } while (1);
@@ -57,6 +60,7 @@ NX_PUBLIC NX_Error NX_SpinUnlock(NX_Spin *lock)
         return NX_EFAULT;
     }
     NX_AtomicSet(&lock->value, 0);
+    NX_PreemptEnable();
     return NX_EOK;
 }
 
@@ -76,10 +80,13 @@ NX_PUBLIC NX_Error NX_SpinUnlockIRQ(NX_Spin *lock, NX_UArch level)
     {
         return NX_EINVAL;
     }
-    if (NX_SpinUnlock(lock) != NX_EOK)
+    if (lock->magic != NX_SPIN_MAGIC)
     {
         return NX_EFAULT;
     }
+    NX_AtomicSet(&lock->value, 0);
     NX_IRQ_RestoreLevel(level);
+    /* enable preempt after interrupt restored, so sched can happen here */
+    NX_PreemptEnable();
     return NX_EOK;
 }
@@ -21,6 +21,7 @@
 #include <sched/smp.h>
 #include <sched/context.h>
 #include <mm/alloc.h>
+#include <mm/page.h>
 #include <utils/string.h>
 #include <mods/time/timer.h>
 
@@ -40,7 +41,7 @@ NX_PRIVATE NX_Error ThreadInit(NX_Thread *thread,
     NX_ListInit(&thread->globalList);
     NX_ListInit(&thread->processList);
     
-    NX_StrCopy(thread->name, name);
+    NX_StrLCopy(thread->name, name, NX_THREAD_NAME_LEN);
     thread->tid = NX_ThreadIdAlloc();
     if (thread->tid < 0)
     {
@@ -52,6 +53,7 @@ NX_PRIVATE NX_Error ThreadInit(NX_Thread *thread,
     thread->timeslice = 3;
     thread->ticks = thread->timeslice;
     thread->needSched = 0;
+    thread->preemptCount = 0;
     thread->isTerminated = 0;
     thread->stackBase = stack;
     thread->stackSize = stackSize;
@@ -59,7 +61,10 @@ NX_PRIVATE NX_Error ThreadInit(NX_Thread *thread,
     thread->stack = NX_ContextInit(handler, (void *)NX_ThreadExit, arg, thread->stack);
     
     thread->onCore = NX_MULTI_CORES_NR; /* not on any core */
-    thread->coreAffinity = NX_MULTI_CORES_NR; /* no core affinity */
+    thread->coreAffinity = NX_CPU_MASK_ALL; /* run on any core */
+    thread->deadline.runtime = 0; /* not deadline thread */
+    thread->deadline.timer = NX_NULL;
+    NX_FairThreadInit(thread);
 
     thread->resource.sleepTimer = NX_NULL;
     thread->resource.process = NX_NULL;
@@ -122,6 +127,8 @@ NX_PUBLIC NX_Error NX_ThreadDestroy(NX_Thread *thread)
         return err;
     }
 
+    NX_DeadlineRelease(thread);
+
     NX_MemFree(stackBase);
 
     NX_MemFree(thread);
@@ -132,6 +139,19 @@ NX_PUBLIC void NX_ThreadReadyRunLocked(NX_Thread *thread, int flags)
 {
     thread->state = NX_THREAD_READY;
 
+    /**
+     * affinity changed after thread left the core, place it on allowed core.
+     * running thread stays, its core moves it out after switched away.
+     */
+    if (thread->onCore < NX_MULTI_CORES_NR && !NX_CpuMaskTest(thread->coreAffinity, thread->onCore) &&
+        thread != NX_CpuGetIndex(thread->onCore)->threadRunning)
+    {
+#ifdef CONFIG_NX_SCHED_FAIR
+        NX_FairMigrate(thread->onCore, thread);
+#endif
+        thread->onCore = NX_SMP_SelectCore(thread->coreAffinity);
+    }
+
     if (thread->onCore < NX_MULTI_CORES_NR)
     {
         NX_SMP_EnqueueThreadIrqDisabled(thread->onCore, thread, flags);
@@ -229,6 +249,8 @@ NX_PRIVATE void ThreadReleaseResouce(NX_Thread *thread)
         thread->resource.sleepTimer = NX_NULL;
     }
 
+    NX_DeadlineRelease(thread);
+
     /* thread had bind on process */
     if (thread->resource.process != NX_NULL)
     {
@@ -297,6 +319,27 @@ NX_PRIVATE void ThreadBlockInterruptDisabled(NX_ThreadState state, NX_UArch irqL
 NX_PRIVATE void ThreadUnblockInterruptDisabled(NX_Thread *thread)
 {
     NX_ThreadReadyRunLocked(thread, NX_SCHED_HEAD);
+
+    /**
+     * preempt the running thread of its core at once if woken thread should
+     * run first, not wait its next tick. same core preempts at outermost
+     * unlock or irq exit.
+     */
+    if (thread->onCore < NX_MULTI_CORES_NR)
+    {
+        NX_SMP_WakeupPreempt(thread->onCore, thread);
+    }
+}
+
+/**
+ * block self until NX_ThreadWakeup, lock must be held by NX_SpinLockIRQ.
+ * lock is released after state set, so a wakeup under the lock is never lost.
+ */
+NX_PUBLIC void NX_ThreadBlockLockedIRQ(NX_Spin *lock, NX_UArch irqLevel)
+{
+    NX_CurrentThread->state = NX_THREAD_SLEEP;
+    NX_SpinUnlock(lock);
+    NX_SchedWithInterruptDisabled(irqLevel);
 }
 
 /**
@@ -391,17 +434,40 @@ NX_PUBLIC NX_Error NX_ThreadSleep(NX_UArch microseconds)
     return NX_EOK;
 }
 
-NX_PUBLIC NX_Error NX_ThreadSetAffinity(NX_Thread *thread, NX_UArch coreId)
+/**
+ * Set cores thread is allowed to run on. Thread ready or running on core
+ * not allowed is moved to allowed core when that core scheds.
+ */
+NX_PUBLIC NX_Error NX_ThreadSetAffinity(NX_Thread *thread, NX_CpuMask mask)
 {
-    if (thread == NX_NULL || coreId >= NX_MULTI_CORES_NR)
+    NX_UArch level;
+    NX_UArch coreId;
+
+    mask &= NX_CPU_MASK_ALL;
+    if (thread == NX_NULL || mask == 0)
     {
         return NX_EINVAL;
     }
-    NX_UArch level;
+    /* deadline thread reserved utilization on its core */
+    if (NX_ThreadIsDeadline(thread))
+    {
+        return NX_EPERM;
+    }
+
     NX_SpinLockIRQ(&thread->lock, &level);
-    thread->coreAffinity = coreId;
-    thread->onCore = coreId;
+    thread->coreAffinity = mask;
+    if (thread->state == NX_THREAD_INIT)
+    {
+        /* queue on the core if only one allowed, or balanced from pending list */
+        thread->onCore = NX_CpuMaskIsSingle(mask) ? NX_CpuMaskFirst(mask) : NX_MULTI_CORES_NR;
+    }
+    coreId = thread->onCore;
     NX_SpinUnlockIRQ(&thread->lock, level);
+
+    if (coreId < NX_MULTI_CORES_NR && !NX_CpuMaskTest(mask, coreId))
+    {
+        NX_SMP_Reschedule(coreId);
+    }
     return NX_EOK;
 }
 
@@ -414,18 +480,25 @@ NX_PUBLIC void NX_ThreadEnqueuePendingList(NX_Thread *thread)
     NX_SpinUnlockIRQ(&NX_ThreadManagerObject.lock, level);
 }
 
-NX_PUBLIC NX_Thread *NX_ThreadDequeuePendingList(void)
+/**
+ * dequeue first pending thread allowed to run on core
+ */
+NX_PUBLIC NX_Thread *NX_ThreadDequeuePendingList(NX_UArch coreId)
 {
-    NX_Thread *thread;
+    NX_Thread *thread, *findThread = NX_NULL;
     NX_SpinLock(&NX_ThreadManagerObject.lock, NX_True);
-    thread = NX_ListFirstEntryOrNULL(&NX_ThreadManagerObject.pendingList, NX_Thread, list);
-    if (thread != NX_NULL)
+    NX_ListForEachEntry(thread, &NX_ThreadManagerObject.pendingList, list)
     {
-        NX_ListDel(&thread->list);
-        NX_AtomicDec(&NX_ThreadManagerObject.pendingThreadCount);
+        if (NX_CpuMaskTest(thread->coreAffinity, coreId))
+        {
+            findThread = thread;
+            NX_ListDel(&thread->list);
+            NX_AtomicDec(&NX_ThreadManagerObject.pendingThreadCount);
+            break;
+        }
     }
     NX_SpinUnlock(&NX_ThreadManagerObject.lock);
-    return thread;
+    return findThread;
 }
 
 NX_PUBLIC void NX_ThreadEnququeExitList(NX_Thread *thread)
@@ -462,10 +535,12 @@ NX_PUBLIC NX_Thread *NX_ThreadFindById(NX_U32 tid)
 NX_PRIVATE void IdleThreadEntry(void *arg)
 {
     NX_LOG_I("Idle thread: %s startting...", NX_ThreadSelf()->name);
-    int i = 0;
     while (1)
     {
-        i++;
+        /* zero one page each loop, so other threads wait no longer */
+        NX_PageZeroPoolFill(1);
+        /* output logs when nothing else to do */
+        NX_LogDrain();
         NX_ThreadYield();
     }
 }
@@ -525,7 +600,9 @@ NX_PUBLIC void NX_ThreadsInit(void)
         idleThread = NX_ThreadCreate(name, IdleThreadEntry, NX_NULL);
         NX_ASSERT(idleThread != NX_NULL);
         /* bind idle on each core */
-        NX_ThreadSetAffinity(idleThread, coreId);
+        NX_ThreadSetAffinity(idleThread, NX_CpuMaskOf(coreId));
+        /* idle yields all the time, run it as less as possible when fair sched */
+        NX_ThreadSetNice(idleThread, NX_NICE_MAX);
 
         NX_ASSERT(NX_ThreadRun(idleThread) == NX_EOK);
     }
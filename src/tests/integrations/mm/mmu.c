@@ -0,0 +1,67 @@
+/**
+ * Copyright (c) 2018-2022, BookOS Development Team
+ * SPDX-License-Identifier: Apache-2.0
+ * 
+ * Contains: MMU map & unmap benchmark
+ */
+
+#include <mods/test/integration.h>
+#include <mods/time/clock.h>
+#include <mm/page.h>
+#include <mmu.h>
+#include <xbook/debug.h>
+#include <platform.h>
+#define NX_LOG_NAME "MMU"
+#include <utils/log.h>
+#include <utils/memory.h>
+
+#ifdef CONFIG_NX_TEST_INTEGRATION_MMU
+
+#define MMU_TEST_ROUNDS 4
+#define MMU_TEST_SIZE   (64 * NX_MB)
+#define MMU_TEST_BASE   MEM_KERNEL_TOP
+
+#ifdef KERNEL_PAGE_ATTR /* x86 */
+#define MMU_TEST_ATTR KERNEL_PAGE_ATTR
+#else
+#define MMU_TEST_ATTR PAGE_DEFAULT_ATTR_KERNEL
+#endif
+
+NX_INTEGRATION_TEST(MMU_MapPage)
+{
+    MMU mmu;
+    void *table = NX_PageAlloc(1);
+    if (table == NX_NULL)
+    {
+        NX_LOG_W("alloc page table failed, skip!");
+        return NX_EOK;
+    }
+    NX_MemZero(table, NX_PAGE_SIZE);
+    MMU_InitTable(&mmu, table, MMU_TEST_BASE, MMU_TEST_SIZE);
+
+    int i;
+    for (i = 0; i < MMU_TEST_ROUNDS; i++)
+    {
+        NX_ClockTick begin = NX_ClockTickGet();
+        if (MMU_MapPage(&mmu, MMU_TEST_BASE, MMU_TEST_SIZE, MMU_TEST_ATTR) == NX_NULL)
+        {
+            NX_LOG_W("map %d MB failed, skip!", MMU_TEST_SIZE / NX_MB);
+            break;
+        }
+        NX_ClockTick mapped = NX_ClockTickGet();
+        NX_ASSERT(MMU_Vir2Phy(&mmu, MMU_TEST_BASE + MMU_TEST_SIZE - 1) != NX_NULL);
+        if (MMU_UnmapPage(&mmu, MMU_TEST_BASE, MMU_TEST_SIZE) != NX_EOK)
+        {
+            NX_LOG_E("unmap %d MB failed!", MMU_TEST_SIZE / NX_MB);
+            return NX_EFAULT;
+        }
+        NX_ClockTick unmapped = NX_ClockTickGet();
+        NX_LOG_I("round %d: map %d MB %d ms, unmap %d ms", i, MMU_TEST_SIZE / NX_MB,
+            (int)NX_TICKS_TO_MILLISECOND(mapped - begin), (int)NX_TICKS_TO_MILLISECOND(unmapped - mapped));
+    }
+
+    NX_PageFree(table);
+    return NX_EOK;
+}
+
+#endif
@@ -0,0 +1,94 @@
+/**
+ * Copyright (c) 2018-2022, BookOS Development Team
+ * SPDX-License-Identifier: Apache-2.0
+ * 
+ * Contains: Memory utils benchmark
+ */
+
+#include <mods/test/integration.h>
+#include <mods/time/clock.h>
+#include <mm/alloc.h>
+#include <xbook/debug.h>
+#define NX_LOG_NAME "Memory"
+#include <utils/log.h>
+#include <utils/memory.h>
+
+#ifdef CONFIG_NX_TEST_INTEGRATION_MEMORY
+
+#define MEMORY_TEST_MIN_SIZE    8
+#define MEMORY_TEST_MAX_SIZE    (1 * NX_MB)
+#define MEMORY_TEST_TOTAL       (32 * NX_MB)   /* bytes done for each size */
+
+NX_PRIVATE int MemoryTestSpeed(NX_ClockTick ticks)
+{
+    int ms = (int)NX_TICKS_TO_MILLISECOND(ticks);
+    return ms > 0 ? (MEMORY_TEST_TOTAL / NX_MB) * 1000 / ms : -1;    /* -1 means too fast to measure */
+}
+
+NX_INTEGRATION_TEST(NX_MemCopy)
+{
+    NX_U8 *src = NX_MemAlloc(MEMORY_TEST_MAX_SIZE + 8);
+    NX_U8 *dst = NX_MemAlloc(MEMORY_TEST_MAX_SIZE + 8);
+    NX_USize size;
+    NX_USize loops;
+    NX_USize i;
+
+    if (src == NX_NULL || dst == NX_NULL)
+    {
+        NX_LOG_W("alloc buffer failed, skip!");
+        NX_MemFreeSafety(src);
+        NX_MemFreeSafety(dst);
+        return NX_EOK;
+    }
+
+    for (i = 0; i < MEMORY_TEST_MAX_SIZE + 8; i++)
+    {
+        src[i] = (NX_U8)i;
+    }
+    /* check copy & move with all alignment */
+    for (i = 0; i < 8; i++)
+    {
+        NX_MemCopy(dst + i, src + 8 - i, 4096);
+        NX_ASSERT(NX_CompareN(dst + i, src + 8 - i, 4096) == 0);
+        NX_MemMove(dst + 1, dst + i, 4096);
+        NX_ASSERT(NX_CompareN(dst + 1, src + 8 - i, 4096) == 0);
+    }
+
+    NX_LOG_I("size        set MB/s   copy MB/s  move MB/s  cmp MB/s");
+    for (size = MEMORY_TEST_MIN_SIZE; size <= MEMORY_TEST_MAX_SIZE; size <<= 2)
+    {
+        loops = MEMORY_TEST_TOTAL / size;
+        NX_ClockTick begin = NX_ClockTickGet();
+        for (i = 0; i < loops; i++)
+        {
+            NX_MemSet(dst, (NX_U8)i, size);
+        }
+        NX_ClockTick setDone = NX_ClockTickGet();
+        for (i = 0; i < loops; i++)
+        {
+            NX_MemCopy(dst, src, size);
+        }
+        NX_ClockTick copyDone = NX_ClockTickGet();
+        for (i = 0; i < loops; i++)
+        {
+            NX_MemMove(dst + 8, dst, size);  /* overlap, copy backward */
+        }
+        NX_ClockTick moveDone = NX_ClockTickGet();
+        NX_MemCopy(dst, src, size);
+        for (i = 0; i < loops; i++)
+        {
+            NX_ASSERT(NX_CompareN(dst, src, size) == 0);
+        }
+        NX_ClockTick cmpDone = NX_ClockTickGet();
+
+        NX_LOG_I("%-10d  %-9d  %-9d  %-9d  %d", (int)size, MemoryTestSpeed(setDone - begin),
+            MemoryTestSpeed(copyDone - setDone), MemoryTestSpeed(moveDone - copyDone),
+            MemoryTestSpeed(cmpDone - moveDone));
+    }
+
+    NX_MemFree(src);
+    NX_MemFree(dst);
+    return NX_EOK;
+}
+
+#endif
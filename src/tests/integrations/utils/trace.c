@@ -0,0 +1,37 @@
+/**
+ * Copyright (c) 2018-2022, BookOS Development Team
+ * SPDX-License-Identifier: Apache-2.0
+ * 
+ * Contains: Trace dump
+ */
+
+#include <mods/test/integration.h>
+#include <mm/alloc.h>
+#include <sched/thread.h>
+#include <utils/trace.h>
+
+#ifdef CONFIG_NX_TEST_INTEGRATION_TRACE
+
+#define TRACE_TEST_LOOPS 16
+
+/**
+ * Make some events and dump them, decode console log on host with
+ * scripts/trace2json.py
+ */
+NX_INTEGRATION_TEST(NX_TraceDump)
+{
+    void *object;
+    int i;
+
+    for (i = 0; i < TRACE_TEST_LOOPS; i++)
+    {
+        object = NX_MemAlloc(64 * (i + 1));
+        NX_ThreadSleep(10);
+        NX_MemFree(object);
+        NX_ThreadYield();
+    }
+    NX_TraceDump();
+    return NX_EOK;
+}
+
+#endif
@@ -0,0 +1,103 @@
+/**
+ * Copyright (c) 2018-2022, BookOS Development Team
+ * SPDX-License-Identifier: Apache-2.0
+ * 
+ * Contains: deadline sched utest
+ */
+
+#include <mods/test/utest.h>
+#include <sched/thread.h>
+#include <sched/deadline.h>
+#include <sched/smp.h>
+
+#ifdef CONFIG_NX_UTEST_SCHED_DEADLINE
+
+#define DEADLINE_TEST_JOBS 5
+
+NX_PRIVATE NX_ThreadDeadlineStat DeadlineTestStat;
+
+NX_PRIVATE void DeadlineNop(void *arg)
+{
+}
+
+NX_PRIVATE void DeadlinePeriodic(void *arg)
+{
+    int i;
+    for (i = 0; i < DEADLINE_TEST_JOBS; i++)
+    {
+        NX_EXPECT_EQ(NX_ThreadDeadlineWait(), NX_EOK);
+    }
+    NX_EXPECT_EQ(NX_ThreadDeadlineStatGet(NX_ThreadSelf(), &DeadlineTestStat), NX_EOK);
+}
+
+NX_TEST(NX_ThreadSetDeadline)
+{
+    NX_Thread *thread = NX_ThreadCreate("deadline", DeadlineNop, NX_NULL);
+    NX_ASSERT_NOT_NULL(thread);
+    NX_EXPECT_EQ(NX_ThreadSetAffinity(thread, NX_CpuMaskOf(NX_SMP_GetIdx())), NX_EOK);
+    NX_U32 util = NX_DeadlineUtilGet(NX_SMP_GetIdx());
+
+    NX_EXPECT_NE(NX_ThreadSetDeadline(NX_NULL, 10, 100, 0), NX_EOK);
+    NX_EXPECT_NE(NX_ThreadSetDeadline(thread, 0, 100, 0), NX_EOK);
+    NX_EXPECT_NE(NX_ThreadSetDeadline(thread, 10, 0, 0), NX_EOK);
+    NX_EXPECT_NE(NX_ThreadSetDeadline(thread, 50, 100, 20), NX_EOK);
+    NX_EXPECT_NE(NX_ThreadSetDeadline(thread, 10, 100, 200), NX_EOK);
+    NX_EXPECT_EQ(NX_ThreadIsDeadline(thread), NX_False);
+
+    NX_EXPECT_EQ(NX_ThreadSetDeadline(thread, 10, 100, 0), NX_EOK);
+    NX_EXPECT_EQ(NX_ThreadIsDeadline(thread), NX_True);
+    NX_EXPECT_EQ(NX_ThreadSetDeadline(thread, 10, 100, 0), NX_EPERM);
+    NX_EXPECT_GT(NX_DeadlineUtilGet(NX_SMP_GetIdx()), util);
+    NX_EXPECT_EQ(NX_ThreadSetAffinity(thread, NX_CPU_MASK_ALL), NX_EPERM);
+
+    NX_EXPECT_EQ(NX_ThreadDestroy(thread), NX_EOK);
+    NX_EXPECT_EQ(NX_DeadlineUtilGet(NX_SMP_GetIdx()), util);
+}
+
+NX_TEST(NX_ThreadDeadlineAdmission)
+{
+    NX_UArch coreId = NX_SMP_GetIdx();
+    NX_U32 util = NX_DeadlineUtilGet(coreId);
+    NX_Thread *thread0 = NX_ThreadCreate("deadline0", DeadlineNop, NX_NULL);
+    NX_Thread *thread1 = NX_ThreadCreate("deadline1", DeadlineNop, NX_NULL);
+    NX_ASSERT_NOT_NULL(thread0);
+    NX_ASSERT_NOT_NULL(thread1);
+    NX_EXPECT_EQ(NX_ThreadSetAffinity(thread0, NX_CpuMaskOf(coreId)), NX_EOK);
+    NX_EXPECT_EQ(NX_ThreadSetAffinity(thread1, NX_CpuMaskOf(coreId)), NX_EOK);
+
+    NX_EXPECT_EQ(NX_ThreadSetDeadline(thread0, 60, 100, 0), NX_EOK);
+    NX_EXPECT_EQ(NX_ThreadSetDeadline(thread1, 60, 100, 0), NX_ENORES);
+    NX_EXPECT_EQ(NX_ThreadIsDeadline(thread1), NX_False);
+
+    NX_EXPECT_EQ(NX_ThreadDestroy(thread0), NX_EOK);
+    NX_EXPECT_EQ(NX_ThreadSetDeadline(thread1, 60, 100, 0), NX_EOK);
+    NX_EXPECT_EQ(NX_ThreadDestroy(thread1), NX_EOK);
+    NX_EXPECT_EQ(NX_DeadlineUtilGet(coreId), util);
+}
+
+NX_TEST(NX_ThreadDeadlineWait)
+{
+    NX_EXPECT_EQ(NX_ThreadDeadlineWait(), NX_EPERM);
+
+    NX_Thread *thread = NX_ThreadCreate("deadline", DeadlinePeriodic, NX_NULL);
+    NX_ASSERT_NOT_NULL(thread);
+    NX_EXPECT_EQ(NX_ThreadSetDeadline(thread, 20, 100, 0), NX_EOK);
+    NX_EXPECT_EQ(NX_ThreadRun(thread), NX_EOK);
+
+    /* sleep until thread exit */
+    NX_EXPECT_EQ(NX_ThreadSleep(1000), NX_EOK);
+
+    NX_EXPECT_EQ(DeadlineTestStat.completed, DEADLINE_TEST_JOBS);
+    NX_EXPECT_EQ(DeadlineTestStat.missCount, 0);
+}
+
+NX_TEST_TABLE(NX_Deadline)
+{
+    NX_TEST_UNIT(NX_ThreadSetDeadline),
+    NX_TEST_UNIT(NX_ThreadDeadlineAdmission),
+    NX_TEST_UNIT(NX_ThreadDeadlineWait),
+};
+
+NX_TEST_CASE(NX_Deadline);
+
+#endif
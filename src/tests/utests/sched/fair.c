@@ -0,0 +1,125 @@
+/**
+ * Copyright (c) 2018-2022, BookOS Development Team
+ * SPDX-License-Identifier: Apache-2.0
+ * 
+ * Contains: fair sched utest
+ */
+
+#include <mods/test/utest.h>
+#include <mods/time/clock.h>
+#include <sched/thread.h>
+#include <sched/fair.h>
+#include <sched/smp.h>
+#define NX_LOG_NAME "Fair"
+#include <utils/log.h>
+
+#ifdef CONFIG_NX_UTEST_SCHED_FAIR
+
+#define FAIR_TEST_MS        1000
+#define FAIR_TEST_SLEEP_MS  10
+
+NX_PRIVATE NX_VOLATILE NX_Bool FairTestStop;
+NX_PRIVATE NX_VOLATILE NX_U32 FairTestLoops[2];
+NX_PRIVATE NX_VOLATILE NX_U32 FairTestWakeups;
+NX_PRIVATE NX_VOLATILE NX_ClockTick FairTestMaxLatency;
+
+NX_PRIVATE void FairCpuBound(void *arg)
+{
+    NX_UArch idx = (NX_UArch)arg;
+    while (!FairTestStop)
+    {
+        FairTestLoops[idx]++;
+    }
+}
+
+NX_PRIVATE void FairIoBound(void *arg)
+{
+    NX_ClockTick start, latency;
+    while (!FairTestStop)
+    {
+        start = NX_ClockTickGet();
+        NX_ThreadSleep(FAIR_TEST_SLEEP_MS);
+        latency = NX_ClockTickGet() - start - NX_MILLISECOND_TO_TICKS(FAIR_TEST_SLEEP_MS);
+        if (latency > FairTestMaxLatency)
+        {
+            FairTestMaxLatency = latency;
+        }
+        FairTestWakeups++;
+    }
+}
+
+NX_TEST(NX_ThreadSetNice)
+{
+    NX_Thread *thread = NX_ThreadCreate("fair", FairCpuBound, NX_NULL);
+    NX_ASSERT_NOT_NULL(thread);
+
+    NX_EXPECT_EQ(NX_ThreadGetNice(thread), 0);
+    NX_EXPECT_EQ(NX_ThreadSetNice(NX_NULL, 0), NX_EINVAL);
+    NX_EXPECT_EQ(NX_ThreadSetNice(thread, NX_NICE_MIN - 1), NX_EINVAL);
+    NX_EXPECT_EQ(NX_ThreadSetNice(thread, NX_NICE_MAX + 1), NX_EINVAL);
+    NX_EXPECT_EQ(NX_ThreadSetNice(thread, NX_NICE_MIN), NX_EOK);
+    NX_EXPECT_EQ(NX_ThreadGetNice(thread), NX_NICE_MIN);
+    NX_EXPECT_EQ(NX_ThreadSetNice(thread, NX_NICE_MAX), NX_EOK);
+    NX_EXPECT_EQ(NX_ThreadGetNice(thread), NX_NICE_MAX);
+    NX_EXPECT_GT(thread->fair.invWeight, NX_NICE_0_WEIGHT);
+
+    NX_EXPECT_EQ(NX_ThreadDestroy(thread), NX_EOK);
+}
+
+/**
+ * Two cpu bound threads of nice 0 and 5 with an io bound thread on one core,
+ * compare cpu share and wakeup latency with fifo sched.
+ */
+NX_TEST(NX_FairMixedLoad)
+{
+    NX_UArch coreId = NX_SMP_GetIdx();
+    NX_Thread *cpu0 = NX_ThreadCreate("fairCpu0", FairCpuBound, (void *)0);
+    NX_Thread *cpu1 = NX_ThreadCreate("fairCpu1", FairCpuBound, (void *)1);
+    NX_Thread *io = NX_ThreadCreate("fairIo", FairIoBound, NX_NULL);
+    NX_ASSERT_NOT_NULL(cpu0);
+    NX_ASSERT_NOT_NULL(cpu1);
+    NX_ASSERT_NOT_NULL(io);
+
+    FairTestStop = NX_False;
+    FairTestLoops[0] = FairTestLoops[1] = 0;
+    FairTestWakeups = 0;
+    FairTestMaxLatency = 0;
+
+    NX_EXPECT_EQ(NX_ThreadSetAffinity(cpu0, NX_CpuMaskOf(coreId)), NX_EOK);
+    NX_EXPECT_EQ(NX_ThreadSetAffinity(cpu1, NX_CpuMaskOf(coreId)), NX_EOK);
+    NX_EXPECT_EQ(NX_ThreadSetAffinity(io, NX_CpuMaskOf(coreId)), NX_EOK);
+    NX_EXPECT_EQ(NX_ThreadSetNice(cpu1, 5), NX_EOK);
+
+    NX_EXPECT_EQ(NX_ThreadRun(cpu0), NX_EOK);
+    NX_EXPECT_EQ(NX_ThreadRun(cpu1), NX_EOK);
+    NX_EXPECT_EQ(NX_ThreadRun(io), NX_EOK);
+
+    NX_EXPECT_EQ(NX_ThreadSleep(FAIR_TEST_MS), NX_EOK);
+    FairTestStop = NX_True;
+    /* wait all threads exit */
+    NX_EXPECT_EQ(NX_ThreadSleep(FAIR_TEST_SLEEP_MS * 10), NX_EOK);
+
+    NX_LOG_I("loops nice 0: %d, nice 5: %d, io wakeups: %d, max latency: %d ms",
+        FairTestLoops[0], FairTestLoops[1], FairTestWakeups,
+        NX_TICKS_TO_MILLISECOND(FairTestMaxLatency));
+
+    NX_EXPECT_GT(FairTestLoops[0], 0);
+    NX_EXPECT_GT(FairTestLoops[1], 0);
+    NX_EXPECT_GT(FairTestWakeups, 0);
+#ifdef CONFIG_NX_SCHED_FAIR
+    /* nice 0 weights about 3 times of nice 5, fifo shares half each */
+    NX_EXPECT_GT(FairTestLoops[0], FairTestLoops[1] * 2);
+    /* woken sleeper runs before threads within latency */
+    NX_EXPECT_LE(FairTestMaxLatency, NX_MILLISECOND_TO_TICKS(NX_SCHED_FAIR_LATENCY));
+#endif
+}
+
+NX_TEST_TABLE(NX_Fair)
+{
+    NX_TEST_UNIT(NX_ThreadSetNice),
+    NX_TEST_UNIT(NX_FairMixedLoad),
+};
+
+NX_TEST_CASE(NX_Fair);
+
+#endif
@@ -0,0 +1,133 @@
+/**
+ * Copyright (c) 2018-2022, BookOS Development Team
+ * SPDX-License-Identifier: Apache-2.0
+ * 
+ * Contains: smp remote call test
+ */
+
+#include <sched/smp.h>
+#include <sched/thread.h>
+#include <mods/test/utest.h>
+
+#ifdef CONFIG_NX_UTEST_SCHED_SMP
+
+NX_PRIVATE void SMP_CallCount(void *arg)
+{
+    NX_AtomicSetMask((NX_Atomic *)arg, 1UL << NX_SMP_GetIdx());
+}
+
+NX_TEST(NX_SMP_CallFunction)
+{
+    NX_Atomic called;
+
+    NX_EXPECT_NE(NX_SMP_CallFunction(1UL << NX_SMP_GetIdx(), NX_NULL, NX_NULL, NX_True), NX_EOK);
+
+    NX_AtomicSet(&called, 0);
+    NX_EXPECT_EQ(NX_SMP_CallFunction(1UL << NX_SMP_GetIdx(), SMP_CallCount, &called, NX_True), NX_EOK);
+    NX_EXPECT_EQ(NX_AtomicGet(&called), 1UL << NX_SMP_GetIdx());
+}
+
+NX_TEST(NX_SMP_CallFunctionAll)
+{
+    NX_Atomic called;
+    NX_UArch mask = 0;
+    NX_UArch coreId;
+
+    /* cores not online are skipped */
+    for (coreId = 0; coreId < NX_MULTI_CORES_NR; coreId++)
+    {
+        if (NX_CpuGetIndex(coreId)->threadRunning != NX_NULL)
+        {
+            mask |= 1UL << coreId;
+        }
+    }
+
+    NX_AtomicSet(&called, 0);
+    NX_EXPECT_EQ(NX_SMP_CallFunction(~0UL, SMP_CallCount, &called, NX_True), NX_EOK);
+    NX_EXPECT_EQ(NX_AtomicGet(&called), mask);
+}
+
+NX_PRIVATE NX_VOLATILE NX_Bool SMP_AffinityStop;
+NX_PRIVATE NX_VOLATILE NX_UArch SMP_AffinityCore;
+
+NX_PRIVATE void SMP_AffinityRecord(void *arg)
+{
+    while (!SMP_AffinityStop)
+    {
+        SMP_AffinityCore = NX_SMP_GetIdx();
+    }
+}
+
+NX_TEST(NX_ThreadSetAffinity)
+{
+    NX_UArch coreId = NX_SMP_GetIdx();
+    NX_Thread *thread = NX_ThreadCreate("affinity", SMP_AffinityRecord, NX_NULL);
+    NX_ASSERT_NOT_NULL(thread);
+
+    NX_EXPECT_EQ(thread->coreAffinity, NX_CPU_MASK_ALL);
+    NX_EXPECT_EQ(NX_ThreadSetAffinity(NX_NULL, NX_CPU_MASK_ALL), NX_EINVAL);
+    NX_EXPECT_EQ(NX_ThreadSetAffinity(thread, 0), NX_EINVAL);
+    NX_EXPECT_EQ(NX_ThreadSetAffinity(thread, ~NX_CPU_MASK_ALL), NX_EINVAL);
+
+    /* pinned to one core, queued on it at once */
+    NX_EXPECT_EQ(NX_ThreadSetAffinity(thread, NX_CpuMaskOf(coreId)), NX_EOK);
+    NX_EXPECT_EQ(thread->coreAffinity, NX_CpuMaskOf(coreId));
+    NX_EXPECT_EQ(thread->onCore, coreId);
+
+    /* many cores, balanced from pending list */
+    NX_EXPECT_EQ(NX_ThreadSetAffinity(thread, NX_CPU_MASK_ALL), NX_EOK);
+    NX_EXPECT_EQ(thread->onCore, NX_CPU_MASK_ALL == NX_CpuMaskOf(coreId) ? coreId : NX_MULTI_CORES_NR);
+
+    NX_EXPECT_EQ(NX_ThreadDestroy(thread), NX_EOK);
+}
+
+NX_TEST(NX_ThreadMigrate)
+{
+    NX_UArch coreId = NX_SMP_GetIdx();
+    NX_UArch target = NX_MULTI_CORES_NR;
+    NX_UArch i;
+
+    for (i = 0; i < NX_MULTI_CORES_NR; i++)
+    {
+        if (i != coreId && NX_CpuGetIndex(i)->threadRunning != NX_NULL)
+        {
+            target = i;
+            break;
+        }
+    }
+    if (target == NX_MULTI_CORES_NR)
+    {
+        return; /* only one core online */
+    }
+
+    NX_Thread *thread = NX_ThreadCreate("migrate", SMP_AffinityRecord, NX_NULL);
+    NX_ASSERT_NOT_NULL(thread);
+
+    SMP_AffinityStop = NX_False;
+    SMP_AffinityCore = NX_MULTI_CORES_NR;
+    NX_EXPECT_EQ(NX_ThreadSetAffinity(thread, NX_CpuMaskOf(coreId)), NX_EOK);
+    NX_EXPECT_EQ(NX_ThreadRun(thread), NX_EOK);
+    NX_EXPECT_EQ(NX_ThreadSleep(50), NX_EOK);
+    NX_EXPECT_EQ(SMP_AffinityCore, coreId);
+
+    /* running thread moves to the allowed core */
+    NX_EXPECT_EQ(NX_ThreadSetAffinity(thread, NX_CpuMaskOf(target)), NX_EOK);
+    NX_EXPECT_EQ(NX_ThreadSleep(100), NX_EOK);
+    NX_EXPECT_EQ(SMP_AffinityCore, target);
+    NX_EXPECT_EQ(thread->onCore, target);
+
+    SMP_AffinityStop = NX_True;
+    NX_EXPECT_EQ(NX_ThreadSleep(50), NX_EOK);
+}
+
+NX_TEST_TABLE(NX_SMP)
+{
+    NX_TEST_UNIT(NX_SMP_CallFunction),
+    NX_TEST_UNIT(NX_SMP_CallFunctionAll),
+    NX_TEST_UNIT(NX_ThreadSetAffinity),
+    NX_TEST_UNIT(NX_ThreadMigrate),
+};
+
+NX_TEST_CASE(NX_SMP);
+
+#endif
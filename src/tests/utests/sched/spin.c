@@ -10,6 +10,7 @@
  */
 
 #include <sched/spin.h>
+#include <sched/thread.h>
 #include <mods/test/utest.h>
 
 #ifdef CONFIG_NX_UTEST_SCHED_SPIN
@@ -34,6 +35,7 @@ NX_TEST(NX_SpinLock)
 
     NX_EXPECT_EQ(NX_SpinLock(&lock, NX_True), NX_EOK);
     NX_EXPECT_NE(NX_SpinLock(&lock, NX_False), NX_EOK);
+    NX_EXPECT_EQ(NX_SpinUnlock(&lock), NX_EOK);
 }
 
 NX_TEST(NX_SpinUnlock)
@@ -64,12 +66,37 @@ NX_TEST(NX_SpinLockAndUnlock)
     }
 }
 
+NX_TEST(NX_SpinPreemptCount)
+{
+    NX_Spin lock;
+    NX_Spin lockOther;
+    NX_Thread *self = NX_ThreadSelf();
+    NX_U32 count = self->preemptCount;
+
+    NX_EXPECT_EQ(NX_SpinInit(&lock), NX_EOK);
+    NX_EXPECT_EQ(NX_SpinInit(&lockOther), NX_EOK);
+
+    NX_EXPECT_EQ(NX_SpinLock(&lock, NX_True), NX_EOK);
+    NX_EXPECT_EQ(self->preemptCount, count + 1);
+    NX_EXPECT_NE(NX_SpinLock(&lock, NX_False), NX_EOK);
+    NX_EXPECT_EQ(self->preemptCount, count + 1);
+
+    NX_EXPECT_EQ(NX_SpinLock(&lockOther, NX_True), NX_EOK);
+    NX_EXPECT_EQ(self->preemptCount, count + 2);
+    NX_EXPECT_EQ(NX_SpinUnlock(&lockOther), NX_EOK);
+    NX_EXPECT_EQ(self->preemptCount, count + 1);
+
+    NX_EXPECT_EQ(NX_SpinUnlock(&lock), NX_EOK);
+    NX_EXPECT_EQ(self->preemptCount, count);
+}
+
 NX_TEST_TABLE(NX_Spin)
 {
     NX_TEST_UNIT(NX_SpinInit),
     NX_TEST_UNIT(NX_SpinLock),
     NX_TEST_UNIT(NX_SpinUnlock),
     NX_TEST_UNIT(NX_SpinLockAndUnlock),
+    NX_TEST_UNIT(NX_SpinPreemptCount),
 };
 
 NX_TEST_CASE(NX_Spin);
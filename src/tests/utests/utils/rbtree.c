@@ -0,0 +1,154 @@
+/**
+ * Copyright (c) 2018-2022, BookOS Development Team
+ * SPDX-License-Identifier: Apache-2.0
+ * 
+ * Contains: rbtree test
+ */
+
+#include <utils/rbtree.h>
+#include <mods/test/utest.h>
+
+#ifdef CONFIG_NX_UTEST_UTILS_RBTREE
+
+#define RB_TEST_NODES 64
+
+struct RbTestNode
+{
+    NX_RbNode node;
+    int key;
+};
+
+NX_PRIVATE struct RbTestNode RbTestNodes[RB_TEST_NODES];
+
+NX_PRIVATE void RbTestInsert(NX_RbRoot *root, struct RbTestNode *test)
+{
+    NX_RbNode **link = &root->node;
+    NX_RbNode *parent = NX_NULL;
+
+    while (*link != NX_NULL)
+    {
+        parent = *link;
+        if (test->key < NX_RbEntry(parent, struct RbTestNode, node)->key)
+        {
+            link = &parent->left;
+        }
+        else
+        {
+            link = &parent->right;
+        }
+    }
+    NX_RbLinkNode(&test->node, parent, link);
+    NX_RbInsertColor(&test->node, root);
+}
+
+/**
+ * check order and black height, return black height or -1 if broken
+ */
+NX_PRIVATE int RbTestCheck(NX_RbNode *node, NX_RbNode *parent)
+{
+    int left, right;
+
+    if (node == NX_NULL)
+    {
+        return 1;
+    }
+    if (node->parent != parent)
+    {
+        return -1;
+    }
+    if (node->color == NX_RB_RED && parent != NX_NULL && parent->color == NX_RB_RED)
+    {
+        return -1;
+    }
+    left = RbTestCheck(node->left, node);
+    right = RbTestCheck(node->right, node);
+    if (left < 0 || left != right)
+    {
+        return -1;
+    }
+    return left + (node->color == NX_RB_BLACK ? 1 : 0);
+}
+
+NX_PRIVATE int RbTestCount(NX_RbRoot *root)
+{
+    NX_RbNode *node;
+    int count = 0;
+    int key = -1;
+
+    for (node = NX_RbFirst(root); node != NX_NULL; node = NX_RbNext(node))
+    {
+        if (NX_RbEntry(node, struct RbTestNode, node)->key < key)
+        {
+            return -1;
+        }
+        key = NX_RbEntry(node, struct RbTestNode, node)->key;
+        count++;
+    }
+    return count;
+}
+
+NX_TEST(NX_RbInsertColor)
+{
+    NX_RbRoot root = NX_RB_ROOT_INIT;
+    int i;
+
+    NX_EXPECT_TRUE(NX_RbEmpty(&root));
+    NX_EXPECT_NULL(NX_RbFirst(&root));
+    NX_EXPECT_NULL(NX_RbLast(&root));
+
+    for (i = 0; i < RB_TEST_NODES; i++)
+    {
+        RbTestNodes[i].key = (i * 37) % RB_TEST_NODES;
+        RbTestInsert(&root, &RbTestNodes[i]);
+        NX_ASSERT_GT(RbTestCheck(root.node, NX_NULL), 0);
+    }
+    NX_EXPECT_FALSE(NX_RbEmpty(&root));
+    NX_EXPECT_EQ(root.node->color, NX_RB_BLACK);
+    NX_EXPECT_EQ(RbTestCount(&root), RB_TEST_NODES);
+    NX_EXPECT_EQ(NX_RbEntry(NX_RbFirst(&root), struct RbTestNode, node)->key, 0);
+    NX_EXPECT_EQ(NX_RbEntry(NX_RbLast(&root), struct RbTestNode, node)->key, RB_TEST_NODES - 1);
+    NX_EXPECT_EQ(NX_RbNext(NX_RbLast(&root)), NX_NULL);
+    NX_EXPECT_EQ(NX_RbPrev(NX_RbFirst(&root)), NX_NULL);
+}
+
+NX_TEST(NX_RbErase)
+{
+    NX_RbRoot root = NX_RB_ROOT_INIT;
+    int i;
+
+    for (i = 0; i < RB_TEST_NODES; i++)
+    {
+        RbTestNodes[i].key = (i * 37) % RB_TEST_NODES;
+        RbTestInsert(&root, &RbTestNodes[i]);
+    }
+
+    /* erase even keys */
+    for (i = 0; i < RB_TEST_NODES; i++)
+    {
+        if (!(RbTestNodes[i].key % 2))
+        {
+            NX_RbErase(&RbTestNodes[i].node, &root);
+            NX_ASSERT_GT(RbTestCheck(root.node, NX_NULL), 0);
+        }
+    }
+    NX_EXPECT_EQ(RbTestCount(&root), RB_TEST_NODES / 2);
+    NX_EXPECT_EQ(NX_RbEntry(NX_RbFirst(&root), struct RbTestNode, node)->key, 1);
+
+    /* erase root until empty */
+    while (!NX_RbEmpty(&root))
+    {
+        NX_RbErase(root.node, &root);
+        NX_ASSERT_GE(RbTestCheck(root.node, NX_NULL), 1);
+    }
+    NX_EXPECT_NULL(NX_RbFirst(&root));
+}
+
+NX_TEST_TABLE(NX_RbTree)
+{
+    NX_TEST_UNIT(NX_RbInsertColor),
+    NX_TEST_UNIT(NX_RbErase),
+};
+
+NX_TEST_CASE(NX_RbTree);
+
+#endif
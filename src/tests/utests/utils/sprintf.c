@@ -0,0 +1,124 @@
+/**
+ * Copyright (c) 2018-2022, BookOS Development Team
+ * SPDX-License-Identifier: Apache-2.0
+ * 
+ * Contains: sprintf test 
+ */
+
+#include <utils/string.h>
+#include <utils/memory.h>
+#include <mods/test/utest.h>
+#include <mods/time/clock.h>
+#define NX_LOG_NAME "Sprintf"
+#include <utils/log.h>
+
+#ifdef CONFIG_NX_UTEST_UTILS_SPRINTF
+
+NX_TEST(NX_SNPrintfNumber)
+{
+    char buf[32];
+
+    NX_EXPECT_EQ(NX_SNPrintf(buf, sizeof(buf), "%d", 0), 1);
+    NX_EXPECT_STREQ(buf, "0");
+    NX_SNPrintf(buf, sizeof(buf), "%d|%i|%u", -2147483647 - 1, 1234567, 4294967295U);
+    NX_EXPECT_STREQ(buf, "-2147483648|1234567|4294967295");
+    NX_SNPrintf(buf, sizeof(buf), "%x|%X|%o", 0xdeadbeef, 0xdeadbeef, 8);
+    NX_EXPECT_STREQ(buf, "deadbeef|DEADBEEF|10");
+    NX_SNPrintf(buf, sizeof(buf), "%#x|%#o|%#x", 255, 8, 0);
+    NX_EXPECT_STREQ(buf, "0xff|010|0");
+    NX_SNPrintf(buf, sizeof(buf), "%5d|%-5d|%05d|%+d", 42, 42, -42, 42);
+    NX_EXPECT_STREQ(buf, "   42|42   |-0042|+42");
+    NX_SNPrintf(buf, sizeof(buf), "%ld|%lx", -1L, 0x7fffffffUL);
+    NX_EXPECT_STREQ(buf, "-1|7fffffff");
+}
+
+NX_TEST(NX_SNPrintfString)
+{
+    char buf[32];
+
+    NX_SNPrintf(buf, sizeof(buf), "[%s][%5s][%-5s][%.2s]", "abc", "abc", "abc", "abc");
+    NX_EXPECT_STREQ(buf, "[abc][  abc][abc  ][ab]");
+    NX_SNPrintf(buf, sizeof(buf), "%c%3c%%", 'a', 'b');
+    NX_EXPECT_STREQ(buf, "a  b%");
+    NX_SNPrintf(buf, sizeof(buf), "%s", NX_NULL);
+    NX_EXPECT_STREQ(buf, "");
+}
+
+NX_TEST(NX_SNPrintfTruncate)
+{
+    char buf[8];
+
+    NX_MemSet(buf, 'x', sizeof(buf));
+    NX_EXPECT_EQ(NX_SNPrintf(buf, sizeof(buf), "hello %s", "world"), 11);
+    NX_EXPECT_STREQ(buf, "hello w");
+    NX_EXPECT_EQ(NX_SNPrintf(buf, 1, "abc"), 3);
+    NX_EXPECT_STREQ(buf, "");
+    NX_EXPECT_EQ(NX_SNPrintf(NX_NULL, 0, "%d", 12345), 5);
+}
+
+#define SINK_BUF_LEN 256
+
+struct SinkBuf
+{
+    char buf[SINK_BUF_LEN];
+    NX_USize len;
+    int calls;
+};
+
+NX_PRIVATE void SinkBufPut(void *sinkArg, const char *str, NX_USize len)
+{
+    struct SinkBuf *sb = (struct SinkBuf *)sinkArg;
+    NX_MemCopy(sb->buf + sb->len, (void *)str, len);
+    sb->len += len;
+    sb->calls++;
+}
+
+NX_TEST(NX_SinkPrintf)
+{
+    struct SinkBuf sb;
+
+    sb.len = 0;
+    sb.calls = 0;
+    /* longer than a chunk, sink is called more than once */
+    NX_EXPECT_EQ(NX_SinkPrintf(SinkBufPut, &sb, "%100d|%-100s|", 7, "x"), 202);
+    sb.buf[sb.len] = '\0';
+    NX_EXPECT_EQ(sb.len, 202);
+    NX_EXPECT_GT(sb.calls, 1);
+    NX_EXPECT_EQ(sb.buf[98], ' ');
+    NX_EXPECT_EQ(sb.buf[99], '7');
+    NX_EXPECT_EQ(sb.buf[101], 'x');
+    NX_EXPECT_EQ(sb.buf[201], '|');
+}
+
+#define SPRINTF_BENCH_LOOPS 100000
+
+NX_TEST(SprintfBenchmark)
+{
+    NX_TimeVal begin, end;
+    char buf[128];
+    NX_USize sum = 0;
+    int i;
+
+    begin = NX_ClockTickGetMillisecond();
+    for (i = 0; i < SPRINTF_BENCH_LOOPS; i++)
+    {
+        sum += NX_SNPrintf(buf, sizeof(buf), "[%s-%s] value %d hex %08x tick %u", "INFO", "Bench", i, i, i);
+    }
+    end = NX_ClockTickGetMillisecond();
+
+    NX_EXPECT_GT(sum, 0);
+    NX_LOG_I("%d lines formatted in %d ms, %d bytes", SPRINTF_BENCH_LOOPS, (int)(end - begin), (int)sum);
+}
+
+NX_TEST_TABLE(Sprintf)
+{
+    NX_TEST_UNIT(NX_SNPrintfNumber),
+    NX_TEST_UNIT(NX_SNPrintfString),
+    NX_TEST_UNIT(NX_SNPrintfTruncate),
+    NX_TEST_UNIT(NX_SinkPrintf),
+    NX_TEST_UNIT(SprintfBenchmark),
+};
+
+NX_TEST_CASE(Sprintf);
+
+#endif
@@ -11,7 +11,11 @@
  */
 
 #include <utils/string.h>
+#include <utils/memory.h>
 #include <mods/test/utest.h>
+#include <mods/time/clock.h>
+#define NX_LOG_NAME "String"
+#include <utils/log.h>
 
 #ifdef CONFIG_NX_UTEST_UTILS_STRING
 
@@ -46,6 +50,97 @@ NX_TEST(NX_StrLen)
     NX_EXPECT_EQ(NX_StrLen(NX_NULL), 0);
     NX_EXPECT_NE(NX_StrLen(str), 0);
     NX_EXPECT_EQ(NX_StrLen(str), 6);
+    NX_EXPECT_EQ(NX_StrLen(""), 0);
+    NX_EXPECT_EQ(NX_StrLen(str + 3), 3);
+}
+
+NX_TEST(NX_StrNLen)
+{
+    const char *str = "hello, world!";
+    NX_EXPECT_EQ(NX_StrNLen(NX_NULL, 10), 0);
+    NX_EXPECT_EQ(NX_StrNLen(str, 0), 0);
+    NX_EXPECT_EQ(NX_StrNLen(str, 5), 5);
+    NX_EXPECT_EQ(NX_StrNLen(str, 13), 13);
+    NX_EXPECT_EQ(NX_StrNLen(str, 100), 13);
+    NX_EXPECT_EQ(NX_StrNLen(str + 1, 100), 12);
+}
+
+NX_TEST(NX_StrCopyN)
+{
+    const char *str = "hello, world!";
+    char buf[16] = {0};
+    NX_EXPECT_NULL(NX_StrCopyN(buf, str, 0));
+    NX_EXPECT_NULL(NX_StrCopyN(NX_NULL, str, 5));
+
+    /* never write more than len */
+    NX_MemSet(buf, 'x', sizeof(buf));
+    NX_EXPECT_NOT_NULL(NX_StrCopyN(buf, str, 5));
+    NX_EXPECT_EQ(NX_CompareN(buf, "hellox", 6), 0);
+
+    NX_MemSet(buf, 'x', sizeof(buf));
+    NX_EXPECT_NOT_NULL(NX_StrCopyN(buf, str, sizeof(buf)));
+    NX_EXPECT_STREQ(buf, str);
+    NX_EXPECT_EQ(buf[14], 'x');
+}
+
+NX_TEST(NX_StrLCopy)
+{
+    const char *str = "hello, world!";
+    char buf[8] = {0};
+    NX_EXPECT_EQ(NX_StrLCopy(NX_NULL, str, sizeof(buf)), 0);
+    NX_EXPECT_EQ(NX_StrLCopy(buf, NX_NULL, sizeof(buf)), 0);
+
+    NX_MemSet(buf, 'x', sizeof(buf));
+    NX_EXPECT_EQ(NX_StrLCopy(buf, str, 0), 13);
+    NX_EXPECT_EQ(buf[0], 'x');
+
+    NX_EXPECT_EQ(NX_StrLCopy(buf, str, sizeof(buf)), 13);
+    NX_EXPECT_STREQ(buf, "hello, ");
+
+    NX_EXPECT_EQ(NX_StrLCopy(buf, "hi", sizeof(buf)), 2);
+    NX_EXPECT_STREQ(buf, "hi");
+}
+
+#define STRING_BENCH_LEN    1000
+#define STRING_BENCH_LOOPS  10000
+
+NX_PRIVATE char StringBenchA[STRING_BENCH_LEN + 1];
+NX_PRIVATE char StringBenchB[STRING_BENCH_LEN + 1];
+
+NX_TEST(StringBenchmark)
+{
+    NX_TimeVal begin, lenDone, cmpDone, copyDone;
+    NX_USize sum[3] = {0};
+    int i;
+
+    NX_MemSet(StringBenchA, 'a', STRING_BENCH_LEN);
+    StringBenchA[STRING_BENCH_LEN] = '\0';
+
+    begin = NX_ClockTickGetMillisecond();
+    for (i = 0; i < STRING_BENCH_LOOPS; i++)
+    {
+        sum[0] += NX_StrLen(StringBenchA);
+    }
+    lenDone = NX_ClockTickGetMillisecond();
+    for (i = 0; i < STRING_BENCH_LOOPS; i++)
+    {
+        sum[1] += NX_StrLCopy(StringBenchB, StringBenchA, sizeof(StringBenchB));
+    }
+    copyDone = NX_ClockTickGetMillisecond();
+    for (i = 0; i < STRING_BENCH_LOOPS; i++)
+    {
+        sum[2] += NX_StrCmp(StringBenchA, StringBenchB);
+    }
+    cmpDone = NX_ClockTickGetMillisecond();
+
+    /* check results out of loops, not to time the checks */
+    NX_EXPECT_EQ(sum[0], STRING_BENCH_LEN * STRING_BENCH_LOOPS);
+    NX_EXPECT_EQ(sum[1], STRING_BENCH_LEN * STRING_BENCH_LOOPS);
+    NX_EXPECT_EQ(sum[2], 0);
+
+    NX_LOG_I("%d loops of %d bytes: len %d ms, lcopy %d ms, cmp %d ms",
+        STRING_BENCH_LOOPS, STRING_BENCH_LEN, (int)(lenDone - begin),
+        (int)(copyDone - lenDone), (int)(cmpDone - copyDone));
 }
 
 NX_TEST_TABLE(String)
@@ -53,6 +148,10 @@ NX_TEST_TABLE(String)
     NX_TEST_UNIT(NX_StrCmp),
     NX_TEST_UNIT(NX_StrCopy),
     NX_TEST_UNIT(NX_StrLen),
+    NX_TEST_UNIT(NX_StrNLen),
+    NX_TEST_UNIT(NX_StrCopyN),
+    NX_TEST_UNIT(NX_StrLCopy),
+    NX_TEST_UNIT(StringBenchmark),
 };
 
 NX_TEST_CASE(String);
@@ -12,17 +12,23 @@
  */
 
 #include <xbook.h>
+#include <utils/memory.h>
 
 /**
  * compatiable for gcc compiler with optimize
  */
-NX_PUBLIC void *memset(void *dst, NX_U8 value, NX_USize sz)
+NX_PUBLIC void *memset(void *dst, int value, NX_USize sz)
 {
-    NX_U8 *dstPtr = (NX_U8 *)dst;
-	while (sz > 0)
-    {
-		*dstPtr++ = value;
-		--sz;
-	}
-	return dst;
+    return NX_MemSet(dst, (NX_U8)value, sz);
+}
+
+NX_PUBLIC void *memcpy(void *dst, const void *src, NX_USize sz)
+{
+    NX_MemCopy(dst, (void *)src, sz);
+    return dst;
+}
+
+NX_PUBLIC void *memmove(void *dst, const void *src, NX_USize sz)
+{
+    return NX_MemMove(dst, src, sz);
 }
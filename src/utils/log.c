@@ -10,17 +10,396 @@
  */
 
 #include <utils/log.h>
+#include <utils/string.h>
+#include <utils/memory.h>
+#include <utils/var_args.h>
+#include <mods/console/console.h>
+#include <mods/time/clock.h>
 #include <sched/spin.h>
+#include <sched/smp.h>
+#include <sched/thread.h>
+#include <mm/barrier.h>
+#include <io/irq.h>
+#include <xbook/debug.h>
+
+#ifdef CONFIG_NX_LOG_RING_SIZE
+#define LOG_RING_SIZE CONFIG_NX_LOG_RING_SIZE
+#else
+#define LOG_RING_SIZE 8192
+#endif
+
+#ifdef CONFIG_NX_LOG_DRAIN_PERIOD
+#define LOG_DRAIN_PERIOD CONFIG_NX_LOG_DRAIN_PERIOD
+#else
+#define LOG_DRAIN_PERIOD 20
+#endif
+
+#if (LOG_RING_SIZE & (LOG_RING_SIZE - 1))
+#error "log ring size must be power of 2"
+#endif
+
+#ifdef NX_LOG_COLOR
+#define LOG_LINE_END "\033[0m" NX_CON_NEWLINE
+#else
+#define LOG_LINE_END NX_CON_NEWLINE
+#endif
+
+/* record output without time */
+#define LOG_RECORD_RAW 0x01
+
+/* line to output, args are used once */
+struct LogLine
+{
+    NX_U16 flags;
+    const char *logName;
+    const char *modName;
+    const char *color;
+    const char *fmt;
+    NX_VarList args;
+};
+typedef struct LogLine LogLine;
 
 /* spin lock for log output */
 NX_PRIVATE STATIC_SPIN_UNLOCKED(LogOutputLock);
 
-NX_PUBLIC NX_Error LogLineLock(NX_UArch *level)
+#ifdef CONFIG_NX_LOG_RING
+struct LogRecord
+{
+    NX_ClockTick tick;  /* time when logged */
+    NX_U16 length;      /* length of text after record */
+    NX_U16 flags;
+};
+typedef struct LogRecord LogRecord;
+
+#define LOG_RECORD_MAX_LEN 0xFFFF
+
+/**
+ * Only the cpu owns the ring writes it with interrupt disabled, only the
+ * drainer reads it, so no lock between them. head and tail increase
+ * forever, masked with ring size to get offset.
+ */
+struct LogRing
+{
+    NX_VOLATILE NX_USize head;  /* bytes written */
+    NX_VOLATILE NX_USize tail;  /* bytes read */
+    NX_Atomic dropped;          /* lines dropped when full */
+    NX_U8 buf[LOG_RING_SIZE];
+};
+typedef struct LogRing LogRing;
+
+/* line formatted to ring after the record reserved at head */
+struct LogWriter
+{
+    LogRing *ring;
+    NX_USize head;
+    NX_USize length;    /* text written */
+    NX_Bool full;       /* line does not fit, drop it */
+};
+typedef struct LogWriter LogWriter;
+
+NX_PRIVATE LogRing LogRingArray[NX_MULTI_CORES_NR];
+
+/**
+ * only one drainer at a time, writers never take it. a flag rather than a
+ * spin lock, so drain on slow console stays preemptible.
+ */
+NX_PRIVATE NX_Atomic LogDrainBusy = NX_ATOMIC_INIT_VALUE(0);
+
+/* lines are output directly until drain thread runs */
+NX_PRIVATE NX_VOLATILE NX_Bool LogRingOnline = NX_False;
+#endif
+
+NX_PRIVATE void LogOutputTime(NX_ClockTick tick)
 {
-    return NX_SpinLockIRQ(&LogOutputLock, level);
+#ifdef CONFIG_NX_DEBUG_TIMELINE
+    NX_TimeVal ms = NX_ClockTickToMillisecond(tick);
+    NX_Printf("[%10d.%03d] ", ms / 1000, ms % 1000);
+#endif
 }
 
-NX_PUBLIC NX_Error LogLineUnlock(NX_UArch level)
+/**
+ * Format line to sink, which is given chunks of text.
+ */
+NX_PRIVATE void LogFormat(NX_PrintSink sink, void *sinkArg, LogLine *line)
+{
+    if (line->flags & LOG_RECORD_RAW)
+    {
+        NX_VSinkPrintf(sink, sinkArg, line->fmt, line->args);
+        return;
+    }
+#ifdef NX_LOG_COLOR
+    NX_SinkPrintf(sink, sinkArg, "\033[%sm[%s-%s] ", line->color, line->logName, line->modName);
+#else
+    NX_SinkPrintf(sink, sinkArg, "[%s-%s] ", line->logName, line->modName);
+#endif
+    NX_VSinkPrintf(sink, sinkArg, line->fmt, line->args);
+    sink(sinkArg, LOG_LINE_END, sizeof(LOG_LINE_END) - 1);
+}
+
+NX_PRIVATE void LogConsoleSink(void *sinkArg, const char *str, NX_USize len)
+{
+    NX_ConsoleOutBuf(str, len);
+}
+
+NX_PRIVATE void LogOutputDirect(LogLine *line)
+{
+    NX_UArch level;
+
+    NX_SpinLockIRQ(&LogOutputLock, &level);
+    if (!(line->flags & LOG_RECORD_RAW))
+    {
+        LogOutputTime(NX_ClockTickGet());
+    }
+    LogFormat(LogConsoleSink, NX_NULL, line);
+    NX_SpinUnlockIRQ(&LogOutputLock, level);
+}
+
+#ifdef CONFIG_NX_LOG_RING
+NX_PRIVATE void LogRingCopyIn(LogRing *ring, NX_USize pos, const void *data, NX_USize len)
+{
+    NX_USize off = pos & (LOG_RING_SIZE - 1);
+    NX_USize first = LOG_RING_SIZE - off;
+
+    if (first >= len)
+    {
+        NX_MemCopy(ring->buf + off, (void *)data, len);
+        return;
+    }
+    NX_MemCopy(ring->buf + off, (void *)data, first);
+    NX_MemCopy(ring->buf, (NX_U8 *)data + first, len - first);
+}
+
+NX_PRIVATE void LogRingCopyOut(LogRing *ring, NX_USize pos, void *data, NX_USize len)
+{
+    NX_USize off = pos & (LOG_RING_SIZE - 1);
+    NX_USize first = LOG_RING_SIZE - off;
+
+    if (first >= len)
+    {
+        NX_MemCopy(data, ring->buf + off, len);
+        return;
+    }
+    NX_MemCopy(data, ring->buf + off, first);
+    NX_MemCopy((NX_U8 *)data + first, ring->buf, len - first);
+}
+
+NX_PRIVATE void LogRingOutput(LogRing *ring, NX_USize pos, NX_USize len)
+{
+    NX_USize off = pos & (LOG_RING_SIZE - 1);
+    NX_USize first = LOG_RING_SIZE - off;
+
+    if (first >= len)
+    {
+        NX_ConsoleOutBuf((const char *)ring->buf + off, len);
+        return;
+    }
+    NX_ConsoleOutBuf((const char *)ring->buf + off, first);
+    NX_ConsoleOutBuf((const char *)ring->buf, len - first);
+}
+
+NX_PRIVATE void LogRingSink(void *sinkArg, const char *str, NX_USize len)
+{
+    LogWriter *writer = (LogWriter *)sinkArg;
+    NX_USize used;
+
+    if (writer->full)
+    {
+        return;
+    }
+    used = writer->head + sizeof(LogRecord) + writer->length - writer->ring->tail;
+    if (LOG_RING_SIZE - used < len || writer->length + len > LOG_RECORD_MAX_LEN)
+    {
+        writer->full = NX_True;
+        return;
+    }
+    LogRingCopyIn(writer->ring, writer->head + sizeof(LogRecord) + writer->length, str, len);
+    writer->length += len;
+}
+
+/**
+ * Format line in ring, published after whole line written.
+ */
+NX_PRIVATE void LogRingWrite(LogLine *line)
+{
+    LogWriter writer;
+    LogRecord record;
+    NX_UArch level;
+
+    record.tick = NX_ClockTickGet();
+    record.flags = line->flags;
+
+    level = NX_IRQ_SaveLevel();
+    writer.ring = &LogRingArray[NX_SMP_GetIdx()];
+    writer.head = writer.ring->head;
+    writer.length = 0;
+    writer.full = LOG_RING_SIZE - (writer.head - writer.ring->tail) < sizeof(LogRecord);
+    if (!writer.full)
+    {
+        LogFormat(LogRingSink, &writer, line);
+    }
+    if (writer.full)
+    {
+        /* never wait for console, drop the line */
+        NX_AtomicInc(&writer.ring->dropped);
+    }
+    else
+    {
+        record.length = writer.length;
+        LogRingCopyIn(writer.ring, writer.head, &record, sizeof(LogRecord));
+        NX_MemoryBarrier(); /* line written before published */
+        writer.ring->head = writer.head + sizeof(LogRecord) + writer.length;
+    }
+    NX_IRQ_RestoreLevel(level);
+}
+
+NX_PRIVATE NX_Bool LogRingPeek(LogRing *ring, LogRecord *record)
+{
+    if (ring->tail == ring->head)
+    {
+        return NX_False;
+    }
+    NX_MemoryBarrier(); /* read line after head */
+    LogRingCopyOut(ring, ring->tail, record, sizeof(LogRecord));
+    return NX_True;
+}
+
+/**
+ * Output lines of all rings in time order, until all rings empty.
+ */
+NX_PRIVATE void LogDrainRings(void)
+{
+    LogRing *ring;
+    LogRing *oldest;
+    LogRecord record;
+    LogRecord oldestRecord;
+    NX_IArch dropped;
+    int i;
+
+    while (1)
+    {
+        oldest = NX_NULL;
+        for (i = 0; i < NX_MULTI_CORES_NR; i++)
+        {
+            ring = &LogRingArray[i];
+            if (LogRingPeek(ring, &record) && (oldest == NX_NULL || record.tick < oldestRecord.tick))
+            {
+                oldest = ring;
+                oldestRecord = record;
+            }
+        }
+        if (oldest == NX_NULL)
+        {
+            break;
+        }
+
+        if (!(oldestRecord.flags & LOG_RECORD_RAW))
+        {
+            LogOutputTime(oldestRecord.tick);
+        }
+        /* output from ring, space is released after */
+        LogRingOutput(oldest, oldest->tail + sizeof(LogRecord), oldestRecord.length);
+        NX_MemoryBarrier(); /* line read before space released */
+        oldest->tail += sizeof(LogRecord) + oldestRecord.length;
+    }
+
+    for (i = 0; i < NX_MULTI_CORES_NR; i++)
+    {
+        dropped = NX_AtomicSwap(&LogRingArray[i].dropped, 0);
+        if (dropped > 0)
+        {
+            NX_Printf("[LOG] %d lines dropped on core %d" NX_CON_NEWLINE, dropped, i);
+        }
+    }
+}
+#endif
+
+NX_PRIVATE void LogPut(LogLine *line)
+{
+#ifdef CONFIG_NX_LOG_RING
+    if (LogRingOnline)
+    {
+        LogRingWrite(line);
+        return;
+    }
+#endif
+    LogOutputDirect(line);
+}
+
+NX_PUBLIC void NX_LogLine(const char *logName, const char *modName, const char *color, const char *fmt, ...)
+{
+    LogLine line;
+
+    line.flags = 0;
+    line.logName = logName;
+    line.modName = modName;
+    line.color = color;
+    line.fmt = fmt;
+    NX_VarStart(line.args, fmt);
+    LogPut(&line);
+    NX_VarEnd(line.args);
+}
+
+NX_PUBLIC void NX_LogRaw(const char *fmt, ...)
+{
+    LogLine line;
+
+    line.flags = LOG_RECORD_RAW;
+    line.logName = NX_NULL;
+    line.modName = NX_NULL;
+    line.color = NX_NULL;
+    line.fmt = fmt;
+    NX_VarStart(line.args, fmt);
+    LogPut(&line);
+    NX_VarEnd(line.args);
+}
+
+/**
+ * Output lines in rings to console. Return at once if other is draining.
+ */
+NX_PUBLIC void NX_LogDrain(void)
+{
+#ifdef CONFIG_NX_LOG_RING
+    if (NX_AtomicCAS(&LogDrainBusy, 0, 1) != 0)
+    {
+        return;
+    }
+    LogDrainRings();
+    NX_AtomicSet(&LogDrainBusy, 0);
+#endif
+}
+
+/**
+ * Output lines in rings at once when panic, lines after are output directly.
+ * Drain flag is ignored, the core holds it may never run again.
+ */
+NX_PUBLIC void NX_LogPanicDump(void)
+{
+#ifdef CONFIG_NX_LOG_RING
+    LogRingOnline = NX_False;
+    LogDrainRings();
+#endif
+}
+
+#ifdef CONFIG_NX_LOG_RING
+NX_PRIVATE void LogDrainThreadEntry(void *arg)
+{
+    LogRingOnline = NX_True;
+    while (1)
+    {
+        NX_LogDrain();
+        NX_ThreadSleep(LOG_DRAIN_PERIOD);
+    }
+}
+#endif
+
+/**
+ * Start drain thread, lines are put to rings after it runs.
+ */
+NX_PUBLIC void NX_LogInit(void)
 {
-    return NX_SpinUnlockIRQ(&LogOutputLock, level);
+#ifdef CONFIG_NX_LOG_RING
+    NX_Thread *thread = NX_ThreadCreate("LogDrain", LogDrainThreadEntry, NX_NULL);
+    NX_ASSERT(thread != NX_NULL);
+    NX_ASSERT(NX_ThreadRun(thread) == NX_EOK);
+#endif
 }
@@ -10,10 +10,66 @@
  */
 
 #include <utils/memory.h>
+#include <mem_ops.h>    /* Platform word copy & set */
+
+/* byte loops here must not be replaced with calls to memset & memcpy */
+#pragma GCC optimize("no-tree-loop-distribute-patterns")
+
+#define WORD_SIZE   sizeof(NX_UArch)
+#define WORD_MASK   (WORD_SIZE - 1)
+
+/* smaller size is done with bytes, aligning costs more than it saves */
+#define MEM_SMALL_SIZE (WORD_SIZE * 2)
+
+/* word may alias any type */
+typedef NX_UArch __attribute__((__may_alias__)) MemWord;
+
+/* word path is used if both aligned after the same bytes of head */
+#define MEM_WORD_COPYABLE(dst, src) \
+    (HAL_MEM_UNALIGNED_ACCESS || !(((NX_Addr)(dst) ^ (NX_Addr)(src)) & WORD_MASK))
+
+/**
+ * copy words from src not aligned to dst aligned, read aligned words of
+ * src and merge them with shift, little endian only.
+ * Never read the word after the one holding the last byte of src.
+ */
+NX_PRIVATE void MemCopyShift(NX_U8 *dst, const NX_U8 *src, NX_USize words)
+{
+    NX_USize shift = ((NX_Addr)src & WORD_MASK) * 8;
+    const MemWord *srcWord = (const MemWord *)((NX_Addr)src & ~WORD_MASK);
+    MemWord *dstWord = (MemWord *)dst;
+    NX_UArch low = *srcWord++;
+    NX_UArch high;
+
+    while (words-- > 0)
+    {
+        high = *srcWord++;
+        *dstWord++ = (low >> shift) | (high << (WORD_SIZE * 8 - shift));
+        low = high;
+    }
+}
 
 NX_PUBLIC void *NX_MemSet(void *dst, NX_U8 value, NX_USize sz)
 {
     NX_U8 *dstPtr = (NX_U8 *)dst;
+    NX_UArch pattern;
+    NX_USize head;
+
+    if (sz >= MEM_SMALL_SIZE)
+    {
+        head = (-(NX_Addr)dstPtr) & WORD_MASK;
+        sz -= head;
+        while (head-- > 0)
+        {
+            *dstPtr++ = value;
+        }
+
+        pattern = (NX_UArch)value * ((NX_UArch)-1 / 0xFF); /* value in each byte */
+        HAL_MemSetWords(dstPtr, pattern, sz / WORD_SIZE);
+        dstPtr += sz & ~WORD_MASK;
+        sz &= WORD_MASK;
+    }
+
 	while (sz > 0)
     {
 		*dstPtr++ = value;
@@ -26,12 +82,76 @@ NX_PUBLIC void NX_MemCopy(void *dst, void *src, NX_USize sz)
 {
     NX_U8 *dstPtr = (NX_U8 *)dst;
     NX_U8 *srcPtr = (NX_U8 *)src;
+    NX_USize head;
+
+    if (sz >= MEM_SMALL_SIZE)
+    {
+        /* align dst first, stores are more costly than loads */
+        head = (-(NX_Addr)dstPtr) & WORD_MASK;
+        sz -= head;
+        while (head-- > 0)
+        {
+            *dstPtr++ = *srcPtr++;
+        }
+
+        if (MEM_WORD_COPYABLE(dstPtr, srcPtr))
+        {
+            HAL_MemCopyWords(dstPtr, srcPtr, sz / WORD_SIZE);
+        }
+        else
+        {
+            MemCopyShift(dstPtr, srcPtr, sz / WORD_SIZE);
+        }
+        dstPtr += sz & ~WORD_MASK;
+        srcPtr += sz & ~WORD_MASK;
+        sz &= WORD_MASK;
+    }
+
     while (sz-- > 0)
     {
         *dstPtr++ = *srcPtr++;
     }
 }
 
+/**
+ * Copy with overlap allowed. Copy forward if dst is lower than src,
+ * otherwise copy backward from the end.
+ */
+NX_PUBLIC void *NX_MemMove(void *dst, const void *src, NX_USize sz)
+{
+    NX_U8 *dstPtr = (NX_U8 *)dst + sz;
+    const NX_U8 *srcPtr = (const NX_U8 *)src + sz;
+
+    if ((NX_Addr)dst <= (NX_Addr)src || (NX_Addr)dst >= (NX_Addr)srcPtr)
+    {
+        /* forward copy never overwrites src not read yet */
+        NX_MemCopy(dst, (void *)src, sz);
+        return dst;
+    }
+
+    if (sz >= MEM_SMALL_SIZE && MEM_WORD_COPYABLE(dstPtr, srcPtr))
+    {
+        while ((NX_Addr)dstPtr & WORD_MASK)
+        {
+            *--dstPtr = *--srcPtr;
+            sz--;
+        }
+        while (sz >= WORD_SIZE)
+        {
+            dstPtr -= WORD_SIZE;
+            srcPtr -= WORD_SIZE;
+            *(MemWord *)dstPtr = *(const MemWord *)srcPtr;
+            sz -= WORD_SIZE;
+        }
+    }
+
+    while (sz-- > 0)
+    {
+        *--dstPtr = *--srcPtr;
+    }
+    return dst;
+}
+
 NX_PUBLIC void *NX_MemZero(void *dst, NX_USize sz)
 {
     return NX_MemSet(dst, 0, sz);
@@ -39,15 +159,36 @@ NX_PUBLIC void *NX_MemZero(void *dst, NX_USize sz)
 
 NX_PUBLIC int NX_CompareN(const void *s1, const void *s2, NX_USize nBytes)
 {
-	if ((s1 == 0) || (s2 == 0)) 
+	if ((s1 == 0) || (s2 == 0))
     {
 		return (s1 - s2);
 	}
 
 	const char *p1 = (const char *)s1;
 	const char *p2 = (const char *)s2;
-	int i;
-	for (i = 0; i < nBytes; i++,p1++,p2++)
+
+    if (nBytes >= MEM_SMALL_SIZE && MEM_WORD_COPYABLE(p1, p2))
+    {
+        while ((NX_Addr)p1 & WORD_MASK)
+        {
+            if (*p1 != *p2)
+            {
+                return (*p1 - *p2);
+            }
+            p1++;
+            p2++;
+            nBytes--;
+        }
+        /* skip equal words, the first different word is compared with bytes */
+        while (nBytes >= WORD_SIZE && *(const MemWord *)p1 == *(const MemWord *)p2)
+        {
+            p1 += WORD_SIZE;
+            p2 += WORD_SIZE;
+            nBytes -= WORD_SIZE;
+        }
+    }
+
+	for (; nBytes > 0; nBytes--, p1++, p2++)
     {
 		if (*p1 != *p2)
         {
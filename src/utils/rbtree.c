@@ -0,0 +1,357 @@
+/**
+ * Copyright (c) 2018-2022, BookOS Development Team
+ * SPDX-License-Identifier: Apache-2.0
+ * 
+ * Contains: Red-black tree utils
+ */
+
+#include <utils/rbtree.h>
+
+NX_PRIVATE void RbRotateLeft(NX_RbNode *node, NX_RbRoot *root)
+{
+    NX_RbNode *right = node->right;
+    NX_RbNode *parent = node->parent;
+
+    node->right = right->left;
+    if (right->left != NX_NULL)
+    {
+        right->left->parent = node;
+    }
+    right->left = node;
+    right->parent = parent;
+
+    if (parent == NX_NULL)
+    {
+        root->node = right;
+    }
+    else if (parent->left == node)
+    {
+        parent->left = right;
+    }
+    else
+    {
+        parent->right = right;
+    }
+    node->parent = right;
+}
+
+NX_PRIVATE void RbRotateRight(NX_RbNode *node, NX_RbRoot *root)
+{
+    NX_RbNode *left = node->left;
+    NX_RbNode *parent = node->parent;
+
+    node->left = left->right;
+    if (left->right != NX_NULL)
+    {
+        left->right->parent = node;
+    }
+    left->right = node;
+    left->parent = parent;
+
+    if (parent == NX_NULL)
+    {
+        root->node = left;
+    }
+    else if (parent->right == node)
+    {
+        parent->right = left;
+    }
+    else
+    {
+        parent->left = left;
+    }
+    node->parent = left;
+}
+
+NX_INLINE NX_Bool RbIsBlack(NX_RbNode *node)
+{
+    return node == NX_NULL || node->color == NX_RB_BLACK;
+}
+
+/**
+ * rebalance after node linked as red leaf
+ */
+NX_PUBLIC void NX_RbInsertColor(NX_RbNode *node, NX_RbRoot *root)
+{
+    NX_RbNode *parent, *gparent, *uncle, *tmp;
+
+    while ((parent = node->parent) != NX_NULL && parent->color == NX_RB_RED)
+    {
+        gparent = parent->parent;   /* red parent is never root */
+
+        if (parent == gparent->left)
+        {
+            uncle = gparent->right;
+            if (!RbIsBlack(uncle))
+            {
+                uncle->color = NX_RB_BLACK;
+                parent->color = NX_RB_BLACK;
+                gparent->color = NX_RB_RED;
+                node = gparent;
+                continue;
+            }
+            if (parent->right == node)
+            {
+                RbRotateLeft(parent, root);
+                tmp = parent;
+                parent = node;
+                node = tmp;
+            }
+            parent->color = NX_RB_BLACK;
+            gparent->color = NX_RB_RED;
+            RbRotateRight(gparent, root);
+        }
+        else
+        {
+            uncle = gparent->left;
+            if (!RbIsBlack(uncle))
+            {
+                uncle->color = NX_RB_BLACK;
+                parent->color = NX_RB_BLACK;
+                gparent->color = NX_RB_RED;
+                node = gparent;
+                continue;
+            }
+            if (parent->left == node)
+            {
+                RbRotateRight(parent, root);
+                tmp = parent;
+                parent = node;
+                node = tmp;
+            }
+            parent->color = NX_RB_BLACK;
+            gparent->color = NX_RB_RED;
+            RbRotateLeft(gparent, root);
+        }
+    }
+    root->node->color = NX_RB_BLACK;
+}
+
+/**
+ * rebalance after a black node removed, node takes the extra black
+ */
+NX_PRIVATE void RbEraseColor(NX_RbNode *node, NX_RbNode *parent, NX_RbRoot *root)
+{
+    NX_RbNode *sibling;
+
+    while (node != root->node && RbIsBlack(node))
+    {
+        if (parent->left == node)
+        {
+            sibling = parent->right;
+            if (sibling->color == NX_RB_RED)
+            {
+                sibling->color = NX_RB_BLACK;
+                parent->color = NX_RB_RED;
+                RbRotateLeft(parent, root);
+                sibling = parent->right;
+            }
+            if (RbIsBlack(sibling->left) && RbIsBlack(sibling->right))
+            {
+                sibling->color = NX_RB_RED;
+                node = parent;
+                parent = node->parent;
+                continue;
+            }
+            if (RbIsBlack(sibling->right))
+            {
+                sibling->left->color = NX_RB_BLACK;
+                sibling->color = NX_RB_RED;
+                RbRotateRight(sibling, root);
+                sibling = parent->right;
+            }
+            sibling->color = parent->color;
+            parent->color = NX_RB_BLACK;
+            sibling->right->color = NX_RB_BLACK;
+            RbRotateLeft(parent, root);
+            node = root->node;
+        }
+        else
+        {
+            sibling = parent->left;
+            if (sibling->color == NX_RB_RED)
+            {
+                sibling->color = NX_RB_BLACK;
+                parent->color = NX_RB_RED;
+                RbRotateRight(parent, root);
+                sibling = parent->left;
+            }
+            if (RbIsBlack(sibling->left) && RbIsBlack(sibling->right))
+            {
+                sibling->color = NX_RB_RED;
+                node = parent;
+                parent = node->parent;
+                continue;
+            }
+            if (RbIsBlack(sibling->left))
+            {
+                sibling->right->color = NX_RB_BLACK;
+                sibling->color = NX_RB_RED;
+                RbRotateLeft(sibling, root);
+                sibling = parent->left;
+            }
+            sibling->color = parent->color;
+            parent->color = NX_RB_BLACK;
+            sibling->left->color = NX_RB_BLACK;
+            RbRotateRight(parent, root);
+            node = root->node;
+        }
+    }
+    if (node != NX_NULL)
+    {
+        node->color = NX_RB_BLACK;
+    }
+}
+
+NX_PUBLIC void NX_RbErase(NX_RbNode *node, NX_RbRoot *root)
+{
+    NX_RbNode *child, *parent, *old;
+    int color;
+
+    if (node->left != NX_NULL && node->right != NX_NULL)
+    {
+        /* replace node with its successor, then remove successor position */
+        old = node;
+        node = node->right;
+        while (node->left != NX_NULL)
+        {
+            node = node->left;
+        }
+
+        if (old->parent == NX_NULL)
+        {
+            root->node = node;
+        }
+        else if (old->parent->left == old)
+        {
+            old->parent->left = node;
+        }
+        else
+        {
+            old->parent->right = node;
+        }
+
+        child = node->right;
+        parent = node->parent;
+        color = node->color;
+
+        if (parent == old)
+        {
+            parent = node;
+        }
+        else
+        {
+            if (child != NX_NULL)
+            {
+                child->parent = parent;
+            }
+            parent->left = child;
+
+            node->right = old->right;
+            old->right->parent = node;
+        }
+
+        node->parent = old->parent;
+        node->color = old->color;
+        node->left = old->left;
+        old->left->parent = node;
+    }
+    else
+    {
+        child = node->left != NX_NULL ? node->left : node->right;
+        parent = node->parent;
+        color = node->color;
+
+        if (child != NX_NULL)
+        {
+            child->parent = parent;
+        }
+        if (parent == NX_NULL)
+        {
+            root->node = child;
+        }
+        else if (parent->left == node)
+        {
+            parent->left = child;
+        }
+        else
+        {
+            parent->right = child;
+        }
+    }
+
+    if (color == NX_RB_BLACK)
+    {
+        RbEraseColor(child, parent, root);
+    }
+}
+
+NX_PUBLIC NX_RbNode *NX_RbFirst(NX_RbRoot *root)
+{
+    NX_RbNode *node = root->node;
+    if (node == NX_NULL)
+    {
+        return NX_NULL;
+    }
+    while (node->left != NX_NULL)
+    {
+        node = node->left;
+    }
+    return node;
+}
+
+NX_PUBLIC NX_RbNode *NX_RbLast(NX_RbRoot *root)
+{
+    NX_RbNode *node = root->node;
+    if (node == NX_NULL)
+    {
+        return NX_NULL;
+    }
+    while (node->right != NX_NULL)
+    {
+        node = node->right;
+    }
+    return node;
+}
+
+NX_PUBLIC NX_RbNode *NX_RbNext(NX_RbNode *node)
+{
+    NX_RbNode *parent;
+
+    if (node->right != NX_NULL)
+    {
+        node = node->right;
+        while (node->left != NX_NULL)
+        {
+            node = node->left;
+        }
+        return node;
+    }
+    /* go up until come from left */
+    while ((parent = node->parent) != NX_NULL && node == parent->right)
+    {
+        node = parent;
+    }
+    return parent;
+}
+
+NX_PUBLIC NX_RbNode *NX_RbPrev(NX_RbNode *node)
+{
+    NX_RbNode *parent;
+
+    if (node->left != NX_NULL)
+    {
+        node = node->left;
+        while (node->right != NX_NULL)
+        {
+            node = node->right;
+        }
+        return node;
+    }
+    /* go up until come from right */
+    while ((parent = node->parent) != NX_NULL && node == parent->left)
+    {
+        node = parent;
+    }
+    return parent;
+}
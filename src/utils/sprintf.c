@@ -23,330 +23,447 @@
 
 #define IsDigit(c)	((c) >= '0' && (c) <= '9')
 
+/* octal of 64 bits is the longest number */
+#define NUMBER_BUF_LEN  24
+
+/* chars collected before given to sink */
+#define PRINT_CHUNK_LEN 64
+
+NX_PRIVATE const char DigitPairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+NX_PRIVATE const char DigitsLarge[] = "0123456789ABCDEF";
+NX_PRIVATE const char DigitsSmall[] = "0123456789abcdef";
+
+/**
+ * Chars are written to [pos, end) with no call, given to sink when full.
+ * Window is the chunk, or the caller buffer of NX_VSNPrintf, which is not
+ * copied again.
+ */
+struct PrintState
+{
+    char *base;
+    char *pos;
+    char *end;
+    NX_PrintSink sink;  /* NX_NULL to drop chars */
+    void *sinkArg;
+    int count;          /* chars given to sink */
+    char chunk[PRINT_CHUNK_LEN];
+};
+typedef struct PrintState PrintState;
+
 NX_PRIVATE int SkipAscii2Int(const char **s)
 {
-	int i = 0;
-	while (IsDigit(**s))
+    int i = 0;
+    while (IsDigit(**s))
+    {
+        i = i * 10 + *((*s)++) - '0';
+    }
+    return i;
+}
+
+NX_PRIVATE void PrintFlush(PrintState *state)
+{
+    NX_USize len = state->pos - state->base;
+
+    if (state->sink != NX_NULL && len > 0)
     {
-		i = i * 10 + *((*s)++) - '0';
+        state->sink(state->sinkArg, state->base, len);
     }
-	return i;
+    state->count += len;
+    state->base = state->pos = state->chunk;
+    state->end = state->chunk + PRINT_CHUNK_LEN;
 }
 
-NX_PRIVATE int _Div(unsigned long *num, char base) 
+/**
+ * Return room in window, flush it if full. Window is never empty after.
+ */
+NX_INLINE NX_USize PrintRoom(PrintState *state)
 {
-    int ret = *num % base;
-    *num = *num / base;
-    return ret;
+    if (state->pos == state->end)
+    {
+        PrintFlush(state);
+    }
+    return state->end - state->pos;
 }
 
-NX_PRIVATE char *_Number(char * str, long num, int base, int size, int precision,	int type)
+NX_INLINE void PrintOut(PrintState *state, const char *str, NX_USize len)
 {
-	char c, sign, tmp[50];
-	const char *digits = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
-	int i;
+    NX_USize room;
+    char *pos;
 
-	if (type & SMALL)
+    while (len > 0)
     {
-        digits = "0123456789abcdefghijklmnopqrstuvwxyz";
+        room = PrintRoom(state);
+        if (room > len)
+        {
+            room = len;
+        }
+        len -= room;
+        /* copy with local pointer, writes do not reload state */
+        for (pos = state->pos; room > 0; room--)
+        {
+            *pos++ = *str++;
+        }
+        state->pos = pos;
     }
-    if (type & LEFT)
+}
+
+NX_INLINE void PrintPad(PrintState *state, char ch, int len)
+{
+    NX_USize room;
+    char *pos;
+
+    while (len > 0)
     {
-        type &= ~ZEROPAD;
+        room = PrintRoom(state);
+        if (room > (NX_USize)len)
+        {
+            room = len;
+        }
+        len -= room;
+        for (pos = state->pos; room > 0; room--)
+        {
+            *pos++ = ch;
+        }
+        state->pos = pos;
     }
-	if (base < 2 || base > 36)
+}
+
+/**
+ * Copy str until NUL, stop char or maxLen chars, return chars copied.
+ */
+NX_INLINE int PrintStr(PrintState *state, const char *str, NX_USize maxLen, char stop)
+{
+    const char *begin = str;
+    NX_USize room;
+    char *pos;
+
+    while (maxLen > 0 && *str && *str != stop)
     {
-		return 0;
+        room = PrintRoom(state);
+        if (room > maxLen)
+        {
+            room = maxLen;
+        }
+        maxLen -= room;
+        for (pos = state->pos; room > 0 && *str && *str != stop; room--)
+        {
+            *pos++ = *str++;
+        }
+        state->pos = pos;
     }
+    return str - begin;
+}
+
+/**
+ * Write decimal digits backward from end, two digits for one division.
+ * Return digits written.
+ */
+NX_PRIVATE int FormatDecimal(char *end, unsigned long num)
+{
+    char *p = end;
+    unsigned long pair;
 
-	c = (type & ZEROPAD) ? '0' : ' ' ;
-	sign = 0;
-	if ((type & SIGN) && num < 0)
+    while (num >= 100)
     {
-		sign='-';
-		num = -num;
-	}
+        pair = (num % 100) * 2;
+        num /= 100;
+        p -= 2;
+        p[0] = DigitPairs[pair];
+        p[1] = DigitPairs[pair + 1];
+    }
+    if (num >= 10)
+    {
+        p -= 2;
+        p[0] = DigitPairs[num * 2];
+        p[1] = DigitPairs[num * 2 + 1];
+    }
     else
     {
-		sign = (type & PLUS) ? '+' : ((type & SPACE) ? ' ' : 0);
+        *--p = '0' + num;
     }
+    return end - p;
+}
+
+/**
+ * Write digits of base 8 or 16 backward from end with shift and mask.
+ * Return digits written.
+ */
+NX_PRIVATE int FormatPower2(char *end, unsigned long num, int shift, const char *digits)
+{
+    char *p = end;
+    unsigned long mask = (1UL << shift) - 1;
 
-	if (sign)
+    do
     {
-        size--;
+        *--p = digits[num & mask];
+        num >>= shift;
+    } while (num != 0);
+    return end - p;
+}
+
+NX_PRIVATE void PrintNumber(PrintState *state, unsigned long num, int base, int size, int precision, int type)
+{
+    char tmp[NUMBER_BUF_LEN];
+    char *end = tmp + NUMBER_BUF_LEN;
+    const char *digits = (type & SMALL) ? DigitsSmall : DigitsLarge;
+    char prefix[3];
+    int prefixLen = 0;
+    int i;
+
+    if (type & LEFT)
+    {
+        type &= ~ZEROPAD;
     }
 
-	if (type & SPECIAL)
+    if (type & SIGN)
     {
-        if (base == 16)
+        if ((long)num < 0)
         {
-            size -= 2;
+            prefix[prefixLen++] = '-';
+            num = -num;
         }
-		else if (base == 8)
+        else if (type & PLUS)
         {
-            size--;
+            prefix[prefixLen++] = '+';
         }
-    }
-    i = 0;
-	if (num == 0)
-    {
-		tmp[i++]='0';
-    }
-	else
-    {
-        while (num!=0)
+        else if (type & SPACE)
         {
-		    tmp[i++] = digits[_Div((unsigned long *)&num, base)];
+            prefix[prefixLen++] = ' ';
         }
     }
-    if (i > precision)
-    {
-        precision = i;
-    }
-	size -= precision;
-	if (!(type & (ZEROPAD + LEFT)))
+
+    /* zero has no prefix, it is the same in octal */
+    if ((type & SPECIAL) && num != 0)
     {
-        while(size-- > 0)
+        if (base == 16)
+        {
+            prefix[prefixLen++] = '0';
+            prefix[prefixLen++] = (type & SMALL) ? 'x' : 'X';
+        }
+        else if (base == 8)
         {
-			*str++ = ' ';
+            prefix[prefixLen++] = '0';
         }
     }
-    if (sign)
+
+    if (base == 10)
     {
-		*str++ = sign;
+        i = FormatDecimal(end, num);
     }
-	if (type & SPECIAL)
+    else
     {
-        if (base == 8)
-        {
-			*str++ = '0';
-        }
-		else if (base == 16) 
-		{
-			*str++ = '0';
-			*str++ = digits[33];
-		}
+        i = FormatPower2(end, num, base == 16 ? 4 : 3, digits);
     }
-    if (!(type & LEFT))
+
+    if (i > precision)
     {
-        while(size-- > 0)
-        {
-			*str++ = c;
-        }
+        precision = i;
     }
-		
-	while(i < precision--)
+    size -= precision + prefixLen;
+
+    if (!(type & (ZEROPAD | LEFT)))
     {
-		*str++ = '0';
+        PrintPad(state, ' ', size);
     }
-	while(i-- > 0)
+    PrintOut(state, prefix, prefixLen);
+    if (type & ZEROPAD)
     {
-		*str++ = tmp[i];
+        PrintPad(state, '0', size);
     }
-	while(size-- > 0)
+    PrintPad(state, '0', precision - i);
+    PrintOut(state, end - i, i);
+    if (type & LEFT)
     {
-		*str++ = ' ';
+        PrintPad(state, ' ', size);
     }
-	return str;
 }
 
-NX_PUBLIC int NX_VSNPrintf(char *buf, int bufLen, const char *fmt, NX_VarList args)
+NX_PRIVATE void PrintFormat(PrintState *state, const char *fmt, NX_VarList args)
 {
-	char *str, *s;
-	int flags;
-	int fieldWidth;
-	int precision;
-	int len, i;
-	int qualifier;		/* 'h', 'l', 'L' or 'Z' for integer fields */
-
-	for(str = buf; *fmt && bufLen--; fmt++)
-	{
-		if(*fmt != '%')
-		{
-			*str++ = *fmt;
-			continue;
-		}
-		flags = 0;
+    const char *s;
+    char ch;
+    int flags;
+    int fieldWidth;
+    int precision;
+    int len;
+    int qualifier;		/* 'h', 'l', 'L' or 'Z' for integer fields */
+    unsigned long num;
+
+    while (*fmt)
+    {
+        /* text before conversion is copied in the same pass as searching */
+        fmt += PrintStr(state, fmt, (NX_USize)-1, '%');
+        if (*fmt == '\0')
+        {
+            break;
+        }
+
+        flags = 0;
     repeat:
         fmt++;
-        switch(*fmt)
+        switch (*fmt)
         {
-        case '-':flags |= LEFT;	
+        case '-':flags |= LEFT;
             goto repeat;
-        case '+':flags |= PLUS;	
+        case '+':flags |= PLUS;
             goto repeat;
-        case ' ':flags |= SPACE;	
+        case ' ':flags |= SPACE;
             goto repeat;
-        case '#':flags |= SPECIAL;	
+        case '#':flags |= SPECIAL;
             goto repeat;
-        case '0':flags |= ZEROPAD;	
+        case '0':flags |= ZEROPAD;
             goto repeat;
         }
 
         /* get field width */
         fieldWidth = -1;
-        if(IsDigit(*fmt))
+        if (IsDigit(*fmt))
         {
             fieldWidth = SkipAscii2Int(&fmt);
         }
-        else if(*fmt == '*')
+        else if (*fmt == '*')
         {
             fmt++;
             fieldWidth = NX_VarArg(args, int);
-            if(fieldWidth < 0)
+            if (fieldWidth < 0)
             {
                 fieldWidth = -fieldWidth;
                 flags |= LEFT;
             }
         }
-        
+
         /* get the precision */
         precision = -1;
-        if(*fmt == '.')
+        if (*fmt == '.')
         {
             fmt++;
-            if(IsDigit(*fmt))
+            if (IsDigit(*fmt))
             {
                 precision = SkipAscii2Int(&fmt);
             }
-            else if(*fmt == '*')
-            {	
+            else if (*fmt == '*')
+            {
                 fmt++;
                 precision = NX_VarArg(args, int);
             }
-            if(precision < 0)
+            if (precision < 0)
             {
                 precision = 0;
             }
         }
-        
+
         qualifier = -1;
-        if(*fmt == 'h' || *fmt == 'l' || *fmt == 'L' || *fmt == 'Z')
-        {	
+        if (*fmt == 'h' || *fmt == 'l' || *fmt == 'L' || *fmt == 'Z')
+        {
             qualifier = *fmt;
             fmt++;
         }
 
-        switch(*fmt)
+        switch (*fmt)
         {
         case 'c':
-            if(!(flags & LEFT))
+            ch = (unsigned char)NX_VarArg(args, int);
+            if (!(flags & LEFT))
             {
-                while(--fieldWidth > 0)
-                {
-                    *str++ = ' ';
-                }
+                PrintPad(state, ' ', fieldWidth - 1);
             }
-            *str++ = (unsigned char)NX_VarArg(args, int);
-            while(--fieldWidth > 0)
+            PrintOut(state, &ch, 1);
+            if (flags & LEFT)
             {
-                *str++ = ' ';
+                PrintPad(state, ' ', fieldWidth - 1);
             }
             break;
+
         case 's':
-            s = NX_VarArg(args,char *);
-            if(!s)
-            {
-                s = '\0';
-            }
-            len = NX_StrLen(s);
-            if(precision < 0)
-            {
-                precision = len;
-            }
-            else if(len > precision)
+            s = NX_VarArg(args, char *);
+            if (!s)
             {
-                len = precision;
+                s = "";
             }
-            
-            if(!(flags & LEFT))
+            if (fieldWidth <= 0)
             {
-                while(len < fieldWidth--)
-                {
-                    *str++ = ' ';
-                }
+                /* length is not needed without width, copy in one pass */
+                PrintStr(state, s, precision < 0 ? (NX_USize)-1 : (NX_USize)precision, '\0');
+                break;
             }
-            for(i = 0;i < len ;i++)
+            len = precision < 0 ? NX_StrLen(s) : (int)NX_StrNLen(s, precision);
+            if (!(flags & LEFT))
             {
-                *str++ = *s++;
+                PrintPad(state, ' ', fieldWidth - len);
             }
-            while(len < fieldWidth--)
+            PrintOut(state, s, len);
+            if (flags & LEFT)
             {
-                *str++ = ' ';
+                PrintPad(state, ' ', fieldWidth - len);
             }
             break;
 
         case 'o':
-            if(qualifier == 'l')
-            {
-                str = _Number(str, NX_VarArg(args, unsigned long), 8, fieldWidth, precision, flags);
-            }
-            else
-            {
-                str = _Number(str, NX_VarArg(args, unsigned int), 8, fieldWidth, precision, flags);
-            }
+            num = qualifier == 'l' ? NX_VarArg(args, unsigned long) : NX_VarArg(args, unsigned int);
+            PrintNumber(state, num, 8, fieldWidth, precision, flags);
             break;
 
         case 'p':
-            if(fieldWidth == -1)
+            if (fieldWidth == -1)
             {
                 fieldWidth = 2 * sizeof(void *);
                 flags |= ZEROPAD;
             }
-
-            str = _Number(str, (unsigned long)NX_VarArg(args, void *), 16, fieldWidth, precision, flags);
+            PrintNumber(state, (unsigned long)NX_VarArg(args, void *), 16, fieldWidth, precision, flags);
             break;
 
         case 'x':
             flags |= SMALL;
-
         case 'X':
-            if(qualifier == 'l')
-            {
-                str = _Number(str, NX_VarArg(args, unsigned long), 16, fieldWidth, precision, flags);
-            }
-            else
-            {
-                str = _Number(str, NX_VarArg(args, unsigned int), 16, fieldWidth, precision, flags);
-            }
+            num = qualifier == 'l' ? NX_VarArg(args, unsigned long) : NX_VarArg(args, unsigned int);
+            PrintNumber(state, num, 16, fieldWidth, precision, flags);
             break;
 
         case 'd':
         case 'i':
             flags |= SIGN;
+            num = qualifier == 'l' ? NX_VarArg(args, long) : NX_VarArg(args, int);
+            PrintNumber(state, num, 10, fieldWidth, precision, flags);
+            break;
+
         case 'u':
-            if(qualifier == 'l')
-            {
-                str = _Number(str, NX_VarArg(args, long), 10, fieldWidth, precision, flags);
-            }
-            else
-            {
-                str = _Number(str, NX_VarArg(args, int), 10, fieldWidth, precision, flags);
-            }
+            num = qualifier == 'l' ? NX_VarArg(args, unsigned long) : NX_VarArg(args, unsigned int);
+            PrintNumber(state, num, 10, fieldWidth, precision, flags);
             break;
 
         case 'n':
-            if(qualifier == 'l')
+            if (qualifier == 'l')
             {
                 long *ip = NX_VarArg(args, long *);
-                *ip = (str - buf);
+                *ip = state->count + (state->pos - state->base);
             }
             else
             {
                 int *ip = NX_VarArg(args, int *);
-                *ip = (str - buf);
+                *ip = state->count + (state->pos - state->base);
             }
             break;
 
         case '%':
-            *str++ = '%';
+            PrintOut(state, "%", 1);
             break;
 
         default:
-            *str++ = '%';	
-            if(*fmt)
+            PrintOut(state, "%", 1);
+            if (*fmt)
             {
-                *str++ = *fmt;
+                PrintOut(state, fmt, 1);
             }
             else
             {
@@ -354,14 +471,69 @@ NX_PUBLIC int NX_VSNPrintf(char *buf, int bufLen, const char *fmt, NX_VarList ar
             }
             break;
         }
-	}
-	*str = '\0';
-	return str - buf;
+        fmt++;
+    }
+}
+
+/**
+ * Format to sink, which is called with chunks of output. Return chars output.
+ */
+NX_PUBLIC int NX_VSinkPrintf(NX_PrintSink sink, void *sinkArg, const char *fmt, NX_VarList args)
+{
+    PrintState state;
+
+    state.base = state.pos = state.chunk;
+    state.end = state.chunk + PRINT_CHUNK_LEN;
+    state.sink = sink;
+    state.sinkArg = sinkArg;
+    state.count = 0;
+    PrintFormat(&state, fmt, args);
+    PrintFlush(&state);
+    return state.count;
+}
+
+NX_PUBLIC int NX_SinkPrintf(NX_PrintSink sink, void *sinkArg, const char *fmt, ...)
+{
+    NX_VarList arg;
+    int len;
+
+    NX_VarStart(arg, fmt);
+    len = NX_VSinkPrintf(sink, sinkArg, fmt, arg);
+    NX_VarEnd(arg);
+    return len;
+}
+
+/**
+ * Store at most bufLen - 1 chars and NUL to buf. Return length of whole
+ * output, it is not less than bufLen if output is truncated.
+ */
+NX_PUBLIC int NX_VSNPrintf(char *buf, int bufLen, const char *fmt, NX_VarList args)
+{
+    PrintState state;
+    NX_USize size = bufLen > 0 ? bufLen - 1 : 0;
+
+    /* chars after buffer full are dropped by the chunk */
+    state.base = state.pos = buf;
+    state.end = buf + size;
+    state.sink = NX_NULL;
+    state.sinkArg = NX_NULL;
+    state.count = 0;
+    PrintFormat(&state, fmt, args);
+    if (bufLen > 0)
+    {
+        *(state.base == buf ? state.pos : buf + size) = '\0';
+    }
+    PrintFlush(&state);
+    return state.count;
 }
 
 NX_PUBLIC int NX_SNPrintf(char *buf, int buflen, const char *fmt, ...)
 {
-	NX_VarList arg;
-	NX_VarStart(arg, fmt);
-	return NX_VSNPrintf(buf, buflen, fmt, arg);
+    NX_VarList arg;
+    int len;
+
+    NX_VarStart(arg, fmt);
+    len = NX_VSNPrintf(buf, buflen, fmt, arg);
+    NX_VarEnd(arg);
+    return len;
 }
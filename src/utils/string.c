@@ -10,8 +10,32 @@
  */
 
 #include <utils/string.h>
+#include <utils/memory.h>
 #include <utils/log.h>
 
+/* byte loops here must not be replaced with calls to strlen & memcpy */
+#pragma GCC optimize("no-tree-loop-distribute-patterns")
+
+#define WORD_SIZE   sizeof(NX_UArch)
+#define WORD_MASK   (WORD_SIZE - 1)
+
+#define WORD_ONES   ((NX_UArch)-1 / 0xFF)   /* 0x01 in each byte */
+#define WORD_HIGHS  (WORD_ONES << 7)        /* 0x80 in each byte */
+
+/**
+ * Not zero if any byte of word is zero. Only bytes above a zero byte can
+ * be wrong with borrow, so it is exact about whether there is a zero.
+ */
+#define WORD_HAS_ZERO(w) (((w) - WORD_ONES) & ~(w) & WORD_HIGHS)
+
+/**
+ * Word may alias any type. Only aligned words are read, an aligned word
+ * never crosses a page, so bytes read after NUL are always accessible.
+ */
+typedef NX_UArch __attribute__((__may_alias__)) StrWord;
+
+#define STR_WORD_ALIGNED(a, b) (!(((NX_Addr)(a) ^ (NX_Addr)(b)) & WORD_MASK))
+
 NX_PUBLIC char *NX_StrCopy(const char *dst, const char *src)
 {
     if (dst == NX_NULL || src == NX_NULL)
@@ -20,12 +44,35 @@ NX_PUBLIC char *NX_StrCopy(const char *dst, const char *src)
         return NX_NULL;
     }
     char *dstPtr = (char *) dst;
+
+    if (STR_WORD_ALIGNED(dstPtr, src))
+    {
+        while ((NX_Addr)src & WORD_MASK)
+        {
+            if ((*dstPtr++ = *src++) == '\0')
+            {
+                return (char *)dst;
+            }
+        }
+        /* copy words without NUL, the last word is copied with bytes */
+        while (!WORD_HAS_ZERO(*(const StrWord *)src))
+        {
+            *(StrWord *)dstPtr = *(const StrWord *)src;
+            dstPtr += WORD_SIZE;
+            src += WORD_SIZE;
+        }
+    }
+
     while ((*dstPtr++ = *src++))
     {
     }
     return (char *)dst;
 }
 
+/**
+ * Copy src to dst until NUL copied or len bytes copied, dst is not
+ * terminated if src is not shorter than len.
+ */
 NX_PUBLIC char *NX_StrCopyN(const char *dst, const char *src, NX_USize len)
 {
     if (dst == NX_NULL || src == NX_NULL || !len)
@@ -34,12 +81,56 @@ NX_PUBLIC char *NX_StrCopyN(const char *dst, const char *src, NX_USize len)
         return NX_NULL;
     }
     char *dstPtr = (char *) dst;
-    while ((*dstPtr++ = *src++) && len-- > 0)
+
+    if (len >= WORD_SIZE && STR_WORD_ALIGNED(dstPtr, src))
+    {
+        while ((NX_Addr)src & WORD_MASK)
+        {
+            if ((*dstPtr++ = *src++) == '\0')
+            {
+                return (char *)dst;
+            }
+            len--;
+        }
+        while (len >= WORD_SIZE && !WORD_HAS_ZERO(*(const StrWord *)src))
+        {
+            *(StrWord *)dstPtr = *(const StrWord *)src;
+            dstPtr += WORD_SIZE;
+            src += WORD_SIZE;
+            len -= WORD_SIZE;
+        }
+    }
+
+    while (len-- > 0 && (*dstPtr++ = *src++))
     {
     }
     return (char *)dst;
 }
 
+/**
+ * Copy at most size - 1 bytes of src to dst, dst is always terminated if
+ * size is not 0. Return length of src, truncated if not less than size.
+ */
+NX_PUBLIC NX_USize NX_StrLCopy(char *dst, const char *src, NX_USize size)
+{
+    NX_USize len;
+    NX_USize copyLen;
+
+    if (dst == NX_NULL || src == NX_NULL)
+    {
+        return 0;
+    }
+
+    len = NX_StrLen(src);
+    if (size > 0)
+    {
+        copyLen = len < size ? len : size - 1;
+        NX_MemCopy(dst, (void *)src, copyLen);
+        dst[copyLen] = '\0';
+    }
+    return len;
+}
+
 NX_PUBLIC int NX_StrCmp(const char *a, const char *b)
 {
     if (a == NX_NULL || b == NX_NULL)
@@ -48,6 +139,25 @@ NX_PUBLIC int NX_StrCmp(const char *a, const char *b)
         return 0;
     }
 
+    if (STR_WORD_ALIGNED(a, b))
+    {
+        while ((NX_Addr)a & WORD_MASK)
+        {
+            if (*a == '\0' || *a != *b)
+            {
+                return (*a - *b);
+            }
+            a++;
+            b++;
+        }
+        /* skip equal words without NUL, the first other word is compared with bytes */
+        while (*(const StrWord *)a == *(const StrWord *)b && !WORD_HAS_ZERO(*(const StrWord *)a))
+        {
+            a += WORD_SIZE;
+            b += WORD_SIZE;
+        }
+    }
+
     while (*a && *a == *b)
     {
         a++;
@@ -65,6 +175,62 @@ NX_PUBLIC int NX_StrLen(const char *str)
         return 0;
     }
     const char *p = str;
-    while(*p++);
-    return (p - str - 1);
+
+    while ((NX_Addr)p & WORD_MASK)
+    {
+        if (*p == '\0')
+        {
+            return (p - str);
+        }
+        p++;
+    }
+    while (!WORD_HAS_ZERO(*(const StrWord *)p))
+    {
+        p += WORD_SIZE;
+    }
+
+    while (*p)
+    {
+        p++;
+    }
+    return (p - str);
+}
+
+/**
+ * Length of str, but not more than maxLen. Bytes after maxLen may be read
+ * in the same word, never touch next word.
+ */
+NX_PUBLIC NX_USize NX_StrNLen(const char *str, NX_USize maxLen)
+{
+    if (str == NX_NULL)
+    {
+        return 0;
+    }
+    const char *p = str;
+    const char *end;
+
+    if (maxLen > (NX_Addr)-1 - (NX_Addr)str)
+    {
+        maxLen = (NX_Addr)-1 - (NX_Addr)str;   /* limit to the end of address space */
+    }
+    end = str + maxLen;
+
+    while (p < end && ((NX_Addr)p & WORD_MASK))
+    {
+        if (*p == '\0')
+        {
+            return (p - str);
+        }
+        p++;
+    }
+    while (p < end && !WORD_HAS_ZERO(*(const StrWord *)p))
+    {
+        p += WORD_SIZE;
+    }
+
+    while (p < end && *p)
+    {
+        p++;
+    }
+    return (p < end ? p : end) - str;
 }
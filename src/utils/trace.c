@@ -0,0 +1,127 @@
+/**
+ * Copyright (c) 2018-2022, BookOS Development Team
+ * SPDX-License-Identifier: Apache-2.0
+ * 
+ * Contains: Binary event trace
+ */
+
+#include <utils/trace.h>
+
+#ifdef CONFIG_NX_TRACE
+
+#include <mods/console/console.h>
+#include <mods/time/clock.h>
+#include <sched/thread.h>
+#include <sched/smp.h>
+#include <io/irq.h>
+
+#if (NX_TRACE_EVENTS & (NX_TRACE_EVENTS - 1))
+#error "trace events must be power of 2"
+#endif
+
+/**
+ * Records of one cpu, only written by the cpu with interrupt disabled.
+ * The oldest record is overwritten when full.
+ */
+struct TraceRing
+{
+    NX_UArch head;  /* records written */
+    NX_TraceRecord records[NX_TRACE_EVENTS];
+};
+typedef struct TraceRing TraceRing;
+
+NX_PRIVATE TraceRing TraceRingArray[NX_MULTI_CORES_NR];
+
+NX_PRIVATE NX_VOLATILE NX_Bool TraceEnabled = NX_True;
+
+NX_IMPORT NX_ThreadManager NX_ThreadManagerObject;
+
+NX_PUBLIC void NX_TraceEmit(NX_U16 event, NX_U64 arg0, NX_U64 arg1, NX_U64 arg2)
+{
+    TraceRing *ring;
+    NX_TraceRecord *record;
+    NX_UArch level;
+    NX_UArch coreId;
+
+    if (!TraceEnabled)
+    {
+        return;
+    }
+
+    level = NX_IRQ_SaveLevel();
+    coreId = NX_SMP_GetIdx();
+    ring = &TraceRingArray[coreId];
+    record = &ring->records[ring->head & (NX_TRACE_EVENTS - 1)];
+    record->time = NX_ClockCounterGet();
+    record->cpu = coreId;
+    record->event = event;
+    record->reserved = 0;
+    record->args[0] = arg0;
+    record->args[1] = arg1;
+    record->args[2] = arg2;
+    ring->head++;
+    NX_IRQ_RestoreLevel(level);
+}
+
+NX_PUBLIC void NX_TraceEnable(NX_Bool enable)
+{
+    TraceEnabled = enable;
+}
+
+NX_PRIVATE void TracePrintU64(NX_U64 value)
+{
+    NX_Printf(" %08x%08x", (NX_U32)(value >> 32), (NX_U32)value);
+}
+
+/**
+ * Print records to console as text, so dump is captured with console log
+ * and decoded by scripts/trace2json.py on host. Records are cleared after.
+ */
+NX_PUBLIC void NX_TraceDump(void)
+{
+    TraceRing *ring;
+    NX_TraceRecord *record;
+    NX_Thread *thread;
+    NX_Bool enabled = TraceEnabled;
+    NX_UArch level;
+    NX_UArch begin;
+    NX_UArch i;
+    int coreId;
+    int arg;
+
+    TraceEnabled = NX_False;
+
+    NX_Printf("NX_TRACE_BEGIN %d", NX_MULTI_CORES_NR);
+    TracePrintU64(NX_ClockCounterFreq());
+    NX_Printf(NX_CON_NEWLINE);
+
+    NX_SpinLockIRQ(&NX_ThreadManagerObject.lock, &level);
+    NX_ListForEachEntry(thread, &NX_ThreadManagerObject.globalList, globalList)
+    {
+        NX_Printf("NX_TRACE_THREAD %d %s" NX_CON_NEWLINE, thread->tid, thread->name);
+    }
+    NX_SpinUnlockIRQ(&NX_ThreadManagerObject.lock, level);
+
+    for (coreId = 0; coreId < NX_MULTI_CORES_NR; coreId++)
+    {
+        ring = &TraceRingArray[coreId];
+        begin = ring->head > NX_TRACE_EVENTS ? ring->head - NX_TRACE_EVENTS : 0;
+        for (i = begin; i < ring->head; i++)
+        {
+            record = &ring->records[i & (NX_TRACE_EVENTS - 1)];
+            NX_Printf("NX_TRACE %d %d", record->cpu, record->event);
+            TracePrintU64(record->time);
+            for (arg = 0; arg < NX_TRACE_ARGS; arg++)
+            {
+                TracePrintU64(record->args[arg]);
+            }
+            NX_Printf(NX_CON_NEWLINE);
+        }
+        ring->head = 0;
+    }
+
+    NX_Printf("NX_TRACE_END" NX_CON_NEWLINE);
+    TraceEnabled = enabled;
+}
+
+#endif /* CONFIG_NX_TRACE */